@@ -4,5 +4,9 @@
 
 USER_OBJS :=
 
-LIBS := -lopengl32 -lglu32 -lfreeglut -lm
+ifeq ($(OS),Windows_NT)
+LIBS := -lopengl32 -lglu32 -lfreeglut -lm -lpthread -lws2_32
+else
+LIBS := -lGL -lGLU -lglut -lEGL -lm -lpthread -lrt
+endif
 
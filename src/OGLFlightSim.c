@@ -38,13 +38,110 @@
  */
 
 #include "OGLFlightSim.h"
-#include "Common.h"
+#include "common.h"
+#include "hud.h"
+#include "timer.h"
+#include "rng.h"
+#include "glFunctions.h"
+#include "jobs.h"
+#include "aircraftRenderer.h"
+#include "server.h"
+#include "bots.h"
+#include "batch.h"
+#include "simplify.h"
+#include "latency.h"
+#include "erosion.h"
+#include "telemetry.h"
+#include "capture.h"
 /**
  * main
  * The main method initially run. Creates the context of the application and begins the display loop.
  */
 int main(int argc, char** argv) {
+	//parseArguments takes out what it reads, a sweep passes it all on
+	int originalArgc = argc;
+	char** originalArgv = malloc(sizeof(char*) * (argc + 1));
+	memcpy(originalArgv, argv, sizeof(char*) * (argc + 1));
+	parseArguments(&argc, argv);
+	if (printConfig == 1) {
+		configWrite(&config, stdout);
+		return 0;
+	}
+	if (sweepFileName != NULL) {
+		//before the workers start, every point runs in its own process
+		runSweep(originalArgc, originalArgv);
+		return 0;
+	}
+	jobsInit(numThreads);
+	if (sweepPoint == 1) {
+		runSweepPoint();
+		return 0;
+	}
+	if (serverMode == 1) {
+		runServer();
+		return 0;
+	}
+	if (benchNetCount > 0) {
+		runNetBenchmark();
+		return 0;
+	}
+	if (botCount > 0) {
+		runBots();
+		return 0;
+	}
+	if (benchAiCount > 0) {
+		runAiBenchmark();
+		return 0;
+	}
+	if (benchFlight == 1) {
+		runFlightBenchmark();
+		return 0;
+	}
+	if (batchWorlds > 0) {
+		runBatch();
+		return 0;
+	}
+	if (benchRender == 1) {
+		runRenderBenchmark();
+		return 0;
+	}
+	if (benchResets > 0) {
+		runResetBenchmark();
+		return 0;
+	}
+	if (buildLods == 1) {
+		runBuildLods();
+		return 0;
+	}
+	if (benchErosion == 1) {
+		runErosionBenchmark();
+		return 0;
+	}
+	if (benchTransformCount > 0) {
+		runTransformBenchmark();
+		return 0;
+	}
+	if (benchSpatial == 1) {
+		runSpatialBenchmark();
+		return 0;
+	}
+	if (telemetryTail == 1) {
+		runTelemetryTail();
+		return 0;
+	}
+	if (checkReplayFileName != NULL) {
+		runReplayCheck();
+		return 0;
+	}
 	init(argc, argv);
+	if (headless == 1) {
+		//replay as fast as possible without a window
+		while (replayDone == 0) {
+			tick();
+		}
+		finishReplay();
+		return 0;
+	}
 	printf(" * w - toggles between frame and solid rendering\n");
 	printf(" * f - toggles between fullscreen and windowed mode\n");
 	printf(" * b - toggle fog on or off\n");
@@ -62,6 +159,7 @@ int main(int argc, char** argv) {
 	printf(" * Bonuses:\n");
 	printf(" *  f1 - toggle between standard and alternate controls\n");
 	printf(" *  f2 - toggle between standard fog and cloud-like fog\n");
+	printf(" *  f3 - toggle the 6-DOF flight model, see README\n");
 	printf(" *  z - shoot bullets\n");
 	printf(" *  Spedometer (Shows speed roughly, green bar bottom left)\n");
 	printf(" *  Altometer (Shows altitude roughly, blue bar bottom right)\n");
@@ -72,6 +170,36 @@ int main(int argc, char** argv) {
 	printf(" *  mouse on top of screen - Tilt plane and camera up\n");
 	printf(" *  mouse on bottom of screen - Title plane and camera down\n");
 	printf(" *  scroll wheel - increase or decrease speed\n");
+	printf(" * Command line:\n");
+	printf(" *  --record file - record the seed and all input to file\n");
+	printf(" *  --replay file - replay a recording in real time\n");
+	printf(" *  --headless - with --replay, replay at full speed without a window\n");
+	printf(" *  --check-replay file - record a scripted flight to file and check its replay\n");
+	printf(" *  --seed n - generate the world from a fixed seed\n");
+	printf(" *  --bench-render - offscreen rendering benchmark, see README\n");
+	printf(" *  --bench-reset n - time n world resets and check they leak nothing\n");
+	printf(" *  --ai n - add n AI aircraft\n");
+	printf(" *  --bench-ai n - time the AI update of n aircraft without a window\n");
+	printf(" *  --bench-flight - time the flight model for 1, 1000 and 100000 aircraft\n");
+	printf(" *  --batch n - fly n headless worlds with scripted pilots, see README\n");
+	printf(" *  --build-lods - write the simplified aircraft models, see README\n");
+	printf(" *  --map-size n - height map cells along each island (default 81)\n");
+	printf(" *  --erosion f - erode the islands with f droplets per cell, see README\n");
+	printf(" *  --world-cache dir - keep generated worlds in dir and load them from there\n");
+	printf(" *  --bench-erosion - time island erosion at growing map sizes\n");
+	printf(" *  --bench-transform n - time the transform hierarchy of n aircraft\n");
+	printf(" *  --bench-spatial - time the spatial hash and its queries at 1k, 10k and 100k aircraft\n");
+	printf(" *  --latency n - measure input to present latency of n synthetic inputs\n");
+	printf(" *  --capture file - capture every frame to a Y4M video, see README\n");
+	printf(" *  --telemetry - publish the state every tick to shared memory, see README\n");
+	printf(" *  --telemetry-tail - print the stream of a running --telemetry sim\n");
+	printf(" *  --config file - read settings from file, see README\n");
+	printf(" *  --set key=value - override one setting, --print-config lists them\n");
+	printf(" *  --sweep file.csv - measure the sim and renderer over a grid of settings, see README\n");
+	printf(" *  --threads n - worker threads including the main one (default one per core)\n");
+	printf(" *  --server - run a multiplayer server without a window\n");
+	printf(" *  --connect host - join a multiplayer server\n");
+	printf(" *  --bots n, --bench-net n - multiplayer load tests, see README\n");
 	glutMainLoop();
 	return 0;
 }
@@ -81,36 +209,117 @@ int main(int argc, char** argv) {
  * Displays the controls in standard out.
  */
 void init(int argc, char** argv) {
-	float seed = time(NULL);
-	//printf("Seed: %f\n", seed);
+	RecordHeader header;
+	if (fixedSeed == 0) {
+		worldSeed = time(NULL);
+	}
+	if (replayFileName != NULL) {
+		if (!replayOpen(replayFileName, &header)) {
+			exit(1);
+		}
+		worldSeed = header.seed;
+		sim.inputWidth = header.width;
+		sim.inputHeight = header.height;
+		if (header.tickMs > 0) {
+			tickMs = sim.tickMs = header.tickMs;
+		}
+	} else if (headless == 1) {
+		printf("--headless needs a recording to --replay.\n");
+		exit(1);
+	}
+	if (latencyEvents > 0 && replayFileName != NULL) {
+		//replayed input never arrives through the callbacks
+		printf("--latency measures live input and cannot --replay.\n");
+		exit(1);
+	}
+	if (connectHost != NULL) {
+		//the server owns the world seed
+		connectToServer();
+	}
+	if (recordFileName != NULL) {
+		header.seed = worldSeed;
+		header.width = sim.inputWidth;
+		header.height = sim.inputHeight;
+		header.tickMs = tickMs;
+		recordStart(recordFileName, &header);
+	}
+	//printf("Seed: %u\n", worldSeed);
 
-	srand(seed);
-	initGLUT(argc, argv);
+	if (!worldInit(&world)) {
+		printf("Could not create the world.\n");
+		exit(1);
+	}
+	worldNew(&world, worldSeed, &sim);
+	if (telemetryEnabled == 1 && !telemetryOpenPublisher(TELEMETRY_NAME)) {
+#ifdef _WIN32
+		printf("Telemetry needs POSIX shared memory, which is not available here.\n");
+#else
+		printf("Could not create the telemetry stream %s.\n", TELEMETRY_NAME);
+#endif
+		exit(1);
+	}
+	if (headless == 0) {
+		initGLUT(argc, argv);
+		loadGLFunctions((GlGetProcAddress) glutGetProcAddress);
+	}
+	initResources();
 	initNew();
-	initGL();
+	if (headless == 0) {
+		initGL();
+		hudInit();
+		initAircraftRenderer();
+		initMinimap();
+	}
+	if (latencyEvents > 0) {
+		startLatency();
+	}
+	if (captureFileName != NULL) {
+		startCapture(appWidth, appHeight);
+	}
+	replayStartTime = timerNow();
 }
 /**
- * initNew
- * Initializes a new world
+ * initResources
+ * Initializes the GL resources every world shares, once.
  */
-void initNew() {
-	numBullets = 0;
-	maxNumBullets = 100;
-	currentBullet = 0;
-	targetScale = 1;
-	firstBullet = NULL;
-	currBullet = NULL;
+void initResources() {
+	if (headless == 1) {
+		//the terrain is never collided with, so a headless world has no GL resources
+		return;
+	}
 	initTextures();
 	initSea();
 	initSky();
-	initTarget();
 	initGrid();
-	initAxis();
-	initMountains();
-	planeId = loadModel(planeId, 6764, "./resources/cessna.txt", 1);
-	propId = loadModel(propId, 6764, "./resources/propeller.txt", 2);
+	loadModel(&planeModel, "./resources/cessna", 1);
+	loadModel(&propModel, "./resources/propellar", 2);
+	initScene();
 	initLight();
-
+}
+/**
+ * initNew
+ * Rebuilds the GL resources that depend on the seed, only the terrain, call
+ * after worldNew.
+ */
+void initNew() {
+	if (headless == 1) {
+		return;
+	}
+	initMountains();
+}
+/**
+ * resetWorld
+ * Replaces the world with a new one from worldSeed in place, keeping every
+ * GL resource except the terrain, which is recompiled into its display list.
+ */
+void resetWorld() {
+	worldNew(&world, worldSeed, &sim);
+	initNew();
+	sim.boolAccelerate = 0;
+	sim.boolDeaccelerate = 0;
+	sim.boolMoveUp = 0;
+	sim.boolMoveDown = 0;
+	sim.boolShoot = 0;
 }
 /**
  * initLight
@@ -145,61 +354,19 @@ void initLight() {
  * colorMountainByHeight
  * Colors a mountain vertex based on its height.
  */
-void colorMountainByHeight(float x, float y, float z,
-		float mountainDetailAccuracy) {
-
-	GLfloat diffuseMaterial[] = { 0.0, 0.0, 0.0, 1.0 };
+void colorMountainByHeight(float y, GLfloat color[4]) {
+	const GLfloat* diffuseMaterial;
 	if (y < 7) {
-		diffuseMaterial[0] = darkgreen[0];
-		diffuseMaterial[1] = darkgreen[1];
-		diffuseMaterial[2] = darkgreen[2];
-		diffuseMaterial[3] = darkgreen[3];
+		diffuseMaterial = darkgreen;
 	} else if (y < 15) {
-		diffuseMaterial[0] = lightgreen[0];
-		diffuseMaterial[1] = lightgreen[1];
-		diffuseMaterial[2] = lightgreen[2];
-		diffuseMaterial[3] = lightgreen[3];
+		diffuseMaterial = lightgreen;
 	} else {
-		diffuseMaterial[0] = white[0];
-		diffuseMaterial[1] = white[1];
-		diffuseMaterial[2] = white[2];
-		diffuseMaterial[3] = white[3];
-	}
-	glColor4f(diffuseMaterial[0], diffuseMaterial[1], diffuseMaterial[2],
-			diffuseMaterial[3]);
-}
-/**
- * raiseMountain
- * Recurssive function to randomize the heights of a heightmap using midpoints.
- *
- */
-void raiseMountain(float map[mountainDetailAccuracy][mountainDetailAccuracy],
-		int left, int right, int top, int bottom, int iteration) {
-	if (iteration >= 8) {
-		return;
+		diffuseMaterial = white;
 	}
-	int width = right - left;
-	int height = bottom - top;
-	map[left + (width / 2)][top + (height / 2)] += randBetween(0, 4)
-			/ (2.0f * iteration);
-	map[left][top + (height / 2)] += randBetween(0, 4) / (2.0f * iteration);
-	map[left + (width / 2)][top] += randBetween(0, 4) / (2.0f * iteration);
-	map[left + (width - 1)][top + (height / 2)] += randBetween(0, 4)
-			/ (2.0f * iteration);
-	map[left + (width / 2)][top + (height - 1)] += randBetween(0, 4)
-			/ (2.0f * iteration);
-
-	iteration++;
-
-	raiseMountain(map, left, left + (width / 2), top, bottom - (height / 2),
-			iteration);
-	raiseMountain(map, left + (width / 2), right, top, bottom - (height / 2),
-			iteration);
-	raiseMountain(map, left, left + (width / 2), top + (height / 2), bottom,
-			iteration);
-	raiseMountain(map, left + (width / 2), right, top + (height / 2), bottom,
-			iteration);
-
+	color[0] = diffuseMaterial[0];
+	color[1] = diffuseMaterial[1];
+	color[2] = diffuseMaterial[2];
+	color[3] = diffuseMaterial[3];
 }
 /**
  * calcNormal
@@ -232,329 +399,517 @@ Point calcNormal(float x1, float y1, float z1, float x2, float y2, float z2, flo
  * calcVertexNormal
  * Calculates the normal for a vertex using the normals of polygons around it.
  */
-void calcVertexNormal(float map[mountainDetailAccuracy][mountainDetailAccuracy], float jitterX[mountainDetailAccuracy][mountainDetailAccuracy], float jitterZ[mountainDetailAccuracy][mountainDetailAccuracy], int x, int z) {
-	Point topleft = calcNormal(x+jitterX[x][z], map[x][z], z+jitterZ[x][z], //
-			x+jitterX[x][z-1], map[x][z - 1], z - 1 +jitterZ[x][z-1], //
-			x - 1+jitterX[x-1][z], map[x - 1][z], z+jitterZ[x-1][z]);
-	Point topright = calcNormal(x+jitterX[x][z], map[x][z], z+jitterZ[x][z], //
-			x + 1+jitterX[x+1][z], map[x + 1][z], z+jitterZ[x+1][z], //
-			x+jitterX[x][z-1], map[x][z - 1], z - 1+jitterZ[x][z-1]);
-	Point bottomleft = calcNormal(x+jitterX[x][z], map[x][z], z+jitterZ[x][z], //
-			x+jitterX[x][z+1], map[x][z + 1], z + 1+jitterZ[x][z+1], //
-			x - 1+jitterX[x-1][z], map[x - 1][z], z+jitterZ[x-1][z]);
-	Point bottomright = calcNormal(x+jitterX[x][z], map[x][z], z+jitterZ[x][z], //
-			x+jitterX[x][z+1], map[x][z + 1], z + 1+jitterZ[x][z+1], //
-			x + 1+jitterX[x+1][z+1], map[x + 1][z], z+jitterZ[x+1][z]);
-	float nx = (topleft.nx + topright.nx + bottomleft.nx + bottomright.nx)
+void calcVertexNormal(const Island* island, int mapSize, int x, int z, GLfloat normal[3]) {
+#define H(x, z) island->heights[(x) * mapSize + (z)]
+#define JX(x, z) island->jitterX[(x) * mapSize + (z)]
+#define JZ(x, z) island->jitterZ[(x) * mapSize + (z)]
+	Point topleft = calcNormal(x+JX(x,z), H(x,z), z+JZ(x,z), //
+			x+JX(x,z-1), H(x,z - 1), z - 1 +JZ(x,z-1), //
+			x - 1+JX(x-1,z), H(x - 1,z), z+JZ(x-1,z));
+	Point topright = calcNormal(x+JX(x,z), H(x,z), z+JZ(x,z), //
+			x + 1+JX(x+1,z), H(x + 1,z), z+JZ(x+1,z), //
+			x+JX(x,z-1), H(x,z - 1), z - 1+JZ(x,z-1));
+	Point bottomleft = calcNormal(x+JX(x,z), H(x,z), z+JZ(x,z), //
+			x+JX(x,z+1), H(x,z + 1), z + 1+JZ(x,z+1), //
+			x - 1+JX(x-1,z), H(x - 1,z), z+JZ(x-1,z));
+	Point bottomright = calcNormal(x+JX(x,z), H(x,z), z+JZ(x,z), //
+			x+JX(x,z+1), H(x,z + 1), z + 1+JZ(x,z+1), //
+			x + 1+JX(x+1,z+1), H(x + 1,z), z+JZ(x+1,z));
+#undef H
+#undef JX
+#undef JZ
+	normal[0] = (topleft.nx + topright.nx + bottomleft.nx + bottomright.nx)
 			/ 4.0f;
-	float ny = (topleft.ny + topright.ny + bottomleft.ny + bottomright.ny)
+	normal[1] = (topleft.ny + topright.ny + bottomleft.ny + bottomright.ny)
 			/ 4.0f;
-	float nz = (topleft.nz + topright.nz + bottomleft.nz + bottomright.nz)
+	normal[2] = (topleft.nz + topright.nz + bottomleft.nz + bottomright.nz)
 			/ 4.0f;
-	glNormal3f(nx, ny, nz);
 }
 /**
- * drawMountain
- * Draws a randomly generated mountain
+ * calcIslandNormals
+ * Calculates the normal of every vertex of an island once, the outer edge is
+ * flat so its normals are straight up.
  */
-void drawMountain(float mountainDetailAccuracy, int maxIterations) {
+void calcIslandNormals(const Island* island, int mapSize, GLfloat* normals) {
 	int x, z;
-	int mapSize = (int) mountainDetailAccuracy;
-	float map[mapSize][mapSize];
-	float jitterX[mapSize][mapSize];
-	float jitterZ[mapSize][mapSize];
-	//initialize the heights to be in a cone-like shape based on distance from center
 	for (x = 0; x < mapSize; x++) {
 		for (z = 0; z < mapSize; z++) {
-			float distance =
-					sqrt((pow((mapSize/2)-x,2))+(pow((mapSize/2)-z,2)))
-							* 0.9f;
-			map[x][z] = ((mapSize / 2) - distance) / 2.0f;
-			//generate some random jitter to be applied to x and z values when drawing (so peaks aren't always straight up)
-			jitterX[x][z] = (randBetween(0, 200) - 100) / 200.0f;
-			jitterZ[x][z] = (randBetween(0, 200) - 100) / 200.0f;
-			if (map[x][z] < 0) {
-				map[x][z] = 0;
+			GLfloat* normal = &normals[(x * mapSize + z) * 3];
+			if (x == 0 || z == 0 || x == mapSize - 1 || z == mapSize - 1) {
+				normal[0] = 0;
+				normal[1] = 1;
+				normal[2] = 0;
+			} else {
+				calcVertexNormal(island, mapSize, x, z, normal);
 			}
 		}
 	}
-	//recussively raise the mountain to give it peaks and valleys, ignore the edges
-	raiseMountain(map, 1, mapSize - 1, 1, mapSize - 1, 1);
-
-	//change the outeredge to always be flat on the ground (so their normals will be 0, 1, 0
-	int i;
-	for (i = 0; i < mapSize; i++) {
-		map[i][0] = 0.0;
-		map[i][mapSize - 1] = 0.0;
-		map[0][i] = 0.0;
-		map[mapSize - 1][i] = 0.0;
-	}
-
-	//draw the mountain
-	for (x = 0; x < mountainDetailAccuracy - 1; x++) {
-		for (z = 0; z < mountainDetailAccuracy - 1; z++) {
-			glBegin(GL_POLYGON);
-
+}
+/**
+ * buildMountainVertex
+ * Writes one vertex of an island: position, normal, color and texture coordinates.
+ */
+GLfloat* buildMountainVertex(const Island* island, int mapSize, int x, int z,
+		const GLfloat* normal, const GLfloat* color, GLfloat* out) {
+	int i = x * mapSize + z;
+	out[0] = x + island->jitterX[i];
+	out[1] = island->heights[i];
+	out[2] = z + island->jitterZ[i];
+	out[3] = normal[0];
+	out[4] = normal[1];
+	out[5] = normal[2];
+	out[6] = color[0];
+	out[7] = color[1];
+	out[8] = color[2];
+	out[9] = color[3];
+	out[10] = x / (float) mapSize;
+	out[11] = z / (float) mapSize;
+	return out + MOUNTAIN_VERTEX_FLOATS;
+}
+/**
+ * buildMountain
+ * Writes the quads of one generated island, 4 vertices each, using the
+ * normals from calcIslandNormals.
+ */
+void buildMountain(const Island* island, int mapSize, const GLfloat* normals,
+		GLfloat* vertices) {
+	const GLfloat up[3] = { 0, 1, 0 };
+	int x, z;
+#define NORMAL(x, z) (edge ? up : &normals[((x) * mapSize + (z)) * 3])
+#define HEIGHT(x, z) island->heights[(x) * mapSize + (z)]
+	for (x = 0; x < mapSize - 1; x++) {
+		for (z = 0; z < mapSize - 1; z++) {
 			//be default the normal is straight up (edges)
-			glNormal3f(0, 1, 0);
-
-			//if it's not an edge then calculate the normal for the point
-			if (x != 0 && z != 0 && x != mountainDetailAccuracy - 1
-					&& z != mountainDetailAccuracy - 1) {
-				calcVertexNormal(map, jitterX, jitterZ, x, z + 1);
-			}
-			//color the mountain for when not using textures
-			colorMountainByHeight(x, map[x][z + 1], z + 1,
-					mountainDetailAccuracy);
-			//map coords of texture
-			glTexCoord2f((x / mountainDetailAccuracy),
-					((z + 1) / mountainDetailAccuracy));
-			//draw vertex
-			glVertex3f(x + jitterX[x][z + 1], map[x][z + 1],
-					z + 1 + jitterZ[x][z + 1]);
-
-			//repeat for other 3 points of tile/quad/square
-
-			if (x != 0 && z != 0 && x != mountainDetailAccuracy - 1
-					&& z != mountainDetailAccuracy - 1) {
-				calcVertexNormal(map, jitterX, jitterZ, x + 1, z + 1);
-			}
-			colorMountainByHeight(x + 1, map[x + 1][z + 1], z + 1,
-					mountainDetailAccuracy);
-
-			glTexCoord2f(((x + 1) / mountainDetailAccuracy),
-					((z + 1) / mountainDetailAccuracy));
-			glVertex3f(x + 1 + jitterX[x + 1][z + 1], map[x + 1][z + 1],
-					z + 1 + jitterZ[x + 1][z + 1]);
-
-			if (x != 0 && z != 0 && x != mountainDetailAccuracy - 1
-					&& z != mountainDetailAccuracy - 1) {
-				calcVertexNormal(map, jitterX, jitterZ, x + 1, z);
-			}
-			colorMountainByHeight(x + 1, map[x + 1][z], z,
-					mountainDetailAccuracy);
-
-			glTexCoord2f(((x + 1) / mountainDetailAccuracy),
-					(z / mountainDetailAccuracy));
-			glVertex3f(x + 1 + jitterX[x + 1][z], map[x + 1][z],
-					z + jitterZ[x + 1][z]);
-
-			if (x != 0 && z != 0 && x != mountainDetailAccuracy - 1
-					&& z != mountainDetailAccuracy - 1) {
-				calcVertexNormal(map, jitterX, jitterZ, x, z);
-			}
-			glTexCoord2f((x / mountainDetailAccuracy),
-					(z / mountainDetailAccuracy));
-			glVertex3f(x + jitterX[x][z], map[x][z], z + jitterZ[x][z]);
-			glEnd();
+			int edge = x == 0 || z == 0;
+			GLfloat color[4];
+			colorMountainByHeight(HEIGHT(x, z + 1), color);
+			vertices = buildMountainVertex(island, mapSize, x, z + 1,
+					NORMAL(x, z + 1), color, vertices);
+			colorMountainByHeight(HEIGHT(x + 1, z + 1), color);
+			vertices = buildMountainVertex(island, mapSize, x + 1, z + 1,
+					NORMAL(x + 1, z + 1), color, vertices);
+			colorMountainByHeight(HEIGHT(x + 1, z), color);
+			vertices = buildMountainVertex(island, mapSize, x + 1, z,
+					NORMAL(x + 1, z), color, vertices);
+			//the last corner keeps the color of the one before
+			vertices = buildMountainVertex(island, mapSize, x, z,
+					NORMAL(x, z), color, vertices);
 		}
 	}
-
-	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+#undef NORMAL
+#undef HEIGHT
+}
+/**
+ * mountainCorner
+ * Index of the vertex at corner (x, z) of fine quad (quadX, quadZ).
+ */
+static GLuint mountainCorner(int mapSize, int quadX, int quadZ, int x, int z) {
+	GLuint first = (quadX * (mapSize - 1) + quadZ) * 4;
+	if (z > quadZ) {
+		return first + (x > quadX ? 1 : 0);
+	}
+	return first + (x > quadX ? 2 : 3);
+}
+/**
+ * buildMountainLod
+ * Writes the indices of one level of detail, whose quads span step fine
+ * quads each way (the last row and column what is left), as two triangles
+ * of the fine quads' corner vertices. Step 1 gives the fine quads as they
+ * are. Returns the indices written.
+ */
+static int buildMountainLod(int mapSize, int step, GLuint* out) {
+	int last = mapSize - 1;
+	int count = 0;
+	int x, z;
+	for (x = 0; x < last; x += step) {
+		for (z = 0; z < last; z += step) {
+			int x1 = x + step < last ? x + step : last;
+			int z1 = z + step < last ? z + step : last;
+			//each corner from the fine quad inside this quad
+			GLuint c0 = mountainCorner(mapSize, x, z1 - 1, x, z1);
+			GLuint c1 = mountainCorner(mapSize, x1 - 1, z1 - 1, x1, z1);
+			GLuint c2 = mountainCorner(mapSize, x1 - 1, z, x1, z);
+			GLuint c3 = mountainCorner(mapSize, x, z, x, z);
+			out[count++] = c0;
+			out[count++] = c1;
+			out[count++] = c2;
+			out[count++] = c0;
+			out[count++] = c2;
+			out[count++] = c3;
+		}
+	}
+	return count;
+}
+/**
+ * initMountainBuffers
+ * Sizes the island arrays and buffers for the map size and island count,
+ * only when they changed. Quads are drawn as the same two triangles
+ * GL_POLYGON made of them. The indices of the coarser terrain levels of
+ * detail follow the fine ones. Returns 0 if they could not be allocated.
+ */
+int initMountainBuffers(int mapSize, int islands) {
+	int quads = (mapSize - 1) * (mapSize - 1);
+	int vertices = quads * 4 * islands;
+	int indices = 0;
+	int lod;
+	if (mapSize == mountainMapSize && islands == mountainIslandCount) {
+		return 1;
+	}
+	for (lod = 0; lod < GOVERNOR_TERRAIN_LODS; lod++) {
+		int cells = (mapSize - 2) / (1 << lod) + 1;
+		indices += cells * cells * 6;
+	}
+	free(mountainVertices);
+	free(mountainIndices);
+	mountainMapSize = 0;
+	mountainVertices = malloc(sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS * vertices);
+	mountainIndices = malloc(sizeof(GLuint) * indices);
+	if (mountainVertices == NULL || mountainIndices == NULL) {
+		return 0;
+	}
+	//one island's indices, every island is drawn with its own vertex offset
+	indices = 0;
+	for (lod = 0; lod < GOVERNOR_TERRAIN_LODS; lod++) {
+		mountainLodFirst[lod] = indices;
+		mountainLodCount[lod] = buildMountainLod(mapSize, 1 << lod,
+				mountainIndices + indices);
+		indices += mountainLodCount[lod];
+	}
+	if (hasBuffers) {
+		if (mountainBuffer == 0) {
+			pglGenBuffers(1, &mountainBuffer);
+			pglGenBuffers(1, &mountainIndexBuffer);
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, mountainBuffer);
+		pglBufferData(GL_ARRAY_BUFFER,
+				sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS * vertices, NULL,
+				GL_DYNAMIC_DRAW);
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mountainIndexBuffer);
+		pglBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices,
+				mountainIndices, GL_STATIC_DRAW);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	mountainMapSize = mapSize;
+	mountainIslandCount = islands;
+	return 1;
 }
-
 /**
  * initMountains
- * Initializes the mountains including position and scale
+ * Generates the world's islands, erodes them if asked to and builds them,
+ * or loads all of that from the world cache, then scatters the archipelago
+ * of their copies, which is cheaper to place again than to cache. Maps over
+ * EROSION_FOREGROUND_SIZE are eroded in the background instead, display
+ * rebuilds the islands once that is done.
  */
 void initMountains() {
-	mountainId = glGenLists(1);
-	glNewList(mountainId, GL_COMPILE);
-
-	glBindTexture(GL_TEXTURE_2D, mountainTexture);
-
-	glColor4f(1, 1, 1, 1);
+	ErosionSettings erosion;
+	erosionCancelBackground();
+	if (worldCacheDir != NULL && loadCachedMountains()) {
+		initArchipelago();
+		return;
+	}
+	worldGenerateTerrain(&world, mountainDetailAccuracy, numIslands);
+	if (erosionDroplets > 0.0f && world.terrain.mapSize > 0) {
+		erosionDefaults(&erosion, erosionDroplets);
+		if (world.terrain.mapSize <= EROSION_FOREGROUND_SIZE) {
+			erodeTerrain(&world.terrain, world.seed, &erosion);
+		} else if (!erosionStartBackground(&world.terrain, world.seed,
+				erosionDroplets)) {
+			printf("Could not erode the islands.\n");
+		}
+	}
+	buildMountains();
+	if (worldCacheDir != NULL && (erosionDroplets <= 0.0f
+			|| world.terrain.mapSize <= EROSION_FOREGROUND_SIZE)) {
+		saveCachedMountains();
+	}
+	initArchipelago();
+}
+/**
+ * mountainCacheKey
+ * The parameters the islands of the current world are generated from.
+ */
+WorldCacheKey mountainCacheKey() {
+	WorldCacheKey key;
+	key.seed = world.seed;
+	key.mapSize = mountainDetailAccuracy;
+	key.islands = numIslands;
+	key.erosion = erosionDroplets > 0.0f ? erosionDroplets : 0.0f;
+	key.vertexFloats = MOUNTAIN_VERTEX_FLOATS;
+	return key;
+}
+/**
+ * loadCachedMountains
+ * Loads the world's islands and their meshes from the world cache.
+ * Returns 0 if they are not cached.
+ */
+int loadCachedMountains() {
+	WorldCacheKey key = mountainCacheKey();
+	WorldCache cache;
+	int size = key.mapSize;
+	size_t floats = (size_t) (size - 1) * (size - 1) * 4
+			* MOUNTAIN_VERTEX_FLOATS * key.islands;
+	if (!worldCacheLoad(&cache, worldCacheDir, &key, &world.terrain)) {
+		return 0;
+	}
+	if (cache.numVertexFloats != floats || !initMountainBuffers(size, key.islands)) {
+		worldCacheClose(&cache);
+		return 0;
+	}
+	if (hasBuffers) {
+		//straight from the mapping, drawing only uses the buffer
+		pglBindBuffer(GL_ARRAY_BUFFER, mountainBuffer);
+		pglBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * floats,
+				cache.vertices);
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+	} else {
+		memcpy(mountainVertices, cache.vertices, sizeof(GLfloat) * floats);
+	}
+	worldCacheClose(&cache);
+	placeIslands();
+	return 1;
+}
+/**
+ * saveCachedMountains
+ * Writes the world's islands and their meshes to the world cache.
+ */
+void saveCachedMountains() {
+	WorldCacheKey key = mountainCacheKey();
+	int size = mountainMapSize;
+	if (size != world.terrain.mapSize || size == 0
+			|| key.islands != world.terrain.islandCount
+			|| key.islands != mountainIslandCount) {
+		return;
+	}
+	if (!worldCacheSave(worldCacheDir, &key, &world.terrain, mountainVertices,
+			(size_t) (size - 1) * (size - 1) * 4 * MOUNTAIN_VERTEX_FLOATS
+					* key.islands)) {
+		printf("Could not write the world cache in %s.\n", worldCacheDir);
+	}
+}
+/**
+ * buildMountains
+ * Writes the world's islands into the island buffers, which are kept from
+ * the last world as long as the map size is the same.
+ */
+void buildMountains() {
+	const Terrain* terrain = &world.terrain;
+	int size = terrain->mapSize;
+	int islandFloats = (size - 1) * (size - 1) * 4 * MOUNTAIN_VERTEX_FLOATS;
+	ArenaMark mark = arenaMark(&frameArena);
+	//vertex normals of the island being built
+	GLfloat* normals = arenaAlloc(&frameArena, sizeof(GLfloat) * size * size * 3);
 	int i;
-	int numMountains = 3;
-	//generate a certain number of mountains
-	for (i = 0; i < numMountains; i++) {
-		glPushMatrix();
-		float angle = (90 * i);
-		float distance = 80;
-
-		//move it down so edges are below sea
-		glTranslatef(0, -2.5f, 0);
-		glScalef(0.5f, 0.5f, 0.5f);
-		glScalef(randBetween(20, 150) / 100.0f, randBetween(20, 150) / 100.0f,
-				randBetween(20, 150) / 100.0f);
 
-		glTranslatef(sin(angle) * distance, 0, cos(angle) * distance);
-		glTranslatef(mountainDetailAccuracy / -2.0f, 0,
-				mountainDetailAccuracy / -2.0f);
-		int accuracy = mountainDetailAccuracy;
-		drawMountain(accuracy, 4);
-
-		glPopMatrix();
+	if (normals == NULL || !initMountainBuffers(size, terrain->islandCount)) {
+		printf("Could not allocate the island buffers.\n");
+		arenaRewind(&frameArena, mark);
+		return;
+	}
+	for (i = 0; i < terrain->islandCount; i++) {
+		const Island* island = &terrain->islands[i];
+		calcIslandNormals(island, size, normals);
+		buildMountain(island, size, normals, mountainVertices + islandFloats * i);
+	}
+	arenaRewind(&frameArena, mark);
+	placeIslands();
+	if (hasBuffers) {
+		pglBindBuffer(GL_ARRAY_BUFFER, mountainBuffer);
+		pglBufferSubData(GL_ARRAY_BUFFER, 0,
+				sizeof(GLfloat) * islandFloats * terrain->islandCount, mountainVertices);
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
-	glEndList();
 }
 
 /**
  * drawMountains
  * Draws all of the mountains with or without textures based on texture.
+ * Each island is placed with its own position and scale, then the
+ * archipelago is drawn from the same meshes, all at the terrain level of
+ * detail of the quality level.
  */
 void drawMountains() {
+	int size = mountainMapSize;
+	int quads = (size - 1) * (size - 1);
+	int lod = governorQuality(qualityLevel)->terrainLod;
+	int indexCount = mountainLodCount[lod];
+	GLsizei stride = sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS;
+	const char* vertices = (const char*) mountainVertices;
+	const void* indices = mountainIndices + mountainLodFirst[lod];
+	GLfloat density = 0.0f;
+	int i;
+	if (size == 0) {
+		return;
+	}
 	glPushMatrix();
 	glDisable( GL_TEXTURE_2D);
 	if (toggleMountainTextures == 1) {
 		glEnable( GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, mountainTexture);
 	}
-	glColor4f(1, 1, 1, 1);
 	glDisable(GL_CULL_FACE);
-	glCallList(mountainId);
+	if (hasBuffers) {
+		//offsets into the bound buffers instead of pointers
+		pglBindBuffer(GL_ARRAY_BUFFER, mountainBuffer);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mountainIndexBuffer);
+		vertices = NULL;
+		indices = (const char*) NULL + sizeof(GLuint) * mountainLodFirst[lod];
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	for (i = 0; i < mountainIslandCount; i++) {
+		const char* island0 = vertices + stride * quads * 4 * i;
+		const TransformNode* node = &scene.nodes[islandNodes[i]];
+		//outside this view
+		if (!frustumOverlapsBounds(&viewFrustum, node->worldMin,
+				node->worldMax)) {
+			continue;
+		}
+		glPushMatrix();
+		loadNodeMatrix(islandNodes[i]);
+		glVertexPointer(3, GL_FLOAT, stride, island0);
+		glNormalPointer(GL_FLOAT, stride, island0 + sizeof(GLfloat) * 3);
+		glColorPointer(4, GL_FLOAT, stride, island0 + sizeof(GLfloat) * 6);
+		glTexCoordPointer(2, GL_FLOAT, stride, island0 + sizeof(GLfloat) * 10);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indices);
+		glPopMatrix();
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	if (glIsEnabled(GL_FOG)) {
+		glGetFloatv(GL_FOG_DENSITY, &density);
+	}
+	archipelagoDraws = archipelagoDraw(&archipelago, hasBuffers ? mountainBuffer : 0,
+			vertices, indices, indexCount, toggleMountainTextures == 1, density);
+	if (hasBuffers) {
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	//colors from an array are not tracked into the material, leave the front
+	//diffuse white as the last color of the islands used to
+	glColor4f(1, 1, 1, 1);
+	if (glIsEnabled(GL_COLOR_MATERIAL)) {
+		glDisable(GL_COLOR_MATERIAL);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, white);
+		glEnable(GL_COLOR_MATERIAL);
+	}
 	glEnable(GL_CULL_FACE);
 	glPopMatrix();
 }
-/**
- * initAxis
- * Initializes the axis marker showing x,y,z axis
- */
-void initAxis() {
-	float lineLength = 7.0f;
-	axisId = glGenLists(1);
-	glNewList(axisId, GL_COMPILE);
-	glBegin(GL_LINES);
-	//x red
-	glColor3f(1, 0, 0);
-	glVertex3f(0, 0, 0);
-	glVertex3f(lineLength, 0, 0);
-	//y green
-	glColor3f(0, 1, 0);
-	glVertex3f(0, 0, 0);
-	glVertex3f(0, lineLength, 0);
-	//z blue
-	glColor3f(0, 0, 1);
-	glVertex3f(0, 0, 0);
-	glVertex3f(0, 0, lineLength);
-	glEnd();
-	//center sphere
-	glColor3f(1, 1, 1);
-	glRotatef(90, 1, 0, 0);
-	glutSolidSphere(0.6, 16, 16);
-	glEndList();
-}
-/**
- * drawCircle
- * Draws a circle.
- */
-void drawCircle() {
-	float numPoints = 120;
-	double angleStep = (2 * 3.14) / numPoints;
-	glBegin(GL_LINE_STRIP);
-	double angle = 0.0;
-	int i;
-	for (i = 0; i <= numPoints; i++) {
-		glVertex2f(sin(angle), cos(angle));
-		angle += angleStep;
-	}
-	glEnd();
-}
-/**
- * initTarget
- * Initializes the target/crosshair
- */
-void initTarget() {
-	float lineLength = 1.0f;
-	targetId = glGenLists(1);
-	glNewList(targetId, GL_COMPILE);
-	glBegin(GL_LINES);
-	glColor3f(1, 0, 0);
-	//y
-	glVertex3f(0, -lineLength / 2.0f, 0);
-	glVertex3f(0, lineLength / 2.0f, 0);
-	//z
-	glVertex3f(0, 0, -lineLength / 2.0f);
-	glVertex3f(0, 0, lineLength / 2.0f);
-	glEnd();
-	glRotatef(90, 0, 1, 0);
-	glScalef(0.3, 0.3, 1);
-	drawCircle();
-	glEndList();
-}
 /*
  * drawTarget
  * Draws the target/crosshair.
+ * Must be called with the plane's transform loaded, the crosshair is placed
+ * in front of the plane and added to the HUD in screen space.
  */
 void drawTarget() {
-	glPushMatrix();
-	glTranslatef(-10, 0, 0);
+	GLdouble modelview[16];
+	GLdouble centerX, centerY, centerZ;
+	GLdouble ends[4][3];
+	//ends of the two crosshair lines in plane coordinates
+	GLdouble local[4][3] = { { -10, -0.5, 0 }, { -10, 0.5, 0 },
+			{ -10, 0, -0.5 }, { -10, 0, 0.5 } };
+	int i;
 
-	if (boolShoot == 1) {
-		targetScale *= 1.3f;
-		if (targetScale > 1.5) {
-			targetScale = 1.5;
-		}
-	} else if (targetScale > 1.0f) {
-		targetScale *= 0.5f;
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	gluProject(-10, 0, 0, modelview, cameraProjection, cameraViewport,
+			&centerX, &centerY, &centerZ);
+	//behind the camera
+	if (centerZ < 0 || centerZ > 1) {
+		return;
 	}
-
-	glScalef(targetScale, targetScale, targetScale);
-	glCallList(targetId);
-	glPopMatrix();
+	for (i = 0; i < 4; i++) {
+		gluProject(local[i][0], local[i][1] * world.targetScale,
+				local[i][2] * world.targetScale, modelview, cameraProjection,
+				cameraViewport, &ends[i][0], &ends[i][1], &ends[i][2]);
+	}
+	hudLine(ends[0][0], ends[0][1], ends[1][0], ends[1][1], 2, red);
+	hudLine(ends[2][0], ends[2][1], ends[3][0], ends[3][1], 2, red);
+	float radius = hypot(ends[1][0] - centerX, ends[1][1] - centerY) * 0.6f;
+	hudCircle(centerX, centerY, radius, 2, 32, red);
 }
 /**
  * randBetween
- * Returns a random number between the given min and max.
+ * Returns a random number between the given min and max from a stream.
  */
-float randBetween(int min, int max) {
-	if (max <= min) {
-		return min;
-	}
-	return ((rand() % (max - min)) + min);
+float randBetween(Rng* rng, int min, int max) {
+	return rngRange(rng, min, max);
+}
+/**
+ * qualitySlices
+ * Slices of the sky or the sea at a quality level, halved for each step of
+ * its tessellation shift but no fewer than 8 or than there were.
+ */
+static int qualitySlices(int slices, int level) {
+	int fewer = slices >> governorQuality(level)->tessellationShift;
+	int least = slices < 8 ? slices : 8;
+	return fewer > least ? fewer : least;
 }
 /**
  * initSky
- * Initializes the sky.
+ * Initializes the sky, a display list for each quality level.
  */
 void initSky() {
+	int level;
 	skyObj = gluNewQuadric();
-	skyId = glGenLists(4);
+	skyId = glGenLists(GOVERNOR_QUALITY_LEVELS);
 	gluQuadricNormals(skyObj, GLU_SMOOTH);
 	gluQuadricTexture(skyObj, GL_TRUE);
 	//texture the sky
 	glBindTexture(GL_TEXTURE_2D, skyTexture);
 	gluQuadricTexture(skyObj, skyTexture);
 
-	glNewList(skyId, GL_COMPILE);
-	glTranslatef(0, (seaDetailAccuracy * 2) - 2.0f, 0);
-	glRotatef(90, 1, 0, 0);
-
-	GLfloat diffuseMaterial[4] = { 0.0, 0.0, 0.0, 1.0 };
-	GLfloat ambientMaterial[4] = { 1.0, 1.0, 1.0, 1.0 };
-	GLfloat mShininess[] = { 50 };
-	glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, mShininess);
-	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuseMaterial);
-	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMaterial);
-	gluCylinder(skyObj, seaDetailAccuracy, seaDetailAccuracy,
-			seaDetailAccuracy * 2, 100, 100);
-
-	glRotatef(-180, 0, 1, 0);
-
-	glScalef(1.01, 1, 1.01);
-	gluCylinder(skyObj, seaDetailAccuracy, seaDetailAccuracy,
-			(seaDetailAccuracy * 1.9f), 100, 100);
-	glEndList();
+	for (level = 0; level < GOVERNOR_QUALITY_LEVELS; level++) {
+		int slices = qualitySlices(skySlices, level);
+		glNewList(skyId + level, GL_COMPILE);
+		glTranslatef(0, (seaDetailAccuracy * 2) - 2.0f, 0);
+		glRotatef(90, 1, 0, 0);
+
+		GLfloat diffuseMaterial[4] = { 0.0, 0.0, 0.0, 1.0 };
+		GLfloat ambientMaterial[4] = { 1.0, 1.0, 1.0, 1.0 };
+		GLfloat mShininess[] = { 50 };
+		glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, mShininess);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuseMaterial);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMaterial);
+		gluCylinder(skyObj, seaDetailAccuracy, seaDetailAccuracy,
+				seaDetailAccuracy * 2, slices, slices);
+
+		glRotatef(-180, 0, 1, 0);
+
+		glScalef(1.01, 1, 1.01);
+		gluCylinder(skyObj, seaDetailAccuracy, seaDetailAccuracy,
+				(seaDetailAccuracy * 1.9f), slices, slices);
+		glEndList();
+	}
 }
 /**
  * initSea
- * Initializes the sea
+ * Initializes the sea, a display list for each quality level.
  */
 void initSea() {
+	int level;
 	seaObj = gluNewQuadric();
-	seaId = glGenLists(1);
+	seaId = glGenLists(GOVERNOR_QUALITY_LEVELS);
 	gluQuadricNormals(seaObj, GLU_SMOOTH);
 	gluQuadricTexture(seaObj, GL_TRUE);
 	glBindTexture(GL_TEXTURE_2D, seaTexture);
 	gluQuadricTexture(seaObj, seaTexture);
 
-	glNewList(seaId, GL_COMPILE);
-	glRotatef(270, 1, 0, 0);
-	glColor4f(0.0, 0.0, 0.6, 1.0);
-	GLfloat ambientMaterial[4] = { 0.2, 0.2, 0.4, 1.0 };
-	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMaterial);
-	gluDisk(seaObj, 0, seaDetailAccuracy + 2, 64, 64);
-	glEndList();
+	for (level = 0; level < GOVERNOR_QUALITY_LEVELS; level++) {
+		int slices = qualitySlices(seaSlices, level);
+		glNewList(seaId + level, GL_COMPILE);
+		glRotatef(270, 1, 0, 0);
+		glColor4f(0.0, 0.0, 0.6, 1.0);
+		GLfloat ambientMaterial[4] = { 0.2, 0.2, 0.4, 1.0 };
+		glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMaterial);
+		gluDisk(seaObj, 0, seaDetailAccuracy + 2, slices, slices);
+		glEndList();
+	}
 }
 /**
  * initGrid
@@ -607,13 +962,13 @@ void drawGrid() {
  * drawSea
  */
 void drawSea() {
-	glCallList(seaId);
+	glCallList(seaId + qualityLevel);
 }
 /**
  * drawSky
  */
 void drawSky() {
-	glCallList(skyId);
+	glCallList(skyId + qualityLevel);
 }
 /**
  * drawPlane
@@ -622,242 +977,94 @@ void drawPlane() {
 	glEnable(GL_COLOR_MATERIAL);
 	// set material properties which will be assigned by glColor
 	glColorMaterial(GL_FRONT, GL_DIFFUSE);
-	glCallList(planeId);
+	drawModel(&planeModel);
 	glDisable(GL_COLOR_MATERIAL);
 }
 /**
  * drawProps
- * Draws the propellers for the plane including positioning and rotating
+ * Draws the propellers for the plane, placed and turned by updateScene.
  */
 void drawProps() {
+	int i;
 	glEnable(GL_COLOR_MATERIAL);
 	// set material properties which will be assigned by glColor
 	glColorMaterial(GL_FRONT, GL_DIFFUSE);
-	propRotation += ((propellerSpeed - planeSpeed) * 2);
-
-	glPushMatrix();
-	glTranslatef(-0.01f, -0.14f, 0.35f);
-	if (alive == 1) {
-		glRotatef(propRotation, 1, 0, 0);
-	}
-	glTranslatef(0, 0.15f, -0.35f);
-	glCallList(propId);
-	glPopMatrix();
-	glPushMatrix();
-	glTranslatef(-0.01f, -0.14f, -0.35f);
-	if (alive == 1) {
-		glRotatef(propRotation, 1, 0, 0);
+	for (i = 0; i < 2; i++) {
+		glPushMatrix();
+		loadNodeMatrix(propNodes[i]);
+		drawModel(&propModel);
+		glPopMatrix();
 	}
-	glTranslatef(0, 0.15f, -0.35f);
-	glCallList(propId);
-	glPopMatrix();
 	glDisable(GL_COLOR_MATERIAL);
 }
 /**
  * loadModel
- * Loads a model from file using a specific format.
- */
-GLuint loadModel(GLuint id, GLuint numPoints, char* fileName, int colorScheme) {
-	//store the points in an array
-	Point* points = malloc(sizeof(Point) * numPoints);
-	//count the number of points and faces
-	int pointCount = 0;
-	int normalCount = 0;
-	int faceCount = 0;
-	int objectCount = 0;
-	//store the display list id for calling later.
-	id = glGenLists(1);
-	glNewList(id, GL_COMPILE);
-
-	GLfloat diffuseMaterial[4] = { 0.0, 0.0, 0.0, 1.0 };
-	GLfloat ambientMaterial[4] = { 0.0, 0.0, 0.0, 1.0 };
-	GLfloat specularMaterial[4] = { 1.0, 1.0, 1.0, 1.0 };
-
-	FILE * file;
-	char objectName[256];
-	char line[256];
-	// open enterprise point/face data file
-	file = fopen(fileName, "rt");
-	if (file == NULL) {
-		printf("Could not load resource.\n");
-		return id;
-	}
-
-	//begin drawing triangles (stored in display list not actually drawn).
-
-	//read line by line, assuming less than 256 characters
-	while (fgets(line, 256, file) != NULL) {
-		float x;
-		float y;
-		float z;
-		float nx;
-		float ny;
-		float nz;
-		char ch;
-		//look for vertex information
-		int found = sscanf(line, "v %f %f %f", &x, &y, &z);
-		//if found vertex info
-		if (found != 0) {
-			//create a point and store in array
-			Point point = { x, y, z };
-			points[pointCount] = point;
-			pointCount++;
-		} else if ((found = sscanf(line, "n %f %f %f", &nx, &ny, &nz)) != 0) {
-			//add the normal data to the right point
-			points[normalCount].nx = nx;
-			points[normalCount].ny = ny;
-			points[normalCount].nz = nz;
-			normalCount++;
-		} else if ((found = sscanf(line, "g %s", objectName)) != 0) {
-			//printf("%d %s\n", found, objectName);
-			if (colorScheme == 1) {
-				if (objectCount <= 3) {
-					diffuseMaterial[0] = yellow[0];
-					diffuseMaterial[1] = yellow[1];
-					diffuseMaterial[2] = yellow[2];
-					diffuseMaterial[3] = yellow[3];
-				} else if (objectCount >= 4 && objectCount <= 5) {
-					diffuseMaterial[0] = black[0];
-					diffuseMaterial[1] = black[1];
-					diffuseMaterial[2] = black[2];
-					diffuseMaterial[3] = black[3];
-				} else if (objectCount == 6) {
-					diffuseMaterial[0] = purple[0];
-					diffuseMaterial[1] = purple[1];
-					diffuseMaterial[2] = purple[2];
-					diffuseMaterial[3] = purple[3];
-				} else if (objectCount == 7) {
-					diffuseMaterial[0] = blue[0];
-					diffuseMaterial[1] = blue[1];
-					diffuseMaterial[2] = blue[2];
-					diffuseMaterial[3] = blue[3];
-				} else if (objectCount >= 8 && objectCount <= 10) {
-					diffuseMaterial[0] = yellow[0];
-					diffuseMaterial[1] = yellow[1];
-					diffuseMaterial[2] = yellow[2];
-					diffuseMaterial[3] = yellow[3];
-				} else if (objectCount == 11) {
-					diffuseMaterial[0] = black[0];
-					diffuseMaterial[1] = black[1];
-					diffuseMaterial[2] = black[2];
-					diffuseMaterial[3] = black[3];
-				} else if (objectCount >= 12 && objectCount <= 13) {
-					diffuseMaterial[0] = yellow[0];
-					diffuseMaterial[1] = yellow[1];
-					diffuseMaterial[2] = yellow[2];
-					diffuseMaterial[3] = yellow[3];
-				} else if (objectCount >= 14 && objectCount <= 25) {
-					diffuseMaterial[0] = blue[0];
-					diffuseMaterial[1] = blue[1];
-					diffuseMaterial[2] = blue[2];
-					diffuseMaterial[3] = blue[3];
-				} else if (objectCount >= 26 && objectCount <= 31) {
-					diffuseMaterial[0] = yellow[0];
-					diffuseMaterial[1] = yellow[1];
-					diffuseMaterial[2] = yellow[2];
-					diffuseMaterial[3] = yellow[3];
-				}
-			} else {
-				if (objectCount == 0) {
-					diffuseMaterial[0] = yellow[0];
-					diffuseMaterial[1] = yellow[1];
-					diffuseMaterial[2] = yellow[2];
-					diffuseMaterial[3] = yellow[3];
-				} else {
-					diffuseMaterial[0] = red[0];
-					diffuseMaterial[1] = red[1];
-					diffuseMaterial[2] = red[2];
-					diffuseMaterial[3] = red[3];
-				}
-			}
-			objectCount++;
-		} else if ((found = sscanf(line, "%c ", &ch)) != 0 && ch == 'f') {
-			int f;
-			//printf("char %c\n", ch);
-			char *token;
-			token = strtok(line, " ");
-			ambientMaterial[0]=diffuseMaterial[0]*0.2f;
-			ambientMaterial[1]=diffuseMaterial[1]*0.2f;
-			ambientMaterial[2]=diffuseMaterial[2]*0.2f;
-			glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMaterial);
-			glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specularMaterial);
-			glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuseMaterial);
-			glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, none);
-			glColor4f(diffuseMaterial[0], diffuseMaterial[1],
-					diffuseMaterial[2], diffuseMaterial[3]);
-			glBegin(GL_POLYGON);
-
-			while (token != NULL) {
-				f = atoi(token);
-				if (f != 0) {
-					//printf(" %d %f %f %f\n", f,points[f - 1].x, points[f - 1].y,
-					//		points[f - 1].z);
-					glNormal3f(points[f - 1].nx, points[f - 1].ny,
-							points[f - 1].nz);
-					glVertex3f(points[f - 1].x, points[f - 1].y,
-							points[f - 1].z);
-				}
-				token = strtok( NULL, " ");
-			}
-			faceCount++;
-			glEnd();
-		}
+ * Loads a model from file using a specific format, as triangles batched by
+ * material (see loadIndexedMesh), into buffers when they are available.
+ */
+void loadModel(IndexedMesh* model, char* fileName, int colorScheme) {
+	GLsizeiptr vectorBytes;
+	if (!loadIndexedMesh(fileName, colorScheme, model) || !hasBuffers) {
+		return;
 	}
-
-	glEndList();
-	//close file
-	fclose(file);
-	//free list of points, not needed anymore (cached in display list)
-	free(points);
-	return id;
-}
-/**
- * loadGLTexture
- * Loads a texture and returns the textureid
- */
-GLuint loadGLTexture(const char * filename, int wrap, int width, int height) {
-	GLuint texture;
-	BYTE * data;
-	FILE * file;
-
-	// open .raw texture file, reading bytes
-	// .raw has no header
-	file = fopen(filename, "rb");
-	if (file == NULL) {
-		printf("Could not load texture.\n");
-		return 0;
+	vectorBytes = sizeof(GLfloat) * 3 * model->numVertices;
+	pglGenBuffers(1, &model->vertexBuffer);
+	pglGenBuffers(1, &model->indexBuffer);
+	pglBindBuffer(GL_ARRAY_BUFFER, model->vertexBuffer);
+	pglBufferData(GL_ARRAY_BUFFER, vectorBytes * 2, NULL, GL_STATIC_DRAW);
+	pglBufferSubData(GL_ARRAY_BUFFER, 0, vectorBytes, model->positions);
+	pglBufferSubData(GL_ARRAY_BUFFER, vectorBytes, vectorBytes, model->normals);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->indexBuffer);
+	pglBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * model->numIndices,
+			model->indices, GL_STATIC_DRAW);
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+/**
+ * drawModel
+ * Draws a model loaded by loadModel with one material change and one draw
+ * per batch. The material is the one the faces used to set one by one:
+ * ambient a fifth of the color and no specular.
+ */
+void drawModel(const IndexedMesh* model) {
+	const char* positions = (const char*) model->positions;
+	const char* normals = (const char*) model->normals;
+	const GLuint* indices = model->indices;
+	GLfloat ambient[4] = { 0.0, 0.0, 0.0, 1.0 };
+	int i;
+	if (model->numBatches == 0) {
+		return;
+	}
+	if (model->vertexBuffer != 0) {
+		//offsets into the bound buffers instead of pointers
+		pglBindBuffer(GL_ARRAY_BUFFER, model->vertexBuffer);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->indexBuffer);
+		positions = NULL;
+		normals = (const char*) NULL + sizeof(GLfloat) * 3 * model->numVertices;
+		indices = NULL;
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, positions);
+	glNormalPointer(GL_FLOAT, 0, normals);
+	for (i = 0; i < model->numBatches; i++) {
+		const MeshBatch* batch = &model->batches[i];
+		ambient[0] = batch->color[0] * 0.2f;
+		ambient[1] = batch->color[1] * 0.2f;
+		ambient[2] = batch->color[2] * 0.2f;
+		glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, none);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, batch->color);
+		glColor4fv(batch->color);
+		glDrawElements(GL_TRIANGLES, batch->numIndices, GL_UNSIGNED_INT,
+				indices + batch->firstIndex);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	if (model->vertexBuffer != 0) {
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
-	// create data buffer
-	data = malloc(width * height * 3);
-
-	// read texture data
-	fread(data, width * height * 3, 1, file);
-	fclose(file);
-
-	// generate texture id
-	glGenTextures(1, &texture);
-	// bind the texture
-	glBindTexture( GL_TEXTURE_2D, texture);
-	//configuration
-	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-	GL_LINEAR_MIPMAP_NEAREST);
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//wrap or cut off based on param
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-			wrap ? GL_REPEAT : GL_CLAMP);
-	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-			wrap ? GL_REPEAT : GL_CLAMP);
-
-	// build 2d mipmaps
-	gluBuild2DMipmaps( GL_TEXTURE_2D, 3, width, height,
-	GL_RGB, GL_UNSIGNED_BYTE, data);
-
-	// free data buffer, no longer needed
-	free(data);
-
-	//return the texture
-	return texture;
 }
 /**
  * initTextures
@@ -865,20 +1072,101 @@ GLuint loadGLTexture(const char * filename, int wrap, int width, int height) {
  * Mountain, sky, sea
  */
 void initTextures() {
-	mountainTexture = loadGLTexture("./textures/mountain.raw", 1, 1280, 1104);
-	seaTexture = loadGLTexture("./textures/sea.raw", 1, 1600, 1200);
-	skyTexture = loadGLTexture("./textures/sky.raw", 1, 896, 385);
+	mountainTexture = textureLoad("./textures/mountain.raw", 1280, 1104, 1);
+	seaTexture = textureLoad("./textures/sea.raw", 1600, 1200, 1);
+	skyTexture = textureLoad("./textures/sky.raw", 896, 385, 1);
 }
-
 /**
- * display
- * Displays the scene, called by opengl every so many milliseconds.
+ * pixelsPerUnit
+ * Screen pixels a world unit facing the camera spans at a distance, in a
+ * view the given number of pixels high.
  */
-void display(int ms) {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	update();
+float pixelsPerUnit(float distance, int viewHeight) {
+	if (distance < nearValue) {
+		distance = nearValue;
+	}
+	return viewHeight / (2.0f * distance * tanf(fov * (float) M_PI / 360.0f));
+}
+/**
+ * wantTextures
+ * Tells the texture manager how many texels across each texture drawn this
+ * frame needs for a texel a pixel where it is closest to the camera: the
+ * sea disk and the sky cylinder are textured once over, and each island
+ * once over its width, those of the archipelago too. Each view asks for
+ * itself from its own eye, the finest any view asks for is kept. The map
+ * looks down from where its projection spans as much as a perspective
+ * would, so it asks as if it were one. Lower quality levels ask for fewer.
+ */
+void wantTextures(const View* view, Vec3 eye) {
+	float seaRadius = seaDetailAccuracy + 2;
+	float skyRadius = seaDetailAccuracy;
+	float fromAxis = sqrtf(eye.x * eye.x + eye.z * eye.z);
+	int height = view->height * governorQuality(qualityLevel)->detail;
+	int i;
+	if (toggleGrid == 0) {
+		textureWant(seaTexture, seaRadius * 2 * pixelsPerUnit(fabsf(eye.y + 1),
+				height));
+		if (view->camera != VIEW_MAP) {
+			textureWant(skyTexture, skyRadius * 2 * (float) M_PI
+					* pixelsPerUnit(fabsf(skyRadius - fromAxis), height));
+		}
+	}
+	if (toggleMountains == 1 && toggleMountainTextures == 1) {
+		for (i = 0; i < mountainIslandCount; i++) {
+			const TransformNode* node = &scene.nodes[islandNodes[i]];
+			//distance to the closest point of the island's box
+			float dx = fmaxf(fmaxf(node->worldMin.x - eye.x, 0),
+					eye.x - node->worldMax.x);
+			float dy = fmaxf(fmaxf(node->worldMin.y - eye.y, 0),
+					eye.y - node->worldMax.y);
+			float dz = fmaxf(fmaxf(node->worldMin.z - eye.z, 0),
+					eye.z - node->worldMax.z);
+			textureWant(mountainTexture, (node->worldMax.x - node->worldMin.x)
+					* pixelsPerUnit(sqrtf(dx * dx + dy * dy + dz * dz), height));
+		}
+		for (i = 0; i < archipelago.count; i++) {
+			float width = archipelago.scale[i] * (archipelago.mapSize - 1);
+			float dx = archipelago.x[i] - eye.x;
+			float dy = ARCHIPELAGO_BASE_Y - eye.y;
+			float dz = archipelago.z[i] - eye.z;
+			float distance = sqrtf(dx * dx + dy * dy + dz * dz) - width * 0.5f;
+			textureWant(mountainTexture, width * pixelsPerUnit(distance, height));
+		}
+	}
+}
+
+/**
+ * display
+ * Displays the scene, called by opengl every so many milliseconds.
+ */
+void display(int ms) {
+	double frameStart = timerNow();
+	if (lastFrameTime > 0) {
+		frameInterval += ((frameStart - lastFrameTime) - frameInterval) * 0.1f;
+	}
+	lastFrameTime = frameStart;
+	arenaReset(&frameArena);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	tick();
+	if (replayDone == 1) {
+		finishReplay();
+	}
+	if (erosionFinishBackground(&world.terrain)) {
+		buildMountains();
+		if (worldCacheDir != NULL) {
+			saveCachedMountains();
+		}
+	}
 	draw();
+	latencyFrame();
+	captureFrame(appWidth, appHeight);
+	frameWorkTime += ((timerNow() - frameStart) - frameWorkTime) * 0.1f;
 	glutSwapBuffers();
+	latencyPresented();
+	if (latencyDone()) {
+		finishLatency();
+	}
 	glutTimerFunc(ms, display, ms);
 }
 /**
@@ -919,19 +1207,32 @@ void handleResize(int w, int h) {
  * Event occurs when scroll wheel is spun.
  */
 void mouseWheel(int button, int state, int x, int y) {
-	if (toggleAltControls == 1) {
-		boolAccelerate = 0;
-		boolDeaccelerate = 0;
+	if (sim.toggleAltControls == 1) {
+		sim.boolAccelerate = 0;
+		sim.boolDeaccelerate = 0;
 		if (state == GLUT_DOWN) {
 			return;
 		}
+		if (networked == 1) {
+			wheelSteps += button == 3 ? 1 : button == 4 ? -1 : 0;
+			return;
+		}
+		if (world.toggleFlightModel == 1) {
+			//the wheel is the throttle
+			if (button == 3 && world.propellerSpeed < WORLD_PROPELLER_MAX_SPEED) {
+				world.propellerSpeed += 1.0f;
+			} else if (button == 4 && world.propellerSpeed > 0.0f) {
+				world.propellerSpeed -= 1.0f;
+			}
+			return;
+		}
 		if (button == 3) {
-			if (planeSpeed <= planeMaxSpeed - planeAcc) {
-				planeSpeed += planeAcc;
+			if (world.planeSpeed <= PLAYER_MAX_SPEED - PLAYER_ACCELERATION) {
+				world.planeSpeed += PLAYER_ACCELERATION;
 			}
 		} else if (button == 4) {
-			if (planeSpeed >= planeMinSpeed + planeDeacc) {
-				planeSpeed -= planeDeacc;
+			if (world.planeSpeed >= PLAYER_MIN_SPEED + PLAYER_DECELERATION) {
+				world.planeSpeed -= PLAYER_DECELERATION;
 			}
 		}
 	}
@@ -948,18 +1249,18 @@ void initGLUT(int argc, char** argv) {
 	glutInitWindowPosition(appX, appY);
 	glutCreateWindow("CSCI 3161 - Project - Flight Simulator - Matthew Thomas");
 
-	glutTimerFunc(15, display, 15);
+	glutTimerFunc(tickMs, display, tickMs);
 	glutDisplayFunc(myDisplay);
-	glutPassiveMotionFunc(mouseEvent);
+	glutPassiveMotionFunc(onMouseEvent);
 
-	glutSpecialUpFunc(keySpecialUp);
-	glutSpecialFunc(keySpecialDown);
+	glutSpecialUpFunc(onKeySpecialUp);
+	glutSpecialFunc(onKeySpecialDown);
 
-	glutMouseFunc(mouseWheel);
+	glutMouseFunc(onMouseWheel);
 
-	glutKeyboardUpFunc(keyUp);
-	glutKeyboardFunc(keyDown);
-	glutReshapeFunc(handleResize);
+	glutKeyboardUpFunc(onKeyUp);
+	glutKeyboardFunc(onKeyDown);
+	glutReshapeFunc(onResize);
 }
 /**
  * initializeGL
@@ -980,8 +1281,8 @@ void initGL(void) {
 
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
-	gluLookAt(eyeX, eyeY, eyeZ, /* eye */
-	atX, atY, atZ, /* looking at*/
+	gluLookAt(world.eyeX, world.eyeY, world.eyeZ, /* eye */
+	world.atX, world.atY, world.atZ, /* looking at*/
 	0.0, 1.0, 0.0); /* up is in positive Y direction */
 
 	glEnable(GL_BLEND);
@@ -1006,73 +1307,223 @@ void initGL(void) {
 }
 /**
  * drawAxis
- * Draws the indicator showing x,y,z axis
+ * Draws the indicator showing x,y,z axis at the world origin.
  */
 void drawAxis() {
-	glLineWidth(5.0f);
-	glScalef(0.5f, 0.5f, 0.5f);
-	glCallList(axisId);
-
+	float lineLength = 3.5f;
+	GLdouble origin[3];
+	GLdouble end[3];
+	const GLfloat* colors[3] = { red, darkgreen, blue };
+	int i;
+	gluProject(0, 0, 0, cameraModelview, cameraProjection, cameraViewport,
+			&origin[0], &origin[1], &origin[2]);
+	if (origin[2] < 0 || origin[2] > 1) {
+		return;
+	}
+	for (i = 0; i < 3; i++) {
+		gluProject(i == 0 ? lineLength : 0, i == 1 ? lineLength : 0,
+				i == 2 ? lineLength : 0, cameraModelview, cameraProjection,
+				cameraViewport, &end[0], &end[1], &end[2]);
+		if (end[2] >= 0 && end[2] <= 1) {
+			hudLine(origin[0], origin[1], end[0], end[1], 5, colors[i]);
+		}
+	}
+	//center marker
+	hudRect(origin[0] - 4, origin[1] - 4, 8, 8, white);
 }
 /**
  * drawAltometer
  * Shows the altitude (y-coord) of camera
  */
 void drawAltometer() {
-	float scaleY = (eyeY / 20.0f);
-	glDisable(GL_LIGHTING);
-
-	glPushMatrix();
-	glColor3f(0, 0, 1);	//blue
-	glTranslatef(4.8f, -2.8f, -5.0f);
-	glScalef(1, scaleY, 0);
-	//glRotatef(-90,0,1,0);
-
-	glBegin(GL_POLYGON);
-	float sizeX = 0.2f;
-	float sizeY = 1.0f;
-	glVertex3f(0, 0, 0);
-	glVertex3f(sizeX, 0, 0);
-	glVertex3f(sizeX, sizeY, 0);
-	glVertex3f(0, sizeY, 0);
-
-	glEnd();
-	glPopMatrix();
-	glEnable(GL_LIGHTING);
+	float scaleY = (world.eyeY / 20.0f);
+	//size of one unit of the old view space bars in pixels
+	float unit = appHeight * 0.173f;
+	float sizeX = 0.2f * unit;
+	float sizeY = 1.0f * unit;
+	float x = appWidth - 0.33f * unit;
+	float y = 0.08f * unit;
+	GLfloat barColor[4] = { 0, 0, 1, 1 };	//blue
+	char text[32];
+
+	hudRect(x, y, sizeX, sizeY * scaleY, barColor);
+	snprintf(text, sizeof(text), "ALT %.0f", world.eyeY);
+	hudText(x + sizeX - hudTextWidth(text, 2), y + sizeY * scaleY + 6, 2,
+			white, text);
 }
 /**
  * drawSpedometer
  * Shows the speed of the plane
  */
 void drawSpedometer() {
-	float scaleX = (2 * planeSpeed / planeMaxSpeed);
-	glDisable(GL_LIGHTING);
-
-	glPushMatrix();
-	glColor3f(0, 1, 0);	//green
-	glTranslatef(-5.05f, -2.8f, -5.0f);
-	glScalef(scaleX, 1, 1);
-	//glRotatef(-90,0,1,0);
-
-	glBegin(GL_POLYGON);
-	float sizeX = 1.0f;
-	float sizeY = 0.2f;
-	glVertex3f(0, 0, 0);
-	glVertex3f(sizeX, 0, 0);
-	glVertex3f(sizeX, sizeY, 0);
-	glVertex3f(0, sizeY, 0);
-
-	glEnd();
-	glPopMatrix();
-	glEnable(GL_LIGHTING);
-
+	float scaleX = (2 * world.planeSpeed / PLAYER_MAX_SPEED);
+	//size of one unit of the old view space bars in pixels
+	float unit = appHeight * 0.173f;
+	float sizeX = 1.0f * unit;
+	float sizeY = 0.2f * unit;
+	float x = 0.08f * unit;
+	float y = 0.08f * unit;
+	GLfloat barColor[4] = { 0, 1, 0, 1 };	//green
+
+	hudRect(x, y, sizeX * scaleX, sizeY, barColor);
+	//world units per second
+	hudPrintf(x, y + sizeY + 6, 2, white, "SPD %.1f",
+			(world.planeSpeed + 1) / 10.0f * (1000.0f / tickMs));
+}
+/**
+ * drawReadouts
+ * Shows the heading, frame rate and frame time, and the governor's render
+ * scale and quality level when it is on
+ */
+void drawReadouts() {
+	float scale = 2;
+	float lineHeight = (HUD_GLYPH_HEIGHT + 3) * scale;
+	float top = appHeight - lineHeight;
+	char text[64];
+	TextureStats textureStats;
+	float heading = fmod(world.planeRotation * 180.0f / M_PI, 360.0f);
+	if (heading < 0) {
+		heading += 360.0f;
+	}
+	hudPrintf(10, top, scale, white, "HDG %03.0f", heading);
+
+	snprintf(text, sizeof(text), "FPS %.0f", 1.0f / frameInterval);
+	hudText(appWidth - 10 - hudTextWidth(text, scale), top, scale, white, text);
+	snprintf(text, sizeof(text), "FRAME %.1fMS", frameInterval * 1000.0f);
+	hudText(appWidth - 10 - hudTextWidth(text, scale), top - lineHeight, scale,
+			white, text);
+	snprintf(text, sizeof(text), "CPU %.1fMS", frameWorkTime * 1000.0f);
+	hudText(appWidth - 10 - hudTextWidth(text, scale), top - lineHeight * 2,
+			scale, white, text);
+	if (sim.aiCount > 0) {
+		snprintf(text, sizeof(text), "AI %d %.2fMS", sim.aiCount,
+				world.aiUpdateTime * 1000.0f);
+		hudText(appWidth - 10 - hudTextWidth(text, scale),
+				top - lineHeight * 3, scale, white, text);
+	}
+	if (networked == 1) {
+		snprintf(text, sizeof(text), "NET %d PILOTS %.1fKB/S",
+				netClient.numRemote + 1, netDownRate / 1024.0f);
+		hudText(appWidth - 10 - hudTextWidth(text, scale),
+				top - lineHeight * 4, scale, white, text);
+	}
+	textureGetStats(&textureStats);
+	if (textureStats.textures > 0) {
+		snprintf(text, sizeof(text), "TEX %zuKB", textureStats.residentBytes / 1024);
+		if (textureStats.budgetBytes > 0) {
+			snprintf(text + strlen(text), sizeof(text) - strlen(text), " OF %zuKB",
+					textureStats.budgetBytes / 1024);
+		}
+		hudText(appWidth - 10 - hudTextWidth(text, scale),
+				top - lineHeight * 5, scale, white, text);
+	}
+	if (governor.budgetMs > 0) {
+		snprintf(text, sizeof(text), "RES %.0f%% Q%d %.1fMS OF %.1fMS",
+				governorScale(&governor) * 100.0f, qualityLevel,
+				governor.frameMs, governor.budgetMs);
+		hudText(appWidth - 10 - hudTextWidth(text, scale),
+				top - lineHeight * 6, scale, white, text);
+	}
+}
+/**
+ * drawMinimap
+ * Minimap in the bottom left corner over the speed, north up.
+ */
+void drawMinimap() {
+	GLfloat frame[4] = { 0, 1, 0, 0.6f };
+	float size = appHeight * 0.25f;
+	float x = 10;
+	float y = appHeight * 0.12f;
+	if (minimapReady == 0 || minimapRate == 0) {
+		return;
+	}
+	minimapDraw(x, y, size, appWidth, appHeight);
+	hudLine(x, y, x + size, y, 1, frame);
+	hudLine(x + size, y, x + size, y + size, 1, frame);
+	hudLine(x + size, y + size, x, y + size, 1, frame);
+	hudLine(x, y + size, x, y, 1, frame);
+}
+/**
+ * drawRadar
+ * Radar in the top left corner, forward is up. Shows the closest AI
+ * aircraft and bullets in range, brighter if they are inside the camera's
+ * field of view, and how many contacts are in range and ahead.
+ */
+void drawRadar() {
+	SpatialHit blips[RADAR_BLIPS];
+	SpatialHit ahead[RADAR_BLIPS];
+	SpatialQuery query;
+	GLfloat ring[4] = { 0, 1, 0, 0.6f };
+	GLfloat aiColor[4] = { 0.8f, 0.2f, 0.2f, 1 };
+	GLfloat bulletColor[4] = { 0.6f, 0.6f, 0.6f, 1 };
+	GLfloat aheadColor[4] = { 1, 1, 0, 1 };
+	float scale = 2;
+	float lineHeight = (HUD_GLYPH_HEIGHT + 3) * scale;
+	float radius = appHeight * 0.1f;
+	float centerX = 10 + radius;
+	float centerY = appHeight - lineHeight * 2 - radius;
+	float forwardX = world.atX - world.eyeX;
+	float forwardZ = world.atZ - world.eyeZ;
+	float length = sqrtf(forwardX * forwardX + forwardZ * forwardZ);
+	int numBlips, numAhead, contacts, i;
+	if (length > 0.0f) {
+		forwardX /= length;
+		forwardZ /= length;
+	} else {
+		forwardX = 0.0f;
+		forwardZ = 1.0f;
+	}
+	memset(&query, 0, sizeof(query));
+	query.x = world.eyeX;
+	query.y = world.eyeY;
+	query.z = world.eyeZ;
+	query.radius = RADAR_RANGE;
+	query.kinds = SPATIAL_KIND_BIT(SPATIAL_AI) | SPATIAL_KIND_BIT(SPATIAL_BULLET);
+	query.ignore = -1;
+	query.type = SPATIAL_RADIUS;
+	contacts = spatialQuery(&world.spatial, &query, NULL, 0);
+	query.type = SPATIAL_NEAREST;
+	numBlips = spatialQuery(&world.spatial, &query, blips, RADAR_BLIPS);
+	//the camera's horizontal field of view
+	query.type = SPATIAL_CONE;
+	query.kinds = SPATIAL_KIND_BIT(SPATIAL_AI);
+	query.dirX = forwardX;
+	query.dirZ = forwardZ;
+	query.cosHalfAngle = cosf(atanf(tanf(fov * M_PI / 360.0f) * appWidth / appHeight));
+	numAhead = spatialQuery(&world.spatial, &query, ahead, RADAR_BLIPS);
+
+	hudCircle(centerX, centerY, radius, 1, 32, ring);
+	hudRect(centerX - 2, centerY - 2, 4, 4, white);
+	for (i = 0; i < numBlips + (numAhead < RADAR_BLIPS ? numAhead : RADAR_BLIPS); i++) {
+		const SpatialHit* hit = i < numBlips ? &blips[i] : &ahead[i - numBlips];
+		const SpatialHash* hash = &world.spatial;
+		float dx = (hash->x[hit->id] - world.eyeX) / RADAR_RANGE * radius;
+		float dz = (hash->z[hit->id] - world.eyeZ) / RADAR_RANGE * radius;
+		//right of the heading is forward x up
+		float screenX = centerX - dx * forwardZ + dz * forwardX;
+		float screenY = centerY + dx * forwardX + dz * forwardZ;
+		hudRect(screenX - 1.5f, screenY - 1.5f, 3, 3, i >= numBlips ? aheadColor
+				: hit->kind == SPATIAL_AI ? aiColor : bulletColor);
+	}
+	hudPrintf(10, centerY - radius - lineHeight, scale, white, "RDR %d AHEAD %d",
+			contacts, numAhead);
 }
 /**
  * drawExplosion
  * Draws the explosion when you crash into the sea
  */
-void drawExplosion(int slices, int stacks) {
+void drawExplosion(int slices, int stacks, Rng* rng) {
+	int count = (slices + 1) * (stacks + 1) * 2;
+	ArenaMark mark = arenaMark(&frameArena);
+	//jitter for both coordinates of every vertex, generated in one batch
+	float* jitter = arenaAlloc(&frameArena, sizeof(float) * count);
+	float* nextJitter = jitter;
 	int i, j;
+	if (jitter == NULL) {
+		arenaRewind(&frameArena, mark);
+		return;
+	}
+	rngFillFloats(rng, jitter, count, -0.05f, 0.05f);
 	for (i = 0; i <= slices; i++) {
 		float lat0 = M_PI * (-0.5 + (float) (i - 1) / slices);
 		float z0 = sin(lat0);
@@ -1086,10 +1537,8 @@ void drawExplosion(int slices, int stacks) {
 		for (j = 0; j <= stacks; j++) {
 			float lng = 2 * M_PI * (float) (j - 1) / stacks;
 			//randomize the position to create somewhat of a jagged shape .
-			float x = cos(lng)
-					+ (((randBetween(0, 1000) / 1000.0f) - 0.5f) / 10.0f);
-			float y = sin(lng)
-					+ (((randBetween(0, 1000) / 1000.0f) - 0.5f) / 10.0f);
+			float x = cos(lng) + *nextJitter++;
+			float y = sin(lng) + *nextJitter++;
 			glNormal3f(x * zr0, y * zr0, z0);
 			glVertex3f(x * zr0, y * zr0, z0);
 			glNormal3f(x * zr1, y * zr1, z1);
@@ -1097,137 +1546,70 @@ void drawExplosion(int slices, int stacks) {
 		}
 		glEnd();
 	}
+	arenaRewind(&frameArena, mark);
 }
 /**
  * explode
  * Causes the plane to explode when it hits the sea creating an explosion
+ * with as many shells and slices as the quality level draws.
  */
 void explode() {
+	const GovernorQuality* quality = governorQuality(qualityLevel);
+	int shells = explosionShells < quality->explosionShells ? explosionShells
+			: quality->explosionShells;
 	glEnable(GL_COLOR_MATERIAL);
 	// set material properties which will be assigned by glColor
 	glColorMaterial(GL_FRONT, GL_DIFFUSE);
 	int i;
-	for (i = 0; i < 10; i++) {
-		explosionScale += delta / 50.0f;
-		glScalef(explosionScale, explosionScale, explosionScale);
+	for (i = 0; i < shells; i++) {
+		//a copy, so every view jitters the shell the same
+		Rng jitter = explosionJitter[i];
+		glScalef(explosionScales[i], explosionScales[i], explosionScales[i]);
 		glColor4f(1, 0, 0, 0.2f);
-		glRotatef(randBetween(0, 360), 1, 0, 0);
+		glRotatef(explosionAngles[i], 1, 0, 0);
 
 		glDisable(GL_CULL_FACE);
-		drawExplosion(32, 32);
+		drawExplosion(quality->explosionSlices, quality->explosionSlices,
+				&jitter);
 		glEnable(GL_CULL_FACE);
 	}
-	if (explosionScale > 1) {
-		exploding = 0;
-		explosionScale = 1.0;
-	}
 	glDisable(GL_COLOR_MATERIAL);
 }
+/**
+ * advanceExplosion
+ * Grows the explosion for this frame and picks each shell's turn and
+ * jitter, once a frame whatever the number of views drawing it.
+ */
+void advanceExplosion() {
+	Rng* rng = &world.rngStreams[RNG_EXPLOSION];
+	int i;
+	explosionShells = 0;
+	if (world.alive != 0 || world.exploding != 1) {
+		return;
+	}
+	for (i = 0; i < EXPLOSION_SHELLS; i++) {
+		world.explosionScale += delta / 50.0f;
+		explosionScales[i] = world.explosionScale;
+		explosionAngles[i] = randBetween(rng, 0, 360);
+		rngSeed(&explosionJitter[i], rngNext(rng), i);
+	}
+	explosionShells = EXPLOSION_SHELLS;
+	if (world.explosionScale > 1) {
+		world.exploding = 0;
+		world.explosionScale = 1.0;
+	}
+}
 /**
  * update
  * Updates the appplication's logic.
- * Controls actual movement of camera and bullets
+ * The simulation itself lives in worldStep.
  */
 void update() {
-	universeTime += delta;
-	appX = glutGet((GLenum) GLUT_WINDOW_X);
-	appY = glutGet((GLenum) GLUT_WINDOW_Y);
-
-	//if shooting
-	if (boolShoot == 1) {
-		//create a new bullet
-		Bullet* bullet = malloc(sizeof(Bullet));
-		bullet->x = eyeX + (sin(planeRotation));
-		bullet->y = eyeY + (sin(planeYawRotation)) - 1;
-		bullet->z = eyeZ + (cos(planeRotation));
-		bullet->rotation = planeRotation
-				+ ((randBetween(0, targetScale * 2) - (targetScale)) / 80.0f);
-		bullet->yaw = planeYawRotation
-				+ ((randBetween(0, targetScale * 2) - (targetScale)) / 80.0f);
-		bullet->nextBullet = NULL;
-		//if its the first bullet
-		if (numBullets == 0) {
-			firstBullet = bullet;
-			currBullet = bullet;
-		} else {
-			//otherwise add to end of linked list
-			currBullet->nextBullet = bullet;
-			currBullet = bullet;
-		}
-		//count number of bullets
-		numBullets++;
-		//if more than allowed number of bullets
-		if (numBullets > maxNumBullets) {
-			//remove the first bullet and set the next in line as the new first
-			Bullet* tempBullet = firstBullet;
-			free(firstBullet);
-			firstBullet = tempBullet->nextBullet;
-		}
-	}
-	//if there are bullets
-	if (numBullets > 0) {
-		//move them a bit based on bullet direction and speed
-		Bullet* bullet = firstBullet;
-		while (bullet != NULL) {
-			bullet->x += (sin(bullet->rotation) * (bulletSpeed));
-			bullet->z += (cos(bullet->rotation) * (bulletSpeed));
-			bullet->y += (sin(bullet->yaw) * (bulletSpeed));
-			bullet = bullet->nextBullet;
-		}
-	}
-	//if alive update the state of camera/plane
-	if (alive == 1) {
-
-		float centerX = appWidth / 2.0f;
-		float distanceX = (centerX - lastMouseX) / appWidth;
-		planeRotation += distanceX / (10.5 * (planeSpeed + 1));
-
-		planeTilt = distanceX * 40.0f;
-
-		if (boolAccelerate == 1 && planeSpeed <= planeMaxSpeed - planeAcc) {
-			planeSpeed += planeAcc;
-		} else if (boolDeaccelerate == 1
-				&& planeSpeed >= planeMinSpeed + planeDeacc) {
-			planeSpeed -= planeDeacc;
-		}
-		//if alternate controls are enabled
-		if (toggleAltControls == 0) {
-			if (boolMoveUp == 1) {
-				eyeY += planeRiseSpeed;
-				atY += planeRiseSpeed;
-			} else if (boolMoveDown == 1) {
-				eyeY -= planeFallSpeed;
-				atY -= planeFallSpeed;
-			}
-		} else {
-			float centerY = appHeight / 2.0f;
-			float distanceY = (centerY - lastMouseY) / appHeight;
-			planeYawRotation += distanceY / (20 * (planeSpeed + 1));
-			if (planeYawRotation > 1) {
-				planeYawRotation = 1;
-			} else if (planeYawRotation < -1) {
-				planeYawRotation = -1;
-			}
-
-			eyeY += (sin(planeYawRotation) * (planeSpeed + 1)) / 10.0f;
-			atY = eyeY + (sin(planeYawRotation) * 10.0f);
-
-		}
-		//move the camera based on circles using plane speed as the radius
-		eyeX += (sin(planeRotation) * (planeSpeed + 1)) / 10.0f;
-		eyeZ += (cos(planeRotation) * (planeSpeed + 1)) / 10.0f;
-		//always look 10 units ahead
-		atX = eyeX + (sin(planeRotation) * 10.0f);
-		atZ = eyeZ + (cos(planeRotation) * 10.0f);
-
-		if (eyeY < 2) {
-			alive = 0;
-			explosionScale = 0.0f;
-			exploding = 1;
-			eyeY = 2;
-		}
+	if (headless == 0) {
+		appX = glutGet((GLenum) GLUT_WINDOW_X);
+		appY = glutGet((GLenum) GLUT_WINDOW_Y);
 	}
-
+	worldStep(&world, &sim);
 }
 /**
  * drawBullet
@@ -1241,24 +1623,31 @@ void drawBullet(float x, float y, float z) {
 /**
  * draw
  *
- * Draws the entire scene based on toggles and current state
+ * Draws the entire scene based on toggles and current state, in every view
+ * of viewLayoutIndex. What the views share is done once before them: the
+ * transforms and the world bounds they are culled with, the animation and
+ * the fog. The views are drawn at the governor's scale and quality level,
+ * the HUD goes over the whole window after them at full size. The
+ * governor is told how long it all took.
  */
 void draw() {
-	glLoadIdentity();
-
-	glPushMatrix();
-	glColor4f(1.0, 1.0, 1.0, 1.0f);
-	//set up camera
-	gluLookAt(eyeX, eyeY, eyeZ, /* eye */
-	atX, atY, atZ, /* looking at*/
-	0.0, 1.0, 0.0); /* up is in positive Y direction */
-
-	//reset light including position
-	initLight();
+	double drawStart = timerNow();
+	View views[VIEW_MAX];
+	View sceneViews[VIEW_MAX];
+	int numViews = viewLayout(viewLayoutIndex, appWidth, appHeight, views);
+	int sceneWidth, sceneHeight;
+	int i;
+	qualityLevel = governorQualityLevel(&governor);
+	aircraftRendererSetDetail(governorQuality(qualityLevel)->detail);
+	hudBegin(appWidth, appHeight);
+	textureUpdate();
+	updateScene();
+	advanceExplosion();
+	updateMinimap();
 
 	//if alternate weather is enabled change fog to be based on camera y-coord
 	if (toggleAltWeather == 1) {
-		float heightFactor = eyeY - 3.0f;
+		float heightFactor = world.eyeY - 3.0f;
 		float density = 0.0f;
 		if (heightFactor < 0) {
 			heightFactor = 0;
@@ -1273,16 +1662,87 @@ void draw() {
 		//otherwise use the normal fog
 		glFogf(GL_FOG_DENSITY, originalFogDensity);
 	}
-	if (toggleGrid == 1) {
-		glPushMatrix();
-		glDisable(GL_LIGHTING);
+	governorBeginScene(&governor, appWidth, appHeight, &sceneWidth,
+			&sceneHeight);
+	viewLayout(viewLayoutIndex, sceneWidth, sceneHeight, sceneViews);
+	for (i = 0; i < numViews; i++) {
+		drawView(&sceneViews[i], &views[i], i == 0);
+	}
+	governorEndScene();
+	glViewport(0, 0, appWidth, appHeight);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(fov, (float) appWidth / (float) appHeight, nearValue,
+			farValue);
+	glMatrixMode(GL_MODELVIEW);
+	glFrontFace(GL_CCW);
+
+	//HUD goes last, on top of the 3D scene
+	drawViewBorders(views, numViews);
+	drawSpedometer();
+	drawAltometer();
+	drawReadouts();
+	drawRadar();
+	drawMinimap();
+	hudFlush();
+	glEnable(GL_LIGHTING);
+	governorUpdate(&governor, (timerNow() - drawStart) * 1000.0f,
+			governorGpuMs());
+}
+/**
+ * drawView
+ * Draws the scene into one view from its camera. The primary view's
+ * matrices are kept for the HUD, which marks the axis and the crosshair
+ * from them, with where the view is in the window, windowView, as it may
+ * be drawn at a smaller scale.
+ */
+void drawView(const View* view, const View* windowView, int primary) {
+	Mat4 projection, viewProjectionMatrix;
+	Vec3 eye, at, up;
+	glViewport(view->x, view->y, view->width, view->height);
+	if (view->inset) {
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(view->x, view->y, view->width, view->height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+	viewProjection(view, fov * (float) M_PI / 180.0f, nearValue, farValue,
+			&projection);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projection.m);
+	glMatrixMode(GL_MODELVIEW);
+	//the mirror's projection turns the faces around
+	glFrontFace(view->camera == VIEW_MIRROR ? GL_CW : GL_CCW);
+	viewFog = toggleFog == 1 && view->camera != VIEW_MAP;
+	viewCamera(view->camera, &eye, &at, &up);
+	glLoadIdentity();
+
+	glPushMatrix();
+	glColor4f(1.0, 1.0, 1.0, 1.0f);
+	//set up camera, up is positive Y unless the flight model rolls
+	mat4LookAt(&viewMatrix, eye, at, up);
+	mat4Multiply(&viewProjectionMatrix, &projection, &viewMatrix);
+	frustumFromMatrix(&viewFrustum, &viewProjectionMatrix);
+	glLoadMatrixf(viewMatrix.m);
+	wantTextures(view, eye);
+	if (primary) {
+		glGetDoublev(GL_MODELVIEW_MATRIX, cameraModelview);
+		glGetDoublev(GL_PROJECTION_MATRIX, cameraProjection);
+		cameraViewport[0] = windowView->x;
+		cameraViewport[1] = windowView->y;
+		cameraViewport[2] = windowView->width;
+		cameraViewport[3] = windowView->height;
+	}
+
+	//reset light including position
+	initLight();
+
+	if (toggleGrid == 1 && primary) {
 		drawAxis();
-		glEnable(GL_LIGHTING);
-		glPopMatrix();
 	}
 	glColor4f(1, 1, 1, 1);
 	glPushMatrix();
-	if (toggleFog == 1) {
+	if (viewFog == 1) {
 		glEnable(GL_FOG);
 	}
 	glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, dull);
@@ -1341,6 +1801,9 @@ void draw() {
 
 		glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, dull);
 		glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, black);
+	}
+	//the map looks down into the sky's cylinder, it would only be its rim
+	if (toggleGrid == 0 && view->camera != VIEW_MAP) {
 		glPushMatrix();
 		gluQuadricNormals(skyObj, GLU_SMOOTH);
 		gluQuadricTexture(skyObj, GL_TRUE);
@@ -1367,37 +1830,34 @@ void draw() {
 	glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, black);
 	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, littlespecular);
 
-	if(alive==1){
+	//the cockpit and the mirror are inside the plane
+	if (world.alive == 1 && view->camera != VIEW_COCKPIT
+			&& view->camera != VIEW_MIRROR) {
 		glPushMatrix();
-		float rotationDeg=(planeRotation * 180.0f /M_PI);
-		glTranslatef(eyeX+((atX-eyeX)/2.0f), eyeY+((atY-eyeY)/2.0f)-2,eyeZ+((atZ-eyeZ)/2.0f));
-		glScalef(0.8f, 0.8f, 0.8f);
-		glRotatef(rotationDeg, 0, 1, 0);
-		glRotatef(-planeTilt, 0, 0, 1);
-		if (toggleAltControls == 1) {
-			glRotatef(-planeYawRotation * 30.0f, 1, 0, 0);
-		}
-
-		glRotatef(90, 0, 1, 0);
-
+		loadNodeMatrix(planeModelNode);
 		drawPlane();
 		drawProps();
+		glPopMatrix();
+	}
+	if (world.alive == 1 && primary) {
+		glPushMatrix();
+		loadNodeMatrix(planeModelNode);
 		glDisable(GL_LIGHTING);
 		drawTarget();
-
-
 		glPopMatrix();
 	}
+	drawAi();
+	drawRemotePilots();
 	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, white);
 	glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, dull);
 	glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, white);
 
 	//draw bullets if there are any
-	if (numBullets > 0) {
-		Bullet* bullet = firstBullet;
+	if (world.numBullets > 0) {
+		Bullet* bullet = world.firstBullet;
 		while (bullet != NULL) {
 			glPushMatrix();
-			drawBullet(bullet->x+((atX-bullet->x)/2.0f), bullet->y+((atY-bullet->y)/2.0f)-2, bullet->z+((atZ-bullet->z)/2.0f));
+			drawBullet(bullet->x+((world.atX-bullet->x)/2.0f), bullet->y+((world.atY-bullet->y)/2.0f)-2, bullet->z+((world.atZ-bullet->z)/2.0f));
 			glPopMatrix();
 			bullet = bullet->nextBullet;
 		}
@@ -1407,26 +1867,91 @@ void draw() {
 	//everything after is no longer affected by camera
 	//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-	glPushMatrix();
-	drawSpedometer();
-	glPopMatrix();
-	glPushMatrix();
-	drawAltometer();
-	glPopMatrix();
-
-	if (alive == 0 && exploding == 1) {
+	if (explosionShells > 0 && view->camera != VIEW_MAP) {
 		explode();
 	}
 	glEnable(GL_LIGHTING);
-
+}
+/**
+ * viewCamera
+ * Where a camera looks from and to, all from the chase camera: the cockpit
+ * sits just over the plane looking the way the chase camera does, the
+ * mirror looks back from there as far up or down and the map looks down on
+ * the plane with the heading up.
+ */
+void viewCamera(ViewCamera camera, Vec3* eye, Vec3* at, Vec3* up) {
+	Vec3 chaseEye = vec3Make(world.eyeX, world.eyeY, world.eyeZ);
+	Vec3 chaseAt = vec3Make(world.atX, world.atY, world.atZ);
+	Vec3 chaseUp = vec3Make(world.upX, world.upY, world.upZ);
+	Vec3 forward = vec3Normalize(vec3Sub(chaseAt, chaseEye));
+	Vec3 cockpit = vec3Add(planePosition(), vec3Scale(chaseUp, 0.5f));
+	Vec3 heading;
+	switch (camera) {
+	case VIEW_COCKPIT:
+		*eye = cockpit;
+		*at = vec3Add(cockpit, forward);
+		*up = chaseUp;
+		break;
+	case VIEW_MIRROR:
+		*eye = cockpit;
+		*at = vec3Add(cockpit, vec3Make(-forward.x, forward.y, -forward.z));
+		*up = chaseUp;
+		break;
+	case VIEW_MAP:
+		heading = vec3Make(forward.x, 0, forward.z);
+		//straight up or down, any heading will do
+		if (vec3Length(heading) < 0.001f) {
+			heading = vec3Make(0, 0, -1);
+		}
+		*at = planePosition();
+		*eye = vec3Add(*at, vec3Make(0, VIEW_MAP_HEIGHT, 0));
+		*up = vec3Normalize(heading);
+		break;
+	default:
+		*eye = chaseEye;
+		*at = chaseAt;
+		*up = chaseUp;
+		break;
+	}
+}
+/**
+ * drawViewBorders
+ * Frames the insets and marks where the split views meet, around the
+ * insets over the split. Insets come after the views they are over.
+ */
+void drawViewBorders(const View* views, int numViews) {
+	GLfloat border[] = { 0.1f, 0.1f, 0.1f, 0.8f };
+	int i, j;
+	for (i = 1; i < numViews; i++) {
+		float left = views[i].x;
+		float bottom = views[i].y;
+		float right = left + views[i].width;
+		float top = bottom + views[i].height;
+		if (!views[i].inset) {
+			float from = bottom;
+			for (j = i + 1; j < numViews; j++) {
+				if (views[j].inset && views[j].x < left
+						&& views[j].x + views[j].width > left) {
+					hudLine(left, from, left, views[j].y, 2, border);
+					from = views[j].y + views[j].height;
+				}
+			}
+			hudLine(left, from, left, top, 2, border);
+			continue;
+		}
+		hudLine(left, bottom, right, bottom, 2, border);
+		hudLine(right, bottom, right, top, 2, border);
+		hudLine(right, top, left, top, 2, border);
+		hudLine(left, top, left, bottom, 2, border);
+	}
 }
 /**
  * mouseEvent
  * Gets the mouse position
  */
 void mouseEvent(int x, int y) {
-	lastMouseX = x;
-	lastMouseY = y;
+	sim.lastMouseX = x;
+	sim.lastMouseY = y;
 }
 /**
  * keyDown
@@ -1435,7 +1960,7 @@ void mouseEvent(int x, int y) {
 void keyDown(unsigned char key, int mouseX, int mouseY) {
 	//z for shooting
 	if (key == 'z') {
-		boolShoot = 1;
+		sim.boolShoot = 1;
 	}
 }
 /**
@@ -1446,13 +1971,18 @@ void keyDown(unsigned char key, int mouseX, int mouseY) {
 void keyUp(unsigned char key, int mouseX, int mouseY) {
 	if (key == 'w') {
 		toggleWireframe = 1 - toggleWireframe;
-		glPolygonMode( GL_BACK, renderingOptions[toggleWireframe]);
-		glPolygonMode( GL_FRONT, renderingOptions[toggleWireframe]);
+		if (headless == 0) {
+			glPolygonMode( GL_BACK, renderingOptions[toggleWireframe]);
+			glPolygonMode( GL_FRONT, renderingOptions[toggleWireframe]);
+		}
 	}
 	if (key == 'b') {
 		toggleFog = 1 - toggleFog;
 	}
-	if (key == 'f') {
+	if (key == 'v') {
+		viewLayoutIndex = (viewLayoutIndex + 1) % VIEW_LAYOUT_COUNT;
+	}
+	if (key == 'f' && headless == 0) {
 		toggleFullscreen = 1 - toggleFullscreen;
 		//glutFullScreenToggle();
 		//hackery because the windows freeglut doesn't have glutFullScreenToggle even though it's supposed to... ****
@@ -1479,33 +2009,19 @@ void keyUp(unsigned char key, int mouseX, int mouseY) {
 	if (key == 'm') {
 		toggleMountains = 1 - toggleMountains;
 	}
-	if (key == 'r') {
-		srand(time(NULL));
-
-		initNew();
-		eyeX = 0;
-		eyeY = 5;
-		eyeZ = -15;
-		atX = 0;
-		atY = 5;
-		atZ = -5;
-		boolAccelerate = 0;
-		boolDeaccelerate = 0;
-		boolMoveUp = 0;
-		boolMoveDown = 0;
-		boolShoot = 0;
-		planeSpeed = 1.0f;
-		planeRotation = 0.0f;
-		planeTilt = 0.0f;
-		planeYawRotation = 0.0f;
-		alive = 1;
+	if (key == 'r' && networked == 1) {
+		//the server respawns the pilot, the world stays
+		respawnRequested = 1;
+	} else if (key == 'r') {
+		newWorldSeed();
+		resetWorld();
 	}
 	//z for shooting
 	if (key == 'z') {
-		boolShoot = 0;
+		sim.boolShoot = 0;
 	}
 	if (key == 'q') {
-		exit(0);
+		quit();
 	}
 }
 /**
@@ -1514,26 +2030,34 @@ void keyUp(unsigned char key, int mouseX, int mouseY) {
  * Used to move the enterprise around (while not warping).
  */
 void keySpecialDown(int key, int mouseX, int mouseY) {
-	if (!toggleAltControls == 1) {
+	if (sim.toggleAltControls != 1) {
 		if (key == GLUT_KEY_PAGE_UP) {
-			boolAccelerate = 1;
+			sim.boolAccelerate = 1;
 		}
 		if (key == GLUT_KEY_PAGE_DOWN) {
-			boolDeaccelerate = 1;
+			sim.boolDeaccelerate = 1;
 		}
 		if (key == GLUT_KEY_UP) {
-			boolMoveUp = 1;
+			sim.boolMoveUp = 1;
 		}
 		if (key == GLUT_KEY_DOWN) {
-			boolMoveDown = 1;
+			sim.boolMoveDown = 1;
 		}
 	}
 	if (key == GLUT_KEY_F1) {
-		toggleAltControls = 1 - toggleAltControls;
+		sim.toggleAltControls = 1 - sim.toggleAltControls;
 	}
 	if (key == GLUT_KEY_F2) {
 		toggleAltWeather = 1 - toggleAltWeather;
 	}
+	if (key == GLUT_KEY_F3 && networked == 0) {
+		world.toggleFlightModel = 1 - world.toggleFlightModel;
+		if (world.toggleFlightModel == 1) {
+			worldEnterFlightModel(&world);
+		} else {
+			worldLeaveFlightModel(&world);
+		}
+	}
 }
 /**
  * keySpecialUp
@@ -1541,19 +2065,1083 @@ void keySpecialDown(int key, int mouseX, int mouseY) {
  * Used to move the enterprise around (while not warping).
  */
 void keySpecialUp(int key, int mouseX, int mouseY) {
-	if (!toggleAltControls == 1) {
+	if (sim.toggleAltControls != 1) {
 		if (key == GLUT_KEY_PAGE_UP) {
-			boolAccelerate = 0;
+			sim.boolAccelerate = 0;
 		}
 		if (key == GLUT_KEY_PAGE_DOWN) {
-			boolDeaccelerate = 0;
+			sim.boolDeaccelerate = 0;
 		}
 		if (key == GLUT_KEY_UP) {
-			boolMoveUp = 0;
+			sim.boolMoveUp = 0;
 		}
 		if (key == GLUT_KEY_DOWN) {
-			boolMoveDown = 0;
+			sim.boolMoveDown = 0;
 		}
 
 	}
 }
+/**
+ * tick
+ * Advances the simulation by one step.
+ * When replaying, the recorded input due for this tick is fed through the
+ * handlers first, exactly as it arrived between ticks when recorded.
+ */
+void tick() {
+	InputEvent event;
+	double tickStart = timerNow();
+	latencyTick(simTick);
+	if (networked == 1) {
+		netTick();
+		publishTelemetry(tickStart);
+		simTick++;
+		return;
+	}
+	if (isReplaying()) {
+		while (replayDone == 0 && replayNext(simTick, &event)) {
+			dispatchEvent(&event);
+		}
+	}
+	if (replayDone == 1) {
+		return;
+	}
+	update();
+	publishTelemetry(tickStart);
+	simTick++;
+}
+/**
+ * publishTelemetry
+ * Publishes the state after this tick to --telemetry readers, with the
+ * tick's cost since tickStart.
+ */
+void publishTelemetry(double tickStart) {
+	TelemetryRecord record;
+	Vec3 position;
+	Quat attitude;
+	if (telemetryEnabled == 0) {
+		return;
+	}
+	position = planePosition();
+	attitude = planeAttitude();
+	record.tick = simTick;
+	record.seed = world.seed;
+	record.universeTime = world.universeTime;
+	record.position[0] = position.x;
+	record.position[1] = position.y;
+	record.position[2] = position.z;
+	record.orientation[0] = attitude.x;
+	record.orientation[1] = attitude.y;
+	record.orientation[2] = attitude.z;
+	record.orientation[3] = attitude.w;
+	record.speed = world.planeSpeed;
+	record.alive = world.alive;
+	record.exploding = world.exploding;
+	record.flightModel = world.toggleFlightModel;
+	record.bulletsLive = world.numBullets < world.maxNumBullets ?
+			world.numBullets : world.maxNumBullets;
+	record.bulletsFired = world.numBullets;
+	record.tickMs = (timerNow() - tickStart) * 1000.0;
+	record.frameMs = frameWorkTime * 1000.0f;
+	record.frameIntervalMs = frameInterval * 1000.0f;
+	telemetryPublish(&record);
+}
+/**
+ * dispatchEvent
+ * Feeds a recorded event to the handler that originally received it.
+ */
+void dispatchEvent(const InputEvent* event) {
+	switch (event->type) {
+	case EVENT_KEY_DOWN:
+		keyDown(event->key, sim.lastMouseX, sim.lastMouseY);
+		break;
+	case EVENT_KEY_UP:
+		keyUp(event->key, sim.lastMouseX, sim.lastMouseY);
+		break;
+	case EVENT_SPECIAL_DOWN:
+		keySpecialDown(event->key, sim.lastMouseX, sim.lastMouseY);
+		break;
+	case EVENT_SPECIAL_UP:
+		keySpecialUp(event->key, sim.lastMouseX, sim.lastMouseY);
+		break;
+	case EVENT_MOUSE_MOVE:
+		mouseEvent(event->x, event->y);
+		break;
+	case EVENT_MOUSE_BUTTON:
+		mouseWheel(event->key, event->state, event->x, event->y);
+		break;
+	case EVENT_RESIZE:
+		sim.inputWidth = event->x;
+		sim.inputHeight = event->y;
+		break;
+	case EVENT_SEED:
+		//seeds are taken by the handler that needs them
+		break;
+	case EVENT_END:
+		replayDone = 1;
+		break;
+	}
+}
+/**
+ * newWorldSeed
+ * Picks the seed for a new world, from the recording when replaying.
+ */
+void newWorldSeed() {
+	InputEvent event = { .tick = simTick, .type = EVENT_SEED };
+	if (!isReplaying() || !replayTakeSeed(&worldSeed)) {
+		worldSeed = time(NULL);
+	}
+	event.seed = worldSeed;
+	recordEvent(&event);
+}
+/**
+ * finishReplay
+ * Reports the replay results and quits.
+ */
+void finishReplay() {
+	double elapsed = timerNow() - replayStartTime;
+	printf("Replay: %u ticks in %.3f s (%.0f ticks/s)\n", simTick, elapsed,
+			elapsed > 0 ? simTick / elapsed : 0.0);
+	printf("Replay: state checksum %08x\n", worldChecksum(&world));
+	replayClose();
+	finishCapture();
+	telemetryClosePublisher();
+	textureShutdown();
+	exit(0);
+}
+/**
+ * runReplayCheck
+ * Records a scripted flight without a window to checkReplayFileName, going
+ * through the same input callbacks a pilot does: steering, throttle, firing,
+ * both flight models and a new world. Then replays the recording from the
+ * start and fails (exit code 1) unless the replay ends with the checksum
+ * the flight did.
+ */
+void runReplayCheck() {
+	SimContext startSim = sim;
+	RecordHeader header;
+	unsigned int recorded, replayed;
+	int i;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	headless = 1;
+	header.seed = worldSeed;
+	header.width = sim.inputWidth;
+	header.height = sim.inputHeight;
+	header.tickMs = tickMs;
+	if (!worldInit(&world) || !recordStart(checkReplayFileName, &header)) {
+		exit(1);
+	}
+	worldNew(&world, worldSeed, &sim);
+	for (i = 0; i < REPLAY_CHECK_TICKS; i++) {
+		onMouseEvent(sim.inputWidth / 2 + sin(i * 0.02) * sim.inputWidth / 4,
+				sim.inputHeight / 2 + cos(i * 0.03) * sim.inputHeight / 8);
+		if (i % 200 == 20) {
+			onKeySpecialDown(GLUT_KEY_PAGE_UP, sim.lastMouseX, sim.lastMouseY);
+		} else if (i % 200 == 80) {
+			onKeySpecialUp(GLUT_KEY_PAGE_UP, sim.lastMouseX, sim.lastMouseY);
+		} else if (i % 200 == 100) {
+			onKeyDown('z', sim.lastMouseX, sim.lastMouseY);
+		} else if (i % 200 == 160) {
+			onKeyUp('z', sim.lastMouseX, sim.lastMouseY);
+		}
+		if (i == REPLAY_CHECK_TICKS / 3) {
+			onKeySpecialDown(GLUT_KEY_F3, sim.lastMouseX, sim.lastMouseY);
+			onKeySpecialUp(GLUT_KEY_F3, sim.lastMouseX, sim.lastMouseY);
+		} else if (i == REPLAY_CHECK_TICKS * 2 / 3) {
+			onKeyUp('r', sim.lastMouseX, sim.lastMouseY);
+		}
+		tick();
+	}
+	recordStop(simTick);
+	recorded = worldChecksum(&world);
+
+	//the replay starts from what the flight started from, a new world and sim
+	worldFree(&world);
+	sim = startSim;
+	simTick = 0;
+	if (!replayOpen(checkReplayFileName, &header) || !worldInit(&world)) {
+		exit(1);
+	}
+	worldSeed = header.seed;
+	worldNew(&world, worldSeed, &sim);
+	while (replayDone == 0) {
+		tick();
+	}
+	replayClose();
+	replayed = worldChecksum(&world);
+	printf("Replay check: %u ticks, recorded %08x, replayed %08x\n", simTick,
+			recorded, replayed);
+	if (replayed != recorded) {
+		printf("Replay check: FAILED, the replay did not end where the flight did\n");
+		exit(1);
+	}
+	printf("Replay check: OK\n");
+}
+/**
+ * quit
+ * Finishes any recording and quits, or ends the replay.
+ */
+void quit() {
+	if (networked == 1) {
+		clientDisconnect(&netClient);
+	}
+	recordStop(simTick);
+	if (isReplaying()) {
+		replayDone = 1;
+		return;
+	}
+	finishCapture();
+	telemetryClosePublisher();
+	textureShutdown();
+	exit(0);
+}
+/**
+ * setOption
+ * Sets a config key from the command line, quits if it is not one.
+ */
+static void setOption(const char* key, const char* value) {
+	if (!configSet(&config, key, value)) {
+		exit(1);
+	}
+}
+/**
+ * applyConfig
+ * Hands the config to the globals and the sim context that use it.
+ */
+void applyConfig() {
+	mountainDetailAccuracy = config.mapSize;
+	numIslands = config.islands;
+	gridSize = config.gridSize;
+	seaSlices = config.seaSlices;
+	skySlices = config.skySlices;
+	tickMs = config.tickMs;
+	erosionDroplets = config.erosion;
+	numThreads = config.threads;
+	sim.aiCount = config.aiCount;
+	sim.maxBullets = config.maxBullets;
+	sim.bulletSpeed = config.bulletSpeed;
+	sim.tickMs = config.tickMs;
+	textureSetBudget((size_t) config.textureBudgetKb * 1024);
+	archipelagoCount = config.archipelago;
+	viewLayoutIndex = config.views;
+	minimapRate = config.minimap;
+	governorInit(&governor, config.frameBudgetMs);
+}
+/**
+ * parseArguments
+ * Reads the recording options and settings and removes them before GLUT
+ * sees them.
+ */
+void parseArguments(int* argc, char** argv) {
+	int i;
+	int kept = 1;
+	configDefaults(&config);
+	//the file first, so the rest of the command line overrides it
+	for (i = 1; i + 1 < *argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && !configLoad(&config, argv[i + 1])) {
+			exit(1);
+		}
+	}
+	for (i = 1; i < *argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < *argc) {
+			i++;
+		} else if (strcmp(argv[i], "--set") == 0 && i + 1 < *argc) {
+			char key[64];
+			const char* equals = strchr(argv[++i], '=');
+			if (equals == NULL || equals - argv[i] >= (int) sizeof(key)) {
+				printf("--set needs key=value, not \"%s\".\n", argv[i]);
+				exit(1);
+			}
+			snprintf(key, sizeof(key), "%.*s", (int) (equals - argv[i]), argv[i]);
+			setOption(key, equals + 1);
+		} else if (strcmp(argv[i], "--print-config") == 0) {
+			printConfig = 1;
+		} else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < *argc) {
+			sweepFileName = argv[++i];
+		} else if (strcmp(argv[i], "--sweep-grid") == 0 && i + 1 < *argc) {
+			if (sweepKeys == SWEEP_MAX_KEYS) {
+				printf("At most %d --sweep-grid settings.\n", SWEEP_MAX_KEYS);
+				exit(1);
+			}
+			sweepGrid[sweepKeys++] = argv[++i];
+		} else if (strcmp(argv[i], "--sweep-point") == 0) {
+			sweepPoint = 1;
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < *argc) {
+			recordFileName = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < *argc) {
+			replayFileName = argv[++i];
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			headless = 1;
+		} else if (strcmp(argv[i], "--check-replay") == 0 && i + 1 < *argc) {
+			checkReplayFileName = argv[++i];
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < *argc) {
+			worldSeed = strtoul(argv[++i], NULL, 10);
+			fixedSeed = 1;
+		} else if (strcmp(argv[i], "--bench-render") == 0) {
+			benchRender = 1;
+		} else if (strcmp(argv[i], "--bench-reset") == 0 && i + 1 < *argc) {
+			benchResets = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bench-size") == 0 && i + 1 < *argc) {
+			sscanf(argv[++i], "%dx%d", &benchRenderWidth, &benchRenderHeight);
+		} else if (strcmp(argv[i], "--bench-frames") == 0 && i + 1 < *argc) {
+			benchFramesPerPath = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < *argc) {
+			benchOutputFile = argv[++i];
+		} else if (strcmp(argv[i], "--ai") == 0 && i + 1 < *argc) {
+			setOption("ai", argv[++i]);
+		} else if (strcmp(argv[i], "--bench-ai") == 0 && i + 1 < *argc) {
+			benchAiCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bench-flight") == 0) {
+			benchFlight = 1;
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < *argc) {
+			batchWorlds = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--map-size") == 0 && i + 1 < *argc) {
+			setOption("map_size", argv[++i]);
+		} else if (strcmp(argv[i], "--erosion") == 0 && i + 1 < *argc) {
+			setOption("erosion", argv[++i]);
+		} else if (strcmp(argv[i], "--world-cache") == 0 && i + 1 < *argc) {
+			worldCacheDir = argv[++i];
+		} else if (strcmp(argv[i], "--bench-transform") == 0 && i + 1 < *argc) {
+			benchTransformCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bench-erosion") == 0) {
+			benchErosion = 1;
+		} else if (strcmp(argv[i], "--bench-spatial") == 0) {
+			benchSpatial = 1;
+		} else if (strcmp(argv[i], "--telemetry") == 0) {
+			telemetryEnabled = 1;
+		} else if (strcmp(argv[i], "--telemetry-tail") == 0) {
+			telemetryTail = 1;
+		} else if (strcmp(argv[i], "--capture") == 0 && i + 1 < *argc) {
+			captureFileName = argv[++i];
+		} else if (strcmp(argv[i], "--capture-raw") == 0) {
+			captureRaw = 1;
+		} else if (strcmp(argv[i], "--capture-sync") == 0) {
+			captureSync = 1;
+		} else if (strcmp(argv[i], "--latency") == 0 && i + 1 < *argc) {
+			latencyEvents = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--latency-out") == 0 && i + 1 < *argc) {
+			latencyOutputFile = argv[++i];
+		} else if (strcmp(argv[i], "--build-lods") == 0) {
+			buildLods = 1;
+		} else if (strcmp(argv[i], "--bench-ticks") == 0 && i + 1 < *argc) {
+			benchTicks = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < *argc) {
+			setOption("threads", argv[++i]);
+		} else if (strcmp(argv[i], "--server") == 0) {
+			serverMode = 1;
+		} else if (strcmp(argv[i], "--connect") == 0 && i + 1 < *argc) {
+			connectHost = argv[++i];
+		} else if (strcmp(argv[i], "--port") == 0 && i + 1 < *argc) {
+			netPort = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bots") == 0 && i + 1 < *argc) {
+			botCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--bench-net") == 0 && i + 1 < *argc) {
+			benchNetCount = atoi(argv[++i]);
+		} else {
+			argv[kept++] = argv[i];
+		}
+	}
+	*argc = kept;
+	applyConfig();
+	if (connectHost != NULL && (recordFileName != NULL || replayFileName != NULL)) {
+		//a recording could not reproduce the other pilots
+		printf("--record and --replay are not supported with --connect.\n");
+		recordFileName = NULL;
+		replayFileName = NULL;
+		headless = 0;
+	}
+}
+/**
+ * recordInput
+ * Records a live input event at the current tick.
+ */
+static void recordInput(EventType type, int key, int state, int x, int y) {
+	InputEvent event = { simTick, type, key, state, x, y, 0 };
+	recordEvent(&event);
+}
+/*
+ * GLUT input callbacks.
+ * Live input is stamped for --latency, recorded, then passed to the
+ * handlers, while replaying it is ignored (apart from quitting) since the
+ * recording drives the handlers.
+ */
+void onKeyDown(unsigned char key, int mouseX, int mouseY) {
+	if (isReplaying()) {
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_KEY_DOWN, key, 0, mouseX, mouseY);
+	keyDown(key, mouseX, mouseY);
+}
+void onKeyUp(unsigned char key, int mouseX, int mouseY) {
+	if (isReplaying()) {
+		if (key == 'q') {
+			quit();
+		}
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_KEY_UP, key, 0, mouseX, mouseY);
+	keyUp(key, mouseX, mouseY);
+}
+void onKeySpecialDown(int key, int mouseX, int mouseY) {
+	if (isReplaying()) {
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_SPECIAL_DOWN, key, 0, mouseX, mouseY);
+	keySpecialDown(key, mouseX, mouseY);
+}
+void onKeySpecialUp(int key, int mouseX, int mouseY) {
+	if (isReplaying()) {
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_SPECIAL_UP, key, 0, mouseX, mouseY);
+	keySpecialUp(key, mouseX, mouseY);
+}
+void onMouseEvent(int x, int y) {
+	if (isReplaying()) {
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_MOUSE_MOVE, 0, 0, x, y);
+	mouseEvent(x, y);
+}
+void onMouseWheel(int button, int state, int x, int y) {
+	if (isReplaying()) {
+		return;
+	}
+	latencyInput();
+	recordInput(EVENT_MOUSE_BUTTON, button, state, x, y);
+	mouseWheel(button, state, x, y);
+}
+void onResize(int w, int h) {
+	if (!isReplaying()) {
+		recordInput(EVENT_RESIZE, 0, 0, w, h);
+		sim.inputWidth = w;
+		sim.inputHeight = h;
+	}
+	handleResize(w, h);
+}
+/**
+ * initAircraftRenderer
+ * Loads the meshes AI aircraft and other pilots are drawn with, needs a
+ * context.
+ */
+void initAircraftRenderer() {
+	if ((sim.aiCount <= 0 && networked == 0) || planeLods[0].numVertices > 0) {
+		return;
+	}
+	loadMeshLods("./resources/cessna", 1, planeLods);
+	loadMeshLods("./resources/propellar", 2, propellerLods);
+	if (!aircraftRendererInit(planeLods, propellerLods)) {
+		printf("Instancing unavailable, drawing AI aircraft one by one.\n");
+	}
+}
+/**
+ * drawAi
+ * Draws the AI aircraft, fogged like the terrain.
+ */
+void drawAi() {
+	GLfloat density = 0.0f;
+	if (sim.aiCount <= 0) {
+		return;
+	}
+	glPushAttrib(GL_ENABLE_BIT);
+	glEnable(GL_LIGHTING);
+	if (viewFog == 1) {
+		glGetFloatv(GL_FOG_DENSITY, &density);
+		glEnable(GL_FOG);
+	}
+	aircraftRendererDraw(world.aiSwarm.count, world.aiSwarm.x, world.aiSwarm.y, world.aiSwarm.z,
+			world.aiSwarm.dirX, world.aiSwarm.dirZ, world.aiSwarm.bank, world.universeTime * 0.8f,
+			density);
+	glPopAttrib();
+}
+/**
+ * connectToServer
+ * Joins the server given by --connect and takes its world seed.
+ * Waits a few seconds for the welcome, quits if none arrives.
+ */
+void connectToServer() {
+	NetAddress server;
+	PlayerInput idle;
+	double giveUp = timerNow() + 5.0;
+	memset(&idle, 0, sizeof(idle));
+	if (!netResolve(connectHost, netPort, &server)
+			|| !clientConnect(&netClient, &server)) {
+		exit(1);
+	}
+	while (netClient.connected == 0) {
+		if (timerNow() > giveUp) {
+			printf("No answer from %s:%d.\n", connectHost, netPort);
+			exit(1);
+		}
+		clientUpdate(&netClient, &idle);
+		timerSleep(tickMs / 1000.0);
+	}
+	networked = 1;
+	fixedSeed = 1;
+	worldSeed = netClient.seed;
+	netRateTime = timerNow();
+	printf("Connected to %s:%d as pilot %d.\n", connectHost, netPort,
+			netClient.id);
+}
+/**
+ * netTick
+ * Multiplayer replacement for update(): sends this tick's input and takes
+ * the camera and plane from the predicted pilot.
+ */
+void netTick() {
+	PlayerInput input;
+	PlayerState* pilot = &netClient.predicted;
+	int wasAlive = world.alive;
+	double now;
+	memset(&input, 0, sizeof(input));
+	input.buttons = (sim.boolAccelerate ? PLAYER_ACCELERATE : 0)
+			| (sim.boolDeaccelerate ? PLAYER_DECELERATE : 0)
+			| (sim.boolMoveUp ? PLAYER_MOVE_UP : 0)
+			| (sim.boolMoveDown ? PLAYER_MOVE_DOWN : 0)
+			| (sim.boolShoot ? PLAYER_SHOOT : 0)
+			| (sim.toggleAltControls ? PLAYER_ALT_CONTROLS : 0)
+			| (respawnRequested ? PLAYER_RESPAWN : 0);
+	input.steerX = (sim.inputWidth / 2.0f - sim.lastMouseX) / sim.inputWidth;
+	input.steerY = (sim.inputHeight / 2.0f - sim.lastMouseY) / sim.inputHeight;
+	input.wheel = wheelSteps > 0 ? 1 : wheelSteps < 0 ? -1 : 0;
+	wheelSteps = 0;
+	respawnRequested = 0;
+
+	world.universeTime += delta;
+	clientUpdate(&netClient, &input);
+	clientInterpolate(&netClient);
+
+	world.eyeX = pilot->x;
+	world.eyeY = pilot->y;
+	world.eyeZ = pilot->z;
+	world.planeRotation = pilot->rotation;
+	world.planeYawRotation = pilot->yawRotation;
+	world.planeTilt = pilot->tilt;
+	world.planeSpeed = pilot->speed;
+	world.alive = pilot->alive;
+	world.atX = world.eyeX + (sin(world.planeRotation) * 10.0f);
+	world.atY = world.eyeY + (sin(world.planeYawRotation) * 10.0f);
+	world.atZ = world.eyeZ + (cos(world.planeRotation) * 10.0f);
+	if (wasAlive == 1 && world.alive == 0) {
+		world.explosionScale = 0.0f;
+		world.exploding = 1;
+	}
+	//own bullets are only drawn, hits are decided by the server
+	worldUpdateBullets(&world, &sim);
+
+	now = timerNow();
+	if (now - netRateTime >= 1.0) {
+		netDownRate = (netClient.bytesReceived - netRateBytes)
+				/ (now - netRateTime);
+		netRateBytes = netClient.bytesReceived;
+		netRateTime = now;
+	}
+}
+/**
+ * drawRemotePilots
+ * Draws the other pilots where the player's plane would be drawn for them,
+ * half way to the look at point and below the camera.
+ */
+void drawRemotePilots() {
+	float x[NET_MAX_VISIBLE], y[NET_MAX_VISIBLE], z[NET_MAX_VISIBLE];
+	GLfloat density = 0.0f;
+	int i;
+	if (networked == 0 || netClient.numRemote == 0) {
+		return;
+	}
+	for (i = 0; i < netClient.numRemote; i++) {
+		x[i] = netClient.remoteX[i] + netClient.remoteDirX[i] * 5.0f;
+		y[i] = netClient.remoteY[i] - 2.0f;
+		z[i] = netClient.remoteZ[i] + netClient.remoteDirZ[i] * 5.0f;
+	}
+	glPushAttrib(GL_ENABLE_BIT);
+	glEnable(GL_LIGHTING);
+	if (viewFog == 1) {
+		glGetFloatv(GL_FOG_DENSITY, &density);
+		glEnable(GL_FOG);
+	}
+	aircraftRendererDraw(netClient.numRemote, x, y, z, netClient.remoteDirX,
+			netClient.remoteDirZ, netClient.remoteBank, world.universeTime * 0.8f,
+			density);
+	glPopAttrib();
+}
+/**
+ * runServer
+ * Runs a multiplayer server until killed, reporting every few seconds.
+ */
+void runServer() {
+	volatile int stop = 0;
+	if (fixedSeed == 0) {
+		worldSeed = time(NULL);
+	}
+	if (!serverStart(netPort, worldSeed, tickMs)) {
+		exit(1);
+	}
+	printf("Server: listening on port %d, seed %u\n", netPort, worldSeed);
+	serverRun(&stop, 5.0);
+	serverStop();
+}
+/**
+ * runBots
+ * Connects --bots simulated clients to the --connect server (localhost by
+ * default) and reports their traffic.
+ */
+void runBots() {
+	NetAddress server;
+	BotStats stats;
+	if (!netResolve(connectHost != NULL ? connectHost : "127.0.0.1", netPort,
+			&server)) {
+		exit(1);
+	}
+	if (benchTicks < 1) {
+		benchTicks = 1000;
+	}
+	if (!botsRun(&server, botCount, benchTicks, tickMs, &stats)) {
+		exit(1);
+	}
+	botsPrintStats(&stats);
+}
+/**
+ * runBatch
+ * Flies batchWorlds headless worlds from consecutive seeds, each for at
+ * most benchTicks ticks, and prints how they went.
+ */
+void runBatch() {
+	BatchResult result;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	if (benchTicks < 1) {
+		//a minute of flight
+		benchTicks = 4000;
+	}
+	if (!batchRun(batchWorlds, worldSeed, benchTicks, sim.aiCount, &result)) {
+		printf("Could not run %d worlds.\n", batchWorlds);
+		exit(1);
+	}
+	printf("Batch: %d worlds from seed %u, %d threads, up to %d ticks, %d AI aircraft each\n",
+			result.worlds, worldSeed, jobsWorkerCount(), benchTicks, sim.aiCount);
+	printf("Batch: %.1f%% crashed, flight time mean %.1f s, p50 %.1f s\n",
+			100.0 * result.crashes / result.worlds, result.flightTimeMean,
+			result.flightTimeP50);
+	printf("Batch: tick cost mean %.2f us, p99 %.2f us\n",
+			result.tickCostMean * 1000000.0, result.tickCostP99 * 1000000.0);
+	printf("Batch: %lld ticks in %.2f s, %.0f ticks/s\n", result.ticks,
+			result.seconds, result.ticks / result.seconds);
+}
+/**
+ * runBuildLods
+ * Writes the level of detail chain of the aircraft models next to them in
+ * resources, see simplify.h. Only needed after a model changes.
+ */
+void runBuildLods() {
+	const char* models[] = { "./resources/cessna", "./resources/propellar" };
+	const float ratios[MODEL_LODS - 1] = { 0.5f, 0.25f, 0.1f };
+	const float pixels[MODEL_LODS - 1] = AIRCRAFT_LOD_PIXELS;
+	float maxErrors[MODEL_LODS - 1];
+	SimplifyLevel levels[MODEL_LODS - 1];
+	int m, i, written;
+	//about a pixel at the largest size each level is drawn at
+	for (i = 0; i < MODEL_LODS - 1; i++) {
+		maxErrors[i] = 0.5f / pixels[i];
+	}
+	for (m = 0; m < 2; m++) {
+		double start = timerNow();
+		written = simplifyModel(models[m], MODEL_LODS - 1, ratios, maxErrors,
+				levels);
+		if (written < 0) {
+			printf("Could not simplify %s.\n", models[m]);
+			exit(1);
+		}
+		for (i = 0; i < written; i++) {
+			printf("LOD: %s.lod%d, %d triangles, error %.2f%% of its size\n",
+					models[m], i + 1, levels[i].triangles, levels[i].error * 100.0f);
+		}
+		printf("LOD: %s done in %.2f s\n", models[m], timerNow() - start);
+	}
+}
+/**
+ * startLatency
+ * Starts measuring latencyEvents inputs, fed by injectInput so the test
+ * runs without anyone at the controls.
+ */
+void startLatency() {
+	if (headless == 1 || !latencyStart(latencyEvents)) {
+		printf("Could not measure latency.\n");
+		exit(1);
+	}
+	rngSeed(&latencyRng, worldSeed, 0);
+	glutTimerFunc(rngRange(&latencyRng, LATENCY_INJECT_MIN_MS,
+			LATENCY_INJECT_MAX_MS), injectInput, 0);
+}
+/**
+ * injectInput
+ * Synthetic pilot for --latency: holds the up key, lets go of it, then
+ * moves the mouse, over and over. Each input goes through the GLUT
+ * callbacks like a real one, at random intervals so inputs land anywhere
+ * between two ticks.
+ */
+void injectInput(int step) {
+	if (!latencyActive() || latencyDone()) {
+		return;
+	}
+	if (step % 3 == 0) {
+		onKeySpecialDown(GLUT_KEY_UP, sim.lastMouseX, sim.lastMouseY);
+	} else if (step % 3 == 1) {
+		onKeySpecialUp(GLUT_KEY_UP, sim.lastMouseX, sim.lastMouseY);
+	} else {
+		onMouseEvent(rngRange(&latencyRng, 0, appWidth), appHeight / 2);
+	}
+	glutTimerFunc(rngRange(&latencyRng, LATENCY_INJECT_MIN_MS,
+			LATENCY_INJECT_MAX_MS), injectInput, step + 1);
+}
+/**
+ * finishLatency
+ * Reports the latency measurement and quits.
+ */
+void finishLatency() {
+	latencyReport(stdout);
+	if (latencyOutputFile != NULL && !latencyWriteSamples(latencyOutputFile)) {
+		printf("Could not write %s.\n", latencyOutputFile);
+	}
+	latencyStop();
+	quit();
+}
+/**
+ * startCapture
+ * Starts capturing width x height frames to captureFileName.
+ */
+void startCapture(int width, int height) {
+	if (headless == 1) {
+		//nothing is drawn to read back
+		printf("--capture needs a window and cannot be used with --headless.\n");
+		exit(1);
+	}
+	if (!captureStart(captureFileName, captureRaw == 1 ?
+			CAPTURE_RAW : CAPTURE_Y4M, width, height, tickMs, captureSync)) {
+		printf("Could not capture to %s.\n", captureFileName);
+		exit(1);
+	}
+	printf("Capturing %dx%d frames to %s\n", width, height, captureFileName);
+}
+/**
+ * finishCapture
+ * Writes the frames still in flight and reports the capture, if there is
+ * one.
+ */
+void finishCapture() {
+	if (captureActive()) {
+		captureStop();
+		captureReport(stdout);
+	}
+}
+/**
+ * initScene
+ * Builds the transform hierarchy of what is drawn: the islands, and the
+ * plane with its model and propellers below it.
+ */
+void initScene() {
+	const float propellerZ[2] = { 0.35f, -0.35f };
+	Vec3 min, max;
+	int i;
+	if (!transformInit(&scene, 8)) {
+		printf("Could not allocate the scene.\n");
+		exit(1);
+	}
+	for (i = 0; i < TERRAIN_MAX_ISLANDS; i++) {
+		islandNodes[i] = transformAdd(&scene, TRANSFORM_ROOT);
+	}
+	planeNode = transformAdd(&scene, TRANSFORM_ROOT);
+	//the model's nose points along x, the plane's along z
+	planeModelNode = transformAdd(&scene, planeNode);
+	transformSetTrs(&scene, planeModelNode, vec3Make(0, 0, 0),
+			quatAxisAngle(vec3Make(0, 1, 0), M_PI / 2), vec3Make(1, 1, 1));
+	if (meshBounds(&planeModel, &min, &max)) {
+		transformSetBounds(&scene, planeModelNode, min, max);
+	}
+	for (i = 0; i < 2; i++) {
+		propNodes[i] = transformAdd(&scene, planeModelNode);
+		propellerHubs[i] = vec3Make(-0.01f, -0.14f, propellerZ[i]);
+		if (meshBounds(&propModel, &min, &max)) {
+			transformSetBounds(&scene, propNodes[i], min, max);
+		}
+	}
+	transformUpdate(&scene);
+}
+/**
+ * meshBounds
+ * Finds the bounding box of a mesh. Returns 0 if it has no vertices.
+ */
+int meshBounds(const IndexedMesh* mesh, Vec3* min, Vec3* max) {
+	int i;
+	if (mesh->numVertices == 0) {
+		return 0;
+	}
+	*min = vec3Make(mesh->positions[0], mesh->positions[1], mesh->positions[2]);
+	*max = *min;
+	for (i = 1; i < mesh->numVertices; i++) {
+		const GLfloat* p = &mesh->positions[i * 3];
+		min->x = fminf(min->x, p[0]);
+		min->y = fminf(min->y, p[1]);
+		min->z = fminf(min->z, p[2]);
+		max->x = fmaxf(max->x, p[0]);
+		max->y = fmaxf(max->y, p[1]);
+		max->z = fmaxf(max->z, p[2]);
+	}
+	return 1;
+}
+/**
+ * placeIslands
+ * Moves the island nodes to the current world's islands: down so the edges
+ * are below the sea, halved, scaled by the island's own scale, out onto the
+ * circle and centred. Their bounds cover the jittered map up to its peak.
+ * The minimap draws its terrain layer again before it is next shown.
+ */
+void placeIslands() {
+	const Terrain* terrain = &world.terrain;
+	int size = terrain->mapSize;
+	int i, j;
+	minimapTerrainDirty = 1;
+	for (i = 0; i < terrain->islandCount; i++) {
+		const Island* island = &terrain->islands[i];
+		//radians, as the islands have always been placed
+		float angle = 90 * i;
+		Vec3 scale = vec3Make(0.5f * island->scaleX, 0.5f * island->scaleY,
+				0.5f * island->scaleZ);
+		Vec3 offset = vec3Make(sinf(angle) * TERRAIN_ISLAND_DISTANCE - size / 2.0f,
+				0, cosf(angle) * TERRAIN_ISLAND_DISTANCE - size / 2.0f);
+		float peak = 0.0f;
+		for (j = 0; j < size * size; j++) {
+			peak = island->heights[j] > peak ? island->heights[j] : peak;
+		}
+		transformSetTrs(&scene, islandNodes[i],
+				vec3Add(vec3Make(0, -2.5f, 0), vec3Mul(scale, offset)),
+				quatIdentity(), scale);
+		transformSetBounds(&scene, islandNodes[i], vec3Make(-0.5f, 0, -0.5f),
+				vec3Make(size - 0.5f, peak, size - 0.5f));
+	}
+}
+/**
+ * initArchipelago
+ * Scatters archipelagoCount copies of the world's islands over the sea,
+ * clear of the world's islands, and uploads them for drawing. What they
+ * are placed from lives in the world's arena, as long as the world does.
+ */
+void initArchipelago() {
+	ArchipelagoSettings settings;
+	float avoid[TERRAIN_MAX_ISLANDS * 3];
+	ArenaMark mark;
+	Rng rng;
+	int i;
+	transformUpdate(&scene);
+	for (i = 0; i < mountainIslandCount; i++) {
+		const TransformNode* node = &scene.nodes[islandNodes[i]];
+		float halfX = (node->worldMax.x - node->worldMin.x) * 0.5f;
+		float halfZ = (node->worldMax.z - node->worldMin.z) * 0.5f;
+		avoid[i * 3] = node->worldMin.x + halfX;
+		avoid[i * 3 + 1] = node->worldMin.z + halfZ;
+		avoid[i * 3 + 2] = sqrtf(halfX * halfX + halfZ * halfZ);
+	}
+	settings.count = archipelagoCount;
+	settings.types = mountainIslandCount;
+	settings.mapSize = mountainMapSize;
+	//inside the sky, which stands at the sea's edge
+	settings.radius = seaDetailAccuracy * 0.9f;
+	settings.avoid = avoid;
+	settings.numAvoid = mountainIslandCount;
+	rngSeedStream(&rng, world.seed, RNG_ARCHIPELAGO, 0);
+	mark = arenaMark(&frameArena);
+	if (!archipelagoGenerate(&archipelago, &world.arena, &frameArena, &rng,
+			&settings)) {
+		printf("Could not place the archipelago.\n");
+	}
+	arenaRewind(&frameArena, mark);
+	archipelagoUpload(&archipelago);
+}
+/**
+ * initMinimap
+ * Creates the minimap, whose terrain layer is drawn with the first frame.
+ */
+void initMinimap() {
+	minimapReady = minimapInit();
+	minimapTerrainDirty = 1;
+	minimapShownCount = -1;
+}
+/**
+ * updateMinimap
+ * Draws the minimap's terrain layer if the islands were placed since, and
+ * refreshes the map every minimapRate frames or at once when something
+ * came or went. Call once a frame, after the tick built the spatial hash.
+ */
+void updateMinimap() {
+	float range = seaDetailAccuracy + 2;
+	if (minimapReady == 0 || minimapRate == 0) {
+		return;
+	}
+	if (minimapTerrainDirty == 1) {
+		drawMinimapTerrain(range);
+		minimapTerrainDirty = 0;
+		minimapShownCount = -1;
+	}
+	minimapFrames++;
+	if (minimapFrames < minimapRate
+			&& world.spatial.count == minimapShownCount) {
+		return;
+	}
+	minimapComposite(&world.spatial, range);
+	minimapFrames = 0;
+	minimapShownCount = world.spatial.count;
+}
+/**
+ * drawMinimapTerrain
+ * Draws the islands and the archipelago straight down, range either way
+ * of the origin, lit and colored by height as without textures.
+ */
+void drawMinimapTerrain(float range) {
+	Mat4 projection, viewProjectionMatrix;
+	GLint textures = toggleMountainTextures;
+	mat4Ortho(&projection, -range, range, -range, range, 1.0f,
+			range * 4.0f);
+	//north up, so world z points down the map
+	mat4LookAt(&viewMatrix, vec3Make(0, range * 2.0f, 0), vec3Make(0, 0, 0),
+			vec3Make(0, 0, -1));
+	mat4Multiply(&viewProjectionMatrix, &projection, &viewMatrix);
+	frustumFromMatrix(&viewFrustum, &viewProjectionMatrix);
+	minimapBeginTerrain(&projection);
+	glLoadMatrixf(viewMatrix.m);
+	initLight();
+	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, none);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, none);
+	glEnable(GL_COLOR_MATERIAL);
+	glColorMaterial(GL_FRONT, GL_DIFFUSE);
+	toggleMountainTextures = 0;
+	drawMountains();
+	toggleMountainTextures = textures;
+	glLoadMatrixf(viewMatrix.m);
+	//where the sea is drawn
+	minimapEndTerrain(-1.0f);
+}
+/**
+ * planePosition
+ * Where the player's plane is drawn, between the camera and what it looks at.
+ */
+Vec3 planePosition() {
+	return vec3Make(
+			world.eyeX + ((world.atX - world.eyeX) / 2.0f) - world.upX * 2,
+			world.eyeY + ((world.atY - world.eyeY) / 2.0f) - world.upY * 2,
+			world.eyeZ + ((world.atZ - world.eyeZ) / 2.0f) - world.upZ * 2);
+}
+/**
+ * planeAttitude
+ * Rotation of the player's plane model, from the flight model or the arcade
+ * model's angles.
+ */
+Quat planeAttitude() {
+	Quat attitude;
+	if (world.toggleFlightModel == 1) {
+		const FlightBatch* flight = &world.playerFlight;
+		attitude.x = flight->qx[0];
+		attitude.y = flight->qy[0];
+		attitude.z = flight->qz[0];
+		attitude.w = flight->qw[0];
+		return attitude;
+	}
+	attitude = quatMultiply(
+			quatAxisAngle(vec3Make(0, 1, 0), world.planeRotation),
+			quatAxisAngle(vec3Make(0, 0, 1), -world.planeTilt * M_PI / 180.0f));
+	if (sim.toggleAltControls == 1) {
+		attitude = quatMultiply(attitude, quatAxisAngle(vec3Make(1, 0, 0),
+				-world.planeYawRotation * 30.0f * M_PI / 180.0f));
+	}
+	return attitude;
+}
+/**
+ * updateScene
+ * Moves the plane and turns its propellers for this frame, then updates the
+ * world matrices of whatever moved.
+ */
+void updateScene() {
+	Vec3 position = planePosition();
+	Quat spin;
+	int i;
+	if (world.alive == 1) {
+		transformSetTrs(&scene, planeNode, position, planeAttitude(),
+				vec3Make(0.8f, 0.8f, 0.8f));
+		propRotation += ((world.propellerSpeed - world.planeSpeed) * 2);
+		spin = quatAxisAngle(vec3Make(1, 0, 0), propRotation * M_PI / 180.0f);
+		//turn around the hub, the mesh sits 0.15 above and 0.35 behind it
+		for (i = 0; i < 2; i++) {
+			transformSetTrs(&scene, propNodes[i], vec3Add(propellerHubs[i],
+					quatRotate(spin, vec3Make(0, 0.15f, -0.35f))), spin,
+					vec3Make(1, 1, 1));
+		}
+	}
+	transformUpdate(&scene);
+}
+/**
+ * loadNodeMatrix
+ * Loads the camera's view times a scene node's world matrix as the
+ * modelview matrix.
+ */
+void loadNodeMatrix(int node) {
+	Mat4 modelview;
+	mat4Multiply(&modelview, &viewMatrix, transformWorld(&scene, node));
+	glLoadMatrixf(modelview.m);
+}
+/**
+ * runTelemetryTail
+ * Follows the telemetry stream of a sim run with --telemetry, printing a
+ * line every TELEMETRY_TAIL_EVERY records and what was lost, until that sim
+ * quits.
+ */
+void runTelemetryTail() {
+	TelemetryReader reader;
+	TelemetryRecord record;
+	unsigned long long received = 0;
+	int waiting = 0;
+#ifdef _WIN32
+	printf("Telemetry needs POSIX shared memory, which is not available here.\n");
+	exit(1);
+#endif
+	while (!telemetryOpenReader(&reader, TELEMETRY_NAME)) {
+		if (waiting == 0) {
+			printf("Waiting for a sim with --telemetry...\n");
+			fflush(stdout);
+			waiting = 1;
+		}
+		timerSleep(0.1);
+	}
+	printf("Telemetry: following %s\n", TELEMETRY_NAME);
+	while (1) {
+		//checked before reading, the last records come before the flag
+		int closed = telemetryPublisherClosed(&reader);
+		if (telemetryRead(&reader, &record)) {
+			if (received++ % TELEMETRY_TAIL_EVERY == 0) {
+				printf("tick %u pos %.1f %.1f %.1f quat %.3f %.3f %.3f %.3f speed %.2f"
+						" %s bullets %u (%u fired) tick %.3f ms frame %.2f ms\n",
+						record.tick, record.position[0], record.position[1],
+						record.position[2], record.orientation[0],
+						record.orientation[1], record.orientation[2],
+						record.orientation[3], record.speed, record.exploding ?
+								"exploding" : record.alive ? "alive" : "dead",
+						record.bulletsLive, record.bulletsFired, record.tickMs,
+						record.frameMs);
+				fflush(stdout);
+			}
+		} else if (closed) {
+			break;
+		} else {
+			timerSleep(0.001);
+		}
+	}
+	printf("Telemetry: %llu records, %llu overwritten before they were read,"
+			" %llu torn\n", received, (unsigned long long) reader.dropped,
+			(unsigned long long) reader.torn);
+	telemetryCloseReader(&reader);
+}
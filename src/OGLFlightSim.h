@@ -7,42 +7,104 @@
 #ifndef OGLFlightSim_H_
 #define OGLFlightSim_H_
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <tgmath.h>
 #include <unistd.h>
 #include <time.h>
+#include "glPlatform.h"
+#include "record.h"
+#include "rng.h"
+#include "ai.h"
+#include "flight.h"
+#include "world.h"
+#include "model.h"
+#include "client.h"
+#include "worldCache.h"
+#include "transform.h"
+#include "config.h"
+#include "arena.h"
+#include "texture.h"
+#include "archipelago.h"
+#include "view.h"
+#include "minimap.h"
+#include "governor.h"
+#include "benchModes.h"
 #ifdef _WIN32
-#include <windows.h>
-#include <gl/Gl.h>
 //#include <gl/freeglut.h>
 #define sleep(x) Sleep(1000 * x)
 #elif linux
-#include <string.h>
-#include </usr/include/GL/gl.h>
 #include </usr/include/GL/freeglut.h>
-typedef unsigned char BYTE;
 #endif
 
 //Update logic methods
 void update();
+void tick();
+
+//input recording and replay
+void parseArguments(int* argc, char** argv);
+void applyConfig();
+void newWorldSeed();
+void dispatchEvent(const InputEvent* event);
+void finishReplay();
+void runReplayCheck();
+void quit();
+
+//AI aircraft
+void initAircraftRenderer();
+void drawAi();
+
+//multiplayer
+void connectToServer();
+void netTick();
+void drawRemotePilots();
+void runServer();
+void runBots();
+
+//batch of headless worlds
+void runBatch();
+void runBuildLods();
+void startLatency();
+void injectInput(int step);
+void finishLatency();
+void buildMountains();
+WorldCacheKey mountainCacheKey();
+int loadCachedMountains();
+void saveCachedMountains();
+void initScene();
+int meshBounds(const IndexedMesh* mesh, Vec3* min, Vec3* max);
+void placeIslands();
+void initArchipelago();
+void updateScene();
+void loadNodeMatrix(int node);
+Vec3 planePosition();
+Quat planeAttitude();
+void publishTelemetry(double tickStart);
+void runTelemetryTail();
+void startCapture(int width, int height);
+void finishCapture();
 
 //Initialization methods
 void init();
+void initResources();
 void initNew();
+void resetWorld();
 void initLight();
 void initTextures();
+float pixelsPerUnit(float distance, int viewHeight);
+void wantTextures(const View* view, Vec3 eye);
 void initSea();
 void initSky();
 void initGrid();
-void initAxis();
-void initTarget();
 void initMountains();
 void initGL(void);
 void initializeGL(void);
 void initGLUT(int argc, char** argv);
 void handleResize(int w, int h);
 
-GLuint loadModel(GLuint id, GLuint numPoints, char* fileName, int colorScheme);
+void loadModel(IndexedMesh* model, char* fileName, int colorScheme);
+void drawModel(const IndexedMesh* model);
 
 //free memory
 void freeApp();
@@ -57,14 +119,29 @@ void drawPlane();
 void drawSky();
 void drawTarget();
 void drawMountains();
-void drawTarget();
-void drawExplosion(int slices, int stacks);
+void drawSpedometer();
+void drawAltometer();
+void drawReadouts();
+void drawRadar();
+void drawExplosion(int slices, int stacks, Rng* rng);
 void drawBullet(float x, float y, float z);
-void drawMountain(float mountainDetailAccuracy, int maxIterations);
+void buildMountain(const Island* island, int mapSize, const GLfloat* normals,
+		GLfloat* vertices);
+GLfloat* buildMountainVertex(const Island* island, int mapSize, int x, int z,
+		const GLfloat* normal, const GLfloat* color, GLfloat* out);
+int initMountainBuffers(int mapSize, int islands);
 
-void colorMountainByHeight(float x, float y, float z, float mountainDetailAccuracy);
+void colorMountainByHeight(float y, GLfloat color[4]);
 
 void explode();
+void advanceExplosion();
+void drawView(const View* view, const View* windowView, int primary);
+void viewCamera(ViewCamera camera, Vec3* eye, Vec3* at, Vec3* up);
+void drawViewBorders(const View* views, int numViews);
+void initMinimap();
+void updateMinimap();
+void drawMinimapTerrain(float range);
+void drawMinimap();
 
 //controls
 void keyDown(unsigned char key, int mouseX, int mouseY);
@@ -73,13 +150,54 @@ void keySpecialDown(int key, int mouseX, int mouseY);
 void keySpecialUp(int key, int mouseX, int mouseY);
 void mouseEvent(int x, int y);
 void mouseWheel(int button, int state, int x, int y);
+void onKeyDown(unsigned char key, int mouseX, int mouseY);
+void onKeyUp(unsigned char key, int mouseX, int mouseY);
+void onKeySpecialDown(int key, int mouseX, int mouseY);
+void onKeySpecialUp(int key, int mouseX, int mouseY);
+void onMouseEvent(int x, int y);
+void onMouseWheel(int button, int state, int x, int y);
+void onResize(int w, int h);
 void display(int ms);
 void handleResize(int w, int h);
 
-float randBetween(int min, int max);
+float randBetween(Rng* rng, int min, int max);
 
-GLfloat renderingOptions[] = { GL_FILL, GL_LINE };
-GLUquadricObj *seaObj;
-GLUquadricObj *skyObj;
-GLUquadricObj *mountainObj;
+//state defined in common.h that the bench modes in benchModes.c drive too
+extern Config config;
+extern GLint numIslands;
+extern GLint appWidth;
+extern GLint appHeight;
+extern GLint tickMs;
+extern unsigned int worldSeed;
+extern GLint fixedSeed;
+extern GLint benchRenderWidth;
+extern GLint benchRenderHeight;
+extern GLint benchFramesPerPath;
+extern GLint benchResets;
+extern char* benchOutputFile;
+extern GLint benchAiCount;
+extern GLint benchTicks;
+extern GLint netPort;
+extern GLint benchNetCount;
+extern float erosionDroplets;
+extern char* worldCacheDir;
+extern GLint benchTransformCount;
+extern char* captureFileName;
+extern char* sweepFileName;
+extern char* sweepGrid[SWEEP_MAX_KEYS];
+extern GLint sweepKeys;
+extern World world;
+extern SimContext sim;
+extern GLint toggleWireframe;
+extern GLint toggleFog;
+extern GLint toggleGrid;
+extern GLint toggleMountains;
+extern GLint toggleMountainTextures;
+extern GLint viewLayoutIndex;
+extern Arena frameArena;
+extern Archipelago archipelago;
+extern int archipelagoDraws;
+extern GLint minimapRate;
+extern Governor governor;
+extern GLfloat renderingOptions[];
 #endif /* OGLFlightSim_H_ */
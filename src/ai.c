@@ -0,0 +1,273 @@
+/**
+ * ai.c
+ * CG flight simulator
+ * AI aircraft swarm, see ai.h.
+ * The steering kernel only uses exactly rounded operations (no reciprocal
+ * estimates) so the SSE2 and scalar paths produce identical results.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ai.h"
+#include "jobs.h"
+#include "rng.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define AI_SPAWN_RADIUS 200.0f
+//fraction of the heading that turns towards the target each tick
+#define AI_TURN_RATE 0.04f
+//roll at the tightest turn, about 45 degrees
+#define AI_MAX_BANK 0.8f
+#define AI_BANK_SMOOTHING 0.1f
+#define AI_MAX_CLIMB 0.15f
+//angle ahead on the patrol circle that is steered towards
+#define AI_PATROL_LEAD 0.3f
+#define AI_FOLLOW_DISTANCE 6.0f
+#define AI_EVADE_RADIUS 60.0f
+//aircraft per job, a multiple of 4 so SIMD blocks never straddle jobs
+#define AI_GRAIN 256
+
+/**
+ * aiCreate
+ * Allocates and spawns a swarm of count aircraft. Returns 0 on failure.
+ */
+int aiCreate(AiSwarm* swarm, int count, unsigned int seed) {
+	return aiCreateIn(swarm, count, seed, NULL);
+}
+/**
+ * aiCreateIn
+ * aiCreate with the arrays taken from an arena, which then owns them and
+ * aiFree leaves them alone. A NULL arena takes them from the heap.
+ */
+int aiCreateIn(AiSwarm* swarm, int count, unsigned int seed, Arena* arena) {
+	float** arrays[] = { &swarm->x, &swarm->y, &swarm->z, &swarm->dirX,
+			&swarm->dirZ, &swarm->speed, &swarm->bank, &swarm->cruiseAltitude,
+			&swarm->homeX, &swarm->homeZ, &swarm->homeRadius, &swarm->targetX,
+			&swarm->targetY, &swarm->targetZ };
+	int numArrays = sizeof(arrays) / sizeof(arrays[0]);
+	size_t arrayBytes, bytes;
+	unsigned char* memory;
+	Rng rng;
+	int i;
+	memset(swarm, 0, sizeof(AiSwarm));
+	if (count <= 0) {
+		return 0;
+	}
+	swarm->count = count;
+	swarm->paddedCount = (count + 3) & ~3;
+	arrayBytes = swarm->paddedCount * sizeof(float);
+	bytes = arrayBytes * numArrays
+			+ swarm->paddedCount * (sizeof(unsigned char) + sizeof(int));
+	if (arena != NULL) {
+		memory = arenaAlloc(arena, bytes);
+	} else {
+		//16 bytes of slack to align the first array, later ones stay aligned
+		memory = swarm->memory = malloc(bytes + 16);
+	}
+	if (memory == NULL) {
+		swarm->count = 0;
+		return 0;
+	}
+	memory += (16 - ((size_t) memory & 15)) & 15;
+	for (i = 0; i < numArrays; i++) {
+		*arrays[i] = (float*) memory;
+		memory += arrayBytes;
+	}
+	swarm->leader = (int*) memory;
+	memory += swarm->paddedCount * sizeof(int);
+	swarm->behaviour = memory;
+
+	rngSeedStream(&rng, seed, RNG_AI, 0);
+	for (i = 0; i < swarm->paddedCount; i++) {
+		float heading = rngFloat(&rng) * 6.2831853f;
+		float angle = rngFloat(&rng) * 6.2831853f;
+		float distance = sqrtf(rngFloat(&rng)) * AI_SPAWN_RADIUS;
+		uint32_t roll = rngBounded(&rng, 10);
+		swarm->x[i] = cosf(angle) * distance;
+		swarm->z[i] = sinf(angle) * distance;
+		swarm->cruiseAltitude[i] = 10.0f + rngFloat(&rng) * 30.0f;
+		swarm->y[i] = swarm->cruiseAltitude[i];
+		swarm->dirX[i] = sinf(heading);
+		swarm->dirZ[i] = cosf(heading);
+		swarm->speed[i] = 0.25f + rngFloat(&rng) * 0.25f;
+		swarm->bank[i] = 0.0f;
+		swarm->homeX[i] = swarm->x[i];
+		swarm->homeZ[i] = swarm->z[i];
+		swarm->homeRadius[i] = 20.0f + rngFloat(&rng) * 60.0f;
+		swarm->targetX[i] = swarm->x[i];
+		swarm->targetY[i] = swarm->y[i];
+		swarm->targetZ[i] = swarm->z[i];
+		swarm->leader[i] = 0;
+		if (roll < 6 || i == 0) {
+			swarm->behaviour[i] = AI_PATROL;
+		} else if (roll < 9) {
+			//leaders always come earlier so chains end at a patrolling aircraft
+			swarm->behaviour[i] = AI_FOLLOW;
+			swarm->leader[i] = rngBounded(&rng, i);
+		} else {
+			swarm->behaviour[i] = AI_EVADE;
+		}
+	}
+	return 1;
+}
+/**
+ * aiFree
+ */
+void aiFree(AiSwarm* swarm) {
+	free(swarm->memory);
+	memset(swarm, 0, sizeof(AiSwarm));
+}
+/**
+ * patrolTarget
+ * Picks a point a little further along the patrol circle.
+ */
+static void patrolTarget(AiSwarm* s, int i) {
+	float offsetX = s->x[i] - s->homeX[i];
+	float offsetZ = s->z[i] - s->homeZ[i];
+	float length = sqrtf(offsetX * offsetX + offsetZ * offsetZ);
+	float c = cosf(AI_PATROL_LEAD), sn = sinf(AI_PATROL_LEAD);
+	if (length < 0.001f) {
+		offsetX = 1.0f;
+		offsetZ = 0.0f;
+		length = 1.0f;
+	}
+	offsetX /= length;
+	offsetZ /= length;
+	s->targetX[i] = s->homeX[i] + (offsetX * c - offsetZ * sn) * s->homeRadius[i];
+	s->targetZ[i] = s->homeZ[i] + (offsetX * sn + offsetZ * c) * s->homeRadius[i];
+	s->targetY[i] = s->cruiseAltitude[i];
+}
+/**
+ * chooseTargets
+ * First pass, only reads positions and writes each aircraft's own target.
+ */
+static void chooseTargets(void* data, int begin, int end, int worker) {
+	AiSwarm* s = data;
+	int i;
+	for (i = begin; i < end; i++) {
+		switch (s->behaviour[i]) {
+		case AI_FOLLOW: {
+			int l = s->leader[i];
+			s->targetX[i] = s->x[l] - s->dirX[l] * AI_FOLLOW_DISTANCE;
+			s->targetY[i] = s->y[l];
+			s->targetZ[i] = s->z[l] - s->dirZ[l] * AI_FOLLOW_DISTANCE;
+			break;
+		}
+		case AI_EVADE: {
+			float awayX = s->x[i] - s->threatX;
+			float awayZ = s->z[i] - s->threatZ;
+			float distance = sqrtf(awayX * awayX + awayZ * awayZ);
+			if (distance < AI_EVADE_RADIUS && distance > 0.001f) {
+				s->targetX[i] = s->x[i] + awayX / distance * AI_EVADE_RADIUS;
+				s->targetZ[i] = s->z[i] + awayZ / distance * AI_EVADE_RADIUS;
+				s->targetY[i] = fmaxf(s->cruiseAltitude[i], s->threatY + 10.0f);
+			} else {
+				patrolTarget(s, i);
+			}
+			break;
+		}
+		default:
+			patrolTarget(s, i);
+			break;
+		}
+	}
+}
+/**
+ * steerScalar
+ * Second pass for a range of aircraft, turns towards the target, banks
+ * with the turn and moves forward.
+ */
+static void steerScalar(AiSwarm* s, int begin, int end) {
+	int i;
+	for (i = begin; i < end; i++) {
+		float toX = s->targetX[i] - s->x[i];
+		float toZ = s->targetZ[i] - s->z[i];
+		float length = sqrtf(toX * toX + toZ * toZ) + 0.001f;
+		float dirX, dirZ, turn, climb;
+		toX /= length;
+		toZ /= length;
+		turn = s->dirZ[i] * toX - s->dirX[i] * toZ;
+		turn = fminf(fmaxf(turn, -1.0f), 1.0f);
+		dirX = s->dirX[i] + toX * AI_TURN_RATE;
+		dirZ = s->dirZ[i] + toZ * AI_TURN_RATE;
+		length = sqrtf(dirX * dirX + dirZ * dirZ) + 0.000001f;
+		s->dirX[i] = dirX / length;
+		s->dirZ[i] = dirZ / length;
+		s->bank[i] += (turn * AI_MAX_BANK - s->bank[i]) * AI_BANK_SMOOTHING;
+		climb = s->targetY[i] - s->y[i];
+		climb = fminf(fmaxf(climb, -AI_MAX_CLIMB), AI_MAX_CLIMB);
+		s->x[i] += s->dirX[i] * s->speed[i];
+		s->y[i] += climb;
+		s->z[i] += s->dirZ[i] * s->speed[i];
+	}
+}
+/**
+ * steer
+ * Job wrapper for the second pass, four aircraft at a time with SSE2.
+ */
+static void steer(void* data, int begin, int end, int worker) {
+	AiSwarm* s = data;
+#ifdef __SSE2__
+	const __m128 turnRate = _mm_set1_ps(AI_TURN_RATE);
+	const __m128 maxBank = _mm_set1_ps(AI_MAX_BANK);
+	const __m128 smoothing = _mm_set1_ps(AI_BANK_SMOOTHING);
+	const __m128 maxClimb = _mm_set1_ps(AI_MAX_CLIMB);
+	const __m128 minClimb = _mm_set1_ps(-AI_MAX_CLIMB);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 epsilon = _mm_set1_ps(0.001f);
+	const __m128 tiny = _mm_set1_ps(0.000001f);
+	int i;
+	for (i = begin; i + 4 <= end; i += 4) {
+		__m128 x = _mm_load_ps(s->x + i);
+		__m128 y = _mm_load_ps(s->y + i);
+		__m128 z = _mm_load_ps(s->z + i);
+		__m128 dirX = _mm_load_ps(s->dirX + i);
+		__m128 dirZ = _mm_load_ps(s->dirZ + i);
+		__m128 bank = _mm_load_ps(s->bank + i);
+		__m128 speed = _mm_load_ps(s->speed + i);
+		__m128 toX = _mm_sub_ps(_mm_load_ps(s->targetX + i), x);
+		__m128 toZ = _mm_sub_ps(_mm_load_ps(s->targetZ + i), z);
+		__m128 climb = _mm_sub_ps(_mm_load_ps(s->targetY + i), y);
+		__m128 length = _mm_add_ps(_mm_sqrt_ps(_mm_add_ps(
+				_mm_mul_ps(toX, toX), _mm_mul_ps(toZ, toZ))), epsilon);
+		__m128 turn;
+		toX = _mm_div_ps(toX, length);
+		toZ = _mm_div_ps(toZ, length);
+		turn = _mm_sub_ps(_mm_mul_ps(dirZ, toX), _mm_mul_ps(dirX, toZ));
+		turn = _mm_min_ps(_mm_max_ps(turn, minusOne), one);
+		dirX = _mm_add_ps(dirX, _mm_mul_ps(toX, turnRate));
+		dirZ = _mm_add_ps(dirZ, _mm_mul_ps(toZ, turnRate));
+		length = _mm_add_ps(_mm_sqrt_ps(_mm_add_ps(
+				_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirZ, dirZ))), tiny);
+		dirX = _mm_div_ps(dirX, length);
+		dirZ = _mm_div_ps(dirZ, length);
+		bank = _mm_add_ps(bank, _mm_mul_ps(_mm_sub_ps(
+				_mm_mul_ps(turn, maxBank), bank), smoothing));
+		climb = _mm_min_ps(_mm_max_ps(climb, minClimb), maxClimb);
+		_mm_store_ps(s->dirX + i, dirX);
+		_mm_store_ps(s->dirZ + i, dirZ);
+		_mm_store_ps(s->bank + i, bank);
+		_mm_store_ps(s->x + i, _mm_add_ps(x, _mm_mul_ps(dirX, speed)));
+		_mm_store_ps(s->y + i, _mm_add_ps(y, climb));
+		_mm_store_ps(s->z + i, _mm_add_ps(z, _mm_mul_ps(dirZ, speed)));
+	}
+	steerScalar(s, i, end);
+#else
+	steerScalar(s, begin, end);
+#endif
+}
+/**
+ * aiUpdate
+ * Advances the swarm by one tick.
+ */
+void aiUpdate(AiSwarm* swarm, float threatX, float threatY, float threatZ) {
+	swarm->threatX = threatX;
+	swarm->threatY = threatY;
+	swarm->threatZ = threatZ;
+	jobsParallelFor(swarm->paddedCount, AI_GRAIN, chooseTargets, swarm);
+	jobsParallelFor(swarm->paddedCount, AI_GRAIN, steer, swarm);
+}
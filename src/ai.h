@@ -0,0 +1,57 @@
+/*
+ * ai.h
+ * CG flight simulator
+ * AI aircraft swarm stored as structure of arrays.
+ * Each tick first picks a steering target per aircraft from the previous
+ * state, then steers and moves every aircraft with a SIMD kernel. Both
+ * passes are split across the worker threads.
+ */
+
+#ifndef AI_H_
+#define AI_H_
+#include "arena.h"
+
+typedef enum AiBehaviour {
+	AI_PATROL,
+	AI_FOLLOW,
+	AI_EVADE
+} AiBehaviour;
+
+typedef struct AiSwarm {
+	int count;
+	//count rounded up to a multiple of 4, the extra aircraft are simulated but never drawn
+	int paddedCount;
+	float* x;
+	float* y;
+	float* z;
+	//horizontal direction of travel, unit length
+	float* dirX;
+	float* dirZ;
+	float* speed;
+	//roll in radians, follows the turn rate
+	float* bank;
+	float* cruiseAltitude;
+	//patrol circle
+	float* homeX;
+	float* homeZ;
+	float* homeRadius;
+	//steering target picked by the first pass
+	float* targetX;
+	float* targetY;
+	float* targetZ;
+	unsigned char* behaviour;
+	int* leader;
+	//position evading aircraft keep away from (the player)
+	float threatX;
+	float threatY;
+	float threatZ;
+	//single allocation backing every array, NULL when an arena owns them
+	void* memory;
+} AiSwarm;
+
+int aiCreate(AiSwarm* swarm, int count, unsigned int seed);
+int aiCreateIn(AiSwarm* swarm, int count, unsigned int seed, Arena* arena);
+void aiFree(AiSwarm* swarm);
+void aiUpdate(AiSwarm* swarm, float threatX, float threatY, float threatZ);
+
+#endif /* AI_H_ */
@@ -0,0 +1,454 @@
+/**
+ * aircraftRenderer.c
+ * CG flight simulator
+ * Instanced aircraft drawing, see aircraftRenderer.h.
+ * The shader repeats the transforms of the player's plane in draw() and
+ * drawProps(): scale, heading, bank, the model's quarter turn and for the
+ * propellers their offset and spin.
+ * Each aircraft keeps its level of detail from frame to frame and only
+ * changes it once its size on screen is clearly past the threshold, so one
+ * flying along at the threshold does not flicker between two levels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "aircraftRenderer.h"
+#include "glFunctions.h"
+#include "shader.h"
+
+//per aircraft arrays, in the order they are stored in the instance buffer
+#define INSTANCE_ARRAYS 6
+//how far past a threshold the size must go before the level changes
+#define LOD_HYSTERESIS 0.15f
+//scale of the aircraft, as in draw()
+#define AIRCRAFT_SCALE 0.8f
+
+static const float lodPixels[MODEL_LODS - 1] = AIRCRAFT_LOD_PIXELS;
+
+static const char* vertexSource =
+		"#version 120\n"
+		"attribute vec3 position;\n"
+		"attribute vec3 normal;\n"
+		"attribute vec4 color;\n"
+		"attribute float instanceX;\n"
+		"attribute float instanceY;\n"
+		"attribute float instanceZ;\n"
+		"attribute float instanceDirX;\n"
+		"attribute float instanceDirZ;\n"
+		"attribute float instanceBank;\n"
+		"uniform float propellerAngle;\n"
+		//0 for the body, -1 or 1 for the propeller on either side
+		"uniform float propellerSide;\n"
+		"uniform float fogDensity;\n"
+		"varying vec4 litColor;\n"
+		"varying float fogFactor;\n"
+		"vec3 place(vec3 v) {\n"
+		"	float c = cos(-instanceBank);\n"
+		"	float s = sin(-instanceBank);\n"
+		"	v = vec3(v.z, v.y, -v.x);\n"
+		"	v = vec3(c * v.x - s * v.y, s * v.x + c * v.y, v.z);\n"
+		"	return vec3(instanceDirZ * v.x + instanceDirX * v.z, v.y,\n"
+		"			instanceDirZ * v.z - instanceDirX * v.x);\n"
+		"}\n"
+		"void main() {\n"
+		"	vec3 p = position;\n"
+		"	vec3 n = normal;\n"
+		"	if (propellerSide != 0.0) {\n"
+		"		float c = cos(propellerAngle);\n"
+		"		float s = sin(propellerAngle);\n"
+		"		p += vec3(0.0, 0.15, -0.35);\n"
+		"		p = vec3(p.x, c * p.y - s * p.z, s * p.y + c * p.z);\n"
+		"		n = vec3(n.x, c * n.y - s * n.z, s * n.y + c * n.z);\n"
+		"		p += vec3(-0.01, -0.14, 0.35 * propellerSide);\n"
+		"	}\n"
+		"	vec4 eye = gl_ModelViewMatrix * vec4(place(p) * 0.8\n"
+		"			+ vec3(instanceX, instanceY, instanceZ), 1.0);\n"
+		"	vec3 eyeNormal = normalize(gl_NormalMatrix * place(n));\n"
+		"	vec3 light = normalize(gl_LightSource[0].position.xyz\n"
+		"			- eye.xyz * gl_LightSource[0].position.w);\n"
+		"	float diffuse = max(dot(eyeNormal, light), 0.0);\n"
+		"	litColor = vec4(color.rgb * (gl_LightSource[0].ambient.rgb * 0.2\n"
+		"			+ gl_LightSource[0].diffuse.rgb * diffuse), color.a);\n"
+		"	fogFactor = clamp(exp(-fogDensity * length(eye.xyz)), 0.0, 1.0);\n"
+		"	gl_Position = gl_ProjectionMatrix * eye;\n"
+		"}\n";
+
+static const char* fragmentSource =
+		"#version 120\n"
+		"varying vec4 litColor;\n"
+		"varying float fogFactor;\n"
+		"void main() {\n"
+		"	gl_FragColor = vec4(mix(gl_Fog.color.rgb, litColor.rgb, fogFactor),\n"
+		"			litColor.a);\n"
+		"}\n";
+
+static const char* attributes[] = { "position", "normal", "color",
+		"instanceX", "instanceY", "instanceZ", "instanceDirX", "instanceDirZ",
+		"instanceBank" };
+
+static const Mesh* planeLods = NULL;
+static const Mesh* propellerLods = NULL;
+static int numLods = 0;
+//the propeller may have fewer levels, coarser plane levels reuse its last
+static int numPropellerLods = 0;
+//model diameter, world units
+static float planeSize = 0.0f;
+//scales the size on screen levels are picked by, under 1 picks coarser ones
+static float detail = 1.0f;
+//level of each aircraft, by index
+static unsigned char* levels = NULL;
+static int levelCapacity = 0;
+//instance arrays sorted by level, each instanceCapacity long
+static float* sortedArrays = NULL;
+static GLuint program = 0;
+static GLint propellerAngleLocation;
+static GLint propellerSideLocation;
+static GLint fogDensityLocation;
+//every plane level then every propeller level, positions, normals and
+//colors of each
+static GLuint meshBuffer = 0;
+static GLintptr planeOffsets[MODEL_LODS];
+static GLintptr propellerOffsets[MODEL_LODS];
+static GLuint instanceBuffer = 0;
+static int instanceCapacity = 0;
+
+/**
+ * meshBytes
+ */
+static GLsizeiptr meshBytes(const Mesh* mesh) {
+	return sizeof(GLfloat) * 10 * mesh->numVertices;
+}
+/**
+ * uploadMesh
+ * Copies a mesh into the mesh buffer at offset, stored array after array.
+ */
+static void uploadMesh(const Mesh* mesh, GLintptr offset) {
+	GLsizeiptr vectorBytes = sizeof(GLfloat) * 3 * mesh->numVertices;
+	pglBufferSubData(GL_ARRAY_BUFFER, offset, vectorBytes, mesh->positions);
+	pglBufferSubData(GL_ARRAY_BUFFER, offset + vectorBytes, vectorBytes,
+			mesh->normals);
+	pglBufferSubData(GL_ARRAY_BUFFER, offset + vectorBytes * 2,
+			sizeof(GLfloat) * 4 * mesh->numVertices, mesh->colors);
+}
+/**
+ * propellerLevel
+ * The propeller level drawn with a plane level.
+ */
+static int propellerLevel(int level) {
+	return level < numPropellerLods ? level : numPropellerLods - 1;
+}
+/**
+ * aircraftRendererInit
+ * Prepares drawing of the given levels of detail (see loadMeshLods), which
+ * must stay loaded until aircraftRendererFree. The plane's levels are drawn
+ * with the propeller's of the same level, or its last if it has fewer.
+ * Returns 1 if instanced drawing is available.
+ */
+int aircraftRendererInit(const Mesh plane[MODEL_LODS],
+		const Mesh propeller[MODEL_LODS]) {
+	GLsizeiptr bytes = 0;
+	int i;
+	planeLods = plane;
+	propellerLods = propeller;
+	numLods = 0;
+	numPropellerLods = 0;
+	while (numLods < MODEL_LODS && plane[numLods].numVertices > 0) {
+		numLods++;
+	}
+	while (numPropellerLods < MODEL_LODS
+			&& propeller[numPropellerLods].numVertices > 0) {
+		numPropellerLods++;
+	}
+	if (numPropellerLods == 0) {
+		numLods = 0;
+	}
+	planeSize = 0.0f;
+	for (i = 0; i < plane[0].numVertices; i++) {
+		const GLfloat* p = &plane[0].positions[i * 3];
+		float size = 2.0f * AIRCRAFT_SCALE * sqrtf(p[0] * p[0] + p[1] * p[1]
+				+ p[2] * p[2]);
+		if (size > planeSize) {
+			planeSize = size;
+		}
+	}
+	if (!hasShaders || !hasBuffers || !hasInstancing || numLods == 0) {
+		return 0;
+	}
+	program = compileProgram(vertexSource, fragmentSource, attributes,
+			sizeof(attributes) / sizeof(attributes[0]));
+	if (program == 0) {
+		return 0;
+	}
+	propellerAngleLocation = pglGetUniformLocation(program, "propellerAngle");
+	propellerSideLocation = pglGetUniformLocation(program, "propellerSide");
+	fogDensityLocation = pglGetUniformLocation(program, "fogDensity");
+
+	for (i = 0; i < numLods; i++) {
+		planeOffsets[i] = bytes;
+		bytes += meshBytes(&plane[i]);
+	}
+	for (i = 0; i < numPropellerLods; i++) {
+		propellerOffsets[i] = bytes;
+		bytes += meshBytes(&propeller[i]);
+	}
+	pglGenBuffers(1, &meshBuffer);
+	pglBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+	pglBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+	for (i = 0; i < numLods; i++) {
+		uploadMesh(&plane[i], planeOffsets[i]);
+	}
+	for (i = 0; i < numPropellerLods; i++) {
+		uploadMesh(&propeller[i], propellerOffsets[i]);
+	}
+	pglGenBuffers(1, &instanceBuffer);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+	instanceCapacity = 0;
+	return 1;
+}
+/**
+ * aircraftRendererInstanced
+ * Returns 1 if aircraft are drawn with instancing.
+ */
+int aircraftRendererInstanced(void) {
+	return program != 0;
+}
+/**
+ * aircraftRendererSetDetail
+ * Scales the size on screen levels of detail are picked by, 1 picks them
+ * by the size itself.
+ */
+void aircraftRendererSetDetail(float scale) {
+	detail = scale;
+}
+/**
+ * aircraftRendererFree
+ */
+void aircraftRendererFree(void) {
+	if (program != 0) {
+		pglDeleteProgram(program);
+		pglDeleteBuffers(1, &meshBuffer);
+		pglDeleteBuffers(1, &instanceBuffer);
+	}
+	program = 0;
+	meshBuffer = 0;
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+	free(levels);
+	free(sortedArrays);
+	levels = NULL;
+	levelCapacity = 0;
+	sortedArrays = NULL;
+	planeLods = NULL;
+	propellerLods = NULL;
+	numLods = 0;
+	numPropellerLods = 0;
+}
+/**
+ * selectLevels
+ * Picks each aircraft's level from its height on screen under the current
+ * matrices and viewport. Returns 0 if the levels could not be allocated.
+ */
+static int selectLevels(int count, const float* x, const float* y,
+		const float* z) {
+	GLfloat modelview[16], projection[16];
+	GLint viewport[4];
+	float pixelsPerUnit;
+	int i;
+	if (count > levelCapacity) {
+		unsigned char* grown = realloc(levels, count);
+		if (grown == NULL) {
+			return 0;
+		}
+		//new aircraft start coarse and refine at once
+		memset(grown + levelCapacity, numLods - 1, count - levelCapacity);
+		levels = grown;
+		levelCapacity = count;
+	}
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	//pixels a unit high covers one unit in front of the eye
+	pixelsPerUnit = projection[5] * viewport[3] * 0.5f * detail;
+	for (i = 0; i < count; i++) {
+		float eyeX = modelview[0] * x[i] + modelview[4] * y[i]
+				+ modelview[8] * z[i] + modelview[12];
+		float eyeY = modelview[1] * x[i] + modelview[5] * y[i]
+				+ modelview[9] * z[i] + modelview[13];
+		float eyeZ = modelview[2] * x[i] + modelview[6] * y[i]
+				+ modelview[10] * z[i] + modelview[14];
+		float distance = sqrtf(eyeX * eyeX + eyeY * eyeY + eyeZ * eyeZ);
+		float pixels = planeSize * pixelsPerUnit / fmaxf(distance, 0.001f);
+		int level = levels[i] < numLods ? levels[i] : numLods - 1;
+		while (level > 0 && pixels > lodPixels[level - 1] * (1 + LOD_HYSTERESIS)) {
+			level--;
+		}
+		while (level < numLods - 1
+				&& pixels < lodPixels[level] * (1 - LOD_HYSTERESIS)) {
+			level++;
+		}
+		levels[i] = level;
+	}
+	return 1;
+}
+/**
+ * bindMesh
+ * Points the per vertex attributes at a mesh in the mesh buffer.
+ */
+static void bindMesh(const Mesh* mesh, GLintptr offset) {
+	GLsizeiptr vectorBytes = sizeof(GLfloat) * 3 * mesh->numVertices;
+	pglBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+	pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*) offset);
+	pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0,
+			(void*) (offset + vectorBytes));
+	pglVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0,
+			(void*) (offset + vectorBytes * 2));
+}
+/**
+ * drawInstanced
+ * Uploads the aircraft arrays sorted by level and draws the body and both
+ * propellers of each level.
+ */
+static void drawInstanced(int count, const float* arrays[INSTANCE_ARRAYS],
+		float propellerAngle, float fogDensity) {
+	int first[MODEL_LODS + 1];
+	int next[MODEL_LODS];
+	int i, a, level, propeller;
+
+	if (count > instanceCapacity) {
+		float* grown = realloc(sortedArrays,
+				sizeof(float) * count * INSTANCE_ARRAYS);
+		if (grown == NULL) {
+			return;
+		}
+		sortedArrays = grown;
+		instanceCapacity = count;
+	}
+	memset(first, 0, sizeof(first));
+	for (i = 0; i < count; i++) {
+		first[levels[i] + 1]++;
+	}
+	for (level = 0; level < numLods; level++) {
+		first[level + 1] += first[level];
+		next[level] = first[level];
+	}
+	for (i = 0; i < count; i++) {
+		int slot = next[levels[i]]++;
+		for (a = 0; a < INSTANCE_ARRAYS; a++) {
+			sortedArrays[instanceCapacity * a + slot] = arrays[a][i];
+		}
+	}
+
+	pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	//new storage every frame so the upload never waits for the GPU
+	pglBufferData(GL_ARRAY_BUFFER, sizeof(float) * instanceCapacity
+			* INSTANCE_ARRAYS, sortedArrays, GL_STREAM_DRAW);
+	for (i = 0; i < INSTANCE_ARRAYS; i++) {
+		pglVertexAttribDivisor(3 + i, 1);
+	}
+	for (i = 0; i < 3 + INSTANCE_ARRAYS; i++) {
+		pglEnableVertexAttribArray(i);
+	}
+
+	pglUseProgram(program);
+	pglUniform1f(propellerAngleLocation, propellerAngle);
+	pglUniform1f(fogDensityLocation, fogDensity);
+	for (level = 0; level < numLods; level++) {
+		int levelCount = first[level + 1] - first[level];
+		if (levelCount == 0) {
+			continue;
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (i = 0; i < INSTANCE_ARRAYS; i++) {
+			pglVertexAttribPointer(3 + i, 1, GL_FLOAT, GL_FALSE, 0,
+					(void*) (sizeof(float) * (instanceCapacity * i + first[level])));
+		}
+		pglUniform1f(propellerSideLocation, 0);
+		bindMesh(&planeLods[level], planeOffsets[level]);
+		pglDrawArraysInstanced(GL_TRIANGLES, 0, planeLods[level].numVertices,
+				levelCount);
+		propeller = propellerLevel(level);
+		bindMesh(&propellerLods[propeller], propellerOffsets[propeller]);
+		pglUniform1f(propellerSideLocation, 1);
+		pglDrawArraysInstanced(GL_TRIANGLES, 0,
+				propellerLods[propeller].numVertices, levelCount);
+		pglUniform1f(propellerSideLocation, -1);
+		pglDrawArraysInstanced(GL_TRIANGLES, 0,
+				propellerLods[propeller].numVertices, levelCount);
+	}
+	pglUseProgram(0);
+
+	for (i = 0; i < 3 + INSTANCE_ARRAYS; i++) {
+		pglDisableVertexAttribArray(i);
+	}
+	for (i = 0; i < INSTANCE_ARRAYS; i++) {
+		pglVertexAttribDivisor(3 + i, 0);
+	}
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+/**
+ * drawMeshArrays
+ * Draws a mesh from client side vertex arrays.
+ */
+static void drawMeshArrays(const Mesh* mesh) {
+	glVertexPointer(3, GL_FLOAT, 0, mesh->positions);
+	glNormalPointer(GL_FLOAT, 0, mesh->normals);
+	glColorPointer(4, GL_FLOAT, 0, mesh->colors);
+	glDrawArrays(GL_TRIANGLES, 0, mesh->numVertices);
+}
+/**
+ * drawFixedFunction
+ * Fallback without shaders, one set of transforms and draws per aircraft.
+ */
+static void drawFixedFunction(int count, const float* x, const float* y,
+		const float* z, const float* dirX, const float* dirZ, const float* bank,
+		float propellerAngle) {
+	float angleDeg = propellerAngle * 180.0f / M_PI;
+	int i, side;
+	glEnable(GL_COLOR_MATERIAL);
+	glColorMaterial(GL_FRONT, GL_DIFFUSE);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	for (i = 0; i < count; i++) {
+		glPushMatrix();
+		glTranslatef(x[i], y[i], z[i]);
+		glScalef(0.8f, 0.8f, 0.8f);
+		glRotatef(atan2(dirX[i], dirZ[i]) * 180.0f / M_PI, 0, 1, 0);
+		glRotatef(-bank[i] * 180.0f / M_PI, 0, 0, 1);
+		glRotatef(90, 0, 1, 0);
+		drawMeshArrays(&planeLods[levels[i]]);
+		for (side = -1; side <= 1; side += 2) {
+			glPushMatrix();
+			glTranslatef(-0.01f, -0.14f, 0.35f * side);
+			glRotatef(angleDeg, 1, 0, 0);
+			glTranslatef(0, 0.15f, -0.35f);
+			drawMeshArrays(&propellerLods[propellerLevel(levels[i])]);
+			glPopMatrix();
+		}
+		glPopMatrix();
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisable(GL_COLOR_MATERIAL);
+}
+/**
+ * aircraftRendererDraw
+ * Draws count aircraft in world space under the current modelview matrix.
+ * fogDensity is 0 when fog is off.
+ */
+void aircraftRendererDraw(int count, const float* x, const float* y,
+		const float* z, const float* dirX, const float* dirZ, const float* bank,
+		float propellerAngle, float fogDensity) {
+	const float* arrays[INSTANCE_ARRAYS] = { x, y, z, dirX, dirZ, bank };
+	if (count <= 0 || numLods == 0 || !selectLevels(count, x, y, z)) {
+		return;
+	}
+	if (program != 0) {
+		drawInstanced(count, arrays, propellerAngle, fogDensity);
+	} else {
+		drawFixedFunction(count, x, y, z, dirX, dirZ, bank, propellerAngle);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * aircraftRenderer.h
+ * CG flight simulator
+ * Draws many copies of the Cessna and its propellers.
+ * With shaders and instanced arrays every aircraft comes from one draw per
+ * mesh, the per-aircraft arrays are uploaded as they are stored (structure
+ * of arrays) and used as instance attributes. Otherwise each aircraft is
+ * drawn with vertex arrays and a fixed function transform. Either way each
+ * aircraft is drawn at the level of detail that fits its size on screen.
+ */
+
+#ifndef AIRCRAFTRENDERER_H_
+#define AIRCRAFTRENDERER_H_
+#include "model.h"
+
+//smallest height on screen in pixels each level of detail is drawn at, the
+//last level is drawn below that
+#define AIRCRAFT_LOD_PIXELS { 160.0f, 60.0f, 20.0f }
+
+int aircraftRendererInit(const Mesh plane[MODEL_LODS],
+		const Mesh propeller[MODEL_LODS]);
+void aircraftRendererFree(void);
+void aircraftRendererDraw(int count, const float* x, const float* y,
+		const float* z, const float* dirX, const float* dirZ, const float* bank,
+		float propellerAngle, float fogDensity);
+int aircraftRendererInstanced(void);
+void aircraftRendererSetDetail(float scale);
+
+#endif /* AIRCRAFTRENDERER_H_ */
@@ -0,0 +1,542 @@
+/**
+ * archipelago.c
+ * CG flight simulator
+ * Archipelago placement and instanced drawing, see archipelago.h.
+ * Islands are sampled with Bridson's algorithm: each new island is tried
+ * at random around one already placed until none fits there any more,
+ * with a grid of cells no wider than the spacing over its diagonal
+ * holding at most one island each, so only the cells around a candidate
+ * are checked. The sampling packs a little more than asked for, a shuffled
+ * subset of it keeps the spacing and spreads over the whole area.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "archipelago.h"
+#include "glFunctions.h"
+#include "shader.h"
+
+//islands Bridson's sampling packs into an area of spacing squared, a little less
+#define SAMPLE_DENSITY 0.6f
+//candidates tried around an island before it is given up on
+#define SAMPLE_CANDIDATES 30
+//random starts, so areas the clear circles cut off are filled too
+#define SAMPLE_STARTS 30
+//widest an island gets, of the spacing, so rotated neighbours never touch
+#define ISLAND_WIDTH 0.7f
+
+static const char* vertexSource =
+		"#version 120\n"
+		"attribute vec3 position;\n"
+		"attribute vec3 normal;\n"
+		"attribute vec4 color;\n"
+		"attribute vec2 texCoord;\n"
+		"attribute float instanceX;\n"
+		"attribute float instanceZ;\n"
+		"attribute float instanceYaw;\n"
+		"attribute float instanceScale;\n"
+		"attribute float instanceHeight;\n"
+		"attribute float instanceTileU;\n"
+		"attribute float instanceTileV;\n"
+		"uniform sampler2D variation;\n"
+		"uniform float atlasWidth;\n"
+		"uniform float atlasHeight;\n"
+		//map size - 1 and variation size - 1
+		"uniform float mapSpan;\n"
+		"uniform float tileSpan;\n"
+		"uniform float variationAmount;\n"
+		"uniform float baseY;\n"
+		"uniform float textured;\n"
+		"uniform float fogDensity;\n"
+		"varying vec4 litColor;\n"
+		"varying vec2 uv;\n"
+		"varying float fogFactor;\n"
+		"void main() {\n"
+		"	vec2 cell = clamp(position.xz / mapSpan, 0.0, 1.0);\n"
+		"	vec2 texel = vec2(instanceTileU, instanceTileV) + 0.5 + cell * tileSpan;\n"
+		"	float lift = 1.0 + variationAmount * (texture2DLod(variation,\n"
+		"			texel / vec2(atlasWidth, atlasHeight), 0.0).r * 2.0 - 1.0);\n"
+		"	float c = cos(instanceYaw);\n"
+		"	float s = sin(instanceYaw);\n"
+		"	vec3 p = vec3(position.x - mapSpan * 0.5, position.y * lift,\n"
+		"			position.z - mapSpan * 0.5);\n"
+		"	p = vec3(p.x * instanceScale, p.y * instanceHeight, p.z * instanceScale);\n"
+		"	p = vec3(c * p.x + s * p.z, p.y + baseY, c * p.z - s * p.x);\n"
+		//scaled by the inverse transpose, which for a scale is the inverse
+		"	vec3 n = vec3(normal.x * instanceHeight * lift,\n"
+		"			normal.y * instanceScale, normal.z * instanceHeight * lift);\n"
+		"	n = vec3(c * n.x + s * n.z, n.y, c * n.z - s * n.x);\n"
+		"	vec4 eye = gl_ModelViewMatrix\n"
+		"			* vec4(p + vec3(instanceX, 0.0, instanceZ), 1.0);\n"
+		"	vec3 eyeNormal = normalize(gl_NormalMatrix * n);\n"
+		"	vec3 light = normalize(gl_LightSource[0].position.xyz\n"
+		"			- eye.xyz * gl_LightSource[0].position.w);\n"
+		"	float diffuse = max(dot(eyeNormal, light), 0.0);\n"
+		"	vec4 base = mix(color, vec4(1.0), textured);\n"
+		"	litColor = vec4(base.rgb * (gl_LightSource[0].ambient.rgb * 0.2\n"
+		"			+ gl_LightSource[0].diffuse.rgb * diffuse), base.a);\n"
+		"	uv = texCoord;\n"
+		"	fogFactor = clamp(exp(-fogDensity * length(eye.xyz)), 0.0, 1.0);\n"
+		"	gl_Position = gl_ProjectionMatrix * eye;\n"
+		"}\n";
+
+static const char* fragmentSource =
+		"#version 120\n"
+		"uniform sampler2D mountain;\n"
+		"uniform float textured;\n"
+		"varying vec4 litColor;\n"
+		"varying vec2 uv;\n"
+		"varying float fogFactor;\n"
+		"void main() {\n"
+		"	vec4 color = litColor * mix(vec4(1.0), texture2D(mountain, uv), textured);\n"
+		"	gl_FragColor = vec4(mix(gl_Fog.color.rgb, color.rgb, fogFactor), color.a);\n"
+		"}\n";
+
+static const char* attributes[] = { "position", "normal", "color", "texCoord",
+		"instanceX", "instanceZ", "instanceYaw", "instanceScale",
+		"instanceHeight", "instanceTileU", "instanceTileV" };
+
+static GLuint program = 0;
+//set once compiling was tried, so a failure is not retried every world
+static int programTried = 0;
+static GLint locations[11];
+static const char* uniforms[11] = { "variation", "mountain", "atlasWidth",
+		"atlasHeight", "mapSpan", "tileSpan", "variationAmount", "baseY",
+		"textured", "fogDensity", NULL };
+enum { VARIATION, MOUNTAIN, ATLAS_WIDTH, ATLAS_HEIGHT, MAP_SPAN, TILE_SPAN,
+	VARIATION_AMOUNT, BASE_Y, TEXTURED, FOG_DENSITY };
+static GLuint instanceBuffer = 0;
+static GLuint variationTexture = 0;
+//islands in the instance buffer, it is sized to this many
+static int instanceCount = 0;
+
+/**
+ * fitsAt
+ * Returns 1 if an island can go at x, z: within the radius, outside the
+ * clear circles and at least the spacing from the islands in the grid.
+ */
+static int fitsAt(float x, float z, const ArchipelagoSettings* settings,
+		float spacing, const int* grid, int cells, float cellSize,
+		const float* points) {
+	int cellX = (int) ((x + settings->radius) / cellSize);
+	int cellZ = (int) ((z + settings->radius) / cellSize);
+	int i, j;
+	if (x * x + z * z > settings->radius * settings->radius) {
+		return 0;
+	}
+	for (i = 0; i < settings->numAvoid; i++) {
+		const float* circle = &settings->avoid[i * 3];
+		float dx = x - circle[0];
+		float dz = z - circle[1];
+		if (dx * dx + dz * dz < circle[2] * circle[2]) {
+			return 0;
+		}
+	}
+	//two cells either way covers the spacing
+	for (i = cellX - 2; i <= cellX + 2; i++) {
+		for (j = cellZ - 2; j <= cellZ + 2; j++) {
+			const float* other;
+			float dx, dz;
+			if (i < 0 || j < 0 || i >= cells || j >= cells || grid[i * cells + j] < 0) {
+				continue;
+			}
+			other = &points[grid[i * cells + j] * 2];
+			dx = x - other[0];
+			dz = z - other[1];
+			if (dx * dx + dz * dz < spacing * spacing) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+/**
+ * samplePoissonDisk
+ * Fills points with x, z pairs at least spacing apart, until no more fit or
+ * there are capacity of them. The grid and active list come from scratch.
+ * Returns the number placed, or -1 if the scratch memory ran out.
+ */
+static int samplePoissonDisk(Rng* rng, Arena* scratch,
+		const ArchipelagoSettings* settings, float spacing, float* points,
+		int capacity) {
+	float cellSize = spacing / sqrtf(2.0f);
+	int cells = (int) ceilf(2.0f * settings->radius / cellSize) + 1;
+	int* grid = arenaAlloc(scratch, sizeof(int) * cells * cells);
+	int* active = arenaAlloc(scratch, sizeof(int) * capacity);
+	int numPoints = 0;
+	int numActive = 0;
+	int start, i;
+	if (grid == NULL || active == NULL) {
+		return -1;
+	}
+	for (i = 0; i < cells * cells; i++) {
+		grid[i] = -1;
+	}
+#define PLACE(px, pz) do { \
+		points[numPoints * 2] = (px); \
+		points[numPoints * 2 + 1] = (pz); \
+		grid[(int) (((px) + settings->radius) / cellSize) * cells \
+				+ (int) (((pz) + settings->radius) / cellSize)] = numPoints; \
+		active[numActive++] = numPoints++; \
+	} while (0)
+	for (start = 0; start < SAMPLE_STARTS && numPoints < capacity; start++) {
+		float x = (rngFloat(rng) * 2.0f - 1.0f) * settings->radius;
+		float z = (rngFloat(rng) * 2.0f - 1.0f) * settings->radius;
+		if (!fitsAt(x, z, settings, spacing, grid, cells, cellSize, points)) {
+			continue;
+		}
+		PLACE(x, z);
+		while (numActive > 0 && numPoints < capacity) {
+			int slot = rngBounded(rng, numActive);
+			const float* from = &points[active[slot] * 2];
+			int candidate;
+			for (candidate = 0; candidate < SAMPLE_CANDIDATES; candidate++) {
+				float angle = rngFloat(rng) * 2.0f * (float) M_PI;
+				float distance = spacing * (1.0f + rngFloat(rng));
+				x = from[0] + cosf(angle) * distance;
+				z = from[1] + sinf(angle) * distance;
+				if (fitsAt(x, z, settings, spacing, grid, cells, cellSize, points)) {
+					PLACE(x, z);
+					break;
+				}
+			}
+			//nothing fits around it any more
+			if (candidate == SAMPLE_CANDIDATES) {
+				active[slot] = active[--numActive];
+			}
+		}
+	}
+#undef PLACE
+	return numPoints;
+}
+/**
+ * archipelagoGenerate
+ * Places the archipelago's islands and gives each a type, heading, scale
+ * and tile of variation. Its arrays are allocated from arena and live as
+ * long as what is allocated there, the sampling only uses scratch for as
+ * long as this takes. Returns 0 if memory ran out, the archipelago is
+ * then empty.
+ */
+int archipelagoGenerate(Archipelago* archipelago, Arena* arena, Arena* scratch,
+		Rng* rng, const ArchipelagoSettings* settings) {
+	float area = (float) M_PI * settings->radius * settings->radius;
+	float clearArea = 0.0f;
+	float spacing;
+	float* points;
+	int* types;
+	int next[TERRAIN_MAX_ISLANDS];
+	int capacity, numPoints, count, columns, tileBytes;
+	int i, t, texel;
+
+	memset(archipelago, 0, sizeof(*archipelago));
+	if (settings->count <= 0 || settings->types <= 0 || settings->mapSize < 2) {
+		return 1;
+	}
+	for (i = 0; i < settings->numAvoid; i++) {
+		clearArea += (float) M_PI * settings->avoid[i * 3 + 2]
+				* settings->avoid[i * 3 + 2];
+	}
+	//the clear circles overlap and reach past the edge, never count them as
+	//more than most of the area
+	area -= fminf(clearArea, area * 0.75f);
+	spacing = sqrtf(SAMPLE_DENSITY * area / settings->count);
+	//no more islands than hexagonal packing fits within the spacing
+	capacity = (int) (3.63f * (settings->radius + spacing)
+			* (settings->radius + spacing) / (spacing * spacing)) + 1;
+	points = arenaAlloc(scratch, sizeof(float) * 2 * capacity);
+	numPoints = points == NULL ? -1 : samplePoissonDisk(rng, scratch, settings,
+			spacing, points, capacity);
+	if (numPoints < 0) {
+		return 0;
+	}
+	//a shuffled subset spreads over the whole area
+	for (i = numPoints - 1; i > 0; i--) {
+		int j = rngBounded(rng, i + 1);
+		float x = points[i * 2];
+		float z = points[i * 2 + 1];
+		points[i * 2] = points[j * 2];
+		points[i * 2 + 1] = points[j * 2 + 1];
+		points[j * 2] = x;
+		points[j * 2 + 1] = z;
+	}
+	count = numPoints < settings->count ? numPoints : settings->count;
+	if (count == 0) {
+		return 1;
+	}
+	columns = (int) ceilf(sqrtf((float) count));
+	types = arenaAlloc(scratch, sizeof(int) * count);
+	archipelago->arrays = arenaAlloc(arena,
+			sizeof(float) * count * ARCHIPELAGO_ARRAYS);
+	archipelago->atlasWidth = columns * ARCHIPELAGO_VARIATION_SIZE;
+	archipelago->atlasHeight = (count + columns - 1) / columns
+			* ARCHIPELAGO_VARIATION_SIZE;
+	archipelago->variation = arenaAlloc(arena,
+			archipelago->atlasWidth * archipelago->atlasHeight);
+	if (types == NULL || archipelago->arrays == NULL
+			|| archipelago->variation == NULL) {
+		memset(archipelago, 0, sizeof(*archipelago));
+		return 0;
+	}
+	archipelago->count = count;
+	archipelago->types = settings->types;
+	archipelago->mapSize = settings->mapSize;
+	archipelago->spacing = spacing;
+	archipelago->x = archipelago->arrays;
+	archipelago->z = archipelago->x + count;
+	archipelago->yaw = archipelago->z + count;
+	archipelago->scale = archipelago->yaw + count;
+	archipelago->height = archipelago->scale + count;
+	archipelago->tileU = archipelago->height + count;
+	archipelago->tileV = archipelago->tileU + count;
+
+	//sorted by type, counted first
+	for (i = 0; i < count; i++) {
+		types[i] = rngBounded(rng, settings->types);
+		archipelago->first[types[i] + 1]++;
+	}
+	for (t = 0; t < settings->types; t++) {
+		archipelago->first[t + 1] += archipelago->first[t];
+		next[t] = archipelago->first[t];
+	}
+	for (i = 0; i < count; i++) {
+		int slot = next[types[i]]++;
+		float width = spacing * ISLAND_WIDTH * (0.6f + 0.4f * rngFloat(rng));
+		archipelago->x[slot] = points[i * 2];
+		archipelago->z[slot] = points[i * 2 + 1];
+		archipelago->yaw[slot] = rngFloat(rng) * 2.0f * (float) M_PI;
+		archipelago->scale[slot] = width / (settings->mapSize - 1);
+		//steeper than the world's islands, they are much smaller
+		archipelago->height[slot] = archipelago->scale[slot]
+				* (1.0f + rngFloat(rng));
+		archipelago->tileU[slot] = (float) (slot % columns * ARCHIPELAGO_VARIATION_SIZE);
+		archipelago->tileV[slot] = (float) (slot / columns * ARCHIPELAGO_VARIATION_SIZE);
+	}
+	//the tiles past the last island are never sampled
+	memset(archipelago->variation, 128,
+			archipelago->atlasWidth * archipelago->atlasHeight);
+	tileBytes = ARCHIPELAGO_VARIATION_SIZE * ARCHIPELAGO_VARIATION_SIZE;
+	for (i = 0; i < count; i++) {
+		for (texel = 0; texel < tileBytes; texel++) {
+			int u = (int) archipelago->tileU[i] + texel % ARCHIPELAGO_VARIATION_SIZE;
+			int v = (int) archipelago->tileV[i] + texel / ARCHIPELAGO_VARIATION_SIZE;
+			archipelago->variation[v * archipelago->atlasWidth + u] =
+					(unsigned char) rngBounded(rng, 256);
+		}
+	}
+	return 1;
+}
+/**
+ * compile
+ * Compiles the program and makes the instance buffer and variation
+ * texture, once. Vertex shaders must be able to read textures.
+ */
+static void compile() {
+	GLint vertexTextures = 0;
+	int i;
+	programTried = 1;
+	glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertexTextures);
+	if (vertexTextures < 1) {
+		return;
+	}
+	program = compileProgram(vertexSource, fragmentSource, attributes,
+			sizeof(attributes) / sizeof(attributes[0]));
+	if (program == 0) {
+		return;
+	}
+	for (i = 0; uniforms[i] != NULL; i++) {
+		locations[i] = pglGetUniformLocation(program, uniforms[i]);
+	}
+	pglGenBuffers(1, &instanceBuffer);
+	glGenTextures(1, &variationTexture);
+}
+/**
+ * archipelagoUpload
+ * Copies the islands' arrays into the instance buffer and their variation
+ * into its texture, both kept from world to world. Returns 1 if the
+ * archipelago is drawn with instancing.
+ */
+int archipelagoUpload(const Archipelago* archipelago) {
+	if (!hasShaders || !hasBuffers || !hasInstancing) {
+		return 0;
+	}
+	if (!programTried && archipelago->count > 0) {
+		compile();
+	}
+	if (program == 0) {
+		return 0;
+	}
+	instanceCount = archipelago->count;
+	if (instanceCount == 0) {
+		return 1;
+	}
+	pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	pglBufferData(GL_ARRAY_BUFFER, sizeof(float) * instanceCount
+			* ARCHIPELAGO_ARRAYS, archipelago->arrays, GL_STATIC_DRAW);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, variationTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, archipelago->atlasWidth,
+			archipelago->atlasHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+			archipelago->variation);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return 1;
+}
+/**
+ * archipelagoFree
+ */
+void archipelagoFree(void) {
+	if (program != 0) {
+		pglDeleteProgram(program);
+		pglDeleteBuffers(1, &instanceBuffer);
+		glDeleteTextures(1, &variationTexture);
+	}
+	program = 0;
+	programTried = 0;
+	instanceBuffer = 0;
+	variationTexture = 0;
+	instanceCount = 0;
+}
+/**
+ * pointMesh
+ * Points the per vertex attributes at the mesh of a type, offset from
+ * vertices into the mesh buffer.
+ */
+static void pointMesh(const char* vertices) {
+	GLsizei stride = sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS;
+	pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, vertices);
+	pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+			vertices + sizeof(GLfloat) * 3);
+	pglVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+			vertices + sizeof(GLfloat) * 6);
+	pglVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
+			vertices + sizeof(GLfloat) * 10);
+}
+/**
+ * drawInstanced
+ * Draws the islands of each type with one draw. Returns the draws made.
+ */
+static int drawInstanced(const Archipelago* archipelago, GLuint meshBuffer,
+		const char* vertices, const void* indices, int indexCount,
+		int textured, float fogDensity) {
+	int quads = (archipelago->mapSize - 1) * (archipelago->mapSize - 1);
+	GLsizei typeBytes = sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS * quads * 4;
+	int draws = 0;
+	int i, t;
+
+	pglUseProgram(program);
+	pglUniform1i(locations[VARIATION], 1);
+	pglUniform1i(locations[MOUNTAIN], 0);
+	pglUniform1f(locations[ATLAS_WIDTH], archipelago->atlasWidth);
+	pglUniform1f(locations[ATLAS_HEIGHT], archipelago->atlasHeight);
+	pglUniform1f(locations[MAP_SPAN], archipelago->mapSize - 1);
+	pglUniform1f(locations[TILE_SPAN], ARCHIPELAGO_VARIATION_SIZE - 1);
+	pglUniform1f(locations[VARIATION_AMOUNT], ARCHIPELAGO_VARIATION);
+	pglUniform1f(locations[BASE_Y], ARCHIPELAGO_BASE_Y);
+	pglUniform1f(locations[TEXTURED], textured ? 1.0f : 0.0f);
+	pglUniform1f(locations[FOG_DENSITY], fogDensity);
+	pglActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, variationTexture);
+	pglActiveTexture(GL_TEXTURE0);
+
+	for (i = 0; i < ARCHIPELAGO_ARRAYS; i++) {
+		pglVertexAttribDivisor(4 + i, 1);
+	}
+	for (i = 0; i < 4 + ARCHIPELAGO_ARRAYS; i++) {
+		pglEnableVertexAttribArray(i);
+	}
+	for (t = 0; t < archipelago->types; t++) {
+		int first = archipelago->first[t];
+		int typeCount = archipelago->first[t + 1] - first;
+		if (typeCount == 0) {
+			continue;
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (i = 0; i < ARCHIPELAGO_ARRAYS; i++) {
+			pglVertexAttribPointer(4 + i, 1, GL_FLOAT, GL_FALSE, 0,
+					(void*) (sizeof(float) * (instanceCount * i + first)));
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+		pointMesh(vertices + typeBytes * t);
+		pglDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+				indices, typeCount);
+		draws++;
+	}
+	for (i = 0; i < 4 + ARCHIPELAGO_ARRAYS; i++) {
+		pglDisableVertexAttribArray(i);
+	}
+	for (i = 0; i < ARCHIPELAGO_ARRAYS; i++) {
+		pglVertexAttribDivisor(4 + i, 0);
+	}
+	pglActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pglActiveTexture(GL_TEXTURE0);
+	pglUseProgram(0);
+	return draws;
+}
+/**
+ * drawFixedFunction
+ * Fallback without instancing, one transform and draw per island, as the
+ * shader places them but without their variation.
+ */
+static int drawFixedFunction(const Archipelago* archipelago,
+		const char* vertices, const void* indices, int indexCount) {
+	int quads = (archipelago->mapSize - 1) * (archipelago->mapSize - 1);
+	GLsizei stride = sizeof(GLfloat) * MOUNTAIN_VERTEX_FLOATS;
+	float half = (archipelago->mapSize - 1) * 0.5f;
+	int i, t;
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	for (t = 0; t < archipelago->types; t++) {
+		const char* type0 = vertices + stride * quads * 4 * t;
+		glVertexPointer(3, GL_FLOAT, stride, type0);
+		glNormalPointer(GL_FLOAT, stride, type0 + sizeof(GLfloat) * 3);
+		glColorPointer(4, GL_FLOAT, stride, type0 + sizeof(GLfloat) * 6);
+		glTexCoordPointer(2, GL_FLOAT, stride, type0 + sizeof(GLfloat) * 10);
+		for (i = archipelago->first[t]; i < archipelago->first[t + 1]; i++) {
+			glPushMatrix();
+			glTranslatef(archipelago->x[i], ARCHIPELAGO_BASE_Y, archipelago->z[i]);
+			glRotatef(archipelago->yaw[i] * 180.0f / M_PI, 0, 1, 0);
+			glScalef(archipelago->scale[i], archipelago->height[i],
+					archipelago->scale[i]);
+			glTranslatef(-half, 0, -half);
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indices);
+			glPopMatrix();
+		}
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	return archipelago->count;
+}
+/**
+ * archipelagoDraw
+ * Draws the archipelago in world space under the current modelview matrix.
+ * The meshes of the types are one after another as drawMountains stores
+ * them, in meshBuffer at vertices if it is not 0 (with their index buffer
+ * bound), at vertices in memory if it is. Each mesh is drawn with the
+ * indexCount indices at indices, so any of the terrain levels of detail.
+ * The islands are modulated by the bound texture if textured, fogDensity is
+ * 0 when fog is off. Returns the draws made.
+ */
+int archipelagoDraw(const Archipelago* archipelago, GLuint meshBuffer,
+		const char* vertices, const void* indices, int indexCount,
+		int textured, float fogDensity) {
+	if (archipelago->count == 0) {
+		return 0;
+	}
+	if (program != 0 && meshBuffer != 0 && instanceCount == archipelago->count) {
+		return drawInstanced(archipelago, meshBuffer, vertices, indices,
+				indexCount, textured, fogDensity);
+	}
+	return drawFixedFunction(archipelago, vertices, indices, indexCount);
+}
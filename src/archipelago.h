@@ -0,0 +1,81 @@
+/*
+ * archipelago.h
+ * CG flight simulator
+ * Many small islands scattered over the sea, each a copy of one of the
+ * world's island meshes (its type) under its own position, heading and
+ * scale. Islands are placed by Poisson-disk sampling, so none is closer
+ * than the spacing to another, and kept off the world's own islands.
+ * All an island has of its own is a small tile of height variation in a
+ * texture shared by all of them, which lifts and lowers parts of its
+ * type's heights so no two copies look alike.
+ * With shaders and instanced arrays every island of a type comes from one
+ * draw, so draws and mesh memory grow with the types and not with the
+ * islands. Otherwise each island is drawn with a fixed function transform
+ * and without its variation.
+ */
+
+#ifndef ARCHIPELAGO_H_
+#define ARCHIPELAGO_H_
+#include "glPlatform.h"
+#include "arena.h"
+#include "rng.h"
+#include "terrain.h"
+
+//islands as quads of 4 vertices: position, normal, color, texture coordinates
+#define MOUNTAIN_VERTEX_FLOATS 12
+//texels along each side of an island's tile of variation
+#define ARCHIPELAGO_VARIATION_SIZE 8
+//how much the variation scales the heights by, either way
+#define ARCHIPELAGO_VARIATION 0.4f
+//height of the islands' flat edges, just under the sea
+#define ARCHIPELAGO_BASE_Y -1.5f
+//per island arrays, in the order they are stored in the instance buffer
+#define ARCHIPELAGO_ARRAYS 7
+
+typedef struct ArchipelagoSettings {
+	//islands wanted, fewer are placed if they do not fit
+	int count;
+	//island meshes to choose from and their map size
+	int types;
+	int mapSize;
+	//islands are placed within this distance of the origin
+	float radius;
+	//circles kept clear, x, z and radius of each
+	const float* avoid;
+	int numAvoid;
+} ArchipelagoSettings;
+
+typedef struct Archipelago {
+	int count;
+	int types;
+	int mapSize;
+	//least distance between two islands
+	float spacing;
+	//islands sorted by type, those of type t are first[t] to first[t + 1]
+	int first[TERRAIN_MAX_ISLANDS + 1];
+	//ARCHIPELAGO_ARRAYS arrays of count floats one after another, which the
+	//pointers below point into: position, heading in radians, scale across
+	//and up, and the texel the island's tile of variation starts at
+	float* arrays;
+	float* x;
+	float* z;
+	float* yaw;
+	float* scale;
+	float* height;
+	float* tileU;
+	float* tileV;
+	//tiles of variation in rows, 128 keeps a height as it is
+	unsigned char* variation;
+	int atlasWidth;
+	int atlasHeight;
+} Archipelago;
+
+int archipelagoGenerate(Archipelago* archipelago, Arena* arena, Arena* scratch,
+		Rng* rng, const ArchipelagoSettings* settings);
+int archipelagoUpload(const Archipelago* archipelago);
+int archipelagoDraw(const Archipelago* archipelago, GLuint meshBuffer,
+		const char* vertices, const void* indices, int indexCount,
+		int textured, float fogDensity);
+void archipelagoFree(void);
+
+#endif /* ARCHIPELAGO_H_ */
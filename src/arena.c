@@ -0,0 +1,181 @@
+/**
+ * arena.c
+ * CG flight simulator
+ * Linear allocator, see arena.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+struct ArenaBlock {
+	ArenaBlock* previous;
+	size_t size;
+	size_t offset;
+	//offset of the first aligned byte
+	size_t start;
+	unsigned char data[];
+};
+
+/**
+ * alignUp
+ */
+static size_t alignUp(size_t bytes) {
+	return (bytes + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+/**
+ * newBlock
+ * Chains a block of at least size bytes onto the arena. Returns 0 if out
+ * of memory.
+ */
+static int newBlock(Arena* arena, size_t size) {
+	ArenaBlock* block = malloc(sizeof(ArenaBlock) + size + ARENA_ALIGN);
+	if (block == NULL) {
+		return 0;
+	}
+	block->previous = arena->block;
+	block->start = (ARENA_ALIGN - ((size_t) block->data & (ARENA_ALIGN - 1)))
+			& (ARENA_ALIGN - 1);
+	block->size = block->start + size;
+	block->offset = block->start;
+	arena->block = block;
+	arena->capacity += size;
+#ifndef NDEBUG
+	arena->heapBlocks++;
+#endif
+	return 1;
+}
+/**
+ * arenaAlloc
+ * Returns bytes of uninitialized memory that stay valid until the arena is
+ * reset or rewound past them, NULL if out of memory.
+ */
+void* arenaAlloc(Arena* arena, size_t bytes) {
+	ArenaBlock* block = arena->block;
+	void* memory;
+	bytes = alignUp(bytes);
+	if (block == NULL || block->size - block->offset < bytes) {
+		//at least double, so a growing arena needs few blocks
+		size_t size = arena->capacity > ARENA_DEFAULT_BLOCK ? arena->capacity
+				: ARENA_DEFAULT_BLOCK;
+		if (!newBlock(arena, size > bytes ? size : bytes)) {
+			return NULL;
+		}
+		block = arena->block;
+	}
+	memory = block->data + block->offset;
+	block->offset += bytes;
+	arena->used += bytes;
+	if (arena->used > arena->highWater) {
+		arena->highWater = arena->used;
+	}
+	if (arena->used > arena->peak) {
+		arena->peak = arena->used;
+	}
+#ifndef NDEBUG
+	arena->allocations++;
+#endif
+	return memory;
+}
+/**
+ * arenaCalloc
+ * arenaAlloc, zeroed.
+ */
+void* arenaCalloc(Arena* arena, size_t bytes) {
+	void* memory = arenaAlloc(arena, bytes);
+	if (memory != NULL) {
+		memset(memory, 0, bytes);
+	}
+	return memory;
+}
+/**
+ * arenaMark
+ */
+ArenaMark arenaMark(const Arena* arena) {
+	ArenaMark mark;
+	mark.block = arena->block;
+	mark.offset = arena->block != NULL ? arena->block->offset : 0;
+	mark.used = arena->used;
+	return mark;
+}
+/**
+ * arenaRewind
+ * Gives back everything allocated since the mark. Blocks chained on since
+ * then stay until the next reset, which folds them into one.
+ */
+void arenaRewind(Arena* arena, ArenaMark mark) {
+	ArenaBlock* block = arena->block;
+	while (block != NULL && block != mark.block) {
+		block->offset = block->start;
+		block = block->previous;
+	}
+	if (block != NULL) {
+		block->offset = mark.offset;
+	}
+	arena->used = mark.used;
+}
+/**
+ * arenaReserve
+ * Makes room for bytes more before they are needed, so a known amount of
+ * allocations later never reach the heap. Returns 0 if out of memory.
+ */
+int arenaReserve(Arena* arena, size_t bytes) {
+	ArenaBlock* block = arena->block;
+	if (block != NULL && block->size - block->offset >= bytes) {
+		return 1;
+	}
+	return newBlock(arena, bytes);
+}
+/**
+ * arenaReset
+ * Releases every allocation at once. Costs nothing more than that unless
+ * more than one block was used, then they are replaced by one that holds
+ * the most that was in use at a time.
+ */
+void arenaReset(Arena* arena) {
+	ArenaBlock* block = arena->block;
+	if (block != NULL && block->previous != NULL) {
+		size_t size = arena->highWater > ARENA_DEFAULT_BLOCK ? arena->highWater
+				: ARENA_DEFAULT_BLOCK;
+		arenaFree(arena);
+		newBlock(arena, size);
+		block = arena->block;
+	}
+	if (block != NULL) {
+		block->offset = block->start;
+	}
+	arena->used = 0;
+	arena->highWater = 0;
+#ifndef NDEBUG
+	arena->resets++;
+#endif
+}
+/**
+ * arenaFree
+ * Returns every block to the heap, the arena can be used again after.
+ */
+void arenaFree(Arena* arena) {
+	ArenaBlock* block = arena->block;
+	while (block != NULL) {
+		ArenaBlock* previous = block->previous;
+		free(block);
+		block = previous;
+	}
+	arena->block = NULL;
+	arena->capacity = 0;
+	arena->used = 0;
+	arena->highWater = 0;
+}
+/**
+ * arenaPrintStats
+ */
+void arenaPrintStats(const Arena* arena, const char* name) {
+	printf("Arena %s: %zu KB used, %zu KB peak, %zu KB reserved", name,
+			arena->used / 1024, arena->peak / 1024, arena->capacity / 1024);
+#ifndef NDEBUG
+	printf(", %lu allocations, %lu resets, %lu heap blocks",
+			arena->allocations, arena->resets, arena->heapBlocks);
+#endif
+	printf("\n");
+}
@@ -0,0 +1,59 @@
+/*
+ * arena.h
+ * CG flight simulator
+ * Linear allocator for memory that lives and dies together, like everything
+ * a world generation owns or the scratch buffers of one frame. Allocating
+ * bumps an offset and nothing is freed on its own; arenaReset releases it
+ * all at once. When a block fills up another is chained on, and the next
+ * reset swaps the chain for one block as large as the most that was in use
+ * at a time, so after
+ * the first generation or frame of a given size the arena stops touching
+ * the heap and cannot fragment it. A zeroed Arena is ready to use.
+ * Builds without NDEBUG also count allocations, resets and heap blocks.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+#include <stddef.h>
+
+//size of the first block unless an allocation needs more
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+//every allocation is aligned for SSE
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena {
+	//newest block, allocations come from here
+	ArenaBlock* block;
+	//bytes in every block, and in use in all of them
+	size_t capacity;
+	size_t used;
+	//most used since the last reset, and since the arena was made
+	size_t highWater;
+	size_t peak;
+#ifndef NDEBUG
+	unsigned long allocations;
+	unsigned long resets;
+	//blocks taken from the heap
+	unsigned long heapBlocks;
+#endif
+} Arena;
+
+//where an arena was, to give back what was allocated after it
+typedef struct ArenaMark {
+	ArenaBlock* block;
+	size_t offset;
+	size_t used;
+} ArenaMark;
+
+void* arenaAlloc(Arena* arena, size_t bytes);
+void* arenaCalloc(Arena* arena, size_t bytes);
+ArenaMark arenaMark(const Arena* arena);
+void arenaRewind(Arena* arena, ArenaMark mark);
+int arenaReserve(Arena* arena, size_t bytes);
+void arenaReset(Arena* arena);
+void arenaFree(Arena* arena);
+void arenaPrintStats(const Arena* arena, const char* name);
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,166 @@
+/**
+ * batch.c
+ * CG flight simulator
+ * Batch runner, see batch.h.
+ * Every job owns one World and one SimContext and flies its share of the
+ * seeds one after another, so worlds never share state and the result does
+ * not depend on the number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "world.h"
+#include "jobs.h"
+#include "timer.h"
+
+//window size the scripted mouse positions refer to
+#define BATCH_INPUT_WIDTH 1600
+#define BATCH_INPUT_HEIGHT 900
+
+typedef struct BatchJob {
+	unsigned int firstSeed;
+	int maxTicks;
+	int aiCount;
+	//per world results
+	int* ticks;
+	unsigned char* crashed;
+	double* tickCosts;
+	int failed;
+} BatchJob;
+
+/**
+ * scriptPilot
+ * Picks the next manoeuvre of a scripted pilot: a turn, a climb, a dive or
+ * level flight, with the throttle and gun set at random. Climbs are a little
+ * more likely than dives since the start is only 3 units above the sea.
+ * Returns the number of ticks to hold it for.
+ */
+static int scriptPilot(Rng* script, SimContext* context) {
+	int pitch = rngRange(script, 0, 10);
+	context->lastMouseX = rngRange(script, 0, context->inputWidth);
+	context->lastMouseY = rngRange(script, 0, context->inputHeight);
+	context->boolMoveUp = pitch < 4;
+	context->boolMoveDown = pitch >= 8;
+	context->boolAccelerate = rngRange(script, 0, 2) == 0;
+	context->boolDeaccelerate = context->boolAccelerate == 0
+			&& rngRange(script, 0, 2) == 0;
+	context->boolShoot = rngRange(script, 0, 4) == 0;
+	return rngRange(script, 10, 120);
+}
+/**
+ * runWorlds
+ * Flies the worlds [begin, end) until they crash or run out of ticks.
+ */
+static void runWorlds(void* data, int begin, int end, int worker) {
+	BatchJob* job = data;
+	World world;
+	SimContext context;
+	int i;
+	if (!worldInit(&world)) {
+		job->failed = 1;
+		return;
+	}
+	for (i = begin; i < end; i++) {
+		Rng* script = &world.rngStreams[RNG_SCRIPT];
+		int manoeuvre = 0;
+		double start;
+
+		memset(&context, 0, sizeof(SimContext));
+		context.inputWidth = BATCH_INPUT_WIDTH;
+		context.inputHeight = BATCH_INPUT_HEIGHT;
+		context.aiCount = job->aiCount;
+		world.toggleFlightModel = 0;
+		worldNew(&world, job->firstSeed + i, &context);
+		//half the pilots fly the 6-DOF model
+		if (rngRange(script, 0, 2) == 1) {
+			worldEnterFlightModel(&world);
+		}
+
+		start = timerNow();
+		while (world.alive == 1 && world.tick < (unsigned int) job->maxTicks) {
+			if (manoeuvre-- <= 0) {
+				manoeuvre = scriptPilot(script, &context);
+			}
+			worldStep(&world, &context);
+		}
+		job->tickCosts[i] = (timerNow() - start) / world.tick;
+		job->ticks[i] = world.tick;
+		job->crashed[i] = world.alive == 0;
+	}
+	worldFree(&world);
+}
+/**
+ * compareDoubles
+ */
+static int compareDoubles(const void* a, const void* b) {
+	double difference = *(const double*) a - *(const double*) b;
+	return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+/**
+ * batchRun
+ * Flies worlds seeded firstSeed, firstSeed + 1, ... for at most maxTicks
+ * each, with aiCount AI aircraft in every world.
+ * Returns 0 if the worlds could not be allocated.
+ */
+int batchRun(int worlds, unsigned int firstSeed, int maxTicks, int aiCount,
+		BatchResult* result) {
+	BatchJob job;
+	double* flightTimes;
+	double start;
+	int i;
+	memset(result, 0, sizeof(BatchResult));
+	if (worlds <= 0 || maxTicks <= 0) {
+		return 0;
+	}
+	job.firstSeed = firstSeed;
+	job.maxTicks = maxTicks;
+	job.aiCount = aiCount;
+	job.ticks = malloc(sizeof(int) * worlds);
+	job.crashed = malloc(sizeof(unsigned char) * worlds);
+	job.tickCosts = malloc(sizeof(double) * worlds);
+	job.failed = 0;
+	flightTimes = malloc(sizeof(double) * worlds);
+	if (job.ticks == NULL || job.crashed == NULL || job.tickCosts == NULL
+			|| flightTimes == NULL) {
+		free(job.ticks);
+		free(job.crashed);
+		free(job.tickCosts);
+		free(flightTimes);
+		return 0;
+	}
+
+	start = timerNow();
+	//one world per chunk, worlds run for very different lengths
+	jobsParallelFor(worlds, 1, runWorlds, &job);
+	result->seconds = timerNow() - start;
+	if (job.failed == 1) {
+		free(job.ticks);
+		free(job.crashed);
+		free(job.tickCosts);
+		free(flightTimes);
+		return 0;
+	}
+
+	result->worlds = worlds;
+	for (i = 0; i < worlds; i++) {
+		result->crashes += job.crashed[i];
+		result->ticks += job.ticks[i];
+		flightTimes[i] = job.ticks[i] * (WORLD_TICK_MS / 1000.0);
+		result->flightTimeMean += flightTimes[i];
+		result->tickCostMean += job.tickCosts[i];
+	}
+	result->flightTimeMean /= worlds;
+	result->tickCostMean /= worlds;
+	qsort(flightTimes, worlds, sizeof(double), compareDoubles);
+	qsort(job.tickCosts, worlds, sizeof(double), compareDoubles);
+	result->flightTimeP50 = flightTimes[worlds / 2];
+	result->tickCostP99 = job.tickCosts[(int) (worlds * 0.99)];
+
+	free(job.ticks);
+	free(job.crashed);
+	free(job.tickCosts);
+	free(flightTimes);
+	return 1;
+}
@@ -0,0 +1,30 @@
+/*
+ * batch.h
+ * CG flight simulator
+ * Batch runner for headless worlds.
+ * Flies many independent worlds, each from its own seed with a scripted
+ * pilot, spread over the worker threads, and sums up how they went: how
+ * often the plane crashed, how long it stayed up and what a tick cost.
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+typedef struct BatchResult {
+	int worlds;
+	int crashes;
+	long long ticks;
+	//seconds in the air per world, a world that never crashes counts maxTicks
+	double flightTimeMean;
+	double flightTimeP50;
+	//seconds per tick, from each world's mean
+	double tickCostMean;
+	double tickCostP99;
+	//wall clock seconds for the whole batch
+	double seconds;
+} BatchResult;
+
+int batchRun(int worlds, unsigned int firstSeed, int maxTicks, int aiCount,
+		BatchResult* result);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,412 @@
+/**
+ * bench.c
+ * CG flight simulator
+ * Offscreen rendering benchmark support.
+ * Only the EGL surfaceless path is implemented, other platforms report that
+ * offscreen benchmarking is unavailable.
+ *
+ * GPU times come from GL_TIME_ELAPSED queries kept in a small ring so the
+ * result of a frame is read a few frames later instead of stalling on it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "glFunctions.h"
+#include "timer.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#define BENCH_QUERY_RING 4
+#define BENCH_MAX_FRAMES 100000
+//GL names below this are always checked when counting objects
+#define BENCH_NAME_SCAN 4096
+
+typedef struct BenchStats {
+	float mean;
+	float p50;
+	float p90;
+	float p95;
+	float p99;
+	float max;
+} BenchStats;
+
+typedef struct BenchCase {
+	char name[64];
+	char parameters[256];
+	int frames;
+	BenchStats cpu;
+	BenchStats gpu;
+} BenchCase;
+
+static int benchWidth = 0;
+static int benchHeight = 0;
+static GLuint framebuffer = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+#ifdef __linux__
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+static BenchCase* cases = NULL;
+static int numCases = 0;
+static BenchCase* currentCase = NULL;
+static float cpuTimes[BENCH_MAX_FRAMES];
+static float gpuTimes[BENCH_MAX_FRAMES];
+static int frame = 0;
+static double frameStart = 0.0;
+static GLuint queries[BENCH_QUERY_RING];
+static int queryFrame[BENCH_QUERY_RING];
+
+#ifdef __linux__
+/**
+ * createContext
+ * Creates a surfaceless desktop GL context and makes it current.
+ */
+static int createContext(void) {
+	EGLint major, minor;
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	//surfaceless configs only advertise pbuffer support
+	EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+					"eglGetPlatformDisplayEXT");
+
+	if (getPlatformDisplay != NULL) {
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		printf("Could not initialize EGL.\n");
+		return 0;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)
+			|| !eglChooseConfig(display, configAttributes, &config, 1, &numConfigs)
+			|| numConfigs == 0) {
+		printf("No EGL config for desktop OpenGL.\n");
+		return 0;
+	}
+	//default attributes give a compatibility context, the renderer is fixed function
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT
+			|| !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		printf("Could not create a surfaceless OpenGL context.\n");
+		return 0;
+	}
+	loadGLFunctions((GlGetProcAddress) eglGetProcAddress);
+	return 1;
+}
+#endif
+/**
+ * benchOpen
+ * Creates the offscreen context and a framebuffer of the given size and
+ * binds it for drawing. Returns 0 on failure.
+ */
+int benchOpen(int width, int height) {
+#ifdef __linux__
+	if (!createContext()) {
+		return 0;
+	}
+#else
+	printf("Offscreen benchmarking needs EGL, which is not available here.\n");
+	return 0;
+#endif
+	if (!hasFramebuffers) {
+		printf("Framebuffer objects are not supported.\n");
+		return 0;
+	}
+	printf("Benchmark renderer: %s, OpenGL %s\n", glGetString(GL_RENDERER),
+			glGetString(GL_VERSION));
+	if (!hasTimerQueries) {
+		printf("Timer queries are not supported, GPU times are not reported.\n");
+	}
+	benchWidth = width;
+	benchHeight = height;
+
+	pglGenRenderbuffers(1, &colorBuffer);
+	pglBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	pglGenRenderbuffers(1, &depthBuffer);
+	pglBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	pglGenFramebuffers(1, &framebuffer);
+	pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_RENDERBUFFER, colorBuffer);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			GL_RENDERBUFFER, depthBuffer);
+	if (pglCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Benchmark framebuffer is incomplete.\n");
+		return 0;
+	}
+	glViewport(0, 0, width, height);
+	if (hasTimerQueries) {
+		pglGenQueries(BENCH_QUERY_RING, queries);
+	}
+	return 1;
+}
+/**
+ * benchClose
+ * Releases the framebuffer, context and results.
+ */
+void benchClose(void) {
+	if (framebuffer != 0) {
+		pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+		pglDeleteFramebuffers(1, &framebuffer);
+		pglDeleteRenderbuffers(1, &colorBuffer);
+		pglDeleteRenderbuffers(1, &depthBuffer);
+		framebuffer = 0;
+	}
+	if (hasTimerQueries && queries[0] != 0) {
+		pglDeleteQueries(BENCH_QUERY_RING, queries);
+		memset(queries, 0, sizeof(queries));
+	}
+#ifdef __linux__
+	if (display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) {
+			eglDestroyContext(display, context);
+		}
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+		context = EGL_NO_CONTEXT;
+	}
+#endif
+	free(cases);
+	cases = NULL;
+	numCases = 0;
+	currentCase = NULL;
+}
+/**
+ * benchBeginCase
+ * Starts collecting frames for a new case, parameters is a JSON object body.
+ */
+void benchBeginCase(const char* name, const char* parameters) {
+	cases = realloc(cases, sizeof(BenchCase) * (numCases + 1));
+	currentCase = &cases[numCases++];
+	memset(currentCase, 0, sizeof(BenchCase));
+	snprintf(currentCase->name, sizeof(currentCase->name), "%s", name);
+	snprintf(currentCase->parameters, sizeof(currentCase->parameters), "%s",
+			parameters);
+	memset(queryFrame, -1, sizeof(queryFrame));
+	frame = 0;
+}
+/**
+ * collectQuery
+ * Reads the GPU time of the frame that used a query slot, in milliseconds.
+ */
+static void collectQuery(int slot) {
+	GLuint64 elapsed = 0;
+	if (queryFrame[slot] < 0) {
+		return;
+	}
+	pglGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+	gpuTimes[queryFrame[slot]] = elapsed / 1000000.0f;
+	queryFrame[slot] = -1;
+}
+/**
+ * benchBeginFrame
+ */
+void benchBeginFrame(void) {
+	if (frame >= BENCH_MAX_FRAMES) {
+		return;
+	}
+	if (hasTimerQueries) {
+		int slot = frame % BENCH_QUERY_RING;
+		collectQuery(slot);
+		pglBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+		queryFrame[slot] = frame;
+	}
+	frameStart = timerNow();
+}
+/**
+ * benchEndFrame
+ * Records the CPU time spent submitting the frame. The flush stands in for
+ * the buffer swap of a windowed frame.
+ */
+void benchEndFrame(void) {
+	if (frame >= BENCH_MAX_FRAMES) {
+		return;
+	}
+	if (hasTimerQueries) {
+		pglEndQuery(GL_TIME_ELAPSED);
+	}
+	glFlush();
+	cpuTimes[frame] = (timerNow() - frameStart) * 1000.0f;
+	frame++;
+}
+/**
+ * compareFloats
+ */
+static int compareFloats(const void* a, const void* b) {
+	float difference = *(const float*) a - *(const float*) b;
+	return (difference > 0) - (difference < 0);
+}
+/**
+ * percentile
+ * Nearest rank percentile of a sorted array.
+ */
+static float percentile(const float* sorted, int count, float p) {
+	int rank = (int) (p / 100.0f * count + 0.5f);
+	if (rank < 1) {
+		rank = 1;
+	} else if (rank > count) {
+		rank = count;
+	}
+	return sorted[rank - 1];
+}
+/**
+ * computeStats
+ * Sorts the times in place and fills in the statistics.
+ */
+static void computeStats(float* times, int count, BenchStats* stats) {
+	double sum = 0;
+	int i;
+	memset(stats, 0, sizeof(BenchStats));
+	if (count == 0) {
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		sum += times[i];
+	}
+	qsort(times, count, sizeof(float), compareFloats);
+	stats->mean = sum / count;
+	stats->p50 = percentile(times, count, 50);
+	stats->p90 = percentile(times, count, 90);
+	stats->p95 = percentile(times, count, 95);
+	stats->p99 = percentile(times, count, 99);
+	stats->max = times[count - 1];
+}
+/**
+ * benchEndCase
+ * Waits for outstanding GPU timings and summarises the case.
+ */
+void benchEndCase(void) {
+	int slot;
+	if (currentCase == NULL) {
+		return;
+	}
+	if (hasTimerQueries) {
+		for (slot = 0; slot < BENCH_QUERY_RING; slot++) {
+			collectQuery(slot);
+		}
+	}
+	currentCase->frames = frame;
+	computeStats(cpuTimes, frame, &currentCase->cpu);
+	if (hasTimerQueries) {
+		computeStats(gpuTimes, frame, &currentCase->gpu);
+	}
+	printf("%-40s cpu p50 %6.2f ms p99 %6.2f ms", currentCase->name,
+			currentCase->cpu.p50, currentCase->cpu.p99);
+	if (hasTimerQueries) {
+		printf("  gpu p50 %6.2f ms p99 %6.2f ms", currentCase->gpu.p50,
+				currentCase->gpu.p99);
+	}
+	printf("\n");
+	currentCase = NULL;
+}
+/**
+ * writeStats
+ */
+static void writeStats(FILE* file, const char* name, const BenchStats* stats) {
+	fprintf(file, "\"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, "
+			"\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }", name, stats->mean,
+			stats->p50, stats->p90, stats->p95, stats->p99, stats->max);
+}
+/**
+ * benchWriteReport
+ * Writes every case to a JSON file, description is a JSON object body
+ * describing the run. Returns 0 on failure.
+ */
+int benchWriteReport(const char* fileName, const char* description) {
+	int i;
+	FILE* file = fopen(fileName, "w");
+	if (file == NULL) {
+		printf("Could not write benchmark report.\n");
+		return 0;
+	}
+	fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"version\": \"%s\",\n",
+			glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", benchWidth,
+			benchHeight);
+	fprintf(file, "  \"gpu_timing\": %s,\n", hasTimerQueries ? "true" : "false");
+	fprintf(file, "  \"run\": { %s },\n  \"cases\": [\n", description);
+	for (i = 0; i < numCases; i++) {
+		fprintf(file, "    { \"name\": \"%s\", %s, \"frames\": %d,\n      ",
+				cases[i].name, cases[i].parameters, cases[i].frames);
+		writeStats(file, "cpu_ms", &cases[i].cpu);
+		if (hasTimerQueries) {
+			fprintf(file, ",\n      ");
+			writeStats(file, "gpu_ms", &cases[i].gpu);
+		}
+		fprintf(file, " }%s\n", i + 1 < numCases ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	fclose(file);
+	printf("Benchmark report written to %s\n", fileName);
+	return 1;
+}
+/**
+ * benchResidentKb
+ * Returns the resident memory of the process in KB, -1 if unknown.
+ */
+long benchResidentKb(void) {
+#ifdef __linux__
+	long pages = -1;
+	long resident = -1;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file == NULL) {
+		return -1;
+	}
+	if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+		resident = -1;
+	}
+	fclose(file);
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return -1;
+#endif
+}
+/**
+ * benchCountGlObjects
+ * Counts the display lists, textures and buffer objects that exist in the
+ * current context. GL cannot list its objects, so every name up to the next
+ * free one (or BENCH_NAME_SCAN) is asked for.
+ */
+void benchCountGlObjects(int* lists, int* textures, int* buffers) {
+	GLuint next, name, last;
+	next = glGenLists(1);
+	glDeleteLists(next, 1);
+	last = next > BENCH_NAME_SCAN ? next : BENCH_NAME_SCAN;
+	*lists = 0;
+	for (name = 1; name < last; name++) {
+		*lists += glIsList(name) == GL_TRUE;
+	}
+	glGenTextures(1, &next);
+	glDeleteTextures(1, &next);
+	last = next > BENCH_NAME_SCAN ? next : BENCH_NAME_SCAN;
+	*textures = 0;
+	for (name = 1; name < last; name++) {
+		*textures += glIsTexture(name) == GL_TRUE;
+	}
+	*buffers = 0;
+	if (!hasBuffers) {
+		return;
+	}
+	pglGenBuffers(1, &next);
+	pglDeleteBuffers(1, &next);
+	last = next > BENCH_NAME_SCAN ? next : BENCH_NAME_SCAN;
+	for (name = 1; name < last; name++) {
+		*buffers += pglIsBuffer(name) == GL_TRUE;
+	}
+}
@@ -0,0 +1,27 @@
+/*
+ * bench.h
+ * CG flight simulator
+ * Offscreen rendering benchmark support.
+ * Creates a windowless context (EGL surfaceless, Mesa llvmpipe works) that
+ * renders into a framebuffer object, times frames on the CPU and GPU and
+ * writes a JSON report with percentiles for each benchmark case.
+ * Also reports resident memory and live GL objects for leak checks.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+int benchOpen(int width, int height);
+void benchClose(void);
+
+void benchBeginCase(const char* name, const char* parameters);
+void benchBeginFrame(void);
+void benchEndFrame(void);
+void benchEndCase(void);
+
+int benchWriteReport(const char* fileName, const char* description);
+
+long benchResidentKb(void);
+void benchCountGlObjects(int* lists, int* textures, int* buffers);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,1023 @@
+/**
+ * benchModes.c
+ * CG flight simulator
+ * The benchmark modes, see benchModes.h. Each runs from main in place of
+ * the sim, prints what it measured and returns, or quits if a check fails.
+ */
+
+#include "OGLFlightSim.h"
+#include "hud.h"
+#include "timer.h"
+#include "bench.h"
+#include "jobs.h"
+#include "server.h"
+#include "bots.h"
+#include "erosion.h"
+#include "capture.h"
+
+/**
+ * compareDoubles
+ */
+static int compareDoubles(const void* a, const void* b) {
+	double difference = *(const double*) a - *(const double*) b;
+	return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+/**
+ * setBenchCamera
+ * Places the camera on a scripted path, t goes from 0 to 1 over the path.
+ * 0 - orbit around the islands
+ * 1 - straight flyover across the middle
+ * 2 - low weaving pass over the water
+ */
+static void setBenchCamera(int path, float t) {
+	float angle = t * 2.0f * M_PI;
+	if (path == 0) {
+		world.eyeX = sin(angle) * 70.0f;
+		world.eyeY = 25.0f;
+		world.eyeZ = cos(angle) * 70.0f;
+		world.atX = 0;
+		world.atY = 5;
+		world.atZ = 0;
+	} else if (path == 1) {
+		world.eyeX = -10.0f + t * 20.0f;
+		world.eyeY = 12.0f;
+		world.eyeZ = -90.0f + t * 180.0f;
+		world.atX = world.eyeX + 1.0f;
+		world.atY = world.eyeY - 2.0f;
+		world.atZ = world.eyeZ + 10.0f;
+	} else {
+		world.eyeX = sin(angle * 2.0f) * 30.0f;
+		world.eyeY = 3.0f;
+		world.eyeZ = -60.0f + t * 120.0f;
+		world.atX = world.eyeX + cos(angle * 2.0f) * 6.0f;
+		world.atY = world.eyeY;
+		world.atZ = world.eyeZ + 10.0f;
+	}
+	world.planeRotation = atan2(world.atX - world.eyeX, world.atZ - world.eyeZ);
+	world.planeTilt = 0;
+	world.planeYawRotation = 0;
+}
+/**
+ * initOffscreen
+ * Opens the offscreen benchmark context at --bench-size and initializes the
+ * world and every GL resource in it. Returns 0 if there is no offscreen
+ * context, quits on other failures.
+ */
+static int initOffscreen() {
+	if (!benchOpen(benchRenderWidth, benchRenderHeight)) {
+		return 0;
+	}
+	appWidth = sim.inputWidth = benchRenderWidth;
+	appHeight = sim.inputHeight = benchRenderHeight;
+	if (!worldInit(&world)) {
+		exit(1);
+	}
+	worldNew(&world, worldSeed, &sim);
+	initResources();
+	initNew();
+	initGL();
+	hudInit();
+	initAircraftRenderer();
+	initMinimap();
+	handleResize(appWidth, appHeight);
+	return 1;
+}
+/**
+ * measureMinimap
+ * Mean milliseconds a frame the minimap takes over frames, its refreshes
+ * included, until what it drew is finished. It is timed on its own because
+ * switching framebuffers pulls the scene's deferred work into the GPU
+ * time of the frame on some drivers, and finished once at the end as a
+ * frame would be.
+ */
+static double measureMinimap(int frames) {
+	double start;
+	int i;
+	if (frames <= 0) {
+		return 0.0;
+	}
+	glFinish();
+	start = timerNow();
+	for (i = 0; i < frames; i++) {
+		hudBegin(appWidth, appHeight);
+		updateMinimap();
+		drawMinimap();
+	}
+	glFinish();
+	return (timerNow() - start) * 1000.0 / frames;
+}
+/**
+ * runRenderBenchmark
+ * Renders every combination of the rendering toggles along each scripted
+ * camera path into an offscreen framebuffer and writes a JSON report.
+ */
+void runRenderBenchmark() {
+	const char* pathNames[3] = { "orbit", "flyover", "lowpass" };
+	int numPaths = 3;
+	int combination, path, i;
+	char name[64];
+	char parameters[256];
+	char description[512];
+	TextureStats textureStats;
+
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	if (!initOffscreen()) {
+		exit(1);
+	}
+	if (captureFileName != NULL) {
+		startCapture(benchRenderWidth, benchRenderHeight);
+	}
+
+	//bit 0 wireframe, 1 fog, 2 grid, 3 mountains, 4 mountain textures
+	for (combination = 0; combination < 32; combination++) {
+		toggleWireframe = (combination >> 0) & 1;
+		toggleFog = (combination >> 1) & 1;
+		toggleGrid = (combination >> 2) & 1;
+		toggleMountains = (combination >> 3) & 1;
+		toggleMountainTextures = (combination >> 4) & 1;
+		glPolygonMode( GL_BACK, renderingOptions[toggleWireframe]);
+		glPolygonMode( GL_FRONT, renderingOptions[toggleWireframe]);
+		for (path = 0; path < numPaths; path++) {
+			snprintf(name, sizeof(name), "%s/w%d-f%d-g%d-m%d-t%d",
+					pathNames[path], toggleWireframe, toggleFog, toggleGrid,
+					toggleMountains, toggleMountainTextures);
+			snprintf(parameters, sizeof(parameters),
+					"\"path\": \"%s\", \"wireframe\": %d, \"fog\": %d, "
+							"\"grid\": %d, \"mountains\": %d, \"mountain_textures\": %d",
+					pathNames[path], toggleWireframe, toggleFog, toggleGrid,
+					toggleMountains, toggleMountainTextures);
+			//untimed warm up so state changes, driver compiles and texture
+			//streaming are not measured
+			for (i = 0; i < 3; i++) {
+				setBenchCamera(path, 0);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				draw();
+			}
+			textureSettle();
+			glFinish();
+			benchBeginCase(name, parameters);
+			for (i = 0; i < benchFramesPerPath; i++) {
+				setBenchCamera(path, (float) i / benchFramesPerPath);
+				benchBeginFrame();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				draw();
+				captureFrame(benchRenderWidth, benchRenderHeight);
+				benchEndFrame();
+			}
+			benchEndCase();
+		}
+	}
+	textureGetStats(&textureStats);
+	snprintf(description, sizeof(description),
+			"\"seed\": %u, \"frames_per_path\": %d, \"texture_kb\": %zu, "
+					"\"texture_budget_kb\": %zu, \"archipelago\": %d, "
+					"\"archipelago_draws\": %d, \"views\": \"%s\", "
+					"\"minimap_rate\": %d, \"minimap_ms\": %.4f, "
+					"\"frame_budget_ms\": %.2f, \"governor_steps\": %d, "
+					"\"render_scale\": %.2f, \"quality\": %d", worldSeed,
+			benchFramesPerPath, textureStats.residentBytes / 1024,
+			textureStats.budgetBytes / 1024, archipelago.count, archipelagoDraws,
+			viewLayoutName(viewLayoutIndex), minimapRate,
+			measureMinimap(benchFramesPerPath * numPaths), governor.budgetMs,
+			governor.changes, governorScale(&governor),
+			governorQualityLevel(&governor));
+	benchWriteReport(benchOutputFile, description);
+	finishCapture();
+	benchClose();
+}
+/**
+ * nextResetSeed
+ * Picks the seed of a reset benchmark world: a new one every time, or with
+ * a world cache one of a few, so resets after the warm up load them.
+ */
+static void nextResetSeed(unsigned int firstSeed, int reset) {
+	if (worldCacheDir != NULL) {
+		worldSeed = firstSeed + reset % RESET_CACHED_SEEDS;
+	} else {
+		worldSeed++;
+	}
+}
+/**
+ * runResetBenchmark
+ * Resets the world benchResets times offscreen, drawing now and then, and
+ * times every reset. Display lists, textures, buffer objects and resident
+ * memory are sampled along the way and must end where they were after the
+ * warm up, otherwise the run fails.
+ */
+void runResetBenchmark() {
+	double* times;
+	double total = 0.0;
+	int lists, textures, buffers, startLists, startTextures, startBuffers;
+	long resident, startResident;
+	unsigned int firstSeed;
+#ifndef NDEBUG
+	unsigned long startHeapBlocks;
+#endif
+	int i;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	firstSeed = worldSeed;
+	if (!initOffscreen()) {
+		exit(1);
+	}
+	times = malloc(sizeof(double) * benchResets);
+	//warm up so allocator pools and driver caches settle before the baseline
+	for (i = 0; i < 100; i++) {
+		nextResetSeed(firstSeed, i);
+		resetWorld();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		draw();
+	}
+	glFinish();
+	benchCountGlObjects(&startLists, &startTextures, &startBuffers);
+	startResident = benchResidentKb();
+	lists = startLists;
+	textures = startTextures;
+	buffers = startBuffers;
+	resident = startResident;
+	printf("Reset: start, %d display lists, %d textures, %d buffers, %ld KB resident\n",
+			startLists, startTextures, startBuffers, startResident);
+#ifndef NDEBUG
+	startHeapBlocks = world.arena.heapBlocks;
+#endif
+	if (worldCacheDir != NULL) {
+		printf("Reset: cycling through %d seeds cached in %s\n",
+				RESET_CACHED_SEEDS, worldCacheDir);
+	}
+
+	for (i = 0; i < benchResets; i++) {
+		double start = timerNow();
+		nextResetSeed(firstSeed, i);
+		resetWorld();
+		times[i] = timerNow() - start;
+		total += times[i];
+		//draw sometimes so the driver really uses the recompiled lists
+		if (i % 100 == 99) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			draw();
+			glFinish();
+		}
+		if ((i + 1) % (benchResets >= 10 ? benchResets / 10 : 1) == 0) {
+			benchCountGlObjects(&lists, &textures, &buffers);
+			resident = benchResidentKb();
+			printf("Reset: %6d resets, %d display lists, %d textures, %d buffers, "
+					"%ld KB resident\n", i + 1, lists, textures, buffers, resident);
+		}
+	}
+	qsort(times, benchResets, sizeof(double), compareDoubles);
+	printf("Reset: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms (tick %d ms)\n",
+			total / benchResets * 1000.0, times[benchResets / 2] * 1000.0,
+			times[(int) (benchResets * 0.99)] * 1000.0,
+			times[benchResets - 1] * 1000.0, tickMs);
+	arenaPrintStats(&world.arena, "world");
+	arenaPrintStats(&frameArena, "frame");
+	free(times);
+	benchClose();
+#ifndef NDEBUG
+	//once the arena fits a world, resetting must not touch the heap
+	if (world.arena.heapBlocks != startHeapBlocks) {
+		printf("Reset: FAILED, the world arena took %lu blocks from the heap\n",
+				world.arena.heapBlocks - startHeapBlocks);
+		exit(1);
+	}
+#endif
+	//a little resident growth is allocator noise, a leak grows with every reset
+	if (lists != startLists || textures != startTextures || buffers != startBuffers
+			|| resident - startResident > 1024) {
+		printf("Reset: FAILED, GL objects or memory grew\n");
+		exit(1);
+	}
+	printf("Reset: OK, GL objects and memory stayed flat\n");
+}
+/**
+ * runAiBenchmark
+ * Times the AI update of benchAiCount aircraft without a window, with the
+ * threat circling through the swarm so evading aircraft keep reacting.
+ */
+void runAiBenchmark() {
+	AiSwarm swarm;
+	double* times;
+	double total = 0.0;
+	int i;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	if (benchTicks < 1) {
+		benchTicks = 1000;
+	}
+	if (!aiCreate(&swarm, benchAiCount, worldSeed)) {
+		printf("Could not create %d AI aircraft.\n", benchAiCount);
+		exit(1);
+	}
+	times = malloc(sizeof(double) * benchTicks);
+	//warm up caches and wake the workers
+	for (i = 0; i < 10; i++) {
+		aiUpdate(&swarm, 0, 20, 0);
+	}
+	for (i = 0; i < benchTicks; i++) {
+		float angle = i * 0.01f;
+		double start = timerNow();
+		aiUpdate(&swarm, sin(angle) * 100.0f, 20, cos(angle) * 100.0f);
+		times[i] = timerNow() - start;
+		total += times[i];
+	}
+	qsort(times, benchTicks, sizeof(double), compareDoubles);
+	printf("AI: %d aircraft, %d threads, %d ticks\n", benchAiCount,
+			jobsWorkerCount(), benchTicks);
+	printf("AI: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+			total / benchTicks * 1000.0, times[benchTicks / 2] * 1000.0,
+			times[(int) (benchTicks * 0.99)] * 1000.0,
+			times[benchTicks - 1] * 1000.0);
+	free(times);
+	aiFree(&swarm);
+}
+/**
+ * runNetBenchmark
+ * Runs a server on a thread and loads it with a growing number of bots on
+ * the loopback interface, up to --bench-net, so the server tick cost and
+ * traffic per client can be compared as pilots are added.
+ */
+void runNetBenchmark() {
+	NetAddress server;
+	ServerStats serverStats;
+	BotStats stats;
+	int count;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	if (benchTicks < 1) {
+		benchTicks = 400;
+	}
+	if (!serverStart(netPort, worldSeed, tickMs) || !serverRunThread()) {
+		exit(1);
+	}
+	netResolve("127.0.0.1", netPort, &server);
+	count = benchNetCount;
+	while (count / 2 >= 25 && count / 2 >= benchNetCount / 8) {
+		count /= 2;
+	}
+	for (; count <= benchNetCount; count = count * 2 > benchNetCount
+			&& count < benchNetCount ? benchNetCount : count * 2) {
+		serverTakeStats(&serverStats);
+		if (!botsRun(&server, count, benchTicks, tickMs, &stats)) {
+			break;
+		}
+		serverTakeStats(&serverStats);
+		printf("Net: %d clients, server tick mean %.3f ms p99 %.3f ms max %.3f ms,"
+				" %llu full snapshots\n", count, serverStats.tickMean * 1000.0,
+				serverStats.tickP99 * 1000.0, serverStats.tickMax * 1000.0,
+				(unsigned long long) serverStats.fullSnapshots);
+		botsPrintStats(&stats);
+		//let the server drop the departed bots
+		timerSleep(0.1);
+	}
+	serverStopThread();
+	serverStop();
+}
+/**
+ * runFlightBenchmark
+ * Times the flight model for 1, 1000 and 100000 aircraft without a window.
+ * Each case runs enough ticks for about ten million integrations unless
+ * --bench-ticks is given.
+ */
+void runFlightBenchmark() {
+	const int counts[] = { 1, 1000, 100000 };
+	int c, i;
+	for (c = 0; c < (int) (sizeof(counts) / sizeof(counts[0])); c++) {
+		int count = counts[c];
+		int ticks = benchTicks;
+		FlightBatch batch;
+		double* times;
+		double total = 0.0;
+		if (ticks < 1) {
+			ticks = 10000000 / (count * WORLD_FLIGHT_SUBSTEPS);
+			ticks = ticks < 10 ? 10 : ticks > 100000 ? 100000 : ticks;
+		}
+		if (!flightCreate(&batch, count)) {
+			printf("Could not create %d aircraft.\n", count);
+			exit(1);
+		}
+		//a spread of headings, speeds and gentle control inputs
+		for (i = 0; i < count; i++) {
+			flightPlace(&batch, i, (i % 100) * 50.0f, 500.0f, (i / 100) * 50.0f,
+					i * 0.618f, FLIGHT_CRUISE_SPEED + (i % 7));
+			batch.aileron[i] = ((i % 11) - 5) * 0.02f;
+			batch.elevator[i] = ((i % 5) - 2) * 0.05f;
+			batch.throttle[i] = 0.3f + (i % 3) * 0.2f;
+		}
+		times = malloc(sizeof(double) * ticks);
+		//warm up caches and wake the workers
+		for (i = 0; i < 10; i++) {
+			flightStep(&batch, tickMs / 1000.0f / WORLD_FLIGHT_SUBSTEPS, WORLD_FLIGHT_SUBSTEPS);
+		}
+		for (i = 0; i < ticks; i++) {
+			double start = timerNow();
+			flightStep(&batch, tickMs / 1000.0f / WORLD_FLIGHT_SUBSTEPS, WORLD_FLIGHT_SUBSTEPS);
+			times[i] = timerNow() - start;
+			total += times[i];
+		}
+		qsort(times, ticks, sizeof(double), compareDoubles);
+		printf("Flight: %d aircraft, %d threads, %d ticks of %d steps\n", count,
+				jobsWorkerCount(), ticks, WORLD_FLIGHT_SUBSTEPS);
+		printf("Flight: mean %.4f ms, p99 %.4f ms, %.2f M integrations/s\n",
+				total / ticks * 1000.0, times[(int) (ticks * 0.99)] * 1000.0,
+				(double) count * WORLD_FLIGHT_SUBSTEPS * ticks / total / 1000000.0);
+		free(times);
+		flightFree(&batch);
+	}
+}
+/**
+ * heightsChecksum
+ * Hashes the island heights, to compare erosion runs.
+ */
+static unsigned int heightsChecksum(const Terrain* terrain) {
+	unsigned int hash = 2166136261u;
+	int i;
+	size_t j;
+	for (i = 0; i < terrain->islandCount; i++) {
+		const unsigned char* bytes = (const unsigned char*) terrain->islands[i].heights;
+		for (j = 0; j < sizeof(float) * terrain->mapSize * terrain->mapSize; j++) {
+			hash = (hash ^ bytes[j]) * 16777619u;
+		}
+	}
+	return hash;
+}
+/**
+ * heightsSharpestPeak
+ * Returns how far the most pinched peak stands above the mean of its four
+ * neighbours.
+ */
+static float heightsSharpestPeak(const Terrain* terrain) {
+	int size = terrain->mapSize;
+	float sharpest = 0.0f;
+	int i, x, z;
+	for (i = 0; i < terrain->islandCount; i++) {
+		const float* map = terrain->islands[i].heights;
+		for (x = 1; x < size - 1; x++) {
+			for (z = 1; z < size - 1; z++) {
+				const float* cell = &map[x * size + z];
+				float peak = cell[0] - (cell[-size] + cell[size] + cell[-1]
+						+ cell[1]) * 0.25f;
+				sharpest = peak > sharpest ? peak : sharpest;
+			}
+		}
+	}
+	return sharpest;
+}
+/**
+ * runErosionBenchmark
+ * Generates and erodes the islands at growing map sizes, on the job pool
+ * and then on one thread, and fails unless both give the same heights.
+ * Foreground sizes are checked against the respawn budget.
+ */
+void runErosionBenchmark() {
+	const int sizes[] = { 129, 257, 513, 1025 };
+	float droplets = erosionDroplets > 0.0f ? erosionDroplets : EROSION_DEFAULT_DROPLETS;
+	int failed = 0;
+	int s;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	printf("Erosion: %.2f droplets per cell, seed %u, %d threads\n", droplets,
+			worldSeed, jobsWorkerCount());
+	for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+		int size = sizes[s];
+		Terrain terrain;
+		ErosionSettings erosion;
+		Rng rng;
+		double start, generate, parallel, serial;
+		float before, after;
+		unsigned int parallelHash;
+		int foreground = size <= EROSION_FOREGROUND_SIZE;
+		memset(&terrain, 0, sizeof(terrain));
+		erosionDefaults(&erosion, droplets);
+		rngSeedStream(&rng, worldSeed, RNG_TERRAIN, 0);
+		start = timerNow();
+		if (!terrainGenerate(&terrain, &rng, size, numIslands)) {
+			printf("Could not allocate a %dx%d terrain.\n", size, size);
+			exit(1);
+		}
+		generate = timerNow() - start;
+		before = heightsSharpestPeak(&terrain);
+		start = timerNow();
+		if (!erodeTerrain(&terrain, worldSeed, &erosion)) {
+			printf("Could not erode a %dx%d terrain.\n", size, size);
+			exit(1);
+		}
+		parallel = timerNow() - start;
+		after = heightsSharpestPeak(&terrain);
+		parallelHash = heightsChecksum(&terrain);
+
+		//the same islands again, on the calling thread only
+		rngSeedStream(&rng, worldSeed, RNG_TERRAIN, 0);
+		terrainGenerate(&terrain, &rng, size, numIslands);
+		erosion.parallel = 0;
+		start = timerNow();
+		erodeTerrain(&terrain, worldSeed, &erosion);
+		serial = timerNow() - start;
+
+		printf("Erosion: %4dx%-4d generate %7.1f ms, erode %8.1f ms (%8.1f ms on 1 thread), "
+				"%.2f M droplets/s, sharpest peak %.2f -> %.2f, %s\n", size, size,
+				generate * 1000.0, parallel * 1000.0, serial * 1000.0,
+				droplets * size * size * terrain.islandCount / parallel / 1000000.0,
+				before, after, !foreground ? "background" :
+				parallel * 1000.0 <= EROSION_RESPAWN_BUDGET_MS ?
+						"within the respawn budget" : "OVER the respawn budget");
+		if (heightsChecksum(&terrain) != parallelHash) {
+			printf("Erosion: FAILED, %dx%d heights depend on the thread count\n",
+					size, size);
+			failed = 1;
+		}
+		terrainFree(&terrain);
+	}
+	if (failed) {
+		exit(1);
+	}
+	printf("Erosion: OK, the same heights on any number of threads\n");
+}
+/**
+ * runTransformBenchmark
+ * Times the transform hierarchy of benchTransformCount aircraft, each with
+ * a model and two propellers below it, when everything moves, when only
+ * the propellers turn and when nothing moves.
+ */
+void runTransformBenchmark() {
+	const char* cases[3] = { "all moving", "propellers turning", "nothing moving" };
+	TransformTree tree;
+	int count = benchTransformCount;
+	int c, i, t;
+	if (benchTicks < 1) {
+		benchTicks = 1000;
+	}
+	if (!transformInit(&tree, count * 4)) {
+		printf("Could not allocate %d aircraft.\n", count);
+		exit(1);
+	}
+	for (i = 0; i < count; i++) {
+		int aircraft = transformAdd(&tree, TRANSFORM_ROOT);
+		int model = transformAdd(&tree, aircraft);
+		transformSetTrs(&tree, model, vec3Make(0, 0, 0),
+				quatAxisAngle(vec3Make(0, 1, 0), M_PI / 2), vec3Make(1, 1, 1));
+		transformSetBounds(&tree, transformAdd(&tree, model),
+				vec3Make(-0.1f, -0.5f, -0.5f), vec3Make(0.1f, 0.5f, 0.5f));
+		transformSetBounds(&tree, transformAdd(&tree, model),
+				vec3Make(-0.1f, -0.5f, -0.5f), vec3Make(0.1f, 0.5f, 0.5f));
+	}
+	transformUpdate(&tree);
+	printf("Transform: %d aircraft, %d nodes, %d ticks\n", count, tree.count,
+			benchTicks);
+	for (c = 0; c < 3; c++) {
+		double total = 0.0;
+		long long updated = 0;
+		for (t = 0; t < benchTicks; t++) {
+			double start;
+			for (i = 0; i < count && c < 2; i++) {
+				Quat spin = quatAxisAngle(vec3Make(1, 0, 0), t * 0.3f + i);
+				if (c == 0) {
+					transformSetTrs(&tree, i * 4, vec3Make(i, 10, t * 0.1f),
+							quatAxisAngle(vec3Make(0, 1, 0), t * 0.01f + i),
+							vec3Make(0.8f, 0.8f, 0.8f));
+				}
+				transformSetTrs(&tree, i * 4 + 2, vec3Make(0, 0, 0.35f), spin,
+						vec3Make(1, 1, 1));
+				transformSetTrs(&tree, i * 4 + 3, vec3Make(0, 0, -0.35f), spin,
+						vec3Make(1, 1, 1));
+			}
+			start = timerNow();
+			updated += transformUpdate(&tree);
+			total += timerNow() - start;
+		}
+		printf("Transform: %-18s %8.3f ms per update, %6lld nodes updated, %.1f ns per node\n",
+				cases[c], total / benchTicks * 1000.0, updated / benchTicks,
+				updated > 0 ? total / updated * 1e9 : 0.0);
+	}
+	transformFree(&tree);
+}
+/**
+ * bruteForceQuery
+ * Answers a spatial query by testing every entity, to check the hash
+ * against. Returns the number of matches and the distance of the kth
+ * nearest one in kthDistance.
+ */
+static int bruteForceQuery(const SpatialHash* hash, const SpatialQuery* query, int k,
+		float* kthDistance) {
+	int found = 0;
+	int id, i;
+	for (i = 0; i < k; i++) {
+		kthDistance[i] = -1.0f;
+	}
+	for (id = 0; id < hash->count; id++) {
+		float dx = hash->x[id] - query->x;
+		float dy = hash->y[id] - query->y;
+		float dz = hash->z[id] - query->z;
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (id == query->ignore
+				|| !(query->kinds & SPATIAL_KIND_BIT(hash->kind[id]))
+				|| distanceSquared > query->radius * query->radius) {
+			continue;
+		}
+		found++;
+		//keeps the k smallest distances in order
+		for (i = 0; i < k; i++) {
+			if (kthDistance[i] < 0.0f || distanceSquared < kthDistance[i]) {
+				float moved = kthDistance[i];
+				kthDistance[i] = distanceSquared;
+				distanceSquared = moved;
+				if (moved < 0.0f) {
+					break;
+				}
+			}
+		}
+	}
+	return found;
+}
+/**
+ * runSpatialBenchmark
+ * Times building the spatial hash and running a targeting query and a hit
+ * test per aircraft at 1k, 10k and 100k aircraft with a bullet per four,
+ * checking a sample of the answers against testing every entity. Also
+ * gives what that costs of a tick on the worker threads there are.
+ */
+void runSpatialBenchmark() {
+	const int sizes[] = { 1000, 10000, 100000 };
+	int failed = 0;
+	int checked = 0;
+	int s, t, q;
+	if (benchTicks < 1) {
+		benchTicks = 20;
+	}
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	printf("Spatial: %d ticks, seed %u, %d threads\n", benchTicks, worldSeed,
+			jobsWorkerCount());
+	for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+		int count = sizes[s];
+		int bullets = count / 4;
+		AiSwarm swarm;
+		SpatialHash hash;
+		SpatialQuery* queries;
+		SpatialHit* hits;
+		int* found;
+		double build = 0.0, nearest = 0.0, radius = 0.0, tick;
+		long long nearestHits = 0, radiusHits = 0;
+		if (!aiCreate(&swarm, count, worldSeed) || !spatialInit(&hash, SPATIAL_DEFAULT_CELL)) {
+			printf("Could not allocate %d aircraft.\n", count);
+			exit(1);
+		}
+		queries = malloc(sizeof(SpatialQuery) * count);
+		hits = malloc(sizeof(SpatialHit) * count * SPATIAL_BENCH_TARGETS);
+		found = malloc(sizeof(int) * count);
+		if (queries == NULL || hits == NULL || found == NULL) {
+			printf("Could not allocate %d aircraft.\n", count);
+			exit(1);
+		}
+		for (t = 0; t < benchTicks; t++) {
+			double start;
+			int b;
+			aiUpdate(&swarm, 0.0f, 100.0f, 0.0f);
+			spatialClear(&hash);
+			start = timerNow();
+			spatialInsertMany(&hash, SPATIAL_AI, count, swarm.x, swarm.y, swarm.z);
+			//bullets trail a quarter of the aircraft, spread along their path
+			for (b = 0; b < bullets; b++) {
+				int a = b * 4;
+				float along = 1.0f + (b % 16);
+				spatialInsert(&hash, SPATIAL_BULLET, b,
+						swarm.x[a] + swarm.dirX[a] * along, swarm.y[a],
+						swarm.z[a] + swarm.dirZ[a] * along);
+			}
+			spatialBuild(&hash);
+			build += timerNow() - start;
+
+			//targeting, the closest few other aircraft
+			for (q = 0; q < count; q++) {
+				queries[q].type = SPATIAL_NEAREST;
+				queries[q].x = swarm.x[q];
+				queries[q].y = swarm.y[q];
+				queries[q].z = swarm.z[q];
+				queries[q].radius = SPATIAL_BENCH_TARGET_RANGE;
+				queries[q].kinds = SPATIAL_KIND_BIT(SPATIAL_AI);
+				queries[q].ignore = q;
+			}
+			start = timerNow();
+			spatialQueryBatch(&hash, queries, count, SPATIAL_BENCH_TARGETS, hits, found);
+			nearest += timerNow() - start;
+			for (q = 0; q < count; q++) {
+				nearestHits += found[q];
+			}
+			for (q = 0; q < SPATIAL_BENCH_CHECKS; q++) {
+				int asker = (int) ((long long) q * count / SPATIAL_BENCH_CHECKS);
+				float kth[SPATIAL_BENCH_TARGETS];
+				int expected = bruteForceQuery(&hash, &queries[asker],
+						SPATIAL_BENCH_TARGETS, kth);
+				int i;
+				if (expected > SPATIAL_BENCH_TARGETS) {
+					expected = SPATIAL_BENCH_TARGETS;
+				}
+				failed |= found[asker] != expected;
+				for (i = 0; i < expected && i < found[asker]; i++) {
+					failed |= hits[asker * SPATIAL_BENCH_TARGETS + i].distanceSquared != kth[i];
+				}
+				checked++;
+			}
+
+			//hit test, everything within touching distance
+			for (q = 0; q < count; q++) {
+				queries[q].type = SPATIAL_RADIUS;
+				queries[q].radius = SPATIAL_BENCH_HIT_RANGE;
+				queries[q].kinds = SPATIAL_ALL_KINDS;
+			}
+			start = timerNow();
+			spatialQueryBatch(&hash, queries, count, SPATIAL_BENCH_TARGETS, hits, found);
+			radius += timerNow() - start;
+			for (q = 0; q < count; q++) {
+				radiusHits += found[q];
+			}
+			for (q = 0; q < SPATIAL_BENCH_CHECKS; q++) {
+				int asker = (int) ((long long) q * count / SPATIAL_BENCH_CHECKS);
+				float kth[1];
+				failed |= found[asker] != bruteForceQuery(&hash, &queries[asker], 0, kth);
+				checked++;
+			}
+		}
+		printf("Spatial: %6d aircraft %5d bullets, build %7.3f ms, nearest %d %8.3f ms, "
+				"radius %8.3f ms, %.1f ns per entity, cell %.1f, %.2f targets %.2f hits each\n",
+				count, bullets, build / benchTicks * 1000.0, SPATIAL_BENCH_TARGETS,
+				nearest / benchTicks * 1000.0, radius / benchTicks * 1000.0,
+				(build + nearest + radius) / benchTicks / (count + bullets) * 1e9,
+				hash.cellSize, (double) nearestHits / benchTicks / count,
+				(double) radiusHits / benchTicks / count);
+		//per query cost stays about the same as the swarm grows, so the
+		//aircraft a tick has room for scale with it
+		tick = (build + nearest + radius) / benchTicks * 1000.0;
+		printf("Spatial: %6d aircraft, per query nearest %.0f ns radius %.0f ns, "
+				"%.3f ms is %.0f%% of the %d ms tick on %d threads, about %d aircraft fit\n",
+				count, nearest / benchTicks / count * 1e9, radius / benchTicks / count * 1e9,
+				tick, tick / tickMs * 100.0, tickMs, jobsWorkerCount(),
+				(int) (count * tickMs / tick));
+		if (failed) {
+			printf("Spatial: FAILED, %d aircraft answers differ from testing every entity\n",
+					count);
+			exit(1);
+		}
+		free(queries);
+		free(hits);
+		free(found);
+		spatialFree(&hash);
+		aiFree(&swarm);
+	}
+	printf("Spatial: OK, %d sampled answers match testing every entity\n", checked);
+}
+/**
+ * summarizeTimes
+ * Sorts count times in seconds and gives their mean, p50, p99 and max in
+ * milliseconds.
+ */
+static void summarizeTimes(double* times, int count, double total, double stats[4]) {
+	qsort(times, count, sizeof(double), compareDoubles);
+	stats[0] = total / count * 1000.0;
+	stats[1] = times[count / 2] * 1000.0;
+	stats[2] = times[(int) (count * 0.99)] * 1000.0;
+	stats[3] = times[count - 1] * 1000.0;
+}
+/**
+ * runSweepPoint
+ * Measures one point of a sweep with the settings this process was given:
+ * ticks of a headless world whose pilot keeps turning and firing, then
+ * frames of the offscreen renderer orbiting the islands. Prints both on one
+ * SWEEP line for runSweep to read.
+ */
+void runSweepPoint() {
+	World sweepWorld;
+	double tickStats[4] = { 0 }, frameStats[4] = { 0 };
+	double tickTotal = 0.0, frameTotal = 0.0;
+	double* times;
+	int ticks = benchTicks > 0 ? benchTicks : SWEEP_DEFAULT_TICKS;
+	int frames = benchFramesPerPath;
+	int rendered = 0;
+	int i;
+	if (fixedSeed == 0) {
+		worldSeed = 1;
+	}
+	times = malloc(sizeof(double) * (ticks > frames ? ticks : frames));
+	if (times == NULL || !worldInit(&sweepWorld)) {
+		printf("Could not allocate the sweep.\n");
+		exit(1);
+	}
+	sim.inputWidth = benchRenderWidth;
+	sim.inputHeight = benchRenderHeight;
+	sim.boolShoot = 1;
+	worldNew(&sweepWorld, worldSeed, &sim);
+	//the first ticks wake the workers and are not timed
+	for (i = -10; i < ticks; i++) {
+		double start;
+		sim.lastMouseX = sim.inputWidth / 2 + sin(i * 0.01) * sim.inputWidth / 4;
+		sim.lastMouseY = sim.inputHeight / 2;
+		start = timerNow();
+		worldStep(&sweepWorld, &sim);
+		if (i >= 0) {
+			times[i] = timerNow() - start;
+			tickTotal += times[i];
+		}
+	}
+	summarizeTimes(times, ticks, tickTotal, tickStats);
+	worldFree(&sweepWorld);
+
+	//bullets are drawn with GLUT, which the offscreen context has not set up
+	sim.boolShoot = 0;
+	if (frames > 0 && initOffscreen()) {
+		for (i = -3; i < frames; i++) {
+			double start;
+			//the world moves on between frames, only drawing it is timed
+			worldStep(&world, &sim);
+			setBenchCamera(0, i < 0 ? 0.0f : (float) i / frames);
+			start = timerNow();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			draw();
+			glFinish();
+			if (i >= 0) {
+				times[i] = timerNow() - start;
+				frameTotal += times[i];
+			}
+		}
+		summarizeTimes(times, frames, frameTotal, frameStats);
+		rendered = 1;
+	}
+	printf("SWEEP %d %.3f %.4f %.4f %.4f %.4f %.3f %.4f %.4f %.4f %.4f %ld\n",
+			tickMs, ticks / tickTotal, tickStats[0], tickStats[1], tickStats[2],
+			tickStats[3], rendered ? frames / frameTotal : 0.0, frameStats[0],
+			frameStats[1], frameStats[2], frameStats[3], benchResidentKb());
+	if (rendered) {
+		benchClose();
+	}
+	free(times);
+}
+/**
+ * appendArgument
+ * Appends an argument to a shell command, quoted for the shell.
+ */
+static void appendArgument(char* command, size_t size, const char* argument) {
+	size_t length = strlen(command);
+#ifdef _WIN32
+	snprintf(command + length, size - length, " \"%s\"", argument);
+#else
+	const char* c;
+	//inside single quotes only a single quote needs care
+	length += snprintf(command + length, size - length, " '");
+	for (c = argument; *c != '\0' && length + 6 < size; c++) {
+		if (*c == '\'') {
+			length += snprintf(command + length, size - length, "'\\''");
+		} else {
+			command[length++] = *c;
+			command[length] = '\0';
+		}
+	}
+	snprintf(command + length, size - length, "'");
+#endif
+}
+/**
+ * runSweep
+ * Runs this program again with --sweep-point at every point of the grid of
+ * --sweep-grid settings, with the rest of its own arguments and then the
+ * point's settings, and writes what each point measured as a CSV row. So
+ * every point starts from a fresh process, heap and GL context. A point
+ * whose tick or frame p99 is longer than its tick is marked over budget.
+ */
+void runSweep(int argc, char** argv) {
+	char* keys[SWEEP_MAX_KEYS];
+	char* values[SWEEP_MAX_KEYS][SWEEP_MAX_VALUES];
+	int counts[SWEEP_MAX_KEYS];
+	int at[SWEEP_MAX_KEYS] = { 0 };
+	char defaultGrid[] = SWEEP_DEFAULT_GRID;
+	char command[4096];
+	char line[512];
+	FILE* csv;
+	int points = 1;
+	int point, k, i;
+	if (sweepKeys == 0) {
+		sweepGrid[sweepKeys++] = defaultGrid;
+	}
+	for (k = 0; k < sweepKeys; k++) {
+		Config check = config;
+		char* value;
+		char* equals = strchr(sweepGrid[k], '=');
+		if (equals == NULL) {
+			printf("--sweep-grid needs key=value,value,..., not \"%s\".\n", sweepGrid[k]);
+			exit(1);
+		}
+		*equals = '\0';
+		keys[k] = sweepGrid[k];
+		counts[k] = 0;
+		for (value = strtok(equals + 1, ","); value != NULL; value = strtok(NULL, ",")) {
+			if (counts[k] == SWEEP_MAX_VALUES) {
+				printf("At most %d values of %s.\n", SWEEP_MAX_VALUES, keys[k]);
+				exit(1);
+			}
+			if (!configSet(&check, keys[k], value)) {
+				exit(1);
+			}
+			values[k][counts[k]++] = value;
+		}
+		if (counts[k] == 0) {
+			printf("No values of %s to sweep.\n", keys[k]);
+			exit(1);
+		}
+		points *= counts[k];
+	}
+	csv = fopen(sweepFileName, "w");
+	if (csv == NULL) {
+		printf("Could not create %s.\n", sweepFileName);
+		exit(1);
+	}
+	for (k = 0; k < sweepKeys; k++) {
+		fprintf(csv, "%s,", keys[k]);
+	}
+	fprintf(csv, "tick_ms,ticks_per_s,tick_mean_ms,tick_p50_ms,tick_p99_ms,"
+			"tick_max_ms,fps,frame_mean_ms,frame_p50_ms,frame_p99_ms,"
+			"frame_max_ms,resident_kb,over_budget\n");
+
+	for (point = 0; point < points; point++) {
+		double tick[6], frame[5];
+		int budget = 0;
+		long resident = 0;
+		int measured = 0;
+		FILE* child;
+		snprintf(command, sizeof(command), "\"%s\"", argv[0]);
+		for (i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--sweep") == 0 || strcmp(argv[i], "--sweep-grid") == 0) {
+				i++;
+			} else {
+				appendArgument(command, sizeof(command), argv[i]);
+			}
+		}
+		appendArgument(command, sizeof(command), "--sweep-point");
+		printf("Sweep: %d/%d", point + 1, points);
+		for (k = 0; k < sweepKeys; k++) {
+			snprintf(line, sizeof(line), "%s=%s", keys[k], values[k][at[k]]);
+			appendArgument(command, sizeof(command), "--set");
+			appendArgument(command, sizeof(command), line);
+			fprintf(csv, "%s,", values[k][at[k]]);
+			printf(" %s", line);
+		}
+		fflush(stdout);
+
+#ifdef _WIN32
+		child = _popen(command, "r");
+#else
+		child = popen(command, "r");
+#endif
+		while (child != NULL && fgets(line, sizeof(line), child) != NULL) {
+			if (sscanf(line, "SWEEP %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %ld",
+					&tick[0], &tick[1], &tick[2], &tick[3], &tick[4], &tick[5],
+					&frame[0], &frame[1], &frame[2], &frame[3], &frame[4],
+					&resident) == 12) {
+				measured = 1;
+			}
+		}
+		if (child != NULL) {
+#ifdef _WIN32
+			_pclose(child);
+#else
+			pclose(child);
+#endif
+		}
+
+		if (measured) {
+			//tick[0] is the tick length, frame[0] is 0 without a renderer
+			budget = (tick[4] > tick[0]) | (frame[0] > 0.0 && frame[3] > tick[0]) << 1;
+			fprintf(csv, "%g,%.1f,%.4f,%.4f,%.4f,%.4f,", tick[0], tick[1],
+					tick[2], tick[3], tick[4], tick[5]);
+			if (frame[0] > 0.0) {
+				fprintf(csv, "%.1f,%.4f,%.4f,%.4f,%.4f,", frame[0], frame[1],
+						frame[2], frame[3], frame[4]);
+			} else {
+				fprintf(csv, ",,,,,");
+			}
+			fprintf(csv, "%ld,%s\n", resident, budget == 3 ? "both" :
+					budget == 2 ? "render" : budget == 1 ? "sim" : "");
+			printf(": %.0f ticks/s, tick p99 %.3f ms", tick[1], tick[4]);
+			if (frame[0] > 0.0) {
+				printf(", %.1f fps, frame p99 %.3f ms", frame[0], frame[3]);
+			}
+			printf("\n");
+		} else {
+			fprintf(csv, ",,,,,,,,,,,,failed\n");
+			printf(": failed\n");
+		}
+		fflush(csv);
+
+		//next point, the last key changes fastest
+		for (k = sweepKeys - 1; k >= 0; k--) {
+			if (++at[k] < counts[k]) {
+				break;
+			}
+			at[k] = 0;
+		}
+	}
+	fclose(csv);
+	printf("Sweep: wrote %d points to %s\n", points, sweepFileName);
+}
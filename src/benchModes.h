@@ -0,0 +1,40 @@
+/*
+ * benchModes.h
+ * CG flight simulator
+ * The --bench-* modes and the scaling sweep, each run by main instead of
+ * the sim when its option is given. They drive the same world, renderer
+ * and modules the sim does, and print what they measured.
+ */
+
+#ifndef BENCHMODES_H_
+#define BENCHMODES_H_
+
+//seeds the reset benchmark cycles through with a world cache
+#define RESET_CACHED_SEEDS 8
+//closest aircraft each one targets in the spatial bench, how far it looks,
+//the range of its hit test and the answers checked per query pass
+#define SPATIAL_BENCH_TARGETS 4
+#define SPATIAL_BENCH_TARGET_RANGE 200.0f
+#define SPATIAL_BENCH_HIT_RANGE 2.0f
+#define SPATIAL_BENCH_CHECKS 100
+//a sweep's --sweep-grid settings and the values of each
+#define SWEEP_MAX_KEYS 8
+#define SWEEP_MAX_VALUES 32
+//ticks measured at each point unless --bench-ticks says otherwise, the
+//frames are --bench-frames
+#define SWEEP_DEFAULT_TICKS 600
+//swept when no --sweep-grid is given
+#define SWEEP_DEFAULT_GRID "ai=0,1000,10000,100000"
+
+void runRenderBenchmark();
+void runResetBenchmark();
+void runAiBenchmark();
+void runNetBenchmark();
+void runFlightBenchmark();
+void runErosionBenchmark();
+void runTransformBenchmark();
+void runSpatialBenchmark();
+void runSweepPoint();
+void runSweep(int argc, char** argv);
+
+#endif /* BENCHMODES_H_ */
@@ -0,0 +1,135 @@
+/**
+ * bots.c
+ * CG flight simulator
+ * Multiplayer load generator, see bots.h.
+ * Each bot is a full client: it predicts its own pilot, decodes every
+ * snapshot and interpolates the pilots around it, so the load on the
+ * server and the per-client traffic are what a real player causes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bots.h"
+#include "client.h"
+#include "rng.h"
+#include "timer.h"
+
+//ticks given to bots to connect before measuring
+#define BOTS_CONNECT_TICKS 60
+
+/**
+ * botInput
+ * Scripted input: keeps a slowly changing turn, changes speed now and then
+ * and holds its height band, shooting in bursts.
+ */
+static void botInput(Rng* rng, const NetClient* client, PlayerInput* input,
+		float* steer) {
+	memset(input, 0, sizeof(PlayerInput));
+	if (rngBounded(rng, 60) == 0) {
+		*steer = rngFloat(rng) - 0.5f;
+	}
+	input->steerX = *steer;
+	if (rngBounded(rng, 90) == 0) {
+		input->buttons |= rngBounded(rng, 2) ? PLAYER_ACCELERATE
+				: PLAYER_DECELERATE;
+	}
+	if (client->predicted.y < 8) {
+		input->buttons |= PLAYER_MOVE_UP;
+	} else if (client->predicted.y > 30) {
+		input->buttons |= PLAYER_MOVE_DOWN;
+	}
+	if (rngBounded(rng, 100) < 20) {
+		input->buttons |= PLAYER_SHOOT;
+	}
+	if (!client->predicted.alive) {
+		input->buttons |= PLAYER_RESPAWN;
+	}
+}
+/**
+ * botsRun
+ * Connects count bots, runs them for ticks ticks after they had time to
+ * connect, then disconnects them. Returns 0 if the sockets could not be
+ * opened.
+ */
+int botsRun(const NetAddress* server, int count, int ticks, int tickMs,
+		BotStats* stats) {
+	NetClient* bots = calloc(count, sizeof(NetClient));
+	Rng* rngs = calloc(count, sizeof(Rng));
+	float* steer = calloc(count, sizeof(float));
+	double tickSeconds = tickMs / 1000.0;
+	double next, start = 0.0, busy = 0.0;
+	int opened, tick, i;
+	memset(stats, 0, sizeof(BotStats));
+	stats->bots = count;
+	if (bots == NULL || rngs == NULL || steer == NULL) {
+		free(bots);
+		free(rngs);
+		free(steer);
+		return 0;
+	}
+	for (opened = 0; opened < count; opened++) {
+		if (!clientConnect(&bots[opened], server)) {
+			break;
+		}
+		rngSeed(&rngs[opened], opened, 0xB075);
+		//spread the hellos over the connect period
+		bots[opened].ticksSinceHello = opened % 30;
+	}
+	next = timerNow();
+	for (tick = -BOTS_CONNECT_TICKS; tick < ticks && opened == count; tick++) {
+		double tickStart;
+		if (tick == 0) {
+			//count traffic from here on
+			start = timerNow();
+			for (i = 0; i < count; i++) {
+				bots[i].bytesSent = 0;
+				bots[i].bytesReceived = 0;
+				bots[i].snapshotsReceived = 0;
+				bots[i].snapshotsDropped = 0;
+			}
+		}
+		tickStart = timerNow();
+		for (i = 0; i < count; i++) {
+			PlayerInput input;
+			botInput(&rngs[i], &bots[i], &input, &steer[i]);
+			clientUpdate(&bots[i], &input);
+			clientInterpolate(&bots[i]);
+		}
+		if (tick >= 0) {
+			busy += timerNow() - tickStart;
+		}
+		next += tickSeconds;
+		timerSleep(next - timerNow());
+	}
+	stats->seconds = timerNow() - start;
+	stats->tickMean = ticks > 0 ? busy / ticks : 0.0;
+	for (i = 0; i < opened; i++) {
+		stats->connected += bots[i].connected;
+		stats->bytesSent += bots[i].bytesSent;
+		stats->bytesReceived += bots[i].bytesReceived;
+		stats->snapshotsReceived += bots[i].snapshotsReceived;
+		stats->snapshotsDropped += bots[i].snapshotsDropped;
+		clientDisconnect(&bots[i]);
+	}
+	free(bots);
+	free(rngs);
+	free(steer);
+	if (opened < count) {
+		printf("Could only open %d of %d bot sockets.\n", opened, count);
+		return 0;
+	}
+	return 1;
+}
+/**
+ * botsPrintStats
+ * Prints the traffic of a run per client.
+ */
+void botsPrintStats(const BotStats* stats) {
+	double perClient = stats->seconds * (stats->bots > 0 ? stats->bots : 1);
+	printf("Bots: %d of %d connected, down %.0f B/s, up %.0f B/s per client, "
+			"%u snapshots (%u dropped), update %.3f ms per tick\n",
+			stats->connected, stats->bots, stats->bytesReceived / perClient,
+			stats->bytesSent / perClient, stats->snapshotsReceived,
+			stats->snapshotsDropped, stats->tickMean * 1000.0);
+}
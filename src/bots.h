@@ -0,0 +1,30 @@
+/*
+ * bots.h
+ * CG flight simulator
+ * Load generator for the multiplayer server: many simulated clients in one
+ * process, flying scripted wandering input at the tick rate.
+ */
+
+#ifndef BOTS_H_
+#define BOTS_H_
+#include <stdint.h>
+#include "net.h"
+
+typedef struct BotStats {
+	int bots;
+	//bots that were welcomed by the server
+	int connected;
+	double seconds;
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint32_t snapshotsReceived;
+	uint32_t snapshotsDropped;
+	//seconds spent updating all bots per tick
+	double tickMean;
+} BotStats;
+
+int botsRun(const NetAddress* server, int count, int ticks, int tickMs,
+		BotStats* stats);
+void botsPrintStats(const BotStats* stats);
+
+#endif /* BOTS_H_ */
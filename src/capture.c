@@ -0,0 +1,438 @@
+/**
+ * capture.c
+ * CG flight simulator
+ * Frame capture, see capture.h.
+ * A buffer goes free -> reading (glReadPixels into it, fenced) -> queued
+ * (mapped and handed to the writer) -> written -> free again once the GL
+ * thread unmaps it. Only the GL thread touches GL; the writer only reads the
+ * mapped memory. Without pixel buffer objects, or with synchronous capture,
+ * frames are read straight into client memory, which waits for the GPU.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "capture.h"
+#include "glFunctions.h"
+#include "timer.h"
+
+//bytes per pixel read back, BGRA is what most drivers copy without swizzling
+#define CAPTURE_BYTES 4
+
+typedef enum SlotState {
+	SLOT_FREE,
+	SLOT_READING,
+	SLOT_QUEUED,
+	SLOT_WRITTEN
+} SlotState;
+
+typedef struct CaptureSlot {
+	GLuint buffer;
+	GLsync fence;
+	//mapped buffer, or client memory when reading synchronously
+	unsigned char* pixels;
+	unsigned int frame;
+	SlotState state;
+} CaptureSlot;
+
+static FILE* file = NULL;
+static CaptureFormat format;
+static int width;
+static int height;
+static int usePixelBuffers;
+static CaptureSlot slots[CAPTURE_BUFFERS];
+//converted frame, only used by the writer
+static unsigned char* converted = NULL;
+static size_t convertedBytes;
+static unsigned int frames;
+static unsigned int written;
+static unsigned int dropped;
+static unsigned int resized;
+static int writeFailed;
+static double captureTime;
+static double startTime;
+static double stopTime;
+
+//slots queued for the writer, in frame order
+static int queue[CAPTURE_BUFFERS];
+static int queueHead;
+static int queueCount;
+static int stopping;
+static int writerRunning = 0;
+static pthread_t writer;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+
+/**
+ * convertY4m
+ * Converts a bottom up BGRA frame to planar BT.601 YUV 4:2:0, averaging
+ * the colour of each 2x2 block.
+ */
+static void convertY4m(const unsigned char* pixels) {
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	unsigned char* yPlane = converted;
+	unsigned char* uPlane = yPlane + width * height;
+	unsigned char* vPlane = uPlane + chromaWidth * chromaHeight;
+	int x, y;
+	for (y = 0; y < height; y++) {
+		const unsigned char* row = pixels + (size_t) (height - 1 - y) * width * CAPTURE_BYTES;
+		unsigned char* out = yPlane + (size_t) y * width;
+		for (x = 0; x < width; x++) {
+			const unsigned char* p = row + x * CAPTURE_BYTES;
+			out[x] = ((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16;
+		}
+	}
+	for (y = 0; y < chromaHeight; y++) {
+		int top = height - 1 - y * 2;
+		int bottom = top > 0 ? top - 1 : top;
+		const unsigned char* rows[2];
+		rows[0] = pixels + (size_t) top * width * CAPTURE_BYTES;
+		rows[1] = pixels + (size_t) bottom * width * CAPTURE_BYTES;
+		for (x = 0; x < chromaWidth; x++) {
+			int left = x * 2 * CAPTURE_BYTES;
+			int right = x * 2 + 1 < width ? left + CAPTURE_BYTES : left;
+			int b = rows[0][left] + rows[0][right] + rows[1][left] + rows[1][right];
+			int g = rows[0][left + 1] + rows[0][right + 1] + rows[1][left + 1]
+					+ rows[1][right + 1];
+			int r = rows[0][left + 2] + rows[0][right + 2] + rows[1][left + 2]
+					+ rows[1][right + 2];
+			//sums of four, the shift by 10 also averages them
+			uPlane[y * chromaWidth + x] = ((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128;
+			vPlane[y * chromaWidth + x] = ((112 * r - 94 * g - 18 * b + 512) >> 10) + 128;
+		}
+	}
+}
+/**
+ * convertRaw
+ * Converts a bottom up BGRA frame to top down RGB24.
+ */
+static void convertRaw(const unsigned char* pixels) {
+	int x, y;
+	for (y = 0; y < height; y++) {
+		const unsigned char* row = pixels + (size_t) (height - 1 - y) * width * CAPTURE_BYTES;
+		unsigned char* out = converted + (size_t) y * width * 3;
+		for (x = 0; x < width; x++) {
+			out[x * 3] = row[x * CAPTURE_BYTES + 2];
+			out[x * 3 + 1] = row[x * CAPTURE_BYTES + 1];
+			out[x * 3 + 2] = row[x * CAPTURE_BYTES];
+		}
+	}
+}
+/**
+ * writeFrame
+ * Converts and writes one frame. After a failed write frames are only
+ * counted, so the GL thread still gets its buffers back.
+ */
+static void writeFrame(const unsigned char* pixels) {
+	if (writeFailed) {
+		return;
+	}
+	if (format == CAPTURE_Y4M) {
+		convertY4m(pixels);
+		writeFailed = fputs("FRAME\n", file) == EOF;
+	} else {
+		convertRaw(pixels);
+	}
+	writeFailed = writeFailed
+			|| fwrite(converted, 1, convertedBytes, file) != convertedBytes;
+	written += !writeFailed;
+}
+/**
+ * writerMain
+ * Writes queued frames in order until capture stops and the queue is empty.
+ */
+static void* writerMain(void* unused) {
+	(void) unused;
+	pthread_mutex_lock(&mutex);
+	while (1) {
+		CaptureSlot* slot;
+		while (queueCount == 0 && !stopping) {
+			pthread_cond_wait(&wake, &mutex);
+		}
+		if (queueCount == 0) {
+			break;
+		}
+		slot = &slots[queue[queueHead]];
+		queueHead = (queueHead + 1) % CAPTURE_BUFFERS;
+		queueCount--;
+		pthread_mutex_unlock(&mutex);
+		writeFrame(slot->pixels);
+		pthread_mutex_lock(&mutex);
+		slot->state = SLOT_WRITTEN;
+	}
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+/**
+ * queueSlot
+ * Hands a slot with its pixels in client memory to the writer.
+ */
+static void queueSlot(CaptureSlot* slot) {
+	pthread_mutex_lock(&mutex);
+	slot->state = SLOT_QUEUED;
+	queue[(queueHead + queueCount) % CAPTURE_BUFFERS] = slot - slots;
+	queueCount++;
+	pthread_cond_signal(&wake);
+	pthread_mutex_unlock(&mutex);
+}
+/**
+ * reclaimSlots
+ * Unmaps the buffers the writer is done with and frees their slots.
+ */
+static void reclaimSlots(void) {
+	int i;
+	pthread_mutex_lock(&mutex);
+	for (i = 0; i < CAPTURE_BUFFERS; i++) {
+		if (slots[i].state != SLOT_WRITTEN) {
+			continue;
+		}
+		if (usePixelBuffers) {
+			pglBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+			pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slots[i].pixels = NULL;
+		}
+		slots[i].state = SLOT_FREE;
+	}
+	pthread_mutex_unlock(&mutex);
+}
+/**
+ * oldestReading
+ * The slot with the oldest readback in flight, -1 if there is none.
+ */
+static int oldestReading(void) {
+	int oldest = -1;
+	int i;
+	for (i = 0; i < CAPTURE_BUFFERS; i++) {
+		if (slots[i].state == SLOT_READING
+				&& (oldest < 0 || slots[i].frame < slots[oldest].frame)) {
+			oldest = i;
+		}
+	}
+	return oldest;
+}
+/**
+ * mapSlot
+ * Maps a finished readback and queues it for the writer.
+ */
+static void mapSlot(CaptureSlot* slot) {
+	pglBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+	slot->pixels = pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (slot->fence != NULL) {
+		pglDeleteSync(slot->fence);
+		slot->fence = NULL;
+	}
+	if (slot->pixels == NULL) {
+		//lost mapping, the frame is gone but the buffer is still usable
+		pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		slot->state = SLOT_FREE;
+		dropped++;
+		return;
+	}
+	queueSlot(slot);
+}
+/**
+ * mapFinished
+ * Maps the readbacks at least CAPTURE_DELAY frames old, oldest first, as
+ * long as their fences say the GPU is done with them.
+ */
+static void mapFinished(void) {
+	int oldest;
+	while ((oldest = oldestReading()) >= 0
+			&& slots[oldest].frame + CAPTURE_DELAY <= frames) {
+		CaptureSlot* slot = &slots[oldest];
+		if (slot->fence != NULL && pglClientWaitSync(slot->fence, 0, 0)
+				== GL_TIMEOUT_EXPIRED) {
+			return;
+		}
+		mapSlot(slot);
+	}
+}
+/**
+ * freeSlot
+ * A slot that is free for a new frame, -1 if all of them are busy.
+ */
+static int freeSlot(void) {
+	int i;
+	for (i = 0; i < CAPTURE_BUFFERS; i++) {
+		if (slots[i].state == SLOT_FREE) {
+			return i;
+		}
+	}
+	return -1;
+}
+/**
+ * captureStart
+ * Starts capturing width x height frames to fileName, at one frame every
+ * frameMs for the Y4M header. Synchronous capture reads each frame straight
+ * into memory, as it does without pixel buffer objects. Returns 0 if the
+ * file or the writer could not be made.
+ */
+int captureStart(const char* fileName, CaptureFormat captureFormat,
+		int captureWidth, int captureHeight, int frameMs, int synchronous) {
+	size_t frameBytes = (size_t) captureWidth * captureHeight * CAPTURE_BYTES;
+	int i;
+	if (file != NULL || captureWidth <= 0 || captureHeight <= 0) {
+		return 0;
+	}
+	format = captureFormat;
+	width = captureWidth;
+	height = captureHeight;
+	usePixelBuffers = hasPixelBuffers && !synchronous;
+	convertedBytes = format == CAPTURE_Y4M ? (size_t) width * height
+			+ 2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2)
+			: (size_t) width * height * 3;
+	converted = malloc(convertedBytes);
+	file = fopen(fileName, "wb");
+	if (converted == NULL || file == NULL) {
+		captureStop();
+		return 0;
+	}
+	if (format == CAPTURE_Y4M) {
+		fprintf(file, "YUV4MPEG2 W%d H%d F1000:%d Ip A1:1 C420jpeg\n", width,
+				height, frameMs);
+	}
+	memset(slots, 0, sizeof(slots));
+	for (i = 0; i < CAPTURE_BUFFERS; i++) {
+		if (usePixelBuffers) {
+			pglGenBuffers(1, &slots[i].buffer);
+			pglBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+			pglBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+		} else {
+			slots[i].pixels = malloc(frameBytes);
+			if (slots[i].pixels == NULL) {
+				captureStop();
+				return 0;
+			}
+		}
+	}
+	if (usePixelBuffers) {
+		pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	frames = 0;
+	written = 0;
+	dropped = 0;
+	resized = 0;
+	writeFailed = 0;
+	captureTime = 0.0;
+	queueHead = 0;
+	queueCount = 0;
+	stopping = 0;
+	if (pthread_create(&writer, NULL, writerMain, NULL) != 0) {
+		captureStop();
+		return 0;
+	}
+	writerRunning = 1;
+	startTime = timerNow();
+	return 1;
+}
+/**
+ * captureActive
+ */
+int captureActive(void) {
+	return file != NULL;
+}
+/**
+ * captureFrame
+ * Reads back the frame just drawn, before the swap, and passes finished
+ * readbacks to the writer. A frame is dropped if every buffer is busy or
+ * the window is no longer the size being captured.
+ */
+void captureFrame(int frameWidth, int frameHeight) {
+	double start;
+	int available;
+	if (file == NULL) {
+		return;
+	}
+	start = timerNow();
+	reclaimSlots();
+	if (usePixelBuffers) {
+		mapFinished();
+	}
+	available = freeSlot();
+	if (frameWidth != width || frameHeight != height) {
+		resized++;
+		dropped++;
+	} else if (available < 0) {
+		dropped++;
+	} else {
+		CaptureSlot* slot = &slots[available];
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		slot->frame = frames;
+		if (usePixelBuffers) {
+			pglBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+			glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+			slot->fence = hasSync ?
+					pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : NULL;
+			slot->state = SLOT_READING;
+		} else {
+			glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE,
+					slot->pixels);
+			queueSlot(slot);
+		}
+	}
+	if (usePixelBuffers) {
+		pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	frames++;
+	captureTime += timerNow() - start;
+}
+/**
+ * captureStop
+ * Writes the readbacks still in flight, waits for the writer and closes
+ * the file.
+ */
+void captureStop(void) {
+	int oldest;
+	int i;
+	if (writerRunning) {
+		while ((oldest = oldestReading()) >= 0) {
+			mapSlot(&slots[oldest]);
+		}
+		pthread_mutex_lock(&mutex);
+		stopping = 1;
+		pthread_cond_broadcast(&wake);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(writer, NULL);
+		writerRunning = 0;
+		reclaimSlots();
+	}
+	for (i = 0; i < CAPTURE_BUFFERS; i++) {
+		if (slots[i].buffer != 0) {
+			pglDeleteBuffers(1, &slots[i].buffer);
+		} else {
+			free(slots[i].pixels);
+		}
+		if (slots[i].fence != NULL) {
+			pglDeleteSync(slots[i].fence);
+		}
+	}
+	if (usePixelBuffers) {
+		pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	memset(slots, 0, sizeof(slots));
+	if (file != NULL && fclose(file) != 0) {
+		writeFailed = 1;
+	}
+	file = NULL;
+	free(converted);
+	converted = NULL;
+	stopTime = timerNow();
+}
+/**
+ * captureReport
+ * Prints how many frames were captured, dropped and what they cost the
+ * GL thread.
+ */
+void captureReport(FILE* out) {
+	double elapsed = (file != NULL ? timerNow() : stopTime) - startTime;
+	fprintf(out, "Capture: %u frames, %u written, %u dropped (%u resized),"
+			" %s readback\n", frames, written, dropped, resized,
+			usePixelBuffers ? "pixel buffer" : "synchronous");
+	fprintf(out, "Capture: %.3f ms per frame on the GL thread, %.1f frames/s"
+			" written\n", frames > 0 ? captureTime * 1000.0 / frames : 0.0,
+			elapsed > 0 ? written / elapsed : 0.0);
+	if (writeFailed) {
+		fprintf(out, "Capture: writing the file failed, later frames were lost\n");
+	}
+}
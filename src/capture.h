@@ -0,0 +1,35 @@
+/*
+ * capture.h
+ * CG flight simulator
+ * Frame capture to a Y4M or raw video file.
+ * Each frame is read back into one of a few pixel buffer objects and only
+ * mapped CAPTURE_DELAY frames later, once the GPU is done with it, so the
+ * read never stalls the frame. A writer thread converts and writes the
+ * mapped frames; when it falls behind every buffer is busy and new frames
+ * are dropped instead of queueing more memory.
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+#include <stdio.h>
+
+//readbacks in flight or waiting for the writer
+#define CAPTURE_BUFFERS 4
+//frames between reading a buffer back and mapping it
+#define CAPTURE_DELAY 2
+
+typedef enum CaptureFormat {
+	//YUV 4:2:0 in a YUV4MPEG2 stream, plays in most tools
+	CAPTURE_Y4M,
+	//headerless top down RGB24 frames
+	CAPTURE_RAW
+} CaptureFormat;
+
+int captureStart(const char* fileName, CaptureFormat format, int width,
+		int height, int frameMs, int synchronous);
+void captureFrame(int width, int height);
+int captureActive(void);
+void captureStop(void);
+void captureReport(FILE* out);
+
+#endif /* CAPTURE_H_ */
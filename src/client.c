@@ -0,0 +1,302 @@
+/**
+ * client.c
+ * CG flight simulator
+ * Multiplayer client connection, see client.h.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "client.h"
+
+//ticks between hellos while waiting for the welcome
+#define CLIENT_HELLO_INTERVAL 30
+
+/**
+ * clientConnect
+ * Opens a socket and starts connecting. Returns 0 on failure.
+ */
+int clientConnect(NetClient* client, const NetAddress* server) {
+	int i;
+	memset(client, 0, sizeof(NetClient));
+	if (!netInit()) {
+		return 0;
+	}
+	client->socket = netOpen(0);
+	if (client->socket < 0) {
+		return 0;
+	}
+	client->server = *server;
+	client->ticksSinceHello = CLIENT_HELLO_INTERVAL;
+	for (i = 0; i < NET_HISTORY; i++) {
+		client->snapshots[i].tick = UINT32_MAX;
+	}
+	return 1;
+}
+/**
+ * sendPacket
+ */
+static void sendPacket(NetClient* client, const PacketWriter* writer) {
+	if (netSend(client->socket, &client->server, writer->data, writer->size) > 0) {
+		client->bytesSent += writer->size;
+	}
+}
+/**
+ * predictStep
+ * Applies one input to the predicted pilot like the server does.
+ */
+static void predictStep(NetClient* client, const PlayerInput* input) {
+	if (input->buttons & PLAYER_RESPAWN) {
+		playerSpawn(&client->predicted, client->id);
+	}
+	playerStep(&client->predicted, input);
+}
+/**
+ * snapshotSlot
+ */
+static Snapshot* snapshotSlot(NetClient* client, uint32_t tick) {
+	return &client->snapshots[(tick / NET_SNAPSHOT_INTERVAL) % NET_HISTORY];
+}
+/**
+ * reconcile
+ * Restarts the prediction from the server's state of the own pilot and
+ * replays the inputs sent since.
+ */
+static void reconcile(NetClient* client, const Snapshot* snapshot) {
+	uint32_t sequence;
+	int i;
+	for (i = 0; i < snapshot->count; i++) {
+		if (snapshot->entities[i].id == client->id) {
+			break;
+		}
+	}
+	if (i == snapshot->count) {
+		return;
+	}
+	entityDequantise(&snapshot->entities[i], &client->predicted);
+	client->hasPredicted = 1;
+	if (client->inputSequence - snapshot->inputAck >= CLIENT_INPUT_HISTORY) {
+		return;
+	}
+	for (sequence = snapshot->inputAck + 1; sequence <= client->inputSequence;
+			sequence++) {
+		predictStep(client, &client->inputs[sequence % CLIENT_INPUT_HISTORY]);
+	}
+}
+/**
+ * receiveSnapshot
+ * Decodes a snapshot against its base and keeps it. Snapshots whose base
+ * is no longer held are dropped, the server falls back to a full snapshot
+ * once acknowledgements stop arriving.
+ */
+static void receiveSnapshot(NetClient* client, PacketReader* reader) {
+	Snapshot decoded;
+	const Snapshot* base = NULL;
+	uint32_t baseTick = snapshotBaseTick(reader);
+	PacketReader peek = *reader;
+	uint32_t tick = packetReadUnsigned(&peek, 4);
+	if (baseTick != tick) {
+		base = snapshotSlot(client, baseTick);
+		if (base->tick != baseTick) {
+			client->snapshotsDropped++;
+			return;
+		}
+	}
+	if (!snapshotRead(reader, &decoded, base)) {
+		client->snapshotsDropped++;
+		return;
+	}
+	client->snapshotsReceived++;
+	*snapshotSlot(client, decoded.tick) = decoded;
+	if (!client->hasSnapshot || decoded.tick > client->newestTick) {
+		client->newestTick = decoded.tick;
+		client->hasSnapshot = 1;
+		reconcile(client, &decoded);
+	}
+}
+/**
+ * receivePackets
+ */
+static void receivePackets(NetClient* client) {
+	uint8_t data[NET_MAX_PACKET];
+	NetAddress address;
+	PacketReader reader;
+	int size;
+	while ((size = netReceive(client->socket, &address, data, sizeof(data))) >= 0) {
+		if (!netAddressEqual(&address, &client->server)) {
+			continue;
+		}
+		client->bytesReceived += size;
+		switch (packetOpen(&reader, data, size)) {
+		case PACKET_WELCOME:
+			if (!client->connected) {
+				client->id = packetReadUnsigned(&reader, 2);
+				client->seed = packetReadUnsigned(&reader, 4);
+				client->renderTick = (float) packetReadUnsigned(&reader, 4)
+						- CLIENT_INTERPOLATION_DELAY;
+				client->connected = reader.error == 0;
+				playerSpawn(&client->predicted, client->id);
+			}
+			break;
+		case PACKET_SNAPSHOT:
+			if (client->connected) {
+				receiveSnapshot(client, &reader);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+/**
+ * sendInput
+ * Sends the newest inputs, repeating a few older ones in case of loss.
+ */
+static void sendInput(NetClient* client) {
+	PacketWriter writer;
+	uint32_t first = client->inputSequence >= NET_INPUT_REDUNDANCY
+			? client->inputSequence - NET_INPUT_REDUNDANCY + 1 : 1;
+	uint32_t sequence;
+	packetBegin(&writer, PACKET_INPUT);
+	packetWriteUnsigned(&writer, client->id, 2);
+	packetWriteUnsigned(&writer, client->hasSnapshot ? client->newestTick : 0, 4);
+	packetWriteUnsigned(&writer, first, 4);
+	packetWriteUnsigned(&writer, client->inputSequence - first + 1, 1);
+	for (sequence = first; sequence <= client->inputSequence; sequence++) {
+		const PlayerInput* input = &client->inputs[sequence % CLIENT_INPUT_HISTORY];
+		packetWriteUnsigned(&writer, input->buttons, 1);
+		packetWriteUnsigned(&writer, (uint8_t) (int8_t) lrintf(input->steerX * 254), 1);
+		packetWriteUnsigned(&writer, (uint8_t) (int8_t) lrintf(input->steerY * 254), 1);
+		packetWriteUnsigned(&writer, (uint8_t) input->wheel, 1);
+	}
+	sendPacket(client, &writer);
+}
+/**
+ * clientUpdate
+ * Runs one client tick: handles received packets, then sends and predicts
+ * this tick's input. Until connected it only repeats the hello.
+ */
+void clientUpdate(NetClient* client, const PlayerInput* input) {
+	PlayerInput* stored;
+	float target;
+	receivePackets(client);
+	if (!client->connected) {
+		if (++client->ticksSinceHello >= CLIENT_HELLO_INTERVAL) {
+			PacketWriter writer;
+			packetBegin(&writer, PACKET_HELLO);
+			packetWriteUnsigned(&writer, NET_PROTOCOL_VERSION, 1);
+			sendPacket(client, &writer);
+			client->ticksSinceHello = 0;
+		}
+		return;
+	}
+	client->inputSequence++;
+	stored = &client->inputs[client->inputSequence % CLIENT_INPUT_HISTORY];
+	*stored = *input;
+	//steering goes over the wire in 1/254 steps, predict with what the server gets
+	stored->steerX = (int8_t) lrintf(input->steerX * 254) / 254.0f;
+	stored->steerY = (int8_t) lrintf(input->steerY * 254) / 254.0f;
+	stored->sequence = client->inputSequence;
+	sendInput(client);
+	predictStep(client, stored);
+
+	//keep the render time a fixed delay behind the newest snapshot
+	client->renderTick += 1.0f;
+	if (client->hasSnapshot) {
+		target = (float) client->newestTick - CLIENT_INTERPOLATION_DELAY;
+		if (fabsf(client->renderTick - target) > 8 * NET_SNAPSHOT_INTERVAL) {
+			client->renderTick = target;
+		} else {
+			client->renderTick += (target - client->renderTick) * 0.05f;
+		}
+	}
+}
+/**
+ * findEntity
+ */
+static const EntityState* findEntity(const Snapshot* snapshot, uint16_t id) {
+	int i;
+	for (i = 0; i < snapshot->count; i++) {
+		if (snapshot->entities[i].id == id) {
+			return &snapshot->entities[i];
+		}
+	}
+	return NULL;
+}
+/**
+ * clientInterpolate
+ * Fills the remote arrays with the other living pilots at renderTick.
+ */
+void clientInterpolate(NetClient* client) {
+	const Snapshot* before = NULL;
+	const Snapshot* after = NULL;
+	float t = 0.0f;
+	int i;
+	client->numRemote = 0;
+	for (i = 0; i < NET_HISTORY; i++) {
+		const Snapshot* snapshot = &client->snapshots[i];
+		if (snapshot->tick == UINT32_MAX
+				|| snapshot->tick + NET_HISTORY * NET_SNAPSHOT_INTERVAL
+						<= client->newestTick) {
+			continue;
+		}
+		if (snapshot->tick <= client->renderTick) {
+			if (before == NULL || snapshot->tick > before->tick) {
+				before = snapshot;
+			}
+		} else if (after == NULL || snapshot->tick < after->tick) {
+			after = snapshot;
+		}
+	}
+	if (before == NULL && after == NULL) {
+		return;
+	}
+	if (before != NULL && after != NULL) {
+		t = (client->renderTick - before->tick) / (after->tick - before->tick);
+	} else if (after == NULL) {
+		//no newer snapshot yet, hold the last one
+		after = before;
+	}
+	for (i = 0; i < after->count; i++) {
+		const EntityState* next = &after->entities[i];
+		const EntityState* previous = before != NULL
+				? findEntity(before, next->id) : NULL;
+		PlayerState a, b;
+		float turn;
+		int n = client->numRemote;
+		if (next->id == client->id || (next->flags & 1) == 0) {
+			continue;
+		}
+		entityDequantise(next, &b);
+		a = b;
+		if (previous != NULL) {
+			entityDequantise(previous, &a);
+		}
+		//shortest way round
+		turn = remainderf(b.rotation - a.rotation, 2.0f * M_PI);
+		client->remoteX[n] = a.x + (b.x - a.x) * t;
+		client->remoteY[n] = a.y + (b.y - a.y) * t;
+		client->remoteZ[n] = a.z + (b.z - a.z) * t;
+		client->remoteDirX[n] = sinf(a.rotation + turn * t);
+		client->remoteDirZ[n] = cosf(a.rotation + turn * t);
+		client->remoteBank[n] = (a.tilt + (b.tilt - a.tilt) * t) * M_PI / 180.0f;
+		client->numRemote++;
+	}
+}
+/**
+ * clientDisconnect
+ * Tells the server the client is leaving and closes the socket.
+ */
+void clientDisconnect(NetClient* client) {
+	PacketWriter writer;
+	if (client->socket < 0) {
+		return;
+	}
+	if (client->connected) {
+		packetBegin(&writer, PACKET_BYE);
+		packetWriteUnsigned(&writer, client->id, 2);
+		sendPacket(client, &writer);
+	}
+	netClose(client->socket);
+	client->socket = -1;
+	client->connected = 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * client.h
+ * CG flight simulator
+ * Multiplayer client connection.
+ * Sends one input per tick, predicts its own pilot with the same step the
+ * server runs and corrects the prediction from each snapshot by replaying
+ * the inputs the server has not applied yet. Other pilots are drawn a few
+ * ticks in the past, interpolated between the two snapshots around that
+ * time. Clients are plain structures so one process can run many bots.
+ */
+
+#ifndef CLIENT_H_
+#define CLIENT_H_
+#include <stdint.h>
+#include "snapshot.h"
+
+#define CLIENT_INPUT_HISTORY 128
+//how far behind the newest snapshot other pilots are drawn
+#define CLIENT_INTERPOLATION_DELAY (2 * NET_SNAPSHOT_INTERVAL)
+
+typedef struct NetClient {
+	int socket;
+	NetAddress server;
+	int connected;
+	uint16_t id;
+	uint32_t seed;
+	int ticksSinceHello;
+	uint32_t inputSequence;
+	PlayerInput inputs[CLIENT_INPUT_HISTORY];
+	//received snapshots, also the delta bases
+	Snapshot snapshots[NET_HISTORY];
+	uint32_t newestTick;
+	int hasSnapshot;
+	//server tick other pilots are drawn at
+	float renderTick;
+	//own pilot, valid once hasPredicted is set
+	PlayerState predicted;
+	int hasPredicted;
+	//other pilots at renderTick, as arrays for the aircraft renderer
+	int numRemote;
+	float remoteX[NET_MAX_VISIBLE];
+	float remoteY[NET_MAX_VISIBLE];
+	float remoteZ[NET_MAX_VISIBLE];
+	float remoteDirX[NET_MAX_VISIBLE];
+	float remoteDirZ[NET_MAX_VISIBLE];
+	float remoteBank[NET_MAX_VISIBLE];
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint32_t snapshotsReceived;
+	uint32_t snapshotsDropped;
+} NetClient;
+
+int clientConnect(NetClient* client, const NetAddress* server);
+void clientUpdate(NetClient* client, const PlayerInput* input);
+void clientInterpolate(NetClient* client);
+void clientDisconnect(NetClient* client);
+
+#endif /* CLIENT_H_ */
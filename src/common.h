@@ -7,9 +7,14 @@
 #ifndef COMMON_H_
 #define COMMON_H_
 
+//the knobs below are set from config by applyConfig, see config.h
+Config config;
 const GLfloat seaDetailAccuracy = 100.0f;
-GLuint mountainDetailAccuracy = 81;
-const GLfloat gridSize = 200.0f;
+GLuint mountainDetailAccuracy = CONFIG_DEFAULT_MAP_SIZE;
+GLint numIslands = TERRAIN_ISLANDS;
+GLfloat gridSize = CONFIG_DEFAULT_GRID_SIZE;
+GLint seaSlices = CONFIG_DEFAULT_SEA_SLICES;
+GLint skySlices = CONFIG_DEFAULT_SKY_SLICES;
 GLint appWidth = 1600;
 GLint appHeight = 900;
 //used to return to previous size when exiting fullscreen
@@ -21,57 +26,178 @@ int appX = 100;
 int appY = 100;
 GLfloat nearValue = 0.1f;
 GLfloat farValue = 100000.0f;
-GLfloat universeTime = 0.0f;
 GLfloat delta = 1.0f;
-GLfloat explosionScale=1.0f;
-GLuint exploding=0;
 GLint fov = 60;
 GLfloat originalFogDensity = 0.005f;
+//frame timings shown on the HUD (seconds, smoothed)
+double lastFrameTime = 0.0;
+GLfloat frameInterval = 0.015f;
+GLfloat frameWorkTime = 0.0f;
+//camera matrices of the current frame, used to place HUD markers
+GLdouble cameraModelview[16];
+GLdouble cameraProjection[16];
+GLint cameraViewport[4];
 
-GLint lastMouseX;
-GLint lastMouseY;
-GLuint alive = 1;
-GLdouble eyeX = 0;
-GLdouble eyeY = 5;
-GLdouble eyeZ = -15;
-GLdouble atX = 0;
-GLdouble atY = 5;
-GLdouble atZ = -5;
+//input recording and replay
+GLint tickMs = WORLD_TICK_MS;
+char* recordFileName = NULL;
+char* replayFileName = NULL;
+//--check-replay records a scripted flight this many ticks long
+char* checkReplayFileName = NULL;
+#define REPLAY_CHECK_TICKS 900
+GLint headless = 0;
+GLint replayDone = 0;
+double replayStartTime = 0.0;
+unsigned int simTick = 0;
+unsigned int worldSeed = 0;
+//offscreen rendering benchmark
+GLint benchRender = 0;
+GLint benchRenderWidth = 1600;
+GLint benchRenderHeight = 900;
+GLint benchFramesPerPath = 60;
+//world resets timed by --bench-reset
+GLint benchResets = 0;
+char* benchOutputFile = "bench_render.json";
+GLint fixedSeed = 0;
+//AI aircraft, updated on the worker threads
+GLint benchAiCount = 0;
+//ticks timed by the AI, flight and network benchmarks, 0 for their defaults
+GLint benchTicks = 0;
+GLint numThreads = 0;
+//aircraft models, level 0 is the full model, see loadMeshLods
+Mesh planeLods[MODEL_LODS];
+Mesh propellerLods[MODEL_LODS];
+//multiplayer
+GLint serverMode = 0;
+char* connectHost = NULL;
+GLint netPort = NET_DEFAULT_PORT;
+GLint botCount = 0;
+GLint benchNetCount = 0;
+GLint networked = 0;
+NetClient netClient;
+//input that only takes effect through the next network tick
+GLint wheelSteps = 0;
+GLint respawnRequested = 0;
+//downstream traffic shown on the HUD
+GLfloat netDownRate = 0.0f;
+double netRateTime = 0.0;
+unsigned long long netRateBytes = 0;
+//flight model benchmark
+GLint benchFlight = 0;
+//headless worlds flown by --batch
+GLint batchWorlds = 0;
+//write the aircraft level of detail models and quit
+GLint buildLods = 0;
+//droplets per island height map cell, 0 leaves the islands uneroded
+float erosionDroplets = 0.0f;
+//directory of the world cache, NULL to always generate
+char* worldCacheDir = NULL;
+//time the transform hierarchy of this many aircraft and quit
+GLint benchTransformCount = 0;
+//time island erosion at growing map sizes and quit
+GLint benchErosion = 0;
+//frame capture to a Y4M (or raw RGB24) file, read back without stalls
+//unless captureSync is set
+char* captureFileName = NULL;
+GLint captureRaw = 0;
+GLint captureSync = 0;
+//radar in world units and the most blips it shows
+#define RADAR_RANGE 300.0f
+#define RADAR_BLIPS 64
+//time the spatial hash at growing entity counts and quit
+GLint benchSpatial = 0;
+//print the configuration in effect and quit
+GLint printConfig = 0;
+//scaling sweep: a CSV row for every point of the grid of --sweep-grid
+//settings, each measured in a child process run with --sweep-point
+char* sweepFileName = NULL;
+char* sweepGrid[SWEEP_MAX_KEYS];
+GLint sweepKeys = 0;
+GLint sweepPoint = 0;
+//shared memory telemetry, published by the sim or followed by the tail
+GLint telemetryEnabled = 0;
+GLint telemetryTail = 0;
+//records per line printed by the tail
+#define TELEMETRY_TAIL_EVERY 60
+//input to present latency measurement of this many synthetic inputs
+GLint latencyEvents = 0;
+char* latencyOutputFile = NULL;
+//time between synthetic inputs, milliseconds
+#define LATENCY_INJECT_MIN_MS 20
+#define LATENCY_INJECT_MAX_MS 120
+Rng latencyRng;
+//the simulated world and the input it reads, the mouse coordinates refer
+//to a window of sim.inputWidth x sim.inputHeight
+World world;
+SimContext sim = { .inputWidth = 1600, .inputHeight = 900 };
 
 GLint toggleWireframe = 0;
 GLint toggleFullscreen = 0;
 GLint toggleFog = 1;
 GLint toggleGrid = 0;
 GLint toggleMountains = 1;
-GLint toggleAltControls = 0;
 GLint toggleAltWeather = 0;
 GLint toggleMountainTextures = 1;
 
-GLint boolAccelerate = 0;
-GLint boolDeaccelerate = 0;
-GLint boolMoveUp = 0;
-GLint boolMoveDown = 0;
-GLint boolShoot=0;
-GLfloat planeSpeed = 1.0f;
-GLfloat planeMaxSpeed = 4.0f;
-GLfloat planeMinSpeed = 1.0f;
-GLfloat planeAcc = 0.2f;
-GLfloat propellerAcc = 1.01;
-GLfloat planeDeacc = 0.1f;
-GLfloat planeRotation = 0.0f;
-GLfloat planeYawRotation = 0.0f;
-GLfloat planeTilt = 0.0f;
-GLfloat propellerSpeed = -8.0f;
-
-GLfloat planeRiseSpeed = 0.2f;
-GLfloat planeFallSpeed = 0.2f;
 GLfloat propRotation=0.0f;
-GLuint axisId;
-GLuint planeId;
-GLuint propId;
-GLuint targetId;
+//the player's plane and propeller, batched by material
+IndexedMesh planeModel;
+IndexedMesh propModel;
+//transforms of what is drawn, see initScene
+TransformTree scene;
+int islandNodes[TERRAIN_MAX_ISLANDS];
+//the plane, its model space (the meshes' nose along x) and its propellers
+int planeNode;
+int planeModelNode;
+int propNodes[2];
+//where each propeller turns, in model space
+Vec3 propellerHubs[2];
+//the camera's view matrix in the view being drawn, and what it sees
+Mat4 viewMatrix;
+Frustum viewFrustum;
+//layout of the views in the window, and whether the view being drawn is
+//fogged, the map is not
+GLint viewLayoutIndex = VIEW_LAYOUT_CHASE;
+GLint viewFog = 1;
+//shells of the explosion this frame, each view draws the same ones
+#define EXPLOSION_SHELLS 10
+int explosionShells = 0;
+float explosionScales[EXPLOSION_SHELLS];
+float explosionAngles[EXPLOSION_SHELLS];
+Rng explosionJitter[EXPLOSION_SHELLS];
+//scratch memory for buffers that only live while a frame or a load needs
+//them, reset every frame
+Arena frameArena;
 
-GLuint mountainId;
+//islands as quads of 4 vertices, laid out as MOUNTAIN_VERTEX_FLOATS says
+GLfloat* mountainVertices = NULL;
+GLuint* mountainIndices = NULL;
+//map size and island count the island arrays and buffers are allocated for
+int mountainMapSize = 0;
+int mountainIslandCount = 0;
+GLuint mountainBuffer = 0;
+GLuint mountainIndexBuffer = 0;
+//first index and index count of each terrain level of detail, one after
+//another in mountainIndices
+int mountainLodFirst[GOVERNOR_TERRAIN_LODS];
+int mountainLodCount[GOVERNOR_TERRAIN_LODS];
+//copies of the islands scattered over the sea, and the draws they took
+//last frame
+Archipelago archipelago;
+GLint archipelagoCount = 0;
+int archipelagoDraws = 0;
+//the minimap is drawn again every minimapRate frames, or sooner when
+//something comes or goes, 0 for no minimap. Its terrain layer is drawn
+//again once the islands are placed
+GLint minimapRate = MINIMAP_DEFAULT_RATE;
+int minimapReady = 0;
+int minimapTerrainDirty = 1;
+int minimapFrames = 0;
+int minimapShownCount = -1;
+//holds frames to its budget when that is over 0 by scaling the resolution
+//and the quality level the scene is drawn at
+Governor governor;
+int qualityLevel = 0;
 GLuint gridId;
 GLuint seaId;
 GLuint skyId;
@@ -98,6 +224,10 @@ GLfloat red[] = { 1.0, 0.0, 0.0, 1.0 };
 GLfloat black[] = { 0.0, 0.0, 0.0, 1.0 };
 GLfloat blue[] = { 0.0, 0.0, 0.8, 1.0 };
 GLfloat purple[] = { 0.7, 0.5, 0.9, 1.0 };
+GLfloat renderingOptions[] = { GL_FILL, GL_LINE };
+GLUquadricObj *seaObj;
+GLUquadricObj *skyObj;
+GLUquadricObj *mountainObj;
 typedef struct Point {
 	float x;
 	float y;
@@ -108,24 +238,6 @@ typedef struct Point {
 } Point;
 
 Point calcNormal(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3);
-void calcVertexNormal(float map[mountainDetailAccuracy][mountainDetailAccuracy], float jitterX[mountainDetailAccuracy][mountainDetailAccuracy], float jitterZ[mountainDetailAccuracy][mountainDetailAccuracy],int x, int z);
-void raiseMountain(float map[mountainDetailAccuracy][mountainDetailAccuracy], int left, int right, int top, int bottom, int iteration);
-
-
-typedef struct Bullet Bullet;
-struct Bullet {
-	float x;
-	float y;
-	float z;
-	float rotation;
-	float yaw;
-	Bullet* nextBullet;
-};
-Bullet* firstBullet;
-Bullet* currBullet;
-GLuint numBullets;
-GLuint currentBullet;
-GLuint maxNumBullets;
-GLfloat targetScale;
-GLfloat bulletSpeed=4.0f;
+void calcVertexNormal(const Island* island, int mapSize, int x, int z, GLfloat normal[3]);
+void calcIslandNormals(const Island* island, int mapSize, GLfloat* normals);
 #endif /* COMMON_H_ */
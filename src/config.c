@@ -0,0 +1,195 @@
+/**
+ * config.c
+ * CG flight simulator
+ * Runtime configuration, see config.h.
+ * Every key is described once in a table, which the file parser, the
+ * command line overrides and configWrite all go through.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include "config.h"
+#include "terrain.h"
+#include "world.h"
+#include "view.h"
+#include "minimap.h"
+
+#define CONFIG_LINE 256
+
+typedef struct ConfigKey {
+	const char* name;
+	int isFloat;
+	size_t offset;
+	double min;
+	double max;
+	const char* description;
+} ConfigKey;
+
+static const ConfigKey keys[] = {
+	{ "map_size", 0, offsetof(Config, mapSize), 9, 4097,
+			"height map cells along each island" },
+	{ "islands", 0, offsetof(Config, islands), 1, TERRAIN_MAX_ISLANDS,
+			"islands in each world" },
+	{ "max_bullets", 0, offsetof(Config, maxBullets), 1, 1000000,
+			"bullets in flight before the oldest is dropped" },
+	{ "bullet_speed", 1, offsetof(Config, bulletSpeed), 0.01, 1000,
+			"world units a bullet flies each tick" },
+	{ "grid_size", 0, offsetof(Config, gridSize), 1, 4000,
+			"cells along each side of the grid" },
+	{ "sea_slices", 0, offsetof(Config, seaSlices), 3, 4096,
+			"slices and rings of the sea" },
+	{ "sky_slices", 0, offsetof(Config, skySlices), 3, 4096,
+			"slices and stacks of the sky" },
+	{ "tick_ms", 0, offsetof(Config, tickMs), 1, 1000,
+			"length of a tick in milliseconds" },
+	{ "ai", 0, offsetof(Config, aiCount), 0, 10000000,
+			"AI aircraft in each world" },
+	{ "erosion", 1, offsetof(Config, erosion), 0, 1000,
+			"erosion droplets per island cell, 0 for none" },
+	{ "threads", 0, offsetof(Config, threads), 0, 1024,
+			"worker threads including the main one, 0 for one per core" },
+	{ "texture_budget", 0, offsetof(Config, textureBudgetKb), 0, 16777216,
+			"KB of GL memory the textures may take, 0 for no limit" },
+	{ "archipelago", 0, offsetof(Config, archipelago), 0, 100000,
+			"copies of the islands scattered over the sea, 0 for none" },
+	{ "views", 0, offsetof(Config, views), 0, VIEW_LAYOUT_COUNT - 1,
+			"views in the window: chase, split, mirror, map or all, 0 to 4" },
+	{ "minimap", 0, offsetof(Config, minimap), 0, 1000,
+			"frames between minimap refreshes, 0 for no minimap" },
+	{ "frame_budget", 1, offsetof(Config, frameBudgetMs), 0, 1000,
+			"milliseconds a frame the governor holds to, 0 for no governor" }
+};
+
+#define NUM_KEYS ((int) (sizeof(keys) / sizeof(keys[0])))
+
+/**
+ * configDefaults
+ */
+void configDefaults(Config* config) {
+	config->mapSize = CONFIG_DEFAULT_MAP_SIZE;
+	config->islands = TERRAIN_ISLANDS;
+	config->maxBullets = WORLD_MAX_BULLETS;
+	config->bulletSpeed = WORLD_BULLET_SPEED;
+	config->gridSize = CONFIG_DEFAULT_GRID_SIZE;
+	config->seaSlices = CONFIG_DEFAULT_SEA_SLICES;
+	config->skySlices = CONFIG_DEFAULT_SKY_SLICES;
+	config->tickMs = WORLD_TICK_MS;
+	config->aiCount = 0;
+	config->erosion = 0.0f;
+	config->threads = 0;
+	config->textureBudgetKb = 0;
+	config->archipelago = 0;
+	config->views = VIEW_LAYOUT_CHASE;
+	config->minimap = MINIMAP_DEFAULT_RATE;
+	config->frameBudgetMs = 0.0f;
+}
+/**
+ * configSet
+ * Sets one key from its text, clamped to the key's range. Returns 0 and
+ * says why if the key is unknown or the value is not a number.
+ */
+int configSet(Config* config, const char* key, const char* value) {
+	char* end;
+	double number;
+	int i;
+	for (i = 0; i < NUM_KEYS; i++) {
+		if (strcmp(keys[i].name, key) == 0) {
+			break;
+		}
+	}
+	if (i == NUM_KEYS) {
+		printf("Unknown setting %s.\n", key);
+		return 0;
+	}
+	number = strtod(value, &end);
+	while (isspace((unsigned char) *end)) {
+		end++;
+	}
+	if (end == value || *end != '\0' || number != number) {
+		printf("Setting %s needs a number, not \"%s\".\n", key, value);
+		return 0;
+	}
+	number = number < keys[i].min ? keys[i].min : number;
+	number = number > keys[i].max ? keys[i].max : number;
+	if (keys[i].isFloat) {
+		*(float*) ((char*) config + keys[i].offset) = (float) number;
+	} else {
+		*(int*) ((char*) config + keys[i].offset) = (int) number;
+	}
+	return 1;
+}
+/**
+ * trim
+ * Cuts the spaces off both ends of a string in place.
+ */
+static char* trim(char* text) {
+	char* end = text + strlen(text);
+	while (isspace((unsigned char) *text)) {
+		text++;
+	}
+	while (end > text && isspace((unsigned char) end[-1])) {
+		end--;
+	}
+	*end = '\0';
+	return text;
+}
+/**
+ * configLoad
+ * Reads "key = value" lines over config. Blank lines and anything after a
+ * # are ignored. Returns 0 and says where if the file cannot be read or a
+ * line is wrong, the keys before it are set.
+ */
+int configLoad(Config* config, const char* fileName) {
+	char line[CONFIG_LINE];
+	FILE* file = fopen(fileName, "r");
+	int number = 0;
+	int ok = 1;
+	if (file == NULL) {
+		printf("Could not open the config file %s.\n", fileName);
+		return 0;
+	}
+	while (ok && fgets(line, sizeof(line), file) != NULL) {
+		char* comment = strchr(line, '#');
+		char* equals;
+		char* key;
+		number++;
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		key = trim(line);
+		if (*key == '\0') {
+			continue;
+		}
+		equals = strchr(key, '=');
+		if (equals == NULL) {
+			printf("%s:%d: expected key = value.\n", fileName, number);
+			ok = 0;
+			continue;
+		}
+		*equals = '\0';
+		if (!configSet(config, trim(key), trim(equals + 1))) {
+			printf("%s:%d: in this line.\n", fileName, number);
+			ok = 0;
+		}
+	}
+	fclose(file);
+	return ok;
+}
+/**
+ * configWrite
+ * Writes every key in the format configLoad reads, with what it does.
+ */
+void configWrite(const Config* config, FILE* file) {
+	int i;
+	for (i = 0; i < NUM_KEYS; i++) {
+		const char* value = (const char*) config + keys[i].offset;
+		fprintf(file, "# %s\n", keys[i].description);
+		if (keys[i].isFloat) {
+			fprintf(file, "%s = %g\n", keys[i].name, *(const float*) value);
+		} else {
+			fprintf(file, "%s = %d\n", keys[i].name, *(const int*) value);
+		}
+	}
+}
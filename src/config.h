@@ -0,0 +1,56 @@
+/*
+ * config.h
+ * CG flight simulator
+ * Runtime configuration of the knobs that decide what the sim and the
+ * renderer cost. Values come from the defaults, then a file of
+ * "key = value" lines, then the command line, each overriding the last.
+ * Values out of a key's range are clamped to it.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+#include <stdio.h>
+
+#define CONFIG_DEFAULT_MAP_SIZE 81
+#define CONFIG_DEFAULT_GRID_SIZE 200
+#define CONFIG_DEFAULT_SEA_SLICES 64
+#define CONFIG_DEFAULT_SKY_SLICES 100
+
+typedef struct Config {
+	//height map cells along each island, and the number of islands
+	int mapSize;
+	int islands;
+	//bullets in flight before the oldest is dropped, world units per tick
+	int maxBullets;
+	float bulletSpeed;
+	//cells along each side of the grid shown instead of the sea and sky
+	int gridSize;
+	//slices and rings of the sea disk, slices and stacks of the sky
+	int seaSlices;
+	int skySlices;
+	//length of a tick, replays use the one they were recorded with
+	int tickMs;
+	int aiCount;
+	//erosion droplets per island cell, 0 for none
+	float erosion;
+	//worker threads including the main one, 0 for one per core
+	int threads;
+	//KB the textures may take in GL, 0 for no limit
+	int textureBudgetKb;
+	//copies of the islands scattered over the sea, 0 for none
+	int archipelago;
+	//layout of the views in the window, see ViewLayout
+	int views;
+	//frames between minimap refreshes, 0 for no minimap
+	int minimap;
+	//milliseconds a frame the governor holds to by scaling the resolution
+	//and detail down, 0 for no governor
+	float frameBudgetMs;
+} Config;
+
+void configDefaults(Config* config);
+int configSet(Config* config, const char* key, const char* value);
+int configLoad(Config* config, const char* fileName);
+void configWrite(const Config* config, FILE* file);
+
+#endif /* CONFIG_H_ */
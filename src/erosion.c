@@ -0,0 +1,489 @@
+/**
+ * erosion.c
+ * CG flight simulator
+ * Island erosion, see erosion.h.
+ * Each droplet pass cuts every island into tiles of EROSION_TILE cells and
+ * colors them in a 2x2 pattern. A droplet starts in its tile and dies before
+ * it gets more than half a tile out of it, so two tiles of the same color
+ * never touch the same cell: the four colors run one after another, the
+ * tiles of a color in parallel, each with its own random stream. The grid
+ * moves between passes so the tile edges do not show. Thermal steps read
+ * one copy of the map and write another, so rows can run in any order too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "erosion.h"
+#include "jobs.h"
+
+//droplet passes, each on its own tile grid
+#define EROSION_PASSES 4
+#define EROSION_TILE 32
+//cells a droplet erodes around it
+#define EROSION_RADIUS 2
+#define EROSION_BRUSH ((EROSION_RADIUS * 2 + 1) * (EROSION_RADIUS * 2 + 1))
+#define EROSION_MAX_STEPS 32
+//how much a droplet keeps its direction instead of following the slope
+#define EROSION_INERTIA 0.1f
+//sediment a droplet carries per unit of drop, speed and water
+#define EROSION_CAPACITY 4.0f
+//drop used for the capacity on flat ground, so droplets still carry some
+#define EROSION_MIN_SLOPE 0.01f
+//shares of the capacity difference eroded or deposited per step
+#define EROSION_ERODE 0.3f
+#define EROSION_DEPOSIT 0.3f
+#define EROSION_EVAPORATE 0.02f
+#define EROSION_GRAVITY 4.0f
+//height difference to a neighbour thermal steps leave alone
+#define EROSION_TALUS 0.6f
+//share of the difference over the talus moved per neighbour and step
+#define EROSION_THERMAL_RATE 0.1f
+#define EROSION_THERMAL_STEPS 2
+//rows per thermal job
+#define EROSION_THERMAL_GRAIN 16
+
+typedef struct Brush {
+	int dx[EROSION_BRUSH];
+	int dz[EROSION_BRUSH];
+	float weight[EROSION_BRUSH];
+	int count;
+} Brush;
+
+typedef struct TileJob {
+	Terrain* terrain;
+	const Brush* brush;
+	unsigned int seed;
+	int pass;
+	//tile grid of this pass
+	int offset;
+	int tilesPerSide;
+	//tiles of the current color, island * tilesPerSide^2 + tx * tilesPerSide + tz
+	const int* tiles;
+	float droplets;
+	int* cancel;
+} TileJob;
+
+typedef struct ThermalJob {
+	const float* from;
+	float* to;
+	int mapSize;
+} ThermalJob;
+
+/**
+ * cancelled
+ */
+static int cancelled(int* cancel) {
+	return cancel != NULL && __atomic_load_n(cancel, __ATOMIC_RELAXED) != 0;
+}
+/**
+ * erosionDefaults
+ * Fills settings for droplets per cell, eroding in parallel.
+ */
+void erosionDefaults(ErosionSettings* settings, float droplets) {
+	settings->droplets = droplets;
+	settings->thermalSteps = EROSION_THERMAL_STEPS;
+	settings->parallel = 1;
+	settings->cancel = NULL;
+}
+/**
+ * initBrush
+ * Weights of the cells around a droplet, falling off linearly with distance.
+ */
+static void initBrush(Brush* brush) {
+	float total = 0.0f;
+	int x, z, i;
+	brush->count = 0;
+	for (x = -EROSION_RADIUS; x <= EROSION_RADIUS; x++) {
+		for (z = -EROSION_RADIUS; z <= EROSION_RADIUS; z++) {
+			float weight = EROSION_RADIUS - sqrtf(x * x + z * z);
+			if (weight > 0.0f) {
+				brush->dx[brush->count] = x;
+				brush->dz[brush->count] = z;
+				brush->weight[brush->count] = weight;
+				brush->count++;
+				total += weight;
+			}
+		}
+	}
+	for (i = 0; i < brush->count; i++) {
+		brush->weight[i] /= total;
+	}
+}
+/**
+ * sampleHeight
+ * Returns the height at a point between cells and its gradient.
+ */
+static float sampleHeight(const float* map, int mapSize, float x, float z,
+		float* gradientX, float* gradientZ) {
+	int cellX = (int) x;
+	int cellZ = (int) z;
+	float u = x - cellX;
+	float v = z - cellZ;
+	const float* cell = &map[cellX * mapSize + cellZ];
+	float h00 = cell[0];
+	float h01 = cell[1];
+	float h10 = cell[mapSize];
+	float h11 = cell[mapSize + 1];
+	*gradientX = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+	*gradientZ = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+	return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v)
+			+ h01 * (1.0f - u) * v + h11 * u * v;
+}
+/**
+ * runDroplet
+ * Runs one droplet from (x, z) until it stops, evaporates, reaches the sea
+ * or would leave [minX, maxX) x [minZ, maxZ).
+ */
+static void runDroplet(float* map, int mapSize, const Brush* brush, float x,
+		float z, float minX, float maxX, float minZ, float maxZ) {
+	float directionX = 0.0f;
+	float directionZ = 0.0f;
+	float speed = 1.0f;
+	float water = 1.0f;
+	float sediment = 0.0f;
+	float gradientX, gradientZ;
+	float height = sampleHeight(map, mapSize, x, z, &gradientX, &gradientZ);
+	int step, i;
+	for (step = 0; step < EROSION_MAX_STEPS; step++) {
+		int cellX = (int) x;
+		int cellZ = (int) z;
+		float u = x - cellX;
+		float v = z - cellZ;
+		float length, newHeight, drop, capacity;
+		directionX = directionX * EROSION_INERTIA - gradientX * (1.0f - EROSION_INERTIA);
+		directionZ = directionZ * EROSION_INERTIA - gradientZ * (1.0f - EROSION_INERTIA);
+		length = sqrtf(directionX * directionX + directionZ * directionZ);
+		if (length < 1e-6f) {
+			//a flat spot or a pit it can not leave
+			break;
+		}
+		directionX /= length;
+		directionZ /= length;
+		x += directionX;
+		z += directionZ;
+		if (x < minX || x >= maxX || z < minZ || z >= maxZ) {
+			break;
+		}
+		//the gradient here steers the next step, what this step changes
+		//around the old cell hardly moves it
+		newHeight = sampleHeight(map, mapSize, x, z, &gradientX, &gradientZ);
+		drop = height - newHeight;
+		capacity = (drop > EROSION_MIN_SLOPE ? drop : EROSION_MIN_SLOPE)
+				* speed * water * EROSION_CAPACITY;
+		if (drop < 0.0f || sediment > capacity) {
+			//uphill it fills the pit it left, otherwise drops the excess
+			float amount = drop < 0.0f ?
+					(-drop < sediment ? -drop : sediment) :
+					(sediment - capacity) * EROSION_DEPOSIT;
+			float* cell = &map[cellX * mapSize + cellZ];
+			sediment -= amount;
+			cell[0] += amount * (1.0f - u) * (1.0f - v);
+			cell[mapSize] += amount * u * (1.0f - v);
+			cell[1] += amount * (1.0f - u) * v;
+			cell[mapSize + 1] += amount * u * v;
+		} else {
+			//never dig deeper than the drop, that would leave a pit behind
+			float amount = (capacity - sediment) * EROSION_ERODE;
+			amount = amount < drop ? amount : drop;
+			for (i = 0; i < brush->count; i++) {
+				float* cell = &map[(cellX + brush->dx[i]) * mapSize + cellZ
+						+ brush->dz[i]];
+				float taken = amount * brush->weight[i];
+				//the sea floor stays at 0
+				taken = taken < *cell ? taken : *cell;
+				*cell -= taken;
+				sediment += taken;
+			}
+		}
+		speed = speed * speed + drop * EROSION_GRAVITY;
+		speed = speed > 0.0f ? sqrtf(speed) : 0.0f;
+		water *= 1.0f - EROSION_EVAPORATE;
+		if (newHeight <= 0.0f) {
+			//reached the sea, its sediment is lost
+			break;
+		}
+		height = newHeight;
+	}
+}
+/**
+ * erodeTiles
+ * Job running the droplets of tiles [begin, end) of the current color.
+ */
+static void erodeTiles(void* data, int begin, int end, int worker) {
+	const TileJob* job = data;
+	int mapSize = job->terrain->mapSize;
+	int perIsland = job->tilesPerSide * job->tilesPerSide;
+	//cells the brush of a droplet reaches stay inside the map's border
+	float low = 1 + EROSION_RADIUS;
+	float high = mapSize - 1 - EROSION_RADIUS;
+	int t, i;
+	(void) worker;
+	for (t = begin; t < end && !cancelled(job->cancel); t++) {
+		int tile = job->tiles[t];
+		int island = tile / perIsland;
+		int tileX = (tile % perIsland) / job->tilesPerSide;
+		int tileZ = tile % job->tilesPerSide;
+		float* map = job->terrain->islands[island].heights;
+		float x0 = tileX * EROSION_TILE - job->offset;
+		float z0 = tileZ * EROSION_TILE - job->offset;
+		//start inside the tile, stop half a tile out of it
+		float startX = x0 > low ? x0 : low;
+		float endX = x0 + EROSION_TILE < high ? x0 + EROSION_TILE : high;
+		float startZ = z0 > low ? z0 : low;
+		float endZ = z0 + EROSION_TILE < high ? z0 + EROSION_TILE : high;
+		float minX = x0 - EROSION_TILE / 2 + EROSION_RADIUS;
+		float maxX = x0 + EROSION_TILE * 3 / 2 - EROSION_RADIUS;
+		float minZ = z0 - EROSION_TILE / 2 + EROSION_RADIUS;
+		float maxZ = z0 + EROSION_TILE * 3 / 2 - EROSION_RADIUS;
+		float expected;
+		int count;
+		Rng rng;
+		if (endX <= startX || endZ <= startZ) {
+			continue;
+		}
+		minX = minX > low ? minX : low;
+		maxX = maxX < high ? maxX : high;
+		minZ = minZ > low ? minZ : low;
+		maxZ = maxZ < high ? maxZ : high;
+		rngSeedStream(&rng, job->seed, RNG_EROSION,
+				job->pass * job->terrain->islandCount * perIsland + tile);
+		//whole droplets, the fraction decides one more
+		expected = job->droplets * (endX - startX) * (endZ - startZ);
+		count = (int) expected;
+		if (rngFloat(&rng) < expected - count) {
+			count++;
+		}
+		for (i = 0; i < count; i++) {
+			float x = startX + rngFloat(&rng) * (endX - startX);
+			float z = startZ + rngFloat(&rng) * (endZ - startZ);
+			runDroplet(map, mapSize, job->brush, x, z, minX, maxX, minZ, maxZ);
+		}
+	}
+}
+/**
+ * thermalRows
+ * Job moving material down slopes steeper than the talus, for the rows
+ * [begin, end) of every island one after another. Every pair of neighbours
+ * trades the same amount both ways, so no material is made or lost.
+ */
+static void thermalRows(void* data, int begin, int end, int worker) {
+	const ThermalJob* job = data;
+	int mapSize = job->mapSize;
+	int row, z, k;
+	(void) worker;
+	for (row = begin; row < end; row++) {
+		int x = row % mapSize;
+		const float* from = job->from + (size_t) (row - x) * mapSize;
+		float* to = job->to + (size_t) (row - x) * mapSize;
+		if (x == 0 || x == mapSize - 1) {
+			memcpy(&to[x * mapSize], &from[x * mapSize], sizeof(float) * mapSize);
+			continue;
+		}
+		to[x * mapSize] = from[x * mapSize];
+		to[x * mapSize + mapSize - 1] = from[x * mapSize + mapSize - 1];
+		for (z = 1; z < mapSize - 1; z++) {
+			const int neighbours[4] = { -mapSize, mapSize, -1, 1 };
+			int i = x * mapSize + z;
+			float change = 0.0f;
+			for (k = 0; k < 4; k++) {
+				float difference = from[i + neighbours[k]] - from[i];
+				if (difference > EROSION_TALUS) {
+					change += (difference - EROSION_TALUS) * EROSION_THERMAL_RATE;
+				} else if (difference < -EROSION_TALUS) {
+					change += (difference + EROSION_TALUS) * EROSION_THERMAL_RATE;
+				}
+			}
+			to[i] = from[i] + change;
+		}
+	}
+}
+/**
+ * erodeThermal
+ * Runs steps thermal steps over every island, scratch holds one copy of all
+ * of them.
+ */
+static void erodeThermal(Terrain* terrain, float* scratch, int steps,
+		int parallel) {
+	int mapSize = terrain->mapSize;
+	int cells = mapSize * mapSize;
+	ThermalJob job;
+	int step, i;
+	job.mapSize = mapSize;
+	for (step = 0; step < steps; step++) {
+		//the islands are separate allocations, gather them
+		for (i = 0; i < terrain->islandCount; i++) {
+			memcpy(scratch + (size_t) cells * i, terrain->islands[i].heights,
+					sizeof(float) * cells);
+		}
+		job.from = scratch;
+		job.to = scratch + (size_t) cells * terrain->islandCount;
+		if (parallel) {
+			jobsParallelFor(mapSize * terrain->islandCount, EROSION_THERMAL_GRAIN,
+					thermalRows, &job);
+		} else {
+			thermalRows(&job, 0, mapSize * terrain->islandCount, 0);
+		}
+		for (i = 0; i < terrain->islandCount; i++) {
+			memcpy(terrain->islands[i].heights, job.to + (size_t) cells * i,
+					sizeof(float) * cells);
+		}
+	}
+}
+/**
+ * erodeTerrain
+ * Erodes every island's height map, from seed. Returns 0 if out of memory
+ * or cancelled, the heights are then partly eroded.
+ */
+int erodeTerrain(Terrain* terrain, unsigned int seed,
+		const ErosionSettings* settings) {
+	int mapSize = terrain->mapSize;
+	int tilesPerSide = (mapSize + EROSION_TILE - 1) / EROSION_TILE + 1;
+	int perIsland = tilesPerSide * tilesPerSide;
+	int* tiles = malloc(sizeof(int) * perIsland * terrain->islandCount);
+	float* scratch = malloc(sizeof(float) * mapSize * mapSize
+			* terrain->islandCount * 2);
+	Brush brush;
+	TileJob job;
+	int pass, color, i;
+	if (tiles == NULL || scratch == NULL) {
+		free(tiles);
+		free(scratch);
+		return 0;
+	}
+	initBrush(&brush);
+	job.terrain = terrain;
+	job.brush = &brush;
+	job.seed = seed;
+	job.tilesPerSide = tilesPerSide;
+	job.tiles = tiles;
+	job.droplets = settings->droplets / EROSION_PASSES;
+	job.cancel = settings->cancel;
+	for (pass = 0; pass < EROSION_PASSES && !cancelled(settings->cancel); pass++) {
+		erodeThermal(terrain, scratch, settings->thermalSteps, settings->parallel);
+		job.pass = pass;
+		//odd steps through the tile so no two passes share edges
+		job.offset = (pass * EROSION_TILE * 3 / 8) % EROSION_TILE;
+		for (color = 0; color < 4; color++) {
+			int count = 0;
+			for (i = 0; i < perIsland * terrain->islandCount; i++) {
+				int tileX = (i % perIsland) / tilesPerSide;
+				int tileZ = i % tilesPerSide;
+				if (((tileX & 1) | ((tileZ & 1) << 1)) == color) {
+					tiles[count++] = i;
+				}
+			}
+			if (settings->parallel) {
+				jobsParallelFor(count, 1, erodeTiles, &job);
+			} else {
+				erodeTiles(&job, 0, count, 0);
+			}
+		}
+	}
+	//smooth the steps the droplets cut
+	erodeThermal(terrain, scratch, settings->thermalSteps, settings->parallel);
+	free(tiles);
+	free(scratch);
+	return !cancelled(settings->cancel);
+}
+
+/*
+ * Background erosion of maps too large to erode while the world is made.
+ * One thread erodes a copy of the heights without the job pool, which
+ * belongs to the main thread, and the main thread takes the result once it
+ * is done.
+ */
+static pthread_t backgroundThread;
+static int backgroundRunning = 0;
+static int backgroundDone = 0;
+static int backgroundCancel = 0;
+static int backgroundOk = 0;
+static unsigned int backgroundSeed;
+static float backgroundDroplets;
+static Terrain backgroundTerrain;
+
+/**
+ * backgroundMain
+ */
+static void* backgroundMain(void* argument) {
+	ErosionSettings settings;
+	(void) argument;
+	erosionDefaults(&settings, backgroundDroplets);
+	settings.parallel = 0;
+	settings.cancel = &backgroundCancel;
+	backgroundOk = erodeTerrain(&backgroundTerrain, backgroundSeed, &settings);
+	__atomic_store_n(&backgroundDone, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+/**
+ * erosionStartBackground
+ * Starts eroding a copy of the terrain's heights on a thread, cancelling
+ * any erosion still running. Returns 0 if it could not be started.
+ */
+int erosionStartBackground(const Terrain* terrain, unsigned int seed,
+		float droplets) {
+	int cells = terrain->mapSize * terrain->mapSize;
+	int i;
+	erosionCancelBackground();
+	for (i = 0; i < terrain->islandCount; i++) {
+		backgroundTerrain.islands[i] = terrain->islands[i];
+		backgroundTerrain.islands[i].heights = malloc(sizeof(float) * cells);
+		backgroundTerrain.islands[i].jitterX = NULL;
+		backgroundTerrain.islands[i].jitterZ = NULL;
+		if (backgroundTerrain.islands[i].heights == NULL) {
+			terrainFree(&backgroundTerrain);
+			return 0;
+		}
+		memcpy(backgroundTerrain.islands[i].heights, terrain->islands[i].heights,
+				sizeof(float) * cells);
+	}
+	backgroundTerrain.mapSize = terrain->mapSize;
+	backgroundTerrain.islandCount = terrain->islandCount;
+	backgroundSeed = seed;
+	backgroundDroplets = droplets;
+	backgroundDone = 0;
+	backgroundCancel = 0;
+	if (pthread_create(&backgroundThread, NULL, backgroundMain, NULL) != 0) {
+		terrainFree(&backgroundTerrain);
+		return 0;
+	}
+	backgroundRunning = 1;
+	return 1;
+}
+/**
+ * erosionFinishBackground
+ * Copies the eroded heights into terrain once the background erosion is
+ * done. Returns 1 if it did, 0 while it is still running or if none is.
+ */
+int erosionFinishBackground(Terrain* terrain) {
+	int ok;
+	int i;
+	if (backgroundRunning == 0
+			|| __atomic_load_n(&backgroundDone, __ATOMIC_ACQUIRE) == 0) {
+		return 0;
+	}
+	pthread_join(backgroundThread, NULL);
+	backgroundRunning = 0;
+	ok = backgroundOk && terrain->mapSize == backgroundTerrain.mapSize
+			&& terrain->islandCount == backgroundTerrain.islandCount;
+	for (i = 0; i < terrain->islandCount && ok; i++) {
+		memcpy(terrain->islands[i].heights, backgroundTerrain.islands[i].heights,
+				sizeof(float) * terrain->mapSize * terrain->mapSize);
+	}
+	terrainFree(&backgroundTerrain);
+	return ok;
+}
+/**
+ * erosionCancelBackground
+ * Stops the background erosion, if any, and drops its result.
+ */
+void erosionCancelBackground(void) {
+	if (backgroundRunning == 0) {
+		return;
+	}
+	__atomic_store_n(&backgroundCancel, 1, __ATOMIC_RELAXED);
+	pthread_join(backgroundThread, NULL);
+	backgroundRunning = 0;
+	terrainFree(&backgroundTerrain);
+}
@@ -0,0 +1,45 @@
+/*
+ * erosion.h
+ * CG flight simulator
+ * Hydraulic and thermal erosion of the island height maps, an optional stage
+ * between terrainGenerate and building the island meshes.
+ * Droplets run downhill picking up sediment where they speed up and dropping
+ * it where they slow down, which cuts gullies and fills valleys, and thermal
+ * steps let slopes steeper than the talus crumble onto their neighbours,
+ * which rounds off the pinched peaks of the midpoint raising. The droplets
+ * run in parallel over tiles that can not touch each other, so the result
+ * only depends on the seed and never on the number of threads.
+ */
+
+#ifndef EROSION_H_
+#define EROSION_H_
+#include "terrain.h"
+
+//droplets per height map cell when none are given
+#define EROSION_DEFAULT_DROPLETS 0.25f
+//maps up to this size erode while the world is made, larger ones in the
+//background while the uneroded islands are flown
+#define EROSION_FOREGROUND_SIZE 513
+//time a foreground erosion should fit in, milliseconds
+#define EROSION_RESPAWN_BUDGET_MS 500
+
+typedef struct ErosionSettings {
+	//droplets per height map cell over all passes, the iteration budget
+	float droplets;
+	//thermal steps before each droplet pass
+	int thermalSteps;
+	//spread the tiles over the job pool, 0 runs them on the calling thread
+	int parallel;
+	//erosion gives up once this is set, may be NULL
+	int* cancel;
+} ErosionSettings;
+
+void erosionDefaults(ErosionSettings* settings, float droplets);
+int erodeTerrain(Terrain* terrain, unsigned int seed,
+		const ErosionSettings* settings);
+int erosionStartBackground(const Terrain* terrain, unsigned int seed,
+		float droplets);
+int erosionFinishBackground(Terrain* terrain);
+void erosionCancelBackground(void);
+
+#endif /* EROSION_H_ */
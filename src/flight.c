@@ -0,0 +1,444 @@
+/**
+ * flight.c
+ * CG flight simulator
+ * Six degree of freedom flight dynamics, see flight.h.
+ * The step kernel is written once against a small lane type that is four
+ * SSE2 floats when available and a single float otherwise. Only the table
+ * lookup runs per lane, everything else is vector arithmetic using exactly
+ * rounded operations, so both builds produce identical trajectories.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "flight.h"
+#include "jobs.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//airframe, roughly a 300 kg ultralight
+#define FLIGHT_MASS 300.0f
+#define FLIGHT_WING_AREA 15.0f
+#define FLIGHT_WING_SPAN 10.0f
+#define FLIGHT_CHORD 1.5f
+#define FLIGHT_MAX_THRUST 800.0f
+//moments of inertia about the pitch (x), yaw (y) and roll (z) axes
+#define FLIGHT_INERTIA_X 400.0f
+#define FLIGHT_INERTIA_Y 600.0f
+#define FLIGHT_INERTIA_Z 300.0f
+#define FLIGHT_AIR_DENSITY 1.225f
+#define FLIGHT_GRAVITY 9.81f
+//stability and control derivatives, per radian or per unit of control
+#define FLIGHT_SIDE_FORCE -0.6f
+#define FLIGHT_PITCH_DAMPING -12.0f
+#define FLIGHT_ELEVATOR_POWER 0.2f
+#define FLIGHT_DIHEDRAL 0.08f
+#define FLIGHT_ROLL_DAMPING -0.5f
+#define FLIGHT_AILERON_POWER 0.12f
+#define FLIGHT_WEATHERVANE 0.08f
+#define FLIGHT_YAW_DAMPING -0.15f
+#define FLIGHT_RUDDER_POWER 0.05f
+//below this airspeed the damping terms stop growing
+#define FLIGHT_MIN_AIRSPEED 1.0f
+//aircraft per job, a multiple of 4 so SIMD blocks never straddle jobs
+#define FLIGHT_GRAIN 1024
+
+//aerodynamic coefficients every 2.5 degrees of angle of attack from -20 to 30,
+//clamped beyond, the lift curve stalls at about 15 degrees either way
+#define AERO_MIN_ALPHA -20.0f
+#define AERO_STEP 2.5f
+#define AERO_ENTRIES 21
+//linear part of the lift curve, per radian, and where it ends
+#define FLIGHT_ZERO_ALPHA_LIFT 0.25f
+#define FLIGHT_LIFT_SLOPE 4.8f
+#define FLIGHT_STALL_ALPHA 0.23f
+typedef struct AeroCoefficients {
+	float lift;
+	float drag;
+	float pitch;
+} AeroCoefficients;
+static const AeroCoefficients aeroTable[AERO_ENTRIES] = {
+	{ -0.74f, 0.336f, 0.347f },
+	{ -0.82f, 0.208f, 0.312f },
+	{ -0.89f, 0.130f, 0.277f },
+	{ -0.80f, 0.086f, 0.243f },
+	{ -0.59f, 0.069f, 0.208f },
+	{ -0.38f, 0.058f, 0.173f },
+	{ -0.17f, 0.052f, 0.138f },
+	{ 0.04f, 0.050f, 0.103f },
+	{ 0.25f, 0.053f, 0.068f },
+	{ 0.46f, 0.062f, 0.033f },
+	{ 0.67f, 0.075f, -0.002f },
+	{ 0.88f, 0.092f, -0.037f },
+	{ 1.09f, 0.115f, -0.072f },
+	{ 1.30f, 0.144f, -0.107f },
+	{ 1.37f, 0.189f, -0.141f },
+	{ 1.24f, 0.256f, -0.176f },
+	{ 1.12f, 0.375f, -0.211f },
+	{ 1.01f, 0.547f, -0.246f },
+	{ 0.96f, 0.777f, -0.281f },
+	{ 0.91f, 1.057f, -0.316f },
+	{ 0.86f, 1.387f, -0.351f }
+};
+
+#ifdef __SSE2__
+#define FLIGHT_LANES 4
+typedef __m128 Lanes;
+#define lanesSet(a) _mm_set1_ps(a)
+#define lanesLoad(p) _mm_load_ps(p)
+#define lanesStore(p, a) _mm_store_ps(p, a)
+#define lanesLoadUnaligned(p) _mm_loadu_ps(p)
+#define lanesStoreUnaligned(p, a) _mm_storeu_ps(p, a)
+#define lanesAdd(a, b) _mm_add_ps(a, b)
+#define lanesSub(a, b) _mm_sub_ps(a, b)
+#define lanesMul(a, b) _mm_mul_ps(a, b)
+#define lanesDiv(a, b) _mm_div_ps(a, b)
+#define lanesMax(a, b) _mm_max_ps(a, b)
+#define lanesSqrt(a) _mm_sqrt_ps(a)
+#else
+#define FLIGHT_LANES 1
+typedef float Lanes;
+#define lanesSet(a) (a)
+#define lanesLoad(p) (*(p))
+#define lanesStore(p, a) (*(p) = (a))
+#define lanesLoadUnaligned(p) (*(p))
+#define lanesStoreUnaligned(p, a) (*(p) = (a))
+#define lanesAdd(a, b) ((a) + (b))
+#define lanesSub(a, b) ((a) - (b))
+#define lanesMul(a, b) ((a) * (b))
+#define lanesDiv(a, b) ((a) / (b))
+#define lanesMax(a, b) ((a) > (b) ? (a) : (b))
+#define lanesSqrt(a) sqrtf(a)
+#endif
+
+/**
+ * flightCreate
+ * Allocates a batch of count aircraft, each at the origin facing +z at rest.
+ * Returns 0 on failure.
+ */
+int flightCreate(FlightBatch* batch, int count) {
+	float** arrays[] = { &batch->x, &batch->y, &batch->z, &batch->vx,
+			&batch->vy, &batch->vz, &batch->qw, &batch->qx, &batch->qy,
+			&batch->qz, &batch->wx, &batch->wy, &batch->wz, &batch->elevator,
+			&batch->aileron, &batch->rudder, &batch->throttle };
+	int numArrays = sizeof(arrays) / sizeof(arrays[0]);
+	size_t arrayBytes;
+	unsigned char* memory;
+	int i;
+	memset(batch, 0, sizeof(FlightBatch));
+	if (count <= 0) {
+		return 0;
+	}
+	batch->count = count;
+	batch->paddedCount = (count + 3) & ~3;
+	arrayBytes = batch->paddedCount * sizeof(float);
+	//16 bytes of slack to align the first array, later ones stay aligned
+	memory = calloc(1, arrayBytes * numArrays + 16);
+	if (memory == NULL) {
+		return 0;
+	}
+	batch->memory = memory;
+	memory += (16 - ((size_t) memory & 15)) & 15;
+	for (i = 0; i < numArrays; i++) {
+		*arrays[i] = (float*) memory;
+		memory += arrayBytes;
+	}
+	for (i = 0; i < batch->paddedCount; i++) {
+		batch->qw[i] = 1.0f;
+	}
+	return 1;
+}
+/**
+ * flightFree
+ */
+void flightFree(FlightBatch* batch) {
+	free(batch->memory);
+	memset(batch, 0, sizeof(FlightBatch));
+}
+/**
+ * flightPlace
+ * Puts an aircraft in level flight at the given position, heading (radians
+ * from +z towards +x) and airspeed, with centred controls. The nose is
+ * raised to the angle of attack that holds its weight at that airspeed.
+ */
+void flightPlace(FlightBatch* batch, int i, float x, float y, float z,
+		float heading, float speed) {
+	float lift = FLIGHT_MASS * FLIGHT_GRAVITY
+			/ (0.5f * FLIGHT_AIR_DENSITY * FLIGHT_WING_AREA * speed * speed + 0.001f);
+	float alpha = (lift - FLIGHT_ZERO_ALPHA_LIFT) / FLIGHT_LIFT_SLOPE;
+	float ch = cosf(heading * 0.5f), sh = sinf(heading * 0.5f);
+	float ca, sa;
+	if (alpha < 0.0f) {
+		alpha = 0.0f;
+	} else if (alpha > FLIGHT_STALL_ALPHA) {
+		alpha = FLIGHT_STALL_ALPHA;
+	}
+	//yaw to the heading then pitch up, a negative turn about x
+	ca = cosf(alpha * 0.5f);
+	sa = sinf(alpha * 0.5f);
+	batch->x[i] = x;
+	batch->y[i] = y;
+	batch->z[i] = z;
+	batch->vx[i] = sinf(heading) * speed;
+	batch->vy[i] = 0.0f;
+	batch->vz[i] = cosf(heading) * speed;
+	batch->qw[i] = ch * ca;
+	batch->qx[i] = -ch * sa;
+	batch->qy[i] = sh * ca;
+	batch->qz[i] = sh * sa;
+	batch->wx[i] = 0.0f;
+	batch->wy[i] = 0.0f;
+	batch->wz[i] = 0.0f;
+	batch->elevator[i] = 0.0f;
+	batch->aileron[i] = 0.0f;
+	batch->rudder[i] = 0.0f;
+	batch->throttle[i] = FLIGHT_CRUISE_THROTTLE;
+}
+/**
+ * aeroLookup
+ * Interpolates the coefficient table at the angle of attack of each lane.
+ * This is the only per lane scalar code in the kernel.
+ */
+static void aeroLookup(Lanes up, Lanes forward, Lanes* lift, Lanes* drag,
+		Lanes* pitch) {
+	float ups[FLIGHT_LANES], forwards[FLIGHT_LANES];
+	float lifts[FLIGHT_LANES], drags[FLIGHT_LANES], pitches[FLIGHT_LANES];
+	int lane;
+	lanesStoreUnaligned(ups, up);
+	lanesStoreUnaligned(forwards, forward);
+	for (lane = 0; lane < FLIGHT_LANES; lane++) {
+		//the air comes from below when the body velocity points down
+		float alpha = atan2f(-ups[lane], forwards[lane]) * (180.0f / 3.14159265f);
+		float position = (alpha - AERO_MIN_ALPHA) / AERO_STEP;
+		int index;
+		float t;
+		if (position < 0.0f) {
+			position = 0.0f;
+		} else if (position > AERO_ENTRIES - 1) {
+			position = AERO_ENTRIES - 1;
+		}
+		index = (int) position;
+		if (index > AERO_ENTRIES - 2) {
+			index = AERO_ENTRIES - 2;
+		}
+		t = position - index;
+		lifts[lane] = aeroTable[index].lift
+				+ (aeroTable[index + 1].lift - aeroTable[index].lift) * t;
+		drags[lane] = aeroTable[index].drag
+				+ (aeroTable[index + 1].drag - aeroTable[index].drag) * t;
+		pitches[lane] = aeroTable[index].pitch
+				+ (aeroTable[index + 1].pitch - aeroTable[index].pitch) * t;
+	}
+	*lift = lanesLoadUnaligned(lifts);
+	*drag = lanesLoadUnaligned(drags);
+	*pitch = lanesLoadUnaligned(pitches);
+}
+/**
+ * stepRange
+ * Integrates aircraft begin to end (multiples of the lane count) for a
+ * number of steps, keeping each group of lanes in registers throughout.
+ */
+static void stepRange(FlightBatch* b, int begin, int end, float dt, int steps) {
+	const Lanes zero = lanesSet(0.0f);
+	const Lanes two = lanesSet(2.0f);
+	const Lanes one = lanesSet(1.0f);
+	const Lanes tiny = lanesSet(0.000001f);
+	const Lanes minAirspeed = lanesSet(FLIGHT_MIN_AIRSPEED);
+	const Lanes timeStep = lanesSet(dt);
+	const Lanes halfTimeStep = lanesSet(dt * 0.5f);
+	const Lanes dynamicPressure = lanesSet(0.5f * FLIGHT_AIR_DENSITY * FLIGHT_WING_AREA);
+	const Lanes inverseMass = lanesSet(1.0f / FLIGHT_MASS);
+	const Lanes gravityStep = lanesSet(FLIGHT_GRAVITY * dt);
+	const Lanes maxThrust = lanesSet(FLIGHT_MAX_THRUST);
+	const Lanes chord = lanesSet(FLIGHT_CHORD);
+	const Lanes span = lanesSet(FLIGHT_WING_SPAN);
+	const Lanes halfChord = lanesSet(FLIGHT_CHORD * 0.5f);
+	const Lanes halfSpan = lanesSet(FLIGHT_WING_SPAN * 0.5f);
+	const Lanes sideForce = lanesSet(FLIGHT_SIDE_FORCE);
+	const Lanes pitchDamping = lanesSet(FLIGHT_PITCH_DAMPING);
+	const Lanes elevatorPower = lanesSet(FLIGHT_ELEVATOR_POWER);
+	const Lanes dihedral = lanesSet(FLIGHT_DIHEDRAL);
+	const Lanes rollDamping = lanesSet(FLIGHT_ROLL_DAMPING);
+	const Lanes aileronPower = lanesSet(FLIGHT_AILERON_POWER);
+	const Lanes weathervane = lanesSet(FLIGHT_WEATHERVANE);
+	const Lanes yawDamping = lanesSet(FLIGHT_YAW_DAMPING);
+	const Lanes rudderPower = lanesSet(FLIGHT_RUDDER_POWER);
+	const Lanes inertiaX = lanesSet(FLIGHT_INERTIA_X);
+	const Lanes inertiaY = lanesSet(FLIGHT_INERTIA_Y);
+	const Lanes inertiaZ = lanesSet(FLIGHT_INERTIA_Z);
+	int i, step;
+	for (i = begin; i < end; i += FLIGHT_LANES) {
+		Lanes x = lanesLoad(b->x + i), y = lanesLoad(b->y + i), z = lanesLoad(b->z + i);
+		Lanes vx = lanesLoad(b->vx + i), vy = lanesLoad(b->vy + i), vz = lanesLoad(b->vz + i);
+		Lanes qw = lanesLoad(b->qw + i), qx = lanesLoad(b->qx + i);
+		Lanes qy = lanesLoad(b->qy + i), qz = lanesLoad(b->qz + i);
+		Lanes wx = lanesLoad(b->wx + i), wy = lanesLoad(b->wy + i), wz = lanesLoad(b->wz + i);
+		Lanes elevator = lanesLoad(b->elevator + i);
+		Lanes aileron = lanesLoad(b->aileron + i);
+		Lanes rudder = lanesLoad(b->rudder + i);
+		Lanes thrust = lanesMul(lanesLoad(b->throttle + i), maxThrust);
+		for (step = 0; step < steps; step++) {
+			Lanes tx, ty, tz, bx, by, bz, fx, fy, fz, mx, my, mz;
+			Lanes airspeed2, airspeed, inverseAirspeed, pressure, sideslip;
+			Lanes lift, drag, pitch, liftScale, dragScale, length;
+
+			//velocity into the body frame with the conjugate, t = 2(v x u), v + wt + t x u
+			tx = lanesMul(two, lanesSub(lanesMul(vy, qz), lanesMul(vz, qy)));
+			ty = lanesMul(two, lanesSub(lanesMul(vz, qx), lanesMul(vx, qz)));
+			tz = lanesMul(two, lanesSub(lanesMul(vx, qy), lanesMul(vy, qx)));
+			bx = lanesAdd(lanesAdd(vx, lanesMul(qw, tx)), lanesSub(lanesMul(ty, qz), lanesMul(tz, qy)));
+			by = lanesAdd(lanesAdd(vy, lanesMul(qw, ty)), lanesSub(lanesMul(tz, qx), lanesMul(tx, qz)));
+			bz = lanesAdd(lanesAdd(vz, lanesMul(qw, tz)), lanesSub(lanesMul(tx, qy), lanesMul(ty, qx)));
+
+			airspeed2 = lanesAdd(lanesAdd(lanesMul(bx, bx), lanesMul(by, by)), lanesMul(bz, bz));
+			airspeed = lanesMax(lanesSqrt(airspeed2), minAirspeed);
+			inverseAirspeed = lanesDiv(one, airspeed);
+			pressure = lanesMul(dynamicPressure, airspeed2);
+			sideslip = lanesMul(bx, inverseAirspeed);
+			aeroLookup(by, bz, &lift, &drag, &pitch);
+
+			//lift is perpendicular to the airflow in the symmetry plane, drag opposes it
+			length = lanesSqrt(lanesAdd(lanesAdd(lanesMul(by, by), lanesMul(bz, bz)), tiny));
+			liftScale = lanesDiv(lanesMul(pressure, lift), length);
+			dragScale = lanesMul(lanesMul(pressure, drag), inverseAirspeed);
+			fx = lanesSub(lanesMul(lanesMul(pressure, sideForce), sideslip), lanesMul(dragScale, bx));
+			fy = lanesSub(lanesMul(liftScale, bz), lanesMul(dragScale, by));
+			fz = lanesAdd(lanesSub(zero, lanesMul(liftScale, by)), lanesSub(thrust, lanesMul(dragScale, bz)));
+
+			//moments, a positive x moment pitches the nose down so the pitch terms are negated
+			mx = lanesMul(lanesMul(pressure, chord), lanesSub(lanesMul(pitchDamping,
+					lanesMul(lanesMul(wx, halfChord), inverseAirspeed)),
+					lanesAdd(pitch, lanesMul(elevatorPower, elevator))));
+			my = lanesMul(lanesMul(pressure, span), lanesSub(lanesAdd(
+					lanesMul(weathervane, sideslip), lanesMul(yawDamping,
+					lanesMul(lanesMul(wy, halfSpan), inverseAirspeed))),
+					lanesMul(rudderPower, rudder)));
+			mz = lanesMul(lanesMul(pressure, span), lanesAdd(lanesAdd(
+					lanesMul(dihedral, sideslip), lanesMul(rollDamping,
+					lanesMul(lanesMul(wz, halfSpan), inverseAirspeed))),
+					lanesMul(aileronPower, aileron)));
+
+			//force back into the world frame, t = 2(u x f), f + wt + u x t
+			tx = lanesMul(two, lanesSub(lanesMul(qy, fz), lanesMul(qz, fy)));
+			ty = lanesMul(two, lanesSub(lanesMul(qz, fx), lanesMul(qx, fz)));
+			tz = lanesMul(two, lanesSub(lanesMul(qx, fy), lanesMul(qy, fx)));
+			bx = lanesAdd(lanesAdd(fx, lanesMul(qw, tx)), lanesSub(lanesMul(qy, tz), lanesMul(qz, ty)));
+			by = lanesAdd(lanesAdd(fy, lanesMul(qw, ty)), lanesSub(lanesMul(qz, tx), lanesMul(qx, tz)));
+			bz = lanesAdd(lanesAdd(fz, lanesMul(qw, tz)), lanesSub(lanesMul(qx, ty), lanesMul(qy, tx)));
+
+			//semi-implicit Euler, velocities first then positions with the new velocities
+			vx = lanesAdd(vx, lanesMul(lanesMul(bx, inverseMass), timeStep));
+			vy = lanesSub(lanesAdd(vy, lanesMul(lanesMul(by, inverseMass), timeStep)), gravityStep);
+			vz = lanesAdd(vz, lanesMul(lanesMul(bz, inverseMass), timeStep));
+			x = lanesAdd(x, lanesMul(vx, timeStep));
+			y = lanesAdd(y, lanesMul(vy, timeStep));
+			z = lanesAdd(z, lanesMul(vz, timeStep));
+
+			//Euler's rotation equations, I dw/dt = M - w x Iw
+			tx = lanesDiv(lanesSub(mx, lanesMul(lanesSub(inertiaZ, inertiaY), lanesMul(wy, wz))), inertiaX);
+			ty = lanesDiv(lanesSub(my, lanesMul(lanesSub(inertiaX, inertiaZ), lanesMul(wz, wx))), inertiaY);
+			tz = lanesDiv(lanesSub(mz, lanesMul(lanesSub(inertiaY, inertiaX), lanesMul(wx, wy))), inertiaZ);
+			wx = lanesAdd(wx, lanesMul(tx, timeStep));
+			wy = lanesAdd(wy, lanesMul(ty, timeStep));
+			wz = lanesAdd(wz, lanesMul(tz, timeStep));
+
+			//dq/dt = q (0, w) / 2 with the body rate, then renormalise
+			tx = lanesAdd(lanesAdd(lanesMul(qw, wx), lanesMul(qy, wz)), lanesSub(zero, lanesMul(qz, wy)));
+			ty = lanesAdd(lanesAdd(lanesMul(qw, wy), lanesMul(qz, wx)), lanesSub(zero, lanesMul(qx, wz)));
+			tz = lanesAdd(lanesAdd(lanesMul(qw, wz), lanesMul(qx, wy)), lanesSub(zero, lanesMul(qy, wx)));
+			length = lanesAdd(lanesAdd(lanesMul(qx, wx), lanesMul(qy, wy)), lanesMul(qz, wz));
+			qw = lanesSub(qw, lanesMul(length, halfTimeStep));
+			qx = lanesAdd(qx, lanesMul(tx, halfTimeStep));
+			qy = lanesAdd(qy, lanesMul(ty, halfTimeStep));
+			qz = lanesAdd(qz, lanesMul(tz, halfTimeStep));
+			length = lanesSqrt(lanesAdd(lanesAdd(lanesMul(qw, qw), lanesMul(qx, qx)),
+					lanesAdd(lanesMul(qy, qy), lanesMul(qz, qz))));
+			qw = lanesDiv(qw, length);
+			qx = lanesDiv(qx, length);
+			qy = lanesDiv(qy, length);
+			qz = lanesDiv(qz, length);
+		}
+		lanesStore(b->x + i, x);
+		lanesStore(b->y + i, y);
+		lanesStore(b->z + i, z);
+		lanesStore(b->vx + i, vx);
+		lanesStore(b->vy + i, vy);
+		lanesStore(b->vz + i, vz);
+		lanesStore(b->qw + i, qw);
+		lanesStore(b->qx + i, qx);
+		lanesStore(b->qy + i, qy);
+		lanesStore(b->qz + i, qz);
+		lanesStore(b->wx + i, wx);
+		lanesStore(b->wy + i, wy);
+		lanesStore(b->wz + i, wz);
+	}
+}
+
+typedef struct StepJob {
+	FlightBatch* batch;
+	float dt;
+	int steps;
+} StepJob;
+
+/**
+ * stepJob
+ */
+static void stepJob(void* data, int begin, int end, int worker) {
+	StepJob* job = data;
+	stepRange(job->batch, begin, end, job->dt, job->steps);
+}
+/**
+ * flightStep
+ * Advances every aircraft by steps fixed steps of dt seconds.
+ */
+void flightStep(FlightBatch* batch, float dt, int steps) {
+	StepJob job = { batch, dt, steps };
+	jobsParallelFor(batch->paddedCount, FLIGHT_GRAIN, stepJob, &job);
+}
+/**
+ * rotate
+ * Rotates a body vector into the world frame.
+ */
+static void rotate(const FlightBatch* b, int i, const float v[3], float out[3]) {
+	float qw = b->qw[i], qx = b->qx[i], qy = b->qy[i], qz = b->qz[i];
+	float tx = 2.0f * (qy * v[2] - qz * v[1]);
+	float ty = 2.0f * (qz * v[0] - qx * v[2]);
+	float tz = 2.0f * (qx * v[1] - qy * v[0]);
+	out[0] = v[0] + qw * tx + qy * tz - qz * ty;
+	out[1] = v[1] + qw * ty + qz * tx - qx * tz;
+	out[2] = v[2] + qw * tz + qx * ty - qy * tx;
+}
+/**
+ * flightAxes
+ * World directions of an aircraft's nose and top.
+ */
+void flightAxes(const FlightBatch* batch, int i, float forward[3], float up[3]) {
+	const float bodyForward[3] = { 0.0f, 0.0f, 1.0f };
+	const float bodyUp[3] = { 0.0f, 1.0f, 0.0f };
+	rotate(batch, i, bodyForward, forward);
+	rotate(batch, i, bodyUp, up);
+}
+/**
+ * flightMatrix
+ * Column major rotation matrix of an aircraft for glMultMatrixf.
+ */
+void flightMatrix(const FlightBatch* batch, int i, float matrix[16]) {
+	const float axes[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	int column;
+	for (column = 0; column < 3; column++) {
+		rotate(batch, i, axes[column], matrix + column * 4);
+		matrix[column * 4 + 3] = 0.0f;
+	}
+	matrix[12] = 0.0f;
+	matrix[13] = 0.0f;
+	matrix[14] = 0.0f;
+	matrix[15] = 1.0f;
+}
+/**
+ * flightAirspeed
+ */
+float flightAirspeed(const FlightBatch* batch, int i) {
+	return sqrtf(batch->vx[i] * batch->vx[i] + batch->vy[i] * batch->vy[i]
+			+ batch->vz[i] * batch->vz[i]);
+}
@@ -0,0 +1,63 @@
+/*
+ * flight.h
+ * CG flight simulator
+ * Six degree of freedom flight dynamics for a batch of identical light
+ * aircraft stored as structure of arrays.
+ * Orientation is a unit quaternion, forces come from lift, drag and pitching
+ * moment coefficients looked up by angle of attack, and each step is
+ * integrated with semi-implicit Euler at a fixed time step. The kernel runs
+ * four aircraft at a time with SSE2 and large batches are split across the
+ * worker threads.
+ *
+ * Units are metres, seconds and kilograms, y is up. In the body frame the
+ * nose points along +z, the top along +y and the left wing along +x.
+ */
+
+#ifndef FLIGHT_H_
+#define FLIGHT_H_
+
+//level flight without control input
+#define FLIGHT_CRUISE_SPEED 22.0f
+#define FLIGHT_CRUISE_THROTTLE 0.41f
+
+typedef struct FlightBatch {
+	int count;
+	//count rounded up to a multiple of 4, the extra aircraft are simulated but never read
+	int paddedCount;
+	//position and velocity in the world frame
+	float* x;
+	float* y;
+	float* z;
+	float* vx;
+	float* vy;
+	float* vz;
+	//orientation, rotates body vectors into the world frame
+	float* qw;
+	float* qx;
+	float* qy;
+	float* qz;
+	//angular velocity in the body frame, radians per second
+	float* wx;
+	float* wy;
+	float* wz;
+	//controls, -1 to 1 with positive elevator pulling the nose up and
+	//positive aileron and rudder rolling and yawing right
+	float* elevator;
+	float* aileron;
+	float* rudder;
+	//0 to 1 of the maximum thrust
+	float* throttle;
+	//single allocation backing every array
+	void* memory;
+} FlightBatch;
+
+int flightCreate(FlightBatch* batch, int count);
+void flightFree(FlightBatch* batch);
+void flightPlace(FlightBatch* batch, int i, float x, float y, float z,
+		float heading, float speed);
+void flightStep(FlightBatch* batch, float dt, int steps);
+void flightAxes(const FlightBatch* batch, int i, float forward[3], float up[3]);
+void flightMatrix(const FlightBatch* batch, int i, float matrix[16]);
+float flightAirspeed(const FlightBatch* batch, int i);
+
+#endif /* FLIGHT_H_ */
@@ -0,0 +1,216 @@
+/**
+ * glFunctions.c
+ * CG flight simulator
+ * Loads the OpenGL entry points past 1.1 through the window system's
+ * getProcAddress. Must be called with a current context.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "glFunctions.h"
+
+int hasFramebuffers = 0;
+PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers;
+PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers;
+PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC pglFramebufferRenderbuffer;
+PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus;
+PFNGLGENRENDERBUFFERSPROC pglGenRenderbuffers;
+PFNGLDELETERENDERBUFFERSPROC pglDeleteRenderbuffers;
+PFNGLBINDRENDERBUFFERPROC pglBindRenderbuffer;
+PFNGLRENDERBUFFERSTORAGEPROC pglRenderbufferStorage;
+PFNGLBLITFRAMEBUFFERPROC pglBlitFramebuffer;
+
+int hasTimerQueries = 0;
+PFNGLGENQUERIESPROC pglGenQueries;
+PFNGLDELETEQUERIESPROC pglDeleteQueries;
+PFNGLBEGINQUERYPROC pglBeginQuery;
+PFNGLENDQUERYPROC pglEndQuery;
+PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv;
+PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v;
+PFNGLQUERYCOUNTERPROC pglQueryCounter;
+
+int hasBuffers = 0;
+PFNGLGENBUFFERSPROC pglGenBuffers;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+PFNGLISBUFFERPROC pglIsBuffer;
+PFNGLBINDBUFFERPROC pglBindBuffer;
+PFNGLBUFFERDATAPROC pglBufferData;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+
+int hasShaders = 0;
+PFNGLCREATESHADERPROC pglCreateShader;
+PFNGLDELETESHADERPROC pglDeleteShader;
+PFNGLSHADERSOURCEPROC pglShaderSource;
+PFNGLCOMPILESHADERPROC pglCompileShader;
+PFNGLGETSHADERIVPROC pglGetShaderiv;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+PFNGLCREATEPROGRAMPROC pglCreateProgram;
+PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+PFNGLATTACHSHADERPROC pglAttachShader;
+PFNGLLINKPROGRAMPROC pglLinkProgram;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+PFNGLUSEPROGRAMPROC pglUseProgram;
+PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+PFNGLUNIFORM1FPROC pglUniform1f;
+PFNGLUNIFORM1IPROC pglUniform1i;
+PFNGLUNIFORM3FPROC pglUniform3f;
+PFNGLUNIFORM4FPROC pglUniform4f;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+PFNGLACTIVETEXTUREPROC pglActiveTexture;
+
+int hasInstancing = 0;
+PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced;
+PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced;
+PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor;
+
+int hasSync = 0;
+PFNGLFENCESYNCPROC pglFenceSync;
+PFNGLCLIENTWAITSYNCPROC pglClientWaitSync;
+PFNGLDELETESYNCPROC pglDeleteSync;
+
+int hasPixelBuffers = 0;
+PFNGLMAPBUFFERPROC pglMapBuffer;
+PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+
+/**
+ * hasGLVersion
+ * Returns 1 if the current context is at least the given version.
+ */
+int hasGLVersion(int major, int minor) {
+	int contextMajor = 1;
+	int contextMinor = 0;
+	const char* version = (const char*) glGetString(GL_VERSION);
+	if (version == NULL || sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2) {
+		return 0;
+	}
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+/**
+ * hasGLExtension
+ * Returns 1 if the extension string contains the given extension.
+ */
+int hasGLExtension(const char* name) {
+	const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+	size_t length = strlen(name);
+	while (extensions != NULL && (extensions = strstr(extensions, name)) != NULL) {
+		if (extensions[length] == ' ' || extensions[length] == '\0') {
+			return 1;
+		}
+		extensions += length;
+	}
+	return 0;
+}
+/**
+ * loadGLFunctions
+ * Loads every group of functions the context supports.
+ */
+void loadGLFunctions(GlGetProcAddress getProcAddress) {
+	pglGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC) getProcAddress("glGenFramebuffers");
+	pglDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC) getProcAddress("glDeleteFramebuffers");
+	pglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC) getProcAddress("glBindFramebuffer");
+	pglFramebufferRenderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC) getProcAddress("glFramebufferRenderbuffer");
+	pglFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC) getProcAddress("glFramebufferTexture2D");
+	pglCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC) getProcAddress("glCheckFramebufferStatus");
+	pglGenRenderbuffers = (PFNGLGENRENDERBUFFERSPROC) getProcAddress("glGenRenderbuffers");
+	pglDeleteRenderbuffers = (PFNGLDELETERENDERBUFFERSPROC) getProcAddress("glDeleteRenderbuffers");
+	pglBindRenderbuffer = (PFNGLBINDRENDERBUFFERPROC) getProcAddress("glBindRenderbuffer");
+	pglRenderbufferStorage = (PFNGLRENDERBUFFERSTORAGEPROC) getProcAddress("glRenderbufferStorage");
+	pglBlitFramebuffer = (PFNGLBLITFRAMEBUFFERPROC) getProcAddress("glBlitFramebuffer");
+	hasFramebuffers = (hasGLVersion(3, 0) || hasGLExtension("GL_ARB_framebuffer_object"))
+			&& pglGenFramebuffers != NULL && pglBindFramebuffer != NULL
+			&& pglFramebufferRenderbuffer != NULL && pglFramebufferTexture2D != NULL
+			&& pglCheckFramebufferStatus != NULL && pglGenRenderbuffers != NULL
+			&& pglBindRenderbuffer != NULL && pglRenderbufferStorage != NULL
+			&& pglDeleteFramebuffers != NULL && pglDeleteRenderbuffers != NULL
+			&& pglBlitFramebuffer != NULL;
+
+	pglGenQueries = (PFNGLGENQUERIESPROC) getProcAddress("glGenQueries");
+	pglDeleteQueries = (PFNGLDELETEQUERIESPROC) getProcAddress("glDeleteQueries");
+	pglBeginQuery = (PFNGLBEGINQUERYPROC) getProcAddress("glBeginQuery");
+	pglEndQuery = (PFNGLENDQUERYPROC) getProcAddress("glEndQuery");
+	pglGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC) getProcAddress("glGetQueryObjectiv");
+	pglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC) getProcAddress("glGetQueryObjectui64v");
+	pglQueryCounter = (PFNGLQUERYCOUNTERPROC) getProcAddress("glQueryCounter");
+	hasTimerQueries = (hasGLVersion(3, 3) || hasGLExtension("GL_ARB_timer_query"))
+			&& pglGenQueries != NULL && pglDeleteQueries != NULL
+			&& pglBeginQuery != NULL && pglEndQuery != NULL
+			&& pglGetQueryObjectiv != NULL && pglGetQueryObjectui64v != NULL
+			&& pglQueryCounter != NULL;
+
+	pglGenBuffers = (PFNGLGENBUFFERSPROC) getProcAddress("glGenBuffers");
+	pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC) getProcAddress("glDeleteBuffers");
+	pglIsBuffer = (PFNGLISBUFFERPROC) getProcAddress("glIsBuffer");
+	pglBindBuffer = (PFNGLBINDBUFFERPROC) getProcAddress("glBindBuffer");
+	pglBufferData = (PFNGLBUFFERDATAPROC) getProcAddress("glBufferData");
+	pglBufferSubData = (PFNGLBUFFERSUBDATAPROC) getProcAddress("glBufferSubData");
+	hasBuffers = (hasGLVersion(1, 5)
+			|| hasGLExtension("GL_ARB_vertex_buffer_object"))
+			&& pglGenBuffers != NULL && pglDeleteBuffers != NULL
+			&& pglIsBuffer != NULL && pglBindBuffer != NULL && pglBufferData != NULL
+			&& pglBufferSubData != NULL;
+
+	pglCreateShader = (PFNGLCREATESHADERPROC) getProcAddress("glCreateShader");
+	pglDeleteShader = (PFNGLDELETESHADERPROC) getProcAddress("glDeleteShader");
+	pglShaderSource = (PFNGLSHADERSOURCEPROC) getProcAddress("glShaderSource");
+	pglCompileShader = (PFNGLCOMPILESHADERPROC) getProcAddress("glCompileShader");
+	pglGetShaderiv = (PFNGLGETSHADERIVPROC) getProcAddress("glGetShaderiv");
+	pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC) getProcAddress("glGetShaderInfoLog");
+	pglCreateProgram = (PFNGLCREATEPROGRAMPROC) getProcAddress("glCreateProgram");
+	pglDeleteProgram = (PFNGLDELETEPROGRAMPROC) getProcAddress("glDeleteProgram");
+	pglAttachShader = (PFNGLATTACHSHADERPROC) getProcAddress("glAttachShader");
+	pglLinkProgram = (PFNGLLINKPROGRAMPROC) getProcAddress("glLinkProgram");
+	pglGetProgramiv = (PFNGLGETPROGRAMIVPROC) getProcAddress("glGetProgramiv");
+	pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC) getProcAddress("glGetProgramInfoLog");
+	pglUseProgram = (PFNGLUSEPROGRAMPROC) getProcAddress("glUseProgram");
+	pglBindAttribLocation = (PFNGLBINDATTRIBLOCATIONPROC) getProcAddress("glBindAttribLocation");
+	pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC) getProcAddress("glGetUniformLocation");
+	pglUniform1f = (PFNGLUNIFORM1FPROC) getProcAddress("glUniform1f");
+	pglUniform1i = (PFNGLUNIFORM1IPROC) getProcAddress("glUniform1i");
+	pglUniform3f = (PFNGLUNIFORM3FPROC) getProcAddress("glUniform3f");
+	pglUniform4f = (PFNGLUNIFORM4FPROC) getProcAddress("glUniform4f");
+	pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC) getProcAddress("glEnableVertexAttribArray");
+	pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC) getProcAddress("glDisableVertexAttribArray");
+	pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC) getProcAddress("glVertexAttribPointer");
+	pglActiveTexture = (PFNGLACTIVETEXTUREPROC) getProcAddress("glActiveTexture");
+	hasShaders = hasGLVersion(2, 0)
+			&& pglCreateShader != NULL && pglDeleteShader != NULL
+			&& pglShaderSource != NULL && pglCompileShader != NULL
+			&& pglGetShaderiv != NULL && pglGetShaderInfoLog != NULL
+			&& pglCreateProgram != NULL && pglDeleteProgram != NULL
+			&& pglAttachShader != NULL && pglLinkProgram != NULL
+			&& pglGetProgramiv != NULL && pglGetProgramInfoLog != NULL
+			&& pglUseProgram != NULL && pglBindAttribLocation != NULL
+			&& pglGetUniformLocation != NULL && pglUniform1f != NULL
+			&& pglUniform1i != NULL && pglUniform3f != NULL
+			&& pglUniform4f != NULL && pglEnableVertexAttribArray != NULL
+			&& pglDisableVertexAttribArray != NULL && pglVertexAttribPointer != NULL
+			&& pglActiveTexture != NULL;
+
+	pglDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC) getProcAddress("glDrawArraysInstanced");
+	pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC) getProcAddress("glDrawElementsInstanced");
+	pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC) getProcAddress("glVertexAttribDivisor");
+	hasInstancing = (hasGLVersion(3, 3)
+			|| (hasGLExtension("GL_ARB_draw_instanced")
+					&& hasGLExtension("GL_ARB_instanced_arrays")))
+			&& pglDrawArraysInstanced != NULL && pglDrawElementsInstanced != NULL
+			&& pglVertexAttribDivisor != NULL;
+
+	pglFenceSync = (PFNGLFENCESYNCPROC) getProcAddress("glFenceSync");
+	pglClientWaitSync = (PFNGLCLIENTWAITSYNCPROC) getProcAddress("glClientWaitSync");
+	pglDeleteSync = (PFNGLDELETESYNCPROC) getProcAddress("glDeleteSync");
+	hasSync = (hasGLVersion(3, 2) || hasGLExtension("GL_ARB_sync"))
+			&& pglFenceSync != NULL && pglClientWaitSync != NULL
+			&& pglDeleteSync != NULL;
+
+	pglMapBuffer = (PFNGLMAPBUFFERPROC) getProcAddress("glMapBuffer");
+	pglUnmapBuffer = (PFNGLUNMAPBUFFERPROC) getProcAddress("glUnmapBuffer");
+	hasPixelBuffers = hasBuffers
+			&& (hasGLVersion(2, 1) || hasGLExtension("GL_ARB_pixel_buffer_object"))
+			&& pglMapBuffer != NULL && pglUnmapBuffer != NULL;
+}
@@ -0,0 +1,97 @@
+/*
+ * glFunctions.h
+ * CG flight simulator
+ * OpenGL entry points past 1.1, loaded at runtime.
+ * opengl32 on Windows only exports 1.1, so anything newer is called through
+ * these pointers. Check the has* flags before using a group of functions.
+ */
+
+#ifndef GLFUNCTIONS_H_
+#define GLFUNCTIONS_H_
+#include "glPlatform.h"
+
+typedef void (*GlProc)(void);
+typedef GlProc (*GlGetProcAddress)(const char* name);
+
+//framebuffer objects (GL 3.0 / ARB_framebuffer_object)
+extern int hasFramebuffers;
+extern PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer;
+extern PFNGLFRAMEBUFFERRENDERBUFFERPROC pglFramebufferRenderbuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus;
+extern PFNGLGENRENDERBUFFERSPROC pglGenRenderbuffers;
+extern PFNGLDELETERENDERBUFFERSPROC pglDeleteRenderbuffers;
+extern PFNGLBINDRENDERBUFFERPROC pglBindRenderbuffer;
+extern PFNGLRENDERBUFFERSTORAGEPROC pglRenderbufferStorage;
+extern PFNGLBLITFRAMEBUFFERPROC pglBlitFramebuffer;
+
+//timer queries (GL 3.3 / ARB_timer_query)
+extern int hasTimerQueries;
+extern PFNGLGENQUERIESPROC pglGenQueries;
+extern PFNGLDELETEQUERIESPROC pglDeleteQueries;
+extern PFNGLBEGINQUERYPROC pglBeginQuery;
+extern PFNGLENDQUERYPROC pglEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v;
+extern PFNGLQUERYCOUNTERPROC pglQueryCounter;
+
+//buffer objects (GL 1.5)
+extern int hasBuffers;
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLISBUFFERPROC pglIsBuffer;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+extern PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+
+//shaders (GL 2.0)
+extern int hasShaders;
+extern PFNGLCREATESHADERPROC pglCreateShader;
+extern PFNGLDELETESHADERPROC pglDeleteShader;
+extern PFNGLSHADERSOURCEPROC pglShaderSource;
+extern PFNGLCOMPILESHADERPROC pglCompileShader;
+extern PFNGLGETSHADERIVPROC pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+extern PFNGLCREATEPROGRAMPROC pglCreateProgram;
+extern PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+extern PFNGLATTACHSHADERPROC pglAttachShader;
+extern PFNGLLINKPROGRAMPROC pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC pglUseProgram;
+extern PFNGLBINDATTRIBLOCATIONPROC pglBindAttribLocation;
+extern PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+extern PFNGLUNIFORM1FPROC pglUniform1f;
+extern PFNGLUNIFORM1IPROC pglUniform1i;
+extern PFNGLUNIFORM3FPROC pglUniform3f;
+extern PFNGLUNIFORM4FPROC pglUniform4f;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+//multitexture is 1.3, shaders sample more than one texture through it
+extern PFNGLACTIVETEXTUREPROC pglActiveTexture;
+
+//instanced drawing (GL 3.3 / ARB_draw_instanced + ARB_instanced_arrays)
+extern int hasInstancing;
+extern PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced;
+extern PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced;
+extern PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor;
+
+//fences (GL 3.2 / ARB_sync)
+extern int hasSync;
+extern PFNGLFENCESYNCPROC pglFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC pglClientWaitSync;
+extern PFNGLDELETESYNCPROC pglDeleteSync;
+
+//pixel buffer objects (GL 2.1 / ARB_pixel_buffer_object), with hasBuffers
+extern int hasPixelBuffers;
+extern PFNGLMAPBUFFERPROC pglMapBuffer;
+extern PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+
+void loadGLFunctions(GlGetProcAddress getProcAddress);
+int hasGLVersion(int major, int minor);
+int hasGLExtension(const char* name);
+
+#endif /* GLFUNCTIONS_H_ */
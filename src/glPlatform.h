@@ -0,0 +1,19 @@
+/*
+ * glPlatform.h
+ * CG flight simulator
+ * Platform specific OpenGL includes shared by every module.
+ */
+
+#ifndef GLPLATFORM_H_
+#define GLPLATFORM_H_
+#ifdef _WIN32
+#include <windows.h>
+#include <gl/Gl.h>
+#include <gl/Glu.h>
+#include <gl/glext.h>
+#else
+#include <GL/gl.h>
+#include <GL/glu.h>
+typedef unsigned char BYTE;
+#endif
+#endif /* GLPLATFORM_H_ */
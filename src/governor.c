@@ -0,0 +1,300 @@
+/**
+ * governor.c
+ * CG flight simulator
+ * Frame time governor, see governor.h.
+ * The scaled scene is drawn into the bottom left of a framebuffer the size
+ * of the window, so changing the scale never reallocates it, only a new
+ * window size does.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "governor.h"
+#include "glFunctions.h"
+
+//weight of the newest frame in the smoothed times
+#define SMOOTHING 0.2f
+//frames over budget before a step down
+#define DEGRADE_FRAMES 8
+//frames under budget by the headroom before a step up
+#define UPGRADE_FRAMES 60
+//of the budget a frame must stay under to step up
+#define HEADROOM 0.75f
+//frames after a step before the times count again
+#define SETTLE_FRAMES 10
+//frames of timestamps in flight
+#define QUERY_RING 4
+
+typedef struct GovernorStep {
+	float scale;
+	int quality;
+} GovernorStep;
+
+//resolution goes first while it is still sharp, then they take turns
+static const GovernorStep ladder[] = { { 1.0f, 0 }, { 0.85f, 0 },
+		{ 0.85f, 1 }, { 0.7f, 1 }, { 0.7f, 2 }, { 0.6f, 2 }, { 0.6f, 3 },
+		{ 0.5f, 3 } };
+
+#define NUM_STEPS ((int) (sizeof(ladder) / sizeof(ladder[0])))
+
+static const GovernorQuality qualities[GOVERNOR_QUALITY_LEVELS] = {
+		{ 0, 1.0f, 0, 10, 32 },
+		{ 0, 0.7f, 1, 8, 24 },
+		{ 1, 0.5f, 2, 6, 16 },
+		{ 2, 0.35f, 3, 4, 12 } };
+
+static GLuint framebuffer = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+static int targetWidth = 0;
+static int targetHeight = 0;
+//the scene being drawn into the framebuffer, and where it goes after
+static int scaled = 0;
+static int sceneWidth = 0;
+static int sceneHeight = 0;
+static int windowWidth = 0;
+static int windowHeight = 0;
+static GLint previousFramebuffer = 0;
+//a start and an end timestamp for each frame in flight
+static GLuint queries[QUERY_RING * 2];
+static int queryUsed[QUERY_RING];
+static int querySlot = 0;
+static int queryStarted = 0;
+static float latestGpuMs = -1.0f;
+
+/**
+ * governorInit
+ * Starts at full resolution and detail, governing only if budgetMs > 0.
+ */
+void governorInit(Governor* governor, float budgetMs) {
+	memset(governor, 0, sizeof(*governor));
+	governor->budgetMs = budgetMs;
+}
+/**
+ * governorUpdate
+ * Takes the times of the frame just drawn, gpuMs < 0 if it is not known,
+ * and steps the ladder if they have been out of the budget long enough.
+ * Returns 1 if it stepped.
+ */
+int governorUpdate(Governor* governor, float cpuMs, float gpuMs) {
+	if (governor->budgetMs <= 0.0f) {
+		return 0;
+	}
+	governor->cpuMs += (cpuMs - governor->cpuMs) * SMOOTHING;
+	if (gpuMs >= 0.0f) {
+		governor->gpuMs += (gpuMs - governor->gpuMs) * SMOOTHING;
+	}
+	governor->frameMs = fmaxf(governor->cpuMs, governor->gpuMs);
+	if (governor->settleFrames > 0) {
+		governor->settleFrames--;
+		return 0;
+	}
+	if (governor->frameMs > governor->budgetMs) {
+		governor->overFrames++;
+		governor->underFrames = 0;
+	} else if (governor->frameMs < governor->budgetMs * HEADROOM) {
+		governor->underFrames++;
+		governor->overFrames = 0;
+	} else {
+		governor->overFrames = 0;
+		governor->underFrames = 0;
+	}
+	if (governor->overFrames >= DEGRADE_FRAMES && governor->step < NUM_STEPS - 1) {
+		governor->step++;
+	} else if (governor->underFrames >= UPGRADE_FRAMES && governor->step > 0) {
+		governor->step--;
+	} else {
+		return 0;
+	}
+	governor->overFrames = 0;
+	governor->underFrames = 0;
+	governor->settleFrames = SETTLE_FRAMES;
+	governor->changes++;
+	return 1;
+}
+/**
+ * governorScale
+ * Of the window's width and height the scene is drawn at.
+ */
+float governorScale(const Governor* governor) {
+	return ladder[governor->step].scale;
+}
+/**
+ * governorQualityLevel
+ */
+int governorQualityLevel(const Governor* governor) {
+	return ladder[governor->step].quality;
+}
+/**
+ * governorQuality
+ * What a quality level draws, levels past the last draw as the last.
+ */
+const GovernorQuality* governorQuality(int level) {
+	if (level < 0) {
+		level = 0;
+	}
+	if (level >= GOVERNOR_QUALITY_LEVELS) {
+		level = GOVERNOR_QUALITY_LEVELS - 1;
+	}
+	return &qualities[level];
+}
+/**
+ * freeTarget
+ * Deletes the framebuffer and its renderbuffers, the timestamps are kept.
+ */
+static void freeTarget(void) {
+	if (framebuffer != 0) {
+		pglDeleteFramebuffers(1, &framebuffer);
+		pglDeleteRenderbuffers(1, &colorBuffer);
+		pglDeleteRenderbuffers(1, &depthBuffer);
+	}
+	framebuffer = 0;
+	colorBuffer = 0;
+	depthBuffer = 0;
+	targetWidth = 0;
+	targetHeight = 0;
+}
+/**
+ * allocateTarget
+ * Sizes the framebuffer for a window. Returns 0 if it cannot be used.
+ */
+static int allocateTarget(int width, int height) {
+	if (width == targetWidth && height == targetHeight) {
+		return framebuffer != 0;
+	}
+	if (framebuffer == 0) {
+		pglGenFramebuffers(1, &framebuffer);
+		pglGenRenderbuffers(1, &colorBuffer);
+		pglGenRenderbuffers(1, &depthBuffer);
+	}
+	pglBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	pglBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_RENDERBUFFER, colorBuffer);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			GL_RENDERBUFFER, depthBuffer);
+	if (pglCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Governor framebuffer is incomplete, the scene stays at full size.\n");
+		pglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		//a frame's timestamps may be in flight, only the target goes
+		freeTarget();
+		//not tried again for this size
+		targetWidth = width;
+		targetHeight = height;
+		return 0;
+	}
+	pglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	targetWidth = width;
+	targetHeight = height;
+	return 1;
+}
+/**
+ * collectTimestamps
+ * Reads the GPU time of the frame that last used a slot if it is done.
+ * Returns 0 if it is still in flight, the slot cannot be used yet.
+ */
+static int collectTimestamps(int slot) {
+	GLint available = 0;
+	GLuint64 start, end;
+	if (!queryUsed[slot]) {
+		return 1;
+	}
+	pglGetQueryObjectiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE,
+			&available);
+	if (!available) {
+		return 0;
+	}
+	pglGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &start);
+	pglGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+	latestGpuMs = (end - start) / 1000000.0f;
+	queryUsed[slot] = 0;
+	return 1;
+}
+/**
+ * governorBeginScene
+ * Starts the scene of a frame for a window of width by height, into the
+ * framebuffer if the governor scales it down, cleared. Sets the size the
+ * scene is drawn at.
+ */
+void governorBeginScene(const Governor* governor, int width, int height,
+		int* renderWidth, int* renderHeight) {
+	float scale = governorScale(governor);
+	*renderWidth = width;
+	*renderHeight = height;
+	queryStarted = 0;
+	if (hasTimerQueries) {
+		if (queries[0] == 0) {
+			pglGenQueries(QUERY_RING * 2, queries);
+		}
+		if (collectTimestamps(querySlot)) {
+			pglQueryCounter(queries[querySlot * 2], GL_TIMESTAMP);
+			queryStarted = 1;
+		}
+	}
+	scaled = 0;
+	if (scale >= 1.0f || !hasFramebuffers || !allocateTarget(width, height)) {
+		return;
+	}
+	sceneWidth = (int) (width * scale + 0.5f);
+	sceneHeight = (int) (height * scale + 0.5f);
+	sceneWidth = sceneWidth > 1 ? sceneWidth : 1;
+	sceneHeight = sceneHeight > 1 ? sceneHeight : 1;
+	windowWidth = width;
+	windowHeight = height;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, sceneWidth, sceneHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	scaled = 1;
+	*renderWidth = sceneWidth;
+	*renderHeight = sceneHeight;
+}
+/**
+ * governorEndScene
+ * Stretches a scaled scene over the window, filtered.
+ */
+void governorEndScene(void) {
+	if (scaled) {
+		pglBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		pglBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+		pglBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, windowWidth,
+				windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		pglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		scaled = 0;
+	}
+	if (queryStarted) {
+		pglQueryCounter(queries[querySlot * 2 + 1], GL_TIMESTAMP);
+		queryUsed[querySlot] = 1;
+		querySlot = (querySlot + 1) % QUERY_RING;
+		queryStarted = 0;
+	}
+}
+/**
+ * governorGpuMs
+ * GPU milliseconds of the latest scene whose time came back since the
+ * last call, -1 if none did.
+ */
+float governorGpuMs(void) {
+	float gpuMs = latestGpuMs;
+	latestGpuMs = -1.0f;
+	return gpuMs;
+}
+/**
+ * governorFree
+ */
+void governorFree(void) {
+	freeTarget();
+	if (queries[0] != 0) {
+		pglDeleteQueries(QUERY_RING * 2, queries);
+	}
+	memset(queries, 0, sizeof(queries));
+	memset(queryUsed, 0, sizeof(queryUsed));
+	querySlot = 0;
+	queryStarted = 0;
+}
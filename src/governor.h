@@ -0,0 +1,68 @@
+/*
+ * governor.h
+ * CG flight simulator
+ * Frame time governor: holds the scene to a budget of milliseconds a frame
+ * by rendering it at a lower resolution and with less detail when it takes
+ * too long, and back again when there is room.
+ * It steps along a fixed ladder of render scales and quality levels, one
+ * step at a time. A step down needs the smoothed frame time over budget for
+ * a few frames, a step up needs it well under budget for many more, and
+ * after each step the new time is given a while to settle, so it does not
+ * swing between two steps.
+ * The scene is drawn into a framebuffer of the scaled size and stretched
+ * over the window, the HUD is drawn after it at full size. GPU times come
+ * from timestamp queries read a few frames later, so they never stall and
+ * can be taken inside another query's frame.
+ */
+
+#ifndef GOVERNOR_H_
+#define GOVERNOR_H_
+#include "glPlatform.h"
+
+//quality levels, 0 is full detail
+#define GOVERNOR_QUALITY_LEVELS 4
+//terrain levels of detail, each drawing every other row and column of the last
+#define GOVERNOR_TERRAIN_LODS 3
+
+//what a quality level draws
+typedef struct GovernorQuality {
+	//terrain level of detail
+	int terrainLod;
+	//scales the pixels textures and aircraft are sized for
+	float detail;
+	//sky and sea slices are halved this many times
+	int tessellationShift;
+	//explosion shells and their slices and stacks
+	int explosionShells;
+	int explosionSlices;
+} GovernorQuality;
+
+typedef struct Governor {
+	//milliseconds a frame to hold, 0 for no governing
+	float budgetMs;
+	//smoothed times of the frames since the last step
+	float cpuMs;
+	float gpuMs;
+	float frameMs;
+	//place on the ladder, 0 is full resolution and detail
+	int step;
+	int overFrames;
+	int underFrames;
+	int settleFrames;
+	//steps taken
+	int changes;
+} Governor;
+
+void governorInit(Governor* governor, float budgetMs);
+int governorUpdate(Governor* governor, float cpuMs, float gpuMs);
+float governorScale(const Governor* governor);
+int governorQualityLevel(const Governor* governor);
+const GovernorQuality* governorQuality(int level);
+
+void governorBeginScene(const Governor* governor, int width, int height,
+		int* renderWidth, int* renderHeight);
+void governorEndScene(void);
+float governorGpuMs(void);
+void governorFree(void);
+
+#endif /* GOVERNOR_H_ */
@@ -0,0 +1,321 @@
+/**
+ * hud.c
+ * CG flight simulator
+ * Batched 2D overlay renderer.
+ * Bars, lines, circles and text are all quads textured from one small font
+ * atlas (solid primitives sample a white texel), so the whole HUD is a single
+ * interleaved vertex array drawn with one glDrawArrays after the 3D scene.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include "hud.h"
+
+#define HUD_ATLAS_WIDTH 128
+#define HUD_ATLAS_HEIGHT 32
+#define HUD_ATLAS_COLUMNS 16
+#define HUD_CELL_SIZE 8
+#define HUD_FIRST_CHAR 32
+#define HUD_NUM_CHARS 64
+
+//layout matches GL_T2F_C4UB_V3F for glInterleavedArrays
+typedef struct HudVertex {
+	GLfloat s;
+	GLfloat t;
+	GLubyte color[4];
+	GLfloat x;
+	GLfloat y;
+	GLfloat z;
+} HudVertex;
+
+static HudVertex vertices[HUD_MAX_VERTICES];
+static int numVertices = 0;
+static int hudWidth = 1;
+static int hudHeight = 1;
+static GLuint atlasTexture = 0;
+//texture coordinate of the solid white texel used by untextured primitives
+static GLfloat solidS;
+static GLfloat solidT;
+
+//5x7 font for ASCII 32-95, one byte per column, least significant bit on top
+static const unsigned char font[HUD_NUM_CHARS][HUD_GLYPH_WIDTH] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 },
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+	{ 0x36, 0x49, 0x56, 0x20, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 },
+	{ 0x2A, 0x1C, 0x7F, 0x1C, 0x2A }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 },
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+	{ 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E },
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E },
+	{ 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 },
+	{ 0x7F, 0x09, 0x09, 0x09, 0x01 }, { 0x3E, 0x41, 0x49, 0x49, 0x7A },
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x0C, 0x02, 0x7F },
+	{ 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E },
+	{ 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 },
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 },
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 } };
+
+/**
+ * hudInit
+ * Bakes the font into an alpha texture atlas.
+ * The space glyph cell is filled solid and used for untextured primitives.
+ */
+void hudInit(void) {
+	GLubyte atlas[HUD_ATLAS_HEIGHT][HUD_ATLAS_WIDTH] = { { 0 } };
+	int c, column, row;
+	for (c = 0; c < HUD_NUM_CHARS; c++) {
+		int cellX = (c % HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+		int cellY = (c / HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE;
+		for (column = 0; column < HUD_GLYPH_WIDTH; column++) {
+			for (row = 0; row < HUD_GLYPH_HEIGHT; row++) {
+				if (c == 0 || (font[c][column] >> row) & 1) {
+					atlas[cellY + row][cellX + column] = 255;
+				}
+			}
+		}
+	}
+	solidS = 2.5f / HUD_ATLAS_WIDTH;
+	solidT = 3.5f / HUD_ATLAS_HEIGHT;
+
+	if (atlasTexture == 0) {
+		glGenTextures(1, &atlasTexture);
+	}
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT,
+			0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+/**
+ * hudFree
+ * Releases the font atlas.
+ */
+void hudFree(void) {
+	if (atlasTexture != 0) {
+		glDeleteTextures(1, &atlasTexture);
+		atlasTexture = 0;
+	}
+}
+/**
+ * hudBegin
+ * Starts collecting primitives for a new frame of the given size.
+ */
+void hudBegin(int width, int height) {
+	numVertices = 0;
+	hudWidth = width > 0 ? width : 1;
+	hudHeight = height > 0 ? height : 1;
+}
+/**
+ * hudVertex
+ * Appends one vertex to the batch.
+ */
+static void hudVertex(float x, float y, float s, float t, const GLubyte color[4]) {
+	HudVertex* vertex = &vertices[numVertices++];
+	vertex->s = s;
+	vertex->t = t;
+	vertex->color[0] = color[0];
+	vertex->color[1] = color[1];
+	vertex->color[2] = color[2];
+	vertex->color[3] = color[3];
+	vertex->x = x;
+	vertex->y = y;
+	vertex->z = 0;
+}
+/**
+ * hudColor
+ * Converts a float color to bytes.
+ */
+static void hudColor(const GLfloat color[4], GLubyte out[4]) {
+	int i;
+	for (i = 0; i < 4; i++) {
+		float c = color[i] < 0 ? 0 : (color[i] > 1 ? 1 : color[i]);
+		out[i] = (GLubyte) (c * 255.0f + 0.5f);
+	}
+}
+/**
+ * hudQuad
+ * Appends an arbitrary quad, all corners sampling the same texel.
+ */
+static void hudQuad(float x0, float y0, float x1, float y1, float x2, float y2,
+		float x3, float y3, const GLubyte color[4]) {
+	if (numVertices + 4 > HUD_MAX_VERTICES) {
+		return;
+	}
+	hudVertex(x0, y0, solidS, solidT, color);
+	hudVertex(x1, y1, solidS, solidT, color);
+	hudVertex(x2, y2, solidS, solidT, color);
+	hudVertex(x3, y3, solidS, solidT, color);
+}
+/**
+ * hudRect
+ * Adds a filled axis aligned rectangle, origin is the bottom left corner.
+ */
+void hudRect(float x, float y, float width, float height, const GLfloat color[4]) {
+	GLubyte c[4];
+	hudColor(color, c);
+	hudQuad(x, y, x + width, y, x + width, y + height, x, y + height, c);
+}
+/**
+ * hudLine
+ * Adds a line of the given width in pixels.
+ */
+void hudLine(float x0, float y0, float x1, float y1, float width,
+		const GLfloat color[4]) {
+	GLubyte c[4];
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float length = sqrtf(dx * dx + dy * dy);
+	if (length <= 0.0f) {
+		return;
+	}
+	//offset perpendicular to the line by half the width
+	float nx = -dy / length * width * 0.5f;
+	float ny = dx / length * width * 0.5f;
+	hudColor(color, c);
+	hudQuad(x0 - nx, y0 - ny, x1 - nx, y1 - ny, x1 + nx, y1 + ny, x0 + nx,
+			y0 + ny, c);
+}
+/**
+ * hudCircle
+ * Adds a circle outline made of line segments.
+ */
+void hudCircle(float x, float y, float radius, float width, int segments,
+		const GLfloat color[4]) {
+	int i;
+	float angleStep = (2.0f * M_PI) / segments;
+	float lastX = x;
+	float lastY = y + radius;
+	for (i = 1; i <= segments; i++) {
+		float nextX = x + sinf(i * angleStep) * radius;
+		float nextY = y + cosf(i * angleStep) * radius;
+		hudLine(lastX, lastY, nextX, nextY, width, color);
+		lastX = nextX;
+		lastY = nextY;
+	}
+}
+/**
+ * hudTextWidth
+ * Returns the width in pixels of a string drawn at the given scale.
+ */
+float hudTextWidth(const char* text, float scale) {
+	int length = 0;
+	while (text[length] != '\0') {
+		length++;
+	}
+	return length * HUD_GLYPH_ADVANCE * scale;
+}
+/**
+ * hudText
+ * Adds a string, (x, y) is the bottom left of the first glyph.
+ * Returns the x position after the last glyph.
+ */
+float hudText(float x, float y, float scale, const GLfloat color[4],
+		const char* text) {
+	GLubyte c[4];
+	hudColor(color, c);
+	for (; *text != '\0'; text++) {
+		int ch = (unsigned char) *text;
+		//the font only has upper case
+		if (ch >= 'a' && ch <= 'z') {
+			ch -= 'a' - 'A';
+		}
+		ch -= HUD_FIRST_CHAR;
+		if (ch > 0 && ch < HUD_NUM_CHARS && numVertices + 4 <= HUD_MAX_VERTICES) {
+			float s0 = (float) ((ch % HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE)
+					/ HUD_ATLAS_WIDTH;
+			float t0 = (float) ((ch / HUD_ATLAS_COLUMNS) * HUD_CELL_SIZE)
+					/ HUD_ATLAS_HEIGHT;
+			float s1 = s0 + (float) HUD_GLYPH_WIDTH / HUD_ATLAS_WIDTH;
+			float t1 = t0 + (float) HUD_GLYPH_HEIGHT / HUD_ATLAS_HEIGHT;
+			float w = HUD_GLYPH_WIDTH * scale;
+			float h = HUD_GLYPH_HEIGHT * scale;
+			//row 0 of the glyph is its top
+			hudVertex(x, y, s0, t1, c);
+			hudVertex(x + w, y, s1, t1, c);
+			hudVertex(x + w, y + h, s1, t0, c);
+			hudVertex(x, y + h, s0, t0, c);
+		}
+		x += HUD_GLYPH_ADVANCE * scale;
+	}
+	return x;
+}
+/**
+ * hudPrintf
+ * Formats and adds a string, see hudText.
+ */
+float hudPrintf(float x, float y, float scale, const GLfloat color[4],
+		const char* format, ...) {
+	char text[128];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	return hudText(x, y, scale, color, text);
+}
+/**
+ * hudFlush
+ * Draws everything collected since hudBegin with one call, using an
+ * orthographic projection in window pixels. GL state is restored afterwards.
+ */
+void hudFlush(void) {
+	if (numVertices == 0 || atlasTexture == 0) {
+		return;
+	}
+	glPushAttrib(
+			GL_ENABLE_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT | GL_POLYGON_BIT
+					| GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, hudWidth, 0, hudHeight, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_FOG);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_COLOR_MATERIAL);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	glInterleavedArrays(GL_T2F_C4UB_V3F, 0, vertices);
+	glDrawArrays(GL_QUADS, 0, numVertices);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopClientAttrib();
+	glPopAttrib();
+	numVertices = 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * hud.h
+ * CG flight simulator
+ * Batched 2D overlay renderer. Every HUD primitive for a frame is collected
+ * into a single vertex array and drawn with one call after the 3D scene.
+ */
+
+#ifndef HUD_H_
+#define HUD_H_
+#include "glPlatform.h"
+
+//maximum number of vertices per frame, primitives past this are dropped
+#define HUD_MAX_VERTICES 8192
+//size of a glyph in the font atlas in pixels (before scaling)
+#define HUD_GLYPH_WIDTH 5
+#define HUD_GLYPH_HEIGHT 7
+#define HUD_GLYPH_ADVANCE 6
+
+void hudInit(void);
+void hudFree(void);
+
+void hudBegin(int width, int height);
+void hudFlush(void);
+
+void hudRect(float x, float y, float width, float height, const GLfloat color[4]);
+void hudLine(float x0, float y0, float x1, float y1, float width,
+		const GLfloat color[4]);
+void hudCircle(float x, float y, float radius, float width, int segments,
+		const GLfloat color[4]);
+float hudText(float x, float y, float scale, const GLfloat color[4],
+		const char* text);
+float hudPrintf(float x, float y, float scale, const GLfloat color[4],
+		const char* format, ...);
+float hudTextWidth(const char* text, float scale);
+
+#endif /* HUD_H_ */
@@ -0,0 +1,175 @@
+/**
+ * jobs.c
+ * CG flight simulator
+ * Worker thread pool. A parallel for hands out chunks of [0, count) from an
+ * atomic counter, so uneven chunks balance themselves, and blocks until
+ * every worker has finished.
+ */
+
+#include <pthread.h>
+#include "jobs.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static pthread_t threads[JOBS_MAX_THREADS];
+static int numWorkers = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+static unsigned int generation = 0;
+static int busyWorkers = 0;
+static int quitting = 0;
+
+static JobFunction jobFunction;
+static void* jobData;
+static int jobCount;
+static int jobGrain;
+static int nextIndex;
+//worker index of this thread and whether it is inside a job
+static __thread int threadWorker = 0;
+static __thread int threadInJob = 0;
+
+/**
+ * runChunks
+ * Takes chunks of the current job until there are none left.
+ */
+static void runChunks(int worker) {
+	for (;;) {
+		int begin = __atomic_fetch_add(&nextIndex, jobGrain, __ATOMIC_RELAXED);
+		if (begin >= jobCount) {
+			break;
+		}
+		int end = begin + jobGrain < jobCount ? begin + jobGrain : jobCount;
+		threadInJob = 1;
+		jobFunction(jobData, begin, end, worker);
+		threadInJob = 0;
+	}
+}
+/**
+ * workerMain
+ * Sleeps until a new job is posted, helps with it, reports back.
+ */
+static void* workerMain(void* argument) {
+	int worker = (int) (long) argument;
+	unsigned int seen = 0;
+	threadWorker = worker;
+	pthread_mutex_lock(&mutex);
+	for (;;) {
+		while (generation == seen && quitting == 0) {
+			pthread_cond_wait(&wake, &mutex);
+		}
+		if (quitting == 1) {
+			break;
+		}
+		seen = generation;
+		pthread_mutex_unlock(&mutex);
+		runChunks(worker);
+		pthread_mutex_lock(&mutex);
+		busyWorkers--;
+		if (busyWorkers == 0) {
+			pthread_cond_signal(&finished);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+/**
+ * jobsCoreCount
+ * Returns the number of online processors.
+ */
+int jobsCoreCount(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int) cores : 1;
+#endif
+}
+/**
+ * jobsInit
+ * Starts the pool. numThreads counts the calling thread, 0 means one per core.
+ * Returns the total number of workers.
+ */
+int jobsInit(int numThreads) {
+	int i;
+	if (numWorkers > 0) {
+		return numWorkers + 1;
+	}
+	if (numThreads <= 0) {
+		numThreads = jobsCoreCount();
+	}
+	if (numThreads > JOBS_MAX_THREADS) {
+		numThreads = JOBS_MAX_THREADS;
+	}
+	quitting = 0;
+	for (i = 1; i < numThreads; i++) {
+		if (pthread_create(&threads[numWorkers], NULL, workerMain,
+				(void*) (long) i) != 0) {
+			break;
+		}
+		numWorkers++;
+	}
+	return numWorkers + 1;
+}
+/**
+ * jobsShutdown
+ * Stops and joins the pool threads.
+ */
+void jobsShutdown(void) {
+	int i;
+	pthread_mutex_lock(&mutex);
+	quitting = 1;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&mutex);
+	for (i = 0; i < numWorkers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	numWorkers = 0;
+}
+/**
+ * jobsWorkerCount
+ * Returns the number of workers including the calling thread, this is the
+ * upper bound of the worker index passed to jobs.
+ */
+int jobsWorkerCount(void) {
+	return numWorkers + 1;
+}
+/**
+ * jobsParallelFor
+ * Runs function over [0, count) in chunks of grain and waits for it.
+ * Called from inside a job it runs the whole range on the calling worker.
+ */
+void jobsParallelFor(int count, int grain, JobFunction function, void* data) {
+	if (grain < 1) {
+		grain = 1;
+	}
+	if (numWorkers == 0 || count <= grain || threadInJob == 1) {
+		if (count > 0) {
+			function(data, 0, count, threadWorker);
+		}
+		return;
+	}
+	pthread_mutex_lock(&mutex);
+	jobFunction = function;
+	jobData = data;
+	jobCount = count;
+	jobGrain = grain;
+	nextIndex = 0;
+	busyWorkers = numWorkers;
+	generation++;
+	pthread_cond_broadcast(&wake);
+	pthread_mutex_unlock(&mutex);
+
+	runChunks(0);
+
+	pthread_mutex_lock(&mutex);
+	while (busyWorkers > 0) {
+		pthread_cond_wait(&finished, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,23 @@
+/*
+ * jobs.h
+ * CG flight simulator
+ * Small worker thread pool running parallel for loops.
+ * The calling thread takes part as worker 0, pool threads are 1..n.
+ * A job that starts a parallel loop itself runs it inline on its own worker,
+ * so independent worlds can be simulated one per job.
+ */
+
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#define JOBS_MAX_THREADS 64
+
+typedef void (*JobFunction)(void* data, int begin, int end, int worker);
+
+int jobsInit(int numThreads);
+void jobsShutdown(void);
+int jobsWorkerCount(void);
+int jobsCoreCount(void);
+void jobsParallelFor(int count, int grain, JobFunction function, void* data);
+
+#endif /* JOBS_H_ */
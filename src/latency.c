@@ -0,0 +1,231 @@
+/**
+ * latency.c
+ * CG flight simulator
+ * Input to present latency measurement, see latency.h.
+ * The present is timed by waiting on a fence put in right after the swap
+ * (glFinish without fences), every frame while measuring so frames with
+ * and without input go through the same pipeline. The driver can then not
+ * queue frames ahead, so the numbers are the latency of the loop itself.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "latency.h"
+#include "glFunctions.h"
+#include "timer.h"
+
+//one second, in nanoseconds
+#define LATENCY_FENCE_TIMEOUT 1000000000ull
+
+static int capacity = 0;
+//per event
+static double* arrived = NULL;
+static double* consumed = NULL;
+static double* presented = NULL;
+static unsigned int* ticks = NULL;
+static unsigned int* frames = NULL;
+//events that reached each stage
+static int numInputs = 0;
+static int numConsumed = 0;
+static int numShown = 0;
+static int numPresented = 0;
+static unsigned int frame = 0;
+
+/**
+ * latencyStart
+ * Starts measuring the next maxEvents input events. Returns 0 if out of
+ * memory.
+ */
+int latencyStart(int maxEvents) {
+	latencyStop();
+	arrived = malloc(sizeof(double) * maxEvents);
+	consumed = malloc(sizeof(double) * maxEvents);
+	presented = malloc(sizeof(double) * maxEvents);
+	ticks = malloc(sizeof(unsigned int) * maxEvents);
+	frames = malloc(sizeof(unsigned int) * maxEvents);
+	if (arrived == NULL || consumed == NULL || presented == NULL
+			|| ticks == NULL || frames == NULL) {
+		latencyStop();
+		return 0;
+	}
+	capacity = maxEvents;
+	return 1;
+}
+/**
+ * latencyStop
+ */
+void latencyStop(void) {
+	free(arrived);
+	free(consumed);
+	free(presented);
+	free(ticks);
+	free(frames);
+	arrived = NULL;
+	consumed = NULL;
+	presented = NULL;
+	ticks = NULL;
+	frames = NULL;
+	capacity = 0;
+	numInputs = 0;
+	numConsumed = 0;
+	numShown = 0;
+	numPresented = 0;
+	frame = 0;
+}
+/**
+ * latencyActive
+ */
+int latencyActive(void) {
+	return capacity > 0;
+}
+/**
+ * latencyDone
+ * Returns 1 once every event measured has been presented.
+ */
+int latencyDone(void) {
+	return capacity > 0 && numPresented == capacity;
+}
+/**
+ * latencyInput
+ * Stamps an input event as it arrives, call from the input callbacks.
+ */
+void latencyInput(void) {
+	if (numInputs < capacity) {
+		arrived[numInputs++] = timerNow();
+	}
+}
+/**
+ * latencyTick
+ * Call at the start of a tick, before it reads the input.
+ */
+void latencyTick(unsigned int tick) {
+	double now = timerNow();
+	for (; numConsumed < numInputs; numConsumed++) {
+		consumed[numConsumed] = now;
+		ticks[numConsumed] = tick;
+	}
+}
+/**
+ * latencyFrame
+ * Call once a frame is drawn, before the swap.
+ */
+void latencyFrame(void) {
+	for (; numShown < numConsumed; numShown++) {
+		frames[numShown] = frame;
+	}
+	frame++;
+}
+/**
+ * latencyPresented
+ * Call right after the swap, waits until it is complete.
+ */
+void latencyPresented(void) {
+	double now;
+	if (capacity == 0) {
+		return;
+	}
+	if (hasSync) {
+		GLsync fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pglClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				LATENCY_FENCE_TIMEOUT);
+		pglDeleteSync(fence);
+	} else {
+		glFinish();
+	}
+	now = timerNow();
+	for (; numPresented < numShown; numPresented++) {
+		presented[numPresented] = now;
+	}
+}
+/**
+ * compareDoubles
+ */
+static int compareDoubles(const void* a, const void* b) {
+	double difference = *(const double*) a - *(const double*) b;
+	return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+/**
+ * reportStage
+ * Prints the spread of to - from in milliseconds, and its histogram if
+ * asked for.
+ */
+static void reportStage(FILE* out, const char* name, const double* from,
+		const double* to, int histogram) {
+	double* times = malloc(sizeof(double) * numPresented);
+	int buckets[LATENCY_BUCKETS];
+	double total = 0.0;
+	int first = LATENCY_BUCKETS;
+	int last = 0;
+	int largest = 0;
+	int i;
+	if (times == NULL || numPresented == 0) {
+		free(times);
+		return;
+	}
+	memset(buckets, 0, sizeof(buckets));
+	for (i = 0; i < numPresented; i++) {
+		int bucket;
+		times[i] = (to[i] - from[i]) * 1000.0;
+		total += times[i];
+		bucket = (int) (times[i] / LATENCY_BUCKET_MS);
+		bucket = bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+		buckets[bucket]++;
+	}
+	qsort(times, numPresented, sizeof(double), compareDoubles);
+	fprintf(out, "Latency: %-17s mean %6.2f ms, p50 %6.2f, p95 %6.2f, p99 %6.2f, max %6.2f\n",
+			name, total / numPresented, times[numPresented / 2],
+			times[(int) (numPresented * 0.95)], times[(int) (numPresented * 0.99)],
+			times[numPresented - 1]);
+	free(times);
+	if (!histogram) {
+		return;
+	}
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		if (buckets[i] > 0) {
+			first = i < first ? i : first;
+			last = i;
+			largest = buckets[i] > largest ? buckets[i] : largest;
+		}
+	}
+	for (i = first; i <= last; i++) {
+		int bar = buckets[i] * 50 / largest;
+		fprintf(out, "Latency: %3d-%-3d%s ms |", i * LATENCY_BUCKET_MS,
+				(i + 1) * LATENCY_BUCKET_MS, i == LATENCY_BUCKETS - 1 ? "+" : " ");
+		while (bar-- > 0) {
+			fputc('#', out);
+		}
+		fprintf(out, " %d\n", buckets[i]);
+	}
+}
+/**
+ * latencyReport
+ * Prints how long the presented events spent in each stage, and a
+ * histogram of the whole.
+ */
+void latencyReport(FILE* out) {
+	fprintf(out, "Latency: %d events over %u frames, present timed with %s\n",
+			numPresented, frame, hasSync ? "fences" : "glFinish");
+	reportStage(out, "input to tick", arrived, consumed, 0);
+	reportStage(out, "tick to present", consumed, presented, 0);
+	reportStage(out, "input to present", arrived, presented, 1);
+}
+/**
+ * latencyWriteSamples
+ * Writes one CSV line per presented event, times in milliseconds since the
+ * first event. Returns 0 if the file could not be written.
+ */
+int latencyWriteSamples(const char* fileName) {
+	FILE* file = fopen(fileName, "w");
+	int i;
+	if (file == NULL) {
+		return 0;
+	}
+	fprintf(file, "event,arrived_ms,tick,consumed_ms,frame,presented_ms\n");
+	for (i = 0; i < numPresented; i++) {
+		fprintf(file, "%d,%.3f,%u,%.3f,%u,%.3f\n", i,
+				(arrived[i] - arrived[0]) * 1000.0, ticks[i],
+				(consumed[i] - arrived[0]) * 1000.0, frames[i],
+				(presented[i] - arrived[0]) * 1000.0);
+	}
+	return fclose(file) == 0;
+}
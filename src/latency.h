@@ -0,0 +1,31 @@
+/*
+ * latency.h
+ * CG flight simulator
+ * Input to present latency measurement.
+ * Every input event is stamped when its callback runs, then tagged with the
+ * sim tick that first runs after it (the one that reads what the handler
+ * set), the frame drawn after that tick and the time that frame's swap was
+ * complete. Events pass through the stages in the order they came, so each
+ * stage only moves a counter along the same arrays.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+#include <stdio.h>
+
+//histogram bucket width and count, later samples go in the last bucket
+#define LATENCY_BUCKET_MS 2
+#define LATENCY_BUCKETS 40
+
+int latencyStart(int maxEvents);
+void latencyStop(void);
+int latencyActive(void);
+int latencyDone(void);
+void latencyInput(void);
+void latencyTick(unsigned int tick);
+void latencyFrame(void);
+void latencyPresented(void);
+void latencyReport(FILE* out);
+int latencyWriteSamples(const char* fileName);
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,374 @@
+/**
+ * minimap.c
+ * CG flight simulator
+ * Minimap layers and markers, see minimap.h.
+ * One framebuffer draws into either texture: the terrain layer with a
+ * depth buffer, the map without. The map is north up: world x to the
+ * right and world z down, range either way of the origin.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "minimap.h"
+#include "glFunctions.h"
+#include "shader.h"
+
+//half the width of each kind's marker, of the map's half width
+static const float markerSizes[SPATIAL_KIND_COUNT] = { 0.04f, 0.02f, 0.012f };
+static const GLfloat markerColors[SPATIAL_KIND_COUNT][4] = {
+		{ 1, 1, 1, 1 }, { 0.8f, 0.2f, 0.2f, 1 }, { 0.6f, 0.6f, 0.6f, 1 } };
+static const GLfloat seaColor[4] = { 0.0f, 0.05f, 0.35f, 1 };
+
+static const char* vertexSource =
+		"#version 120\n"
+		"attribute vec2 corner;\n"
+		"attribute float instanceX;\n"
+		"attribute float instanceZ;\n"
+		"attribute float instanceKind;\n"
+		"uniform float inverseRange;\n"
+		"uniform vec4 colors[3];\n"
+		"uniform float sizes[3];\n"
+		"varying vec4 markerColor;\n"
+		"void main() {\n"
+		"	int kind = int(instanceKind);\n"
+		"	markerColor = colors[kind];\n"
+		"	gl_Position = vec4(vec2(instanceX, -instanceZ) * inverseRange\n"
+		"			+ corner * sizes[kind], 0.0, 1.0);\n"
+		"}\n";
+
+static const char* fragmentSource =
+		"#version 120\n"
+		"varying vec4 markerColor;\n"
+		"void main() {\n"
+		"	gl_FragColor = markerColor;\n"
+		"}\n";
+
+static const char* attributes[] = { "corner", "instanceX", "instanceZ",
+		"instanceKind" };
+
+static const GLfloat corners[8] = { -1, -1, 1, -1, 1, 1, -1, 1 };
+
+static GLuint framebuffer = 0;
+static GLuint depthBuffer = 0;
+static GLuint terrainTexture = 0;
+static GLuint mapTexture = 0;
+static GLuint program = 0;
+static GLint inverseRangeLocation;
+static GLuint cornerBuffer = 0;
+static GLuint instanceBuffer = 0;
+//what was bound before the map was drawn into, bound again after
+static GLint previousFramebuffer = 0;
+
+/**
+ * createTexture
+ */
+static GLuint createTexture(void) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, MINIMAP_SIZE, MINIMAP_SIZE, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+/**
+ * bindTarget
+ * Starts drawing into a texture of the map, with the depth buffer or
+ * without. GL state is kept until releaseTarget.
+ */
+static void bindTarget(GLuint texture, int depth) {
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, texture, 0);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			GL_RENDERBUFFER, depth ? depthBuffer : 0);
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	glViewport(0, 0, MINIMAP_SIZE, MINIMAP_SIZE);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+}
+/**
+ * releaseTarget
+ */
+static void releaseTarget(void) {
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+	pglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+}
+/**
+ * minimapInit
+ * Creates the map's textures and framebuffer and clears both layers to
+ * the sea. Returns 0 if framebuffers are not available, there is no map
+ * then.
+ */
+int minimapInit(void) {
+	GLenum status;
+	int i;
+	if (!hasFramebuffers) {
+		return 0;
+	}
+	terrainTexture = createTexture();
+	mapTexture = createTexture();
+	pglGenRenderbuffers(1, &depthBuffer);
+	pglBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, MINIMAP_SIZE,
+			MINIMAP_SIZE);
+	pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+	pglGenFramebuffers(1, &framebuffer);
+
+	bindTarget(terrainTexture, 1);
+	status = pglCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glClearColor(seaColor[0], seaColor[1], seaColor[2], seaColor[3]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	releaseTarget();
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Minimap framebuffer is incomplete.\n");
+		minimapFree();
+		return 0;
+	}
+	bindTarget(mapTexture, 0);
+	glClearColor(seaColor[0], seaColor[1], seaColor[2], seaColor[3]);
+	glClear(GL_COLOR_BUFFER_BIT);
+	releaseTarget();
+
+	if (!hasShaders || !hasBuffers || !hasInstancing) {
+		return 1;
+	}
+	program = compileProgram(vertexSource, fragmentSource, attributes,
+			sizeof(attributes) / sizeof(attributes[0]));
+	if (program == 0) {
+		return 1;
+	}
+	inverseRangeLocation = pglGetUniformLocation(program, "inverseRange");
+	pglUseProgram(program);
+	for (i = 0; i < SPATIAL_KIND_COUNT; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "colors[%d]", i);
+		pglUniform4f(pglGetUniformLocation(program, name), markerColors[i][0],
+				markerColors[i][1], markerColors[i][2], markerColors[i][3]);
+		snprintf(name, sizeof(name), "sizes[%d]", i);
+		pglUniform1f(pglGetUniformLocation(program, name), markerSizes[i]);
+	}
+	pglUseProgram(0);
+	pglGenBuffers(1, &cornerBuffer);
+	pglBindBuffer(GL_ARRAY_BUFFER, cornerBuffer);
+	pglBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	pglGenBuffers(1, &instanceBuffer);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+	return 1;
+}
+/**
+ * minimapFree
+ */
+void minimapFree(void) {
+	if (program != 0) {
+		pglDeleteProgram(program);
+		pglDeleteBuffers(1, &cornerBuffer);
+		pglDeleteBuffers(1, &instanceBuffer);
+	}
+	if (framebuffer != 0) {
+		pglDeleteFramebuffers(1, &framebuffer);
+		pglDeleteRenderbuffers(1, &depthBuffer);
+		glDeleteTextures(1, &terrainTexture);
+		glDeleteTextures(1, &mapTexture);
+	}
+	program = 0;
+	cornerBuffer = 0;
+	instanceBuffer = 0;
+	framebuffer = 0;
+	depthBuffer = 0;
+	terrainTexture = 0;
+	mapTexture = 0;
+}
+/**
+ * minimapBeginTerrain
+ * Starts drawing the terrain layer over the sea, under projection and
+ * with the modelview matrix the caller loads. The islands are drawn
+ * filled whatever the polygon mode.
+ */
+void minimapBeginTerrain(const Mat4* projection) {
+	if (framebuffer == 0) {
+		return;
+	}
+	bindTarget(terrainTexture, 1);
+	glClearColor(seaColor[0], seaColor[1], seaColor[2], seaColor[3]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_FOG);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projection->m);
+	glMatrixMode(GL_MODELVIEW);
+}
+/**
+ * minimapEndTerrain
+ * Covers what was drawn below seaLevel with the sea, under the caller's
+ * modelview matrix, and finishes the terrain layer.
+ */
+void minimapEndTerrain(float seaLevel) {
+	float far = 1.0e5f;
+	if (framebuffer == 0) {
+		return;
+	}
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_CULL_FACE);
+	glColor4fv(seaColor);
+	glBegin(GL_QUADS);
+	glVertex3f(-far, seaLevel, -far);
+	glVertex3f(-far, seaLevel, far);
+	glVertex3f(far, seaLevel, far);
+	glVertex3f(far, seaLevel, -far);
+	glEnd();
+	releaseTarget();
+}
+/**
+ * drawInstanced
+ * Every marker in one draw, the hash's arrays as they are stored as the
+ * instance attributes.
+ */
+static void drawInstanced(const SpatialHash* hash, float range) {
+	GLsizeiptr floatBytes = sizeof(float) * hash->count;
+	int i;
+	pglBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	//new storage every refresh so the upload never waits for the GPU
+	pglBufferData(GL_ARRAY_BUFFER, floatBytes * 2 + hash->count, NULL,
+			GL_STREAM_DRAW);
+	pglBufferSubData(GL_ARRAY_BUFFER, 0, floatBytes, hash->x);
+	pglBufferSubData(GL_ARRAY_BUFFER, floatBytes, floatBytes, hash->z);
+	pglBufferSubData(GL_ARRAY_BUFFER, floatBytes * 2, hash->count, hash->kind);
+	pglVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void*) 0);
+	pglVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, (void*) floatBytes);
+	pglVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_FALSE, 0,
+			(void*) (floatBytes * 2));
+	pglBindBuffer(GL_ARRAY_BUFFER, cornerBuffer);
+	pglVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*) 0);
+	for (i = 0; i < 4; i++) {
+		pglVertexAttribDivisor(i, i == 0 ? 0 : 1);
+		pglEnableVertexAttribArray(i);
+	}
+
+	pglUseProgram(program);
+	pglUniform1f(inverseRangeLocation, 1.0f / range);
+	pglDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, hash->count);
+	pglUseProgram(0);
+
+	for (i = 0; i < 4; i++) {
+		pglDisableVertexAttribArray(i);
+		pglVertexAttribDivisor(i, 0);
+	}
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+/**
+ * drawFixedFunction
+ * Fallback without shaders, the markers as points a kind at a time, the
+ * player last so it stays on top.
+ */
+static void drawFixedFunction(const SpatialHash* hash, float range) {
+	int kind, i;
+	for (kind = SPATIAL_KIND_COUNT - 1; kind >= 0; kind--) {
+		glPointSize(markerSizes[kind] * MINIMAP_SIZE);
+		glColor4fv(markerColors[kind]);
+		glBegin(GL_POINTS);
+		for (i = 0; i < hash->count; i++) {
+			if (hash->kind[i] == kind) {
+				glVertex2f(hash->x[i] / range, -hash->z[i] / range);
+			}
+		}
+		glEnd();
+	}
+}
+/**
+ * minimapComposite
+ * Draws the map again: the terrain layer, then a marker for everything
+ * in the hash as it was last built.
+ */
+void minimapComposite(const SpatialHash* hash, float range) {
+	if (framebuffer == 0) {
+		return;
+	}
+	bindTarget(mapTexture, 0);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_FOG);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, terrainTexture);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex2f(-1, -1);
+	glTexCoord2f(1, 0);
+	glVertex2f(1, -1);
+	glTexCoord2f(1, 1);
+	glVertex2f(1, 1);
+	glTexCoord2f(0, 1);
+	glVertex2f(-1, 1);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
+	if (hash->count > 0) {
+		if (program != 0) {
+			drawInstanced(hash, range);
+		} else {
+			drawFixedFunction(hash, range);
+		}
+	}
+	releaseTarget();
+}
+/**
+ * minimapDraw
+ * Draws the map size pixels across with its bottom left corner at x, y in
+ * a window of the given size.
+ */
+void minimapDraw(float x, float y, float size, int windowWidth,
+		int windowHeight) {
+	if (framebuffer == 0) {
+		return;
+	}
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT
+			| GL_POLYGON_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_FOG);
+	glDisable(GL_CULL_FACE);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, mapTexture);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, windowWidth, 0, windowHeight, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex2f(x, y);
+	glTexCoord2f(1, 0);
+	glVertex2f(x + size, y);
+	glTexCoord2f(1, 1);
+	glVertex2f(x + size, y + size);
+	glTexCoord2f(0, 1);
+	glVertex2f(x, y + size);
+	glEnd();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+}
@@ -0,0 +1,33 @@
+/*
+ * minimap.h
+ * CG flight simulator
+ * Top-down map of the world in a corner of the HUD, kept in a texture.
+ * The islands do not move, so they are drawn into a layer of their own
+ * once a world (the caller draws them between minimapBeginTerrain and
+ * minimapEndTerrain, which covers what is under the sea). What moves is
+ * read from the spatial hash and drawn over a copy of that layer as
+ * markers, with shaders and instanced arrays all of them in one draw, only
+ * when the caller refreshes the map. Every frame in between only draws the
+ * texture.
+ */
+
+#ifndef MINIMAP_H_
+#define MINIMAP_H_
+#include "glPlatform.h"
+#include "vecmath.h"
+#include "spatial.h"
+
+//texels along each side of the map
+#define MINIMAP_SIZE 256
+//frames between refreshes
+#define MINIMAP_DEFAULT_RATE 4
+
+int minimapInit(void);
+void minimapFree(void);
+void minimapBeginTerrain(const Mat4* projection);
+void minimapEndTerrain(float seaLevel);
+void minimapComposite(const SpatialHash* hash, float range);
+void minimapDraw(float x, float y, float size, int windowWidth,
+		int windowHeight);
+
+#endif /* MINIMAP_H_ */
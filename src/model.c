@@ -0,0 +1,403 @@
+/**
+ * model.c
+ * CG flight simulator
+ * Loads the point/face model files into triangle arrays.
+ * Files list "v x y z" points, "n x y z" normals in the same order as the
+ * points, "g name" groups and "f a b c ..." polygons of 1-based indices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model.h"
+#include "vertexCache.h"
+
+static const GLfloat yellow[] = { 0.8, 0.8, 0.0, 1.0 };
+static const GLfloat red[] = { 1.0, 0.0, 0.0, 1.0 };
+static const GLfloat black[] = { 0.0, 0.0, 0.0, 1.0 };
+static const GLfloat blue[] = { 0.0, 0.0, 0.8, 1.0 };
+static const GLfloat purple[] = { 0.7, 0.5, 0.9, 1.0 };
+
+/**
+ * modelGroupColor
+ * Returns the color of a group (by order in the file) for a color scheme.
+ * Scheme 1 is the cessna, anything else the propeller.
+ */
+void modelGroupColor(int colorScheme, int objectCount, GLfloat color[4]) {
+	const GLfloat* source = black;
+	if (colorScheme == 1) {
+		if (objectCount <= 3) {
+			source = yellow;
+		} else if (objectCount >= 4 && objectCount <= 5) {
+			source = black;
+		} else if (objectCount == 6) {
+			source = purple;
+		} else if (objectCount == 7) {
+			source = blue;
+		} else if (objectCount >= 8 && objectCount <= 10) {
+			source = yellow;
+		} else if (objectCount == 11) {
+			source = black;
+		} else if (objectCount >= 12 && objectCount <= 13) {
+			source = yellow;
+		} else if (objectCount >= 14 && objectCount <= 25) {
+			source = blue;
+		} else {
+			source = yellow;
+		}
+	} else {
+		source = objectCount == 0 ? yellow : red;
+	}
+	memcpy(color, source, sizeof(GLfloat) * 4);
+}
+/**
+ * addVertex
+ * Appends a vertex to the mesh, growing the arrays as needed.
+ */
+static void addVertex(Mesh* mesh, int* capacity, const GLfloat* point,
+		const GLfloat* normal, const GLfloat* color) {
+	if (mesh->numVertices == *capacity) {
+		*capacity = *capacity == 0 ? 1024 : *capacity * 2;
+		mesh->positions = realloc(mesh->positions, sizeof(GLfloat) * 3 * *capacity);
+		mesh->normals = realloc(mesh->normals, sizeof(GLfloat) * 3 * *capacity);
+		mesh->colors = realloc(mesh->colors, sizeof(GLfloat) * 4 * *capacity);
+	}
+	memcpy(&mesh->positions[mesh->numVertices * 3], point, sizeof(GLfloat) * 3);
+	memcpy(&mesh->normals[mesh->numVertices * 3], normal, sizeof(GLfloat) * 3);
+	memcpy(&mesh->colors[mesh->numVertices * 4], color, sizeof(GLfloat) * 4);
+	mesh->numVertices++;
+}
+/**
+ * addTriangle
+ */
+static void addTriangle(ModelFile* model, int* capacity, int a, int b, int c) {
+	if (model->numTriangles == *capacity) {
+		*capacity = *capacity == 0 ? 1024 : *capacity * 2;
+		model->corners = realloc(model->corners, sizeof(int) * 3 * *capacity);
+		model->groups = realloc(model->groups, sizeof(int) * *capacity);
+	}
+	model->corners[model->numTriangles * 3] = a;
+	model->corners[model->numTriangles * 3 + 1] = b;
+	model->corners[model->numTriangles * 3 + 2] = c;
+	model->groups[model->numTriangles] = model->numGroups - 1;
+	model->numTriangles++;
+}
+/**
+ * readModelFile
+ * Reads a model file, triangulating each polygon as a fan. Returns 0 if it
+ * could not be read or has no triangles.
+ */
+int readModelFile(const char* fileName, ModelFile* model) {
+	int pointCapacity = 0;
+	int triangleCapacity = 0;
+	int normalCount = 0;
+	char line[256];
+	FILE* file = fopen(fileName, "rt");
+
+	memset(model, 0, sizeof(ModelFile));
+	if (file == NULL) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		GLfloat x, y, z;
+		if (sscanf(line, "v %f %f %f", &x, &y, &z) == 3) {
+			if (model->numPoints == pointCapacity) {
+				pointCapacity = pointCapacity == 0 ? 1024 : pointCapacity * 2;
+				model->points = realloc(model->points,
+						sizeof(GLfloat) * 3 * pointCapacity);
+				model->normals = realloc(model->normals,
+						sizeof(GLfloat) * 3 * pointCapacity);
+			}
+			model->points[model->numPoints * 3] = x;
+			model->points[model->numPoints * 3 + 1] = y;
+			model->points[model->numPoints * 3 + 2] = z;
+			model->normals[model->numPoints * 3] = 0;
+			model->normals[model->numPoints * 3 + 1] = 1;
+			model->normals[model->numPoints * 3 + 2] = 0;
+			model->numPoints++;
+		} else if (sscanf(line, "n %f %f %f", &x, &y, &z) == 3) {
+			if (normalCount < model->numPoints) {
+				model->normals[normalCount * 3] = x;
+				model->normals[normalCount * 3 + 1] = y;
+				model->normals[normalCount * 3 + 2] = z;
+			}
+			normalCount++;
+		} else if (line[0] == 'g') {
+			line[strcspn(line, "\r\n")] = '\0';
+			model->groupLines = realloc(model->groupLines,
+					sizeof(char*) * (model->numGroups + 1));
+			model->groupLines[model->numGroups] = malloc(strlen(line) + 1);
+			strcpy(model->groupLines[model->numGroups], line);
+			model->numGroups++;
+		} else if (line[0] == 'f') {
+			int face[64];
+			int numIndices = 0;
+			int i;
+			char* token = strtok(line + 1, " \t\r\n");
+			while (token != NULL && numIndices < 64) {
+				int f = atoi(token);
+				if (f > 0 && f <= model->numPoints) {
+					face[numIndices++] = f - 1;
+				}
+				token = strtok(NULL, " \t\r\n");
+			}
+			for (i = 2; i < numIndices; i++) {
+				addTriangle(model, &triangleCapacity, face[0], face[i - 1],
+						face[i]);
+			}
+		}
+	}
+	fclose(file);
+	return model->numTriangles > 0;
+}
+/**
+ * freeModelFile
+ */
+void freeModelFile(ModelFile* model) {
+	int i;
+	for (i = 0; i < model->numGroups; i++) {
+		free(model->groupLines[i]);
+	}
+	free(model->groupLines);
+	free(model->points);
+	free(model->normals);
+	free(model->corners);
+	free(model->groups);
+	memset(model, 0, sizeof(ModelFile));
+}
+/**
+ * triangleColor
+ * Faces before the first group are black.
+ */
+static void triangleColor(const ModelFile* model, int colorScheme, int t,
+		GLfloat color[4]) {
+	if (model->groups[t] < 0) {
+		memcpy(color, black, sizeof(GLfloat) * 4);
+	} else {
+		modelGroupColor(colorScheme, model->groups[t], color);
+	}
+}
+/**
+ * loadMesh
+ * Loads a model, one vertex per triangle corner. Returns 0 on failure.
+ */
+int loadMesh(const char* fileName, int colorScheme, Mesh* mesh) {
+	ModelFile model;
+	int vertexCapacity = 0;
+	GLfloat color[4];
+	int t, i;
+
+	memset(mesh, 0, sizeof(Mesh));
+	if (!readModelFile(fileName, &model)) {
+		printf("Could not load resource.\n");
+		freeModelFile(&model);
+		return 0;
+	}
+	for (t = 0; t < model.numTriangles; t++) {
+		triangleColor(&model, colorScheme, t, color);
+		for (i = 0; i < 3; i++) {
+			int point = model.corners[t * 3 + i];
+			addVertex(mesh, &vertexCapacity, &model.points[point * 3],
+					&model.normals[point * 3], color);
+		}
+	}
+	freeModelFile(&model);
+	return mesh->numVertices > 0;
+}
+/**
+ * loadMeshLods
+ * Loads a model and its simplified versions written by --build-lods. A
+ * missing level is left empty along with the ones after it. Returns the
+ * number of levels loaded.
+ */
+int loadMeshLods(const char* fileName, int colorScheme,
+		Mesh lods[MODEL_LODS]) {
+	char lodName[256];
+	FILE* file;
+	int level;
+	memset(lods, 0, sizeof(Mesh) * MODEL_LODS);
+	if (!loadMesh(fileName, colorScheme, &lods[0])) {
+		return 0;
+	}
+	for (level = 1; level < MODEL_LODS; level++) {
+		snprintf(lodName, sizeof(lodName), "%s.lod%d", fileName, level);
+		file = fopen(lodName, "rt");
+		if (file == NULL) {
+			break;
+		}
+		fclose(file);
+		if (!loadMesh(lodName, colorScheme, &lods[level])) {
+			break;
+		}
+	}
+	return level;
+}
+/**
+ * freeMesh
+ */
+void freeMesh(Mesh* mesh) {
+	free(mesh->positions);
+	free(mesh->normals);
+	free(mesh->colors);
+	memset(mesh, 0, sizeof(Mesh));
+}
+/**
+ * colorIndex
+ * Returns the index of a color in colors, adding it if it is new.
+ */
+static int colorIndex(GLfloat (*colors)[4], int* numColors,
+		const GLfloat color[4]) {
+	int c;
+	for (c = 0; c < *numColors; c++) {
+		if (memcmp(colors[c], color, sizeof(GLfloat) * 4) == 0) {
+			return c;
+		}
+	}
+	memcpy(colors[c], color, sizeof(GLfloat) * 4);
+	(*numColors)++;
+	return c;
+}
+/**
+ * batchTriangles
+ * Sorts the triangles into batches by color, with one vertex per point and
+ * batch (a point used in two colors is split). batchOf gives the batch of
+ * each triangle. positions and normals must have room for every corner.
+ */
+static void batchTriangles(const ModelFile* model, const int* batchOf,
+		IndexedMesh* mesh, int* vertexOf, int* next, GLfloat* positions,
+		GLfloat* normals) {
+	int t, i, b;
+	for (t = 0; t < model->numTriangles; t++) {
+		mesh->batches[batchOf[t]].numIndices += 3;
+	}
+	for (b = 0; b < mesh->numBatches; b++) {
+		if (b > 0) {
+			mesh->batches[b].firstIndex = mesh->batches[b - 1].firstIndex
+					+ mesh->batches[b - 1].numIndices;
+		}
+		next[b] = mesh->batches[b].firstIndex;
+	}
+	memset(vertexOf, -1, sizeof(int) * model->numPoints * mesh->numBatches);
+	for (t = 0; t < model->numTriangles; t++) {
+		b = batchOf[t];
+		for (i = 0; i < 3; i++) {
+			int point = model->corners[t * 3 + i];
+			int* vertex = &vertexOf[point * mesh->numBatches + b];
+			if (*vertex < 0) {
+				*vertex = mesh->numVertices++;
+				memcpy(&positions[*vertex * 3], &model->points[point * 3],
+						sizeof(GLfloat) * 3);
+				memcpy(&normals[*vertex * 3], &model->normals[point * 3],
+						sizeof(GLfloat) * 3);
+			}
+			mesh->indices[next[b]++] = *vertex;
+		}
+	}
+	mesh->numIndices = model->numTriangles * 3;
+}
+/**
+ * loadIndexedMesh
+ * Loads a model with the triangles sorted into one batch per color. Each
+ * batch is reordered for the vertex cache, then the vertices for the order
+ * they are fetched in. The batch with the color of the file's last face is
+ * drawn last, so a draw leaves the same material behind as drawing the
+ * faces in file order did. Returns 0 on failure.
+ */
+int loadIndexedMesh(const char* fileName, int colorScheme, IndexedMesh* mesh) {
+	ModelFile model;
+	GLfloat (*colors)[4];
+	GLfloat color[4];
+	int numColors = 0;
+	int *triangleColors, *lastUse, *batchOf, *vertexOf, *next, *remap;
+	GLfloat *positions, *normals;
+	int ok;
+	int t, c, i;
+
+	memset(mesh, 0, sizeof(IndexedMesh));
+	if (!readModelFile(fileName, &model)) {
+		printf("Could not load resource.\n");
+		freeModelFile(&model);
+		return 0;
+	}
+	//at most one color per group and black
+	colors = malloc(sizeof(GLfloat) * 4 * (model.numGroups + 1));
+	lastUse = malloc(sizeof(int) * (model.numGroups + 1));
+	triangleColors = malloc(sizeof(int) * model.numTriangles);
+	batchOf = malloc(sizeof(int) * model.numTriangles);
+	next = malloc(sizeof(int) * (model.numGroups + 1));
+	vertexOf = malloc(sizeof(int) * model.numPoints * (model.numGroups + 1));
+	positions = malloc(sizeof(GLfloat) * 9 * model.numTriangles);
+	normals = malloc(sizeof(GLfloat) * 9 * model.numTriangles);
+	remap = malloc(sizeof(int) * 3 * model.numTriangles);
+	mesh->indices = malloc(sizeof(GLuint) * 3 * model.numTriangles);
+	mesh->batches = calloc(model.numGroups + 1, sizeof(MeshBatch));
+	ok = colors != NULL && lastUse != NULL && triangleColors != NULL
+			&& batchOf != NULL && next != NULL && vertexOf != NULL
+			&& positions != NULL && normals != NULL && remap != NULL
+			&& mesh->indices != NULL && mesh->batches != NULL;
+
+	if (ok) {
+		for (t = 0; t < model.numTriangles; t++) {
+			triangleColor(&model, colorScheme, t, color);
+			triangleColors[t] = colorIndex(colors, &numColors, color);
+			lastUse[triangleColors[t]] = t;
+		}
+		//batches in the order their colors are last used, next is the batch
+		//of each color for now
+		for (c = 0; c < numColors; c++) {
+			next[c] = 0;
+			for (i = 0; i < numColors; i++) {
+				next[c] += lastUse[i] < lastUse[c];
+			}
+			memcpy(mesh->batches[next[c]].color, colors[c], sizeof(color));
+		}
+		for (t = 0; t < model.numTriangles; t++) {
+			batchOf[t] = next[triangleColors[t]];
+		}
+		mesh->numBatches = numColors;
+		batchTriangles(&model, batchOf, mesh, vertexOf, next, positions,
+				normals);
+
+		for (i = 0; i < mesh->numBatches; i++) {
+			vertexCacheOptimize(&mesh->indices[mesh->batches[i].firstIndex],
+					mesh->batches[i].numIndices, mesh->numVertices);
+		}
+		vertexFetchOptimize(mesh->indices, mesh->numIndices, mesh->numVertices,
+				remap);
+		mesh->positions = malloc(sizeof(GLfloat) * 3 * mesh->numVertices);
+		mesh->normals = malloc(sizeof(GLfloat) * 3 * mesh->numVertices);
+		ok = mesh->positions != NULL && mesh->normals != NULL;
+	}
+	for (i = 0; ok && i < mesh->numVertices; i++) {
+		memcpy(&mesh->positions[remap[i] * 3], &positions[i * 3],
+				sizeof(GLfloat) * 3);
+		memcpy(&mesh->normals[remap[i] * 3], &normals[i * 3],
+				sizeof(GLfloat) * 3);
+	}
+
+	free(colors);
+	free(lastUse);
+	free(triangleColors);
+	free(batchOf);
+	free(next);
+	free(vertexOf);
+	free(positions);
+	free(normals);
+	free(remap);
+	freeModelFile(&model);
+	if (!ok) {
+		freeIndexedMesh(mesh);
+	}
+	return ok;
+}
+/**
+ * freeIndexedMesh
+ * Frees the arrays, the buffers are the caller's.
+ */
+void freeIndexedMesh(IndexedMesh* mesh) {
+	free(mesh->positions);
+	free(mesh->normals);
+	free(mesh->indices);
+	free(mesh->batches);
+	memset(mesh, 0, sizeof(IndexedMesh));
+}
@@ -0,0 +1,72 @@
+/*
+ * model.h
+ * CG flight simulator
+ * Loads the point/face model files into triangle arrays that can be drawn
+ * with vertex arrays or uploaded to buffers, either one vertex per corner
+ * with its color (Mesh) or indexed and batched by color (IndexedMesh).
+ */
+
+#ifndef MODEL_H_
+#define MODEL_H_
+#include "glPlatform.h"
+
+//levels of detail per model: the model itself and "<model>.lod1" onwards
+#define MODEL_LODS 4
+
+//a model file as it was read, polygons split into fans
+typedef struct ModelFile {
+	int numPoints;
+	//3 floats per point, each point has its own normal
+	GLfloat* points;
+	GLfloat* normals;
+	int numGroups;
+	//"g name" lines as they were read
+	char** groupLines;
+	int numTriangles;
+	//3 point indices per triangle
+	int* corners;
+	//group of each triangle, -1 before the first group
+	int* groups;
+} ModelFile;
+
+typedef struct Mesh {
+	int numVertices;
+	//3 floats per vertex
+	GLfloat* positions;
+	GLfloat* normals;
+	//4 floats per vertex
+	GLfloat* colors;
+} Mesh;
+
+//triangles of one color, drawn with one call
+typedef struct MeshBatch {
+	GLfloat color[4];
+	int firstIndex;
+	int numIndices;
+} MeshBatch;
+
+typedef struct IndexedMesh {
+	int numVertices;
+	//3 floats per vertex
+	GLfloat* positions;
+	GLfloat* normals;
+	int numIndices;
+	GLuint* indices;
+	int numBatches;
+	MeshBatch* batches;
+	//vertices (positions then normals) and indices, 0 if not uploaded
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+} IndexedMesh;
+
+int readModelFile(const char* fileName, ModelFile* model);
+void freeModelFile(ModelFile* model);
+int loadMesh(const char* fileName, int colorScheme, Mesh* mesh);
+int loadMeshLods(const char* fileName, int colorScheme,
+		Mesh lods[MODEL_LODS]);
+void freeMesh(Mesh* mesh);
+int loadIndexedMesh(const char* fileName, int colorScheme, IndexedMesh* mesh);
+void freeIndexedMesh(IndexedMesh* mesh);
+void modelGroupColor(int colorScheme, int objectCount, GLfloat color[4]);
+
+#endif /* MODEL_H_ */
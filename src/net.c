@@ -0,0 +1,137 @@
+/**
+ * net.c
+ * CG flight simulator
+ * UDP sockets, see net.h. Sockets are plain ints so callers need no
+ * platform headers, on Windows they hold the SOCKET value.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "net.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * netInit
+ * Starts the socket library. Returns 0 on failure.
+ */
+int netInit(void) {
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return 1;
+#endif
+}
+/**
+ * netOpen
+ * Opens a non-blocking UDP socket bound to the port on every interface,
+ * port 0 picks a free one. Returns -1 on failure.
+ */
+int netOpen(uint16_t port) {
+	struct sockaddr_in address;
+	//room for a burst of packets from hundreds of clients
+	int bufferSize = 4 * 1024 * 1024;
+	int s = (int) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s < 0) {
+		printf("Could not create socket.\n");
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(s, (struct sockaddr*) &address, sizeof(address)) != 0) {
+		printf("Could not bind port %d.\n", port);
+		netClose(s);
+		return -1;
+	}
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*) &bufferSize,
+			sizeof(bufferSize));
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	ioctlsocket(s, FIONBIO, &nonBlocking);
+#else
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+	return s;
+}
+/**
+ * netClose
+ */
+void netClose(int socket) {
+	if (socket < 0) {
+		return;
+	}
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+/**
+ * netResolve
+ * Looks up an IPv4 address by name or dotted quad. Returns 0 on failure.
+ */
+int netResolve(const char* host, uint16_t port, NetAddress* address) {
+	struct addrinfo hints;
+	struct addrinfo* result = NULL;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL) {
+		printf("Could not resolve %s.\n", host);
+		return 0;
+	}
+	address->host = ntohl(
+			((struct sockaddr_in*) result->ai_addr)->sin_addr.s_addr);
+	address->port = port;
+	freeaddrinfo(result);
+	return 1;
+}
+/**
+ * netSend
+ * Sends one datagram. Returns the bytes sent or -1 if it was dropped.
+ */
+int netSend(int socket, const NetAddress* address, const void* data, int size) {
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(address->host);
+	to.sin_port = htons(address->port);
+	return sendto(socket, data, size, 0, (struct sockaddr*) &to, sizeof(to));
+}
+/**
+ * netReceive
+ * Receives one datagram if one is waiting. Returns its size, or -1 if
+ * there is none.
+ */
+int netReceive(int socket, NetAddress* address, void* data, int capacity) {
+	struct sockaddr_in from;
+	socklen_t fromSize = sizeof(from);
+	int size = recvfrom(socket, data, capacity, 0, (struct sockaddr*) &from,
+			&fromSize);
+	if (size < 0) {
+		return -1;
+	}
+	address->host = ntohl(from.sin_addr.s_addr);
+	address->port = ntohs(from.sin_port);
+	return size;
+}
+/**
+ * netAddressEqual
+ */
+int netAddressEqual(const NetAddress* a, const NetAddress* b) {
+	return a->host == b->host && a->port == b->port;
+}
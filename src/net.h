@@ -0,0 +1,29 @@
+/*
+ * net.h
+ * CG flight simulator
+ * Minimal non-blocking UDP sockets over Winsock or BSD sockets.
+ */
+
+#ifndef NET_H_
+#define NET_H_
+#include <stdint.h>
+
+#define NET_DEFAULT_PORT 7777
+//largest datagram sent, stays under a typical MTU
+#define NET_MAX_PACKET 1200
+
+typedef struct NetAddress {
+	//IPv4 address and port in host byte order
+	uint32_t host;
+	uint16_t port;
+} NetAddress;
+
+int netInit(void);
+int netOpen(uint16_t port);
+void netClose(int socket);
+int netResolve(const char* host, uint16_t port, NetAddress* address);
+int netSend(int socket, const NetAddress* address, const void* data, int size);
+int netReceive(int socket, NetAddress* address, void* data, int capacity);
+int netAddressEqual(const NetAddress* a, const NetAddress* b);
+
+#endif /* NET_H_ */
@@ -0,0 +1,77 @@
+/**
+ * player.c
+ * CG flight simulator
+ * Pilot flight step, see player.h.
+ */
+
+#include <math.h>
+#include "player.h"
+
+/**
+ * playerSpawn
+ * Places a pilot at the start position, slots are spread along a line so
+ * pilots joining together do not overlap.
+ */
+void playerSpawn(PlayerState* player, int slot) {
+	player->x = (slot % 32) * 4.0f - 64.0f;
+	player->y = 5;
+	player->z = -15 - (slot / 32) * 4.0f;
+	player->rotation = 0;
+	player->yawRotation = 0;
+	player->tilt = 0;
+	player->speed = 1.0f;
+	player->alive = 1;
+	player->firing = 0;
+}
+/**
+ * playerStep
+ * Applies one tick of input, mirroring the alive part of update().
+ */
+void playerStep(PlayerState* player, const PlayerInput* input) {
+	float speedFactor;
+	player->firing = player->alive && (input->buttons & PLAYER_SHOOT) != 0;
+	if (!player->alive) {
+		return;
+	}
+	player->rotation += input->steerX / (10.5f * (player->speed + 1));
+	player->tilt = input->steerX * 40.0f;
+
+	if ((input->buttons & PLAYER_ACCELERATE)
+			&& player->speed <= PLAYER_MAX_SPEED - PLAYER_ACCELERATION) {
+		player->speed += PLAYER_ACCELERATION;
+	} else if ((input->buttons & PLAYER_DECELERATE)
+			&& player->speed >= PLAYER_MIN_SPEED + PLAYER_DECELERATION) {
+		player->speed -= PLAYER_DECELERATION;
+	}
+	if ((input->buttons & PLAYER_ALT_CONTROLS) == 0) {
+		if (input->buttons & PLAYER_MOVE_UP) {
+			player->y += PLAYER_RISE_SPEED;
+		} else if (input->buttons & PLAYER_MOVE_DOWN) {
+			player->y -= PLAYER_FALL_SPEED;
+		}
+	} else {
+		if (input->wheel > 0
+				&& player->speed <= PLAYER_MAX_SPEED - PLAYER_ACCELERATION) {
+			player->speed += PLAYER_ACCELERATION;
+		} else if (input->wheel < 0
+				&& player->speed >= PLAYER_MIN_SPEED + PLAYER_DECELERATION) {
+			player->speed -= PLAYER_DECELERATION;
+		}
+		player->yawRotation += input->steerY / (20 * (player->speed + 1));
+		if (player->yawRotation > 1) {
+			player->yawRotation = 1;
+		} else if (player->yawRotation < -1) {
+			player->yawRotation = -1;
+		}
+		player->y += sinf(player->yawRotation) * (player->speed + 1) / 10.0f;
+	}
+	speedFactor = (player->speed + 1) / 10.0f;
+	player->x += sinf(player->rotation) * speedFactor;
+	player->z += cosf(player->rotation) * speedFactor;
+
+	if (player->y < PLAYER_MIN_ALTITUDE) {
+		player->alive = 0;
+		player->firing = 0;
+		player->y = PLAYER_MIN_ALTITUDE;
+	}
+}
@@ -0,0 +1,58 @@
+/*
+ * player.h
+ * CG flight simulator
+ * Flight state of one pilot and the step applying one tick of input.
+ * This is the same kinematic flight as worldStep(), kept free of globals so
+ * the multiplayer server and the client's prediction run identical code.
+ */
+
+#ifndef PLAYER_H_
+#define PLAYER_H_
+#include <stdint.h>
+
+#define PLAYER_MAX_SPEED 4.0f
+#define PLAYER_MIN_SPEED 1.0f
+#define PLAYER_ACCELERATION 0.2f
+#define PLAYER_DECELERATION 0.1f
+#define PLAYER_RISE_SPEED 0.2f
+#define PLAYER_FALL_SPEED 0.2f
+//crash below this height
+#define PLAYER_MIN_ALTITUDE 2.0f
+
+typedef enum PlayerButton {
+	PLAYER_ACCELERATE = 1,
+	PLAYER_DECELERATE = 2,
+	PLAYER_MOVE_UP = 4,
+	PLAYER_MOVE_DOWN = 8,
+	PLAYER_SHOOT = 16,
+	PLAYER_ALT_CONTROLS = 32,
+	PLAYER_RESPAWN = 64
+} PlayerButton;
+
+typedef struct PlayerInput {
+	//sequence number given by the client, one per tick
+	uint32_t sequence;
+	uint8_t buttons;
+	//mouse offset from the window center, -0.5 to 0.5 of the window size
+	float steerX;
+	float steerY;
+	//scroll wheel notches, alternate controls only
+	int8_t wheel;
+} PlayerInput;
+
+typedef struct PlayerState {
+	float x;
+	float y;
+	float z;
+	float rotation;
+	float yawRotation;
+	float tilt;
+	float speed;
+	uint8_t alive;
+	uint8_t firing;
+} PlayerState;
+
+void playerSpawn(PlayerState* player, int slot);
+void playerStep(PlayerState* player, const PlayerInput* input);
+
+#endif /* PLAYER_H_ */
@@ -0,0 +1,279 @@
+/**
+ * record.c
+ * CG flight simulator
+ * Writes and plays back input recordings, see record.h for the format.
+ * Recordings are buffered through stdio while recording and read fully into
+ * memory for playback so replay never touches the disk per tick.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "record.h"
+
+static FILE* recordFile = NULL;
+static unsigned int recordLastTick = 0;
+
+static unsigned char* replayData = NULL;
+static long replaySize = 0;
+static long replayPosition = 0;
+static unsigned int replayLastTick = 0;
+//next decoded event, valid if replayHasPending
+static InputEvent replayPending;
+static int replayHasPending = 0;
+
+/**
+ * writeUnsigned
+ * Writes a little endian unsigned integer of the given size in bytes.
+ */
+static void writeUnsigned(unsigned int value, int bytes) {
+	int i;
+	for (i = 0; i < bytes; i++) {
+		fputc((value >> (8 * i)) & 0xFF, recordFile);
+	}
+}
+/**
+ * writeVarint
+ * Writes an unsigned integer 7 bits at a time, small tick deltas take one byte.
+ */
+static void writeVarint(unsigned int value) {
+	while (value >= 0x80) {
+		fputc((value & 0x7F) | 0x80, recordFile);
+		value >>= 7;
+	}
+	fputc(value, recordFile);
+}
+/**
+ * recordStart
+ * Opens a new recording and writes its header. Returns 0 on failure.
+ */
+int recordStart(const char* fileName, const RecordHeader* header) {
+	recordFile = fopen(fileName, "wb");
+	if (recordFile == NULL) {
+		printf("Could not create recording.\n");
+		return 0;
+	}
+	fwrite("FSRC", 1, 4, recordFile);
+	writeUnsigned(RECORD_VERSION, 1);
+	writeUnsigned(header->seed, 4);
+	writeUnsigned(header->width, 2);
+	writeUnsigned(header->height, 2);
+	writeUnsigned(header->tickMs, 2);
+	recordLastTick = 0;
+	return 1;
+}
+/**
+ * recordEvent
+ * Appends an event to the recording. Does nothing if not recording.
+ */
+void recordEvent(const InputEvent* event) {
+	if (recordFile == NULL) {
+		return;
+	}
+	writeVarint(event->tick - recordLastTick);
+	recordLastTick = event->tick;
+	writeUnsigned(event->type, 1);
+	switch (event->type) {
+	case EVENT_KEY_DOWN:
+	case EVENT_KEY_UP:
+	case EVENT_SPECIAL_DOWN:
+	case EVENT_SPECIAL_UP:
+		writeUnsigned(event->key, 1);
+		break;
+	case EVENT_MOUSE_BUTTON:
+		writeUnsigned(event->key, 1);
+		writeUnsigned(event->state, 1);
+		writeUnsigned((unsigned short) event->x, 2);
+		writeUnsigned((unsigned short) event->y, 2);
+		break;
+	case EVENT_MOUSE_MOVE:
+	case EVENT_RESIZE:
+		writeUnsigned((unsigned short) event->x, 2);
+		writeUnsigned((unsigned short) event->y, 2);
+		break;
+	case EVENT_SEED:
+		writeUnsigned(event->seed, 4);
+		break;
+	case EVENT_END:
+		break;
+	}
+}
+/**
+ * recordStop
+ * Marks the end of the recording at the given tick and closes it.
+ */
+void recordStop(unsigned int tick) {
+	InputEvent event = { .tick = tick, .type = EVENT_END };
+	if (recordFile == NULL) {
+		return;
+	}
+	recordEvent(&event);
+	fclose(recordFile);
+	recordFile = NULL;
+}
+/**
+ * isRecording
+ */
+int isRecording(void) {
+	return recordFile != NULL;
+}
+/**
+ * readUnsigned
+ * Reads a little endian unsigned integer, returns 0 past the end of data.
+ */
+static unsigned int readUnsigned(int bytes) {
+	unsigned int value = 0;
+	int i;
+	for (i = 0; i < bytes; i++) {
+		if (replayPosition < replaySize) {
+			value |= (unsigned int) replayData[replayPosition++] << (8 * i);
+		}
+	}
+	return value;
+}
+/**
+ * readVarint
+ */
+static unsigned int readVarint(void) {
+	unsigned int value = 0;
+	int shift = 0;
+	while (replayPosition < replaySize && shift < 32) {
+		unsigned char byte = replayData[replayPosition++];
+		value |= (unsigned int) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+		shift += 7;
+	}
+	return value;
+}
+/**
+ * decodeNext
+ * Decodes the next event into replayPending.
+ * A truncated recording ends as if it had an end event.
+ */
+static void decodeNext(void) {
+	InputEvent* event = &replayPending;
+	memset(event, 0, sizeof(InputEvent));
+	replayHasPending = 1;
+	if (replayPosition >= replaySize) {
+		event->tick = replayLastTick;
+		event->type = EVENT_END;
+		return;
+	}
+	replayLastTick += readVarint();
+	event->tick = replayLastTick;
+	event->type = readUnsigned(1);
+	switch (event->type) {
+	case EVENT_KEY_DOWN:
+	case EVENT_KEY_UP:
+	case EVENT_SPECIAL_DOWN:
+	case EVENT_SPECIAL_UP:
+		event->key = readUnsigned(1);
+		break;
+	case EVENT_MOUSE_BUTTON:
+		event->key = readUnsigned(1);
+		event->state = readUnsigned(1);
+		event->x = (short) readUnsigned(2);
+		event->y = (short) readUnsigned(2);
+		break;
+	case EVENT_MOUSE_MOVE:
+	case EVENT_RESIZE:
+		event->x = (short) readUnsigned(2);
+		event->y = (short) readUnsigned(2);
+		break;
+	case EVENT_SEED:
+		event->seed = readUnsigned(4);
+		break;
+	case EVENT_END:
+		break;
+	default:
+		printf("Corrupt recording.\n");
+		event->type = EVENT_END;
+		replayPosition = replaySize;
+		break;
+	}
+}
+/**
+ * replayOpen
+ * Loads a recording into memory and reads its header. Returns 0 on failure.
+ */
+int replayOpen(const char* fileName, RecordHeader* header) {
+	FILE* file = fopen(fileName, "rb");
+	if (file == NULL) {
+		printf("Could not load recording.\n");
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	replaySize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	replayData = malloc(replaySize > 0 ? replaySize : 1);
+	if (fread(replayData, 1, replaySize, file) != (size_t) replaySize
+			|| replaySize < 15 || memcmp(replayData, "FSRC", 4) != 0) {
+		printf("Not a recording.\n");
+		fclose(file);
+		replayClose();
+		return 0;
+	}
+	fclose(file);
+	replayPosition = 4;
+	if (readUnsigned(1) != RECORD_VERSION) {
+		printf("Unsupported recording version.\n");
+		replayClose();
+		return 0;
+	}
+	header->seed = readUnsigned(4);
+	header->width = readUnsigned(2);
+	header->height = readUnsigned(2);
+	header->tickMs = readUnsigned(2);
+	replayLastTick = 0;
+	decodeNext();
+	return 1;
+}
+/**
+ * replayNext
+ * Returns 1 and the next event if it is due at or before the given tick.
+ * The end event is returned once, after which replay is finished and
+ * nothing more is returned.
+ */
+int replayNext(unsigned int tick, InputEvent* event) {
+	if (replayData == NULL || !replayHasPending || replayPending.tick > tick) {
+		return 0;
+	}
+	*event = replayPending;
+	if (replayPending.type == EVENT_END) {
+		replayHasPending = 0;
+	} else {
+		decodeNext();
+	}
+	return 1;
+}
+/**
+ * replayTakeSeed
+ * Consumes the next event if it is a seed, used by handlers that reseed.
+ */
+int replayTakeSeed(unsigned int* seed) {
+	if (replayData == NULL || !replayHasPending
+			|| replayPending.type != EVENT_SEED) {
+		return 0;
+	}
+	*seed = replayPending.seed;
+	decodeNext();
+	return 1;
+}
+/**
+ * replayClose
+ */
+void replayClose(void) {
+	free(replayData);
+	replayData = NULL;
+	replaySize = 0;
+	replayPosition = 0;
+	replayHasPending = 0;
+}
+/**
+ * isReplaying
+ */
+int isReplaying(void) {
+	return replayData != NULL;
+}
@@ -0,0 +1,61 @@
+/*
+ * record.h
+ * CG flight simulator
+ * Compact binary recording of the world seed and the timestamped input
+ * stream, and playback of such recordings.
+ *
+ * File layout (little endian):
+ *  header: "FSRC", version (1 byte), seed (4), width (2), height (2), tick ms (2)
+ *  events: tick delta (varint), type (1 byte), type specific payload
+ */
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#define RECORD_VERSION 1
+
+typedef enum EventType {
+	EVENT_KEY_DOWN,
+	EVENT_KEY_UP,
+	EVENT_SPECIAL_DOWN,
+	EVENT_SPECIAL_UP,
+	EVENT_MOUSE_MOVE,
+	EVENT_MOUSE_BUTTON,
+	EVENT_RESIZE,
+	EVENT_SEED,
+	EVENT_END
+} EventType;
+
+typedef struct InputEvent {
+	//sim tick the event is consumed by
+	unsigned int tick;
+	EventType type;
+	//key, special key or mouse button
+	int key;
+	//mouse button state
+	int state;
+	//mouse position or window size
+	int x;
+	int y;
+	unsigned int seed;
+} InputEvent;
+
+typedef struct RecordHeader {
+	unsigned int seed;
+	int width;
+	int height;
+	int tickMs;
+} RecordHeader;
+
+int recordStart(const char* fileName, const RecordHeader* header);
+void recordEvent(const InputEvent* event);
+void recordStop(unsigned int tick);
+int isRecording(void);
+
+int replayOpen(const char* fileName, RecordHeader* header);
+int replayNext(unsigned int tick, InputEvent* event);
+int replayTakeSeed(unsigned int* seed);
+void replayClose(void);
+int isReplaying(void);
+
+#endif /* RECORD_H_ */
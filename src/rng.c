@@ -0,0 +1,137 @@
+/**
+ * rng.c
+ * CG flight simulator
+ * PCG32 random number streams with unbiased range mapping, and batched
+ * float generation using four xoshiro128+ lanes (SSE2 when available).
+ */
+
+#include "rng.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * rngSeed
+ * Seeds a generator. Generators with the same seed but different stream
+ * numbers produce unrelated sequences.
+ */
+void rngSeed(Rng* rng, uint64_t seed, uint64_t stream) {
+	rng->state = 0;
+	rng->increment = (stream << 1) | 1;
+	rngNext(rng);
+	rng->state += seed;
+	rngNext(rng);
+}
+/**
+ * rngSeedStream
+ * Seeds the stream of a subsystem for the given worker thread (0 if serial).
+ */
+void rngSeedStream(Rng* rng, uint64_t seed, RngStream stream, int worker) {
+	rngSeed(rng, seed, ((uint64_t) stream << 32) | (uint32_t) worker);
+}
+/**
+ * rngNext
+ * Returns the next 32 random bits.
+ */
+uint32_t rngNext(Rng* rng) {
+	uint64_t old = rng->state;
+	rng->state = old * 6364136223846793005ULL + rng->increment;
+	uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+	uint32_t rotation = old >> 59;
+	return (xorshifted >> rotation) | (xorshifted << ((-rotation) & 31));
+}
+/**
+ * rngBounded
+ * Returns an unbiased number in [0, bound) using Lemire's multiply method,
+ * which only needs a division in the rare rejection case.
+ */
+uint32_t rngBounded(Rng* rng, uint32_t bound) {
+	uint64_t m = (uint64_t) rngNext(rng) * bound;
+	uint32_t low = (uint32_t) m;
+	if (low < bound) {
+		uint32_t threshold = -bound % bound;
+		while (low < threshold) {
+			m = (uint64_t) rngNext(rng) * bound;
+			low = (uint32_t) m;
+		}
+	}
+	return m >> 32;
+}
+/**
+ * rngRange
+ * Returns a number in [min, max), or min if the range is empty.
+ */
+int rngRange(Rng* rng, int min, int max) {
+	if (max <= min) {
+		return min;
+	}
+	return min + (int) rngBounded(rng, (uint32_t) (max - min));
+}
+/**
+ * rngFloat
+ * Returns a float in [0, 1) using the top 24 bits.
+ */
+float rngFloat(Rng* rng) {
+	return (rngNext(rng) >> 8) * (1.0f / 16777216.0f);
+}
+/**
+ * rngFillFloats
+ * Fills an array with floats in [min, max).
+ * Four xoshiro128+ lanes are seeded from the stream and stepped together,
+ * lane i writing out[4n + i]. The scalar path produces identical output.
+ */
+void rngFillFloats(Rng* rng, float* out, int count, float min, float max) {
+	uint32_t s[4][4];
+	float scale = (max - min) * (1.0f / 16777216.0f);
+	int lane, i, j;
+	for (i = 0; i < 4; i++) {
+		for (lane = 0; lane < 4; lane++) {
+			s[i][lane] = rngNext(rng);
+		}
+	}
+	//all zero lanes would stay zero
+	for (lane = 0; lane < 4; lane++) {
+		s[0][lane] |= 1;
+	}
+	i = 0;
+#ifdef __SSE2__
+	__m128i s0 = _mm_loadu_si128((__m128i*) s[0]);
+	__m128i s1 = _mm_loadu_si128((__m128i*) s[1]);
+	__m128i s2 = _mm_loadu_si128((__m128i*) s[2]);
+	__m128i s3 = _mm_loadu_si128((__m128i*) s[3]);
+	__m128 vectorScale = _mm_set1_ps(scale);
+	__m128 vectorMin = _mm_set1_ps(min);
+	for (; i + 4 <= count; i += 4) {
+		__m128i result = _mm_add_epi32(s0, s3);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+		__m128 value = _mm_cvtepi32_ps(_mm_srli_epi32(result, 8));
+		_mm_storeu_ps(out + i, _mm_add_ps(vectorMin, _mm_mul_ps(value, vectorScale)));
+	}
+	_mm_storeu_si128((__m128i*) s[0], s0);
+	_mm_storeu_si128((__m128i*) s[1], s1);
+	_mm_storeu_si128((__m128i*) s[2], s2);
+	_mm_storeu_si128((__m128i*) s[3], s3);
+#endif
+	for (; i < count; i += 4) {
+		for (lane = 0; lane < 4; lane++) {
+			uint32_t result = s[0][lane] + s[3][lane];
+			uint32_t t = s[1][lane] << 9;
+			s[2][lane] ^= s[0][lane];
+			s[3][lane] ^= s[1][lane];
+			s[1][lane] ^= s[2][lane];
+			s[0][lane] ^= s[3][lane];
+			s[2][lane] ^= t;
+			s[3][lane] = (s[3][lane] << 11) | (s[3][lane] >> 21);
+			j = i + lane;
+			if (j < count) {
+				out[j] = min + (result >> 8) * scale;
+			}
+		}
+	}
+}
@@ -0,0 +1,41 @@
+/*
+ * rng.h
+ * CG flight simulator
+ * Seedable random number streams.
+ * Each subsystem (and each worker thread within one) owns an independent
+ * PCG32 stream so results are reproducible for a seed regardless of the
+ * order other subsystems draw numbers in.
+ */
+
+#ifndef RNG_H_
+#define RNG_H_
+#include <stdint.h>
+
+typedef enum RngStream {
+	RNG_TERRAIN,
+	RNG_WEAPONS,
+	RNG_EXPLOSION,
+	RNG_AI,
+	//scripted pilots of the batch runner
+	RNG_SCRIPT,
+	//erosion droplets, the worker is the tile they start in
+	RNG_EROSION,
+	//placement and variation of the archipelago's islands
+	RNG_ARCHIPELAGO,
+	RNG_STREAM_COUNT
+} RngStream;
+
+typedef struct Rng {
+	uint64_t state;
+	uint64_t increment;
+} Rng;
+
+void rngSeed(Rng* rng, uint64_t seed, uint64_t stream);
+void rngSeedStream(Rng* rng, uint64_t seed, RngStream stream, int worker);
+uint32_t rngNext(Rng* rng);
+uint32_t rngBounded(Rng* rng, uint32_t bound);
+int rngRange(Rng* rng, int min, int max);
+float rngFloat(Rng* rng);
+void rngFillFloats(Rng* rng, float* out, int count, float min, float max);
+
+#endif /* RNG_H_ */
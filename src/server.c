@@ -0,0 +1,561 @@
+/**
+ * server.c
+ * CG flight simulator
+ * Authoritative multiplayer server, see server.h.
+ * One server runs per process, its state is private to this file like the
+ * recorder's. serverRunThread runs it next to bot clients for load tests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "server.h"
+#include "snapshot.h"
+#include "timer.h"
+
+#define SERVER_INPUT_QUEUE 8
+#define SERVER_BULLETS 64
+#define SERVER_BULLET_LIFE 50
+#define SERVER_BULLET_SPEED 4.0f
+#define SERVER_HIT_RADIUS 1.5f
+//visibility reaches the 3x3 cells around a pilot
+#define SERVER_CELL_SIZE 128.0f
+#define SERVER_GRID_BUCKETS 4096
+#define SERVER_TIMING_SAMPLES 8192
+
+typedef struct ServerClient {
+	NetAddress address;
+	double lastHeard;
+	PlayerState player;
+	//inputs received ahead of the tick they are applied in
+	PlayerInput queue[SERVER_INPUT_QUEUE];
+	int queueStart;
+	int queueCount;
+	uint32_t lastQueued;
+	//input applied last tick, repeated while the queue is empty
+	PlayerInput input;
+	uint32_t inputAck;
+	//newest snapshot the client has decoded
+	uint32_t ackTick;
+	int hasAck;
+	Snapshot history[NET_HISTORY];
+	//bullet ring, life 0 means unused
+	float bulletX[SERVER_BULLETS];
+	float bulletY[SERVER_BULLETS];
+	float bulletZ[SERVER_BULLETS];
+	float bulletDirX[SERVER_BULLETS];
+	float bulletDirY[SERVER_BULLETS];
+	float bulletDirZ[SERVER_BULLETS];
+	int bulletLife[SERVER_BULLETS];
+	int nextBullet;
+	//next pilot in the same grid bucket
+	int cellNext;
+	//connected, a free id keeps the address of its last client
+	int active;
+} ServerClient;
+
+static int serverSocket = -1;
+static uint32_t serverSeed;
+static uint32_t serverTickCount;
+static double tickSeconds;
+static ServerClient* clients = NULL;
+//ids of connected clients, and a stack of free ids
+static int activeIds[SERVER_MAX_CLIENTS];
+static int numActive = 0;
+static int freeIds[SERVER_MAX_CLIENTS];
+static int numFree = 0;
+static int grid[SERVER_GRID_BUCKETS];
+
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+static ServerStats totals;
+static double tickSamples[SERVER_TIMING_SAMPLES];
+static double tickSum;
+static pthread_t thread;
+static volatile int threadStop;
+
+/**
+ * serverStart
+ * Opens the server socket. Returns 0 on failure.
+ */
+int serverStart(uint16_t port, uint32_t seed, int tickMs) {
+	int i;
+	if (!netInit()) {
+		return 0;
+	}
+	serverSocket = netOpen(port);
+	if (serverSocket < 0) {
+		return 0;
+	}
+	clients = calloc(SERVER_MAX_CLIENTS, sizeof(ServerClient));
+	if (clients == NULL) {
+		netClose(serverSocket);
+		serverSocket = -1;
+		return 0;
+	}
+	serverSeed = seed;
+	serverTickCount = 1;
+	tickSeconds = tickMs / 1000.0;
+	numActive = 0;
+	numFree = SERVER_MAX_CLIENTS;
+	for (i = 0; i < SERVER_MAX_CLIENTS; i++) {
+		//lowest ids are handed out first
+		freeIds[i] = SERVER_MAX_CLIENTS - 1 - i;
+	}
+	memset(&totals, 0, sizeof(totals));
+	tickSum = 0;
+	return 1;
+}
+/**
+ * serverStop
+ */
+void serverStop(void) {
+	netClose(serverSocket);
+	serverSocket = -1;
+	free(clients);
+	clients = NULL;
+	numActive = 0;
+}
+/**
+ * sendPacket
+ */
+static void sendPacket(const NetAddress* address, const PacketWriter* writer) {
+	if (netSend(serverSocket, address, writer->data, writer->size) > 0) {
+		pthread_mutex_lock(&statsMutex);
+		totals.bytesSent += writer->size;
+		totals.packetsSent++;
+		pthread_mutex_unlock(&statsMutex);
+	}
+}
+/**
+ * sendWelcome
+ */
+static void sendWelcome(int id) {
+	PacketWriter writer;
+	packetBegin(&writer, PACKET_WELCOME);
+	packetWriteUnsigned(&writer, id, 2);
+	packetWriteUnsigned(&writer, serverSeed, 4);
+	packetWriteUnsigned(&writer, serverTickCount, 4);
+	sendPacket(&clients[id].address, &writer);
+}
+/**
+ * addClient
+ * Connects a client, or welcomes it again if its hello was repeated.
+ */
+static void addClient(const NetAddress* address) {
+	ServerClient* client;
+	int i, id;
+	for (i = 0; i < numActive; i++) {
+		if (netAddressEqual(&clients[activeIds[i]].address, address)) {
+			sendWelcome(activeIds[i]);
+			return;
+		}
+	}
+	if (numFree == 0) {
+		return;
+	}
+	id = freeIds[--numFree];
+	activeIds[numActive++] = id;
+	client = &clients[id];
+	memset(client, 0, sizeof(ServerClient));
+	client->address = *address;
+	client->active = 1;
+	client->lastHeard = timerNow();
+	playerSpawn(&client->player, id);
+	for (i = 0; i < NET_HISTORY; i++) {
+		client->history[i].tick = UINT32_MAX;
+	}
+	sendWelcome(id);
+}
+/**
+ * removeClient
+ */
+static void removeClient(int index) {
+	clients[activeIds[index]].active = 0;
+	freeIds[numFree++] = activeIds[index];
+	activeIds[index] = activeIds[--numActive];
+}
+/**
+ * receiveInput
+ * Queues the inputs of an input packet that are newer than any seen, from
+ * the address of a connected client only.
+ */
+static void receiveInput(PacketReader* reader, const NetAddress* address) {
+	int id = packetReadUnsigned(reader, 2);
+	uint32_t ackTick = packetReadUnsigned(reader, 4);
+	uint32_t sequence = packetReadUnsigned(reader, 4);
+	int count = packetReadUnsigned(reader, 1);
+	ServerClient* client;
+	int i;
+	if (reader->error || id >= SERVER_MAX_CLIENTS || !clients[id].active
+			|| !netAddressEqual(&clients[id].address, address)) {
+		return;
+	}
+	client = &clients[id];
+	client->lastHeard = timerNow();
+	if (ackTick != 0 && (!client->hasAck || ackTick > client->ackTick)) {
+		client->ackTick = ackTick;
+		client->hasAck = 1;
+	}
+	for (i = 0; i < count; i++, sequence++) {
+		PlayerInput input;
+		input.sequence = sequence;
+		input.buttons = packetReadUnsigned(reader, 1);
+		input.steerX = (int8_t) packetReadUnsigned(reader, 1) / 254.0f;
+		input.steerY = (int8_t) packetReadUnsigned(reader, 1) / 254.0f;
+		input.wheel = (int8_t) packetReadUnsigned(reader, 1);
+		if (reader->error || sequence <= client->lastQueued) {
+			continue;
+		}
+		if (client->queueCount == SERVER_INPUT_QUEUE) {
+			//too far ahead, drop the oldest
+			client->queueStart = (client->queueStart + 1) % SERVER_INPUT_QUEUE;
+			client->queueCount--;
+		}
+		client->queue[(client->queueStart + client->queueCount)
+				% SERVER_INPUT_QUEUE] = input;
+		client->queueCount++;
+		client->lastQueued = sequence;
+	}
+}
+/**
+ * serverPoll
+ * Handles every packet waiting on the socket.
+ */
+void serverPoll(void) {
+	uint8_t data[NET_MAX_PACKET];
+	NetAddress address;
+	PacketReader reader;
+	int size, i;
+	while ((size = netReceive(serverSocket, &address, data, sizeof(data))) >= 0) {
+		pthread_mutex_lock(&statsMutex);
+		totals.bytesReceived += size;
+		pthread_mutex_unlock(&statsMutex);
+		switch (packetOpen(&reader, data, size)) {
+		case PACKET_HELLO:
+			if (packetReadUnsigned(&reader, 1) == NET_PROTOCOL_VERSION) {
+				addClient(&address);
+			}
+			break;
+		case PACKET_INPUT:
+			receiveInput(&reader, &address);
+			break;
+		case PACKET_BYE:
+			for (i = 0; i < numActive; i++) {
+				if (netAddressEqual(&clients[activeIds[i]].address, &address)) {
+					removeClient(i);
+					break;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+/**
+ * bucketOf
+ * Returns the grid bucket of the cell at the given cell coordinates.
+ */
+static int bucketOf(int cellX, int cellZ) {
+	return ((cellX * 73856093) ^ (cellZ * 19349663)) & (SERVER_GRID_BUCKETS - 1);
+}
+/**
+ * cellOf
+ */
+static int cellOf(float coordinate) {
+	return (int) floorf(coordinate / SERVER_CELL_SIZE);
+}
+/**
+ * fireBullet
+ * Spawns a bullet in front of a pilot, as update() does for the player.
+ */
+static void fireBullet(ServerClient* client) {
+	PlayerState* p = &client->player;
+	int b = client->nextBullet;
+	client->nextBullet = (b + 1) % SERVER_BULLETS;
+	client->bulletX[b] = p->x + sinf(p->rotation);
+	client->bulletY[b] = p->y + sinf(p->yawRotation) - 1;
+	client->bulletZ[b] = p->z + cosf(p->rotation);
+	client->bulletDirX[b] = sinf(p->rotation) * SERVER_BULLET_SPEED;
+	client->bulletDirY[b] = sinf(p->yawRotation) * SERVER_BULLET_SPEED;
+	client->bulletDirZ[b] = cosf(p->rotation) * SERVER_BULLET_SPEED;
+	client->bulletLife[b] = SERVER_BULLET_LIFE;
+}
+/**
+ * moveBullets
+ * Moves a client's bullets and crashes any other pilot they hit.
+ */
+static void moveBullets(int owner) {
+	ServerClient* client = &clients[owner];
+	int b;
+	for (b = 0; b < SERVER_BULLETS; b++) {
+		float x, y, z;
+		int cellX, cellZ;
+		if (client->bulletLife[b] == 0) {
+			continue;
+		}
+		client->bulletLife[b]--;
+		x = client->bulletX[b] += client->bulletDirX[b];
+		y = client->bulletY[b] += client->bulletDirY[b];
+		z = client->bulletZ[b] += client->bulletDirZ[b];
+		for (cellX = cellOf(x - SERVER_HIT_RADIUS);
+				cellX <= cellOf(x + SERVER_HIT_RADIUS); cellX++) {
+			for (cellZ = cellOf(z - SERVER_HIT_RADIUS);
+					cellZ <= cellOf(z + SERVER_HIT_RADIUS); cellZ++) {
+				int other = grid[bucketOf(cellX, cellZ)];
+				for (; other >= 0; other = clients[other].cellNext) {
+					PlayerState* target = &clients[other].player;
+					float dx = target->x - x, dy = target->y - y, dz = target->z - z;
+					if (other != owner && target->alive
+							&& dx * dx + dy * dy + dz * dz
+									< SERVER_HIT_RADIUS * SERVER_HIT_RADIUS) {
+						target->alive = 0;
+						target->firing = 0;
+						client->bulletLife[b] = 0;
+					}
+				}
+			}
+		}
+	}
+}
+/**
+ * buildSnapshot
+ * Fills a snapshot with the client itself and the nearest pilots around it,
+ * sorted by id.
+ */
+static void buildSnapshot(int id, Snapshot* snapshot) {
+	ServerClient* client = &clients[id];
+	int visible[NET_MAX_ENTITIES];
+	float distances[NET_MAX_VISIBLE];
+	int numVisible = 0;
+	int buckets[9];
+	int numBuckets = 0;
+	int cellX = cellOf(client->player.x);
+	int cellZ = cellOf(client->player.z);
+	int dx, dz, i, j;
+	for (dx = -1; dx <= 1; dx++) {
+		for (dz = -1; dz <= 1; dz++) {
+			int bucket = bucketOf(cellX + dx, cellZ + dz);
+			//two cells can share a bucket, visit it once
+			for (i = 0; i < numBuckets && buckets[i] != bucket; i++) {
+			}
+			if (i == numBuckets) {
+				buckets[numBuckets++] = bucket;
+			}
+		}
+	}
+	for (i = 0; i < numBuckets; i++) {
+		int other;
+		for (other = grid[buckets[i]]; other >= 0; other = clients[other].cellNext) {
+			float ox = clients[other].player.x - client->player.x;
+			float oz = clients[other].player.z - client->player.z;
+			float distance = ox * ox + oz * oz;
+			if (other == id) {
+				continue;
+			}
+			if (numVisible == NET_MAX_VISIBLE
+					&& distance >= distances[numVisible - 1]) {
+				continue;
+			}
+			//insertion into the list of the nearest, sorted by distance
+			j = numVisible < NET_MAX_VISIBLE ? numVisible++ : numVisible - 1;
+			for (; j > 0 && distances[j - 1] > distance; j--) {
+				distances[j] = distances[j - 1];
+				visible[j] = visible[j - 1];
+			}
+			distances[j] = distance;
+			visible[j] = other;
+		}
+	}
+	visible[numVisible++] = id;
+	//sort by id for delta coding
+	for (i = 1; i < numVisible; i++) {
+		int value = visible[i];
+		for (j = i; j > 0 && visible[j - 1] > value; j--) {
+			visible[j] = visible[j - 1];
+		}
+		visible[j] = value;
+	}
+	snapshot->tick = serverTickCount;
+	snapshot->inputAck = client->inputAck;
+	snapshot->count = numVisible;
+	for (i = 0; i < numVisible; i++) {
+		entityQuantise(&clients[visible[i]].player, visible[i],
+				&snapshot->entities[i]);
+	}
+}
+/**
+ * sendSnapshot
+ * Sends a client its snapshot, as a delta if its acknowledged snapshot is
+ * still in the history.
+ */
+static void sendSnapshot(int id) {
+	ServerClient* client = &clients[id];
+	Snapshot* snapshot = &client->history[(serverTickCount
+			/ NET_SNAPSHOT_INTERVAL) % NET_HISTORY];
+	const Snapshot* base = NULL;
+	PacketWriter writer;
+	//the slot being written holds a snapshot too old to be a base
+	if (client->hasAck && serverTickCount - client->ackTick
+			< NET_HISTORY * NET_SNAPSHOT_INTERVAL) {
+		base = &client->history[(client->ackTick / NET_SNAPSHOT_INTERVAL)
+				% NET_HISTORY];
+		if (base->tick != client->ackTick) {
+			base = NULL;
+		}
+	}
+	if (base == NULL) {
+		pthread_mutex_lock(&statsMutex);
+		totals.fullSnapshots++;
+		pthread_mutex_unlock(&statsMutex);
+	}
+	buildSnapshot(id, snapshot);
+	snapshotWrite(&writer, snapshot, base);
+	if (!writer.overflow) {
+		sendPacket(&client->address, &writer);
+	}
+}
+/**
+ * serverTick
+ * Steps every pilot with its next input, moves bullets and sends snapshots.
+ */
+void serverTick(void) {
+	double now = timerNow();
+	int i;
+	for (i = 0; i < numActive; i++) {
+		ServerClient* client = &clients[activeIds[i]];
+		if (now - client->lastHeard > SERVER_TIMEOUT) {
+			removeClient(i--);
+			continue;
+		}
+		if (client->queueCount > 0) {
+			client->input = client->queue[client->queueStart];
+			client->queueStart = (client->queueStart + 1) % SERVER_INPUT_QUEUE;
+			client->queueCount--;
+			client->inputAck = client->input.sequence;
+			if (client->input.buttons & PLAYER_RESPAWN) {
+				playerSpawn(&client->player, activeIds[i]);
+			}
+		}
+		playerStep(&client->player, &client->input);
+		if (client->player.firing) {
+			fireBullet(client);
+		}
+	}
+
+	for (i = 0; i < SERVER_GRID_BUCKETS; i++) {
+		grid[i] = -1;
+	}
+	for (i = 0; i < numActive; i++) {
+		int id = activeIds[i];
+		int bucket = bucketOf(cellOf(clients[id].player.x),
+				cellOf(clients[id].player.z));
+		clients[id].cellNext = grid[bucket];
+		grid[bucket] = id;
+	}
+	for (i = 0; i < numActive; i++) {
+		moveBullets(activeIds[i]);
+	}
+	if (serverTickCount % NET_SNAPSHOT_INTERVAL == 0) {
+		for (i = 0; i < numActive; i++) {
+			sendSnapshot(activeIds[i]);
+		}
+	}
+	serverTickCount++;
+}
+/**
+ * recordTickTime
+ */
+static void recordTickTime(double seconds) {
+	pthread_mutex_lock(&statsMutex);
+	tickSamples[totals.ticks % SERVER_TIMING_SAMPLES] = seconds;
+	tickSum += seconds;
+	if (seconds > totals.tickMax) {
+		totals.tickMax = seconds;
+	}
+	totals.ticks++;
+	totals.players = numActive;
+	pthread_mutex_unlock(&statsMutex);
+}
+/**
+ * compareSeconds
+ */
+static int compareSeconds(const void* a, const void* b) {
+	double difference = *(const double*) a - *(const double*) b;
+	return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+/**
+ * serverTakeStats
+ * Returns the statistics since the last call and starts counting again.
+ */
+void serverTakeStats(ServerStats* stats) {
+	int samples;
+	pthread_mutex_lock(&statsMutex);
+	*stats = totals;
+	samples = totals.ticks < SERVER_TIMING_SAMPLES ? totals.ticks
+			: SERVER_TIMING_SAMPLES;
+	if (totals.ticks > 0) {
+		stats->tickMean = tickSum / totals.ticks;
+		qsort(tickSamples, samples, sizeof(double), compareSeconds);
+		stats->tickP99 = tickSamples[(int) (samples * 0.99)];
+	}
+	memset(&totals, 0, sizeof(totals));
+	tickSum = 0;
+	pthread_mutex_unlock(&statsMutex);
+}
+/**
+ * serverRun
+ * Polls and ticks at the tick rate until stop is set. With a report
+ * interval, prints the statistics that often.
+ */
+void serverRun(volatile int* stop, double reportInterval) {
+	double next = timerNow();
+	double nextReport = next + reportInterval;
+	while (*stop == 0) {
+		double start = timerNow();
+		serverPoll();
+		serverTick();
+		recordTickTime(timerNow() - start);
+		next += tickSeconds;
+		if (timerNow() - next > 0.25) {
+			//far behind, do not try to catch up
+			next = timerNow();
+		}
+		if (reportInterval > 0 && start >= nextReport) {
+			ServerStats stats;
+			serverTakeStats(&stats);
+			printf("Server: %d players, tick mean %.3f ms p99 %.3f ms, "
+					"out %.1f KB/s, in %.1f KB/s\n", stats.players,
+					stats.tickMean * 1000.0, stats.tickP99 * 1000.0,
+					stats.bytesSent / reportInterval / 1024.0,
+					stats.bytesReceived / reportInterval / 1024.0);
+			nextReport += reportInterval;
+			fflush(stdout);
+		}
+		timerSleep(next - timerNow());
+	}
+}
+/**
+ * threadMain
+ */
+static void* threadMain(void* argument) {
+	serverRun(&threadStop, 0);
+	return NULL;
+}
+/**
+ * serverRunThread
+ * Runs a started server on its own thread. Returns 0 on failure.
+ */
+int serverRunThread(void) {
+	threadStop = 0;
+	return pthread_create(&thread, NULL, threadMain, NULL) == 0;
+}
+/**
+ * serverStopThread
+ */
+void serverStopThread(void) {
+	threadStop = 1;
+	pthread_join(thread, NULL);
+}
@@ -0,0 +1,43 @@
+/*
+ * server.h
+ * CG flight simulator
+ * Authoritative multiplayer server.
+ * Owns the world seed and every pilot, their bullets and crashes. Clients
+ * send input each tick, the server steps all pilots with the same code the
+ * clients predict with and sends each client a delta compressed snapshot
+ * of itself and the pilots nearest to it. Pilots are bucketed in a grid so
+ * visibility and bullet hits only look at nearby pilots, keeping the cost
+ * per pilot and the bandwidth per client flat as pilots join.
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+#include <stdint.h>
+
+#define SERVER_MAX_CLIENTS 1024
+//clients not heard from for this long are dropped
+#define SERVER_TIMEOUT 5.0
+
+typedef struct ServerStats {
+	int players;
+	int ticks;
+	//seconds spent in poll and tick
+	double tickMean;
+	double tickP99;
+	double tickMax;
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint64_t packetsSent;
+	uint64_t fullSnapshots;
+} ServerStats;
+
+int serverStart(uint16_t port, uint32_t seed, int tickMs);
+void serverStop(void);
+void serverPoll(void);
+void serverTick(void);
+void serverRun(volatile int* stop, double reportInterval);
+int serverRunThread(void);
+void serverStopThread(void);
+void serverTakeStats(ServerStats* stats);
+
+#endif /* SERVER_H_ */
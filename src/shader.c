@@ -0,0 +1,70 @@
+/**
+ * shader.c
+ * CG flight simulator
+ * GLSL program compilation. Needs hasShaders.
+ */
+
+#include <stdio.h>
+#include "shader.h"
+#include "glFunctions.h"
+
+/**
+ * compileShader
+ * Compiles one stage, printing the log on failure. Returns 0 on failure.
+ */
+static GLuint compileShader(GLenum type, const char* source) {
+	GLint status = 0;
+	char log[1024];
+	GLuint shader = pglCreateShader(type);
+	pglShaderSource(shader, 1, &source, NULL);
+	pglCompileShader(shader);
+	pglGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status == 0) {
+		pglGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("Could not compile shader:\n%s\n", log);
+		pglDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+/**
+ * compileProgram
+ * Compiles and links a program, binding the attributes to locations
+ * 0..numAttributes-1 in order. Returns 0 on failure.
+ */
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource,
+		const char** attributes, int numAttributes) {
+	GLint status = 0;
+	char log[1024];
+	GLuint program;
+	int i;
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if (vertexShader == 0 || fragmentShader == 0) {
+		if (vertexShader != 0) {
+			pglDeleteShader(vertexShader);
+		}
+		if (fragmentShader != 0) {
+			pglDeleteShader(fragmentShader);
+		}
+		return 0;
+	}
+	program = pglCreateProgram();
+	pglAttachShader(program, vertexShader);
+	pglAttachShader(program, fragmentShader);
+	for (i = 0; i < numAttributes; i++) {
+		pglBindAttribLocation(program, i, attributes[i]);
+	}
+	pglLinkProgram(program);
+	//the program keeps the stages alive
+	pglDeleteShader(vertexShader);
+	pglDeleteShader(fragmentShader);
+	pglGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == 0) {
+		pglGetProgramInfoLog(program, sizeof(log), NULL, log);
+		printf("Could not link program:\n%s\n", log);
+		pglDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
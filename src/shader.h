@@ -0,0 +1,14 @@
+/*
+ * shader.h
+ * CG flight simulator
+ * GLSL program compilation.
+ */
+
+#ifndef SHADER_H_
+#define SHADER_H_
+#include "glPlatform.h"
+
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource,
+		const char** attributes, int numAttributes);
+
+#endif /* SHADER_H_ */
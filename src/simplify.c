@@ -0,0 +1,738 @@
+/**
+ * simplify.c
+ * CG flight simulator
+ * Quadric error mesh simplification, see simplify.h.
+ * Points with the same position are welded into one vertex so the model is
+ * one closed surface, but every triangle corner keeps its own point and
+ * with it the normal and group of the original. A collapse moves vertex u
+ * onto its neighbour v (no new positions, so every corner can take one of
+ * v's points), and each pass collapses the cheapest edges whose
+ * neighbourhoods do not overlap before the costs are worked out again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "simplify.h"
+#include "model.h"
+
+//weight of the planes that hold seams in place, relative to the surface
+#define SIMPLIFY_SEAM_WEIGHT 10.0
+//a collapse may not turn any triangle further than this (cosine)
+#define SIMPLIFY_MIN_TURN_COS 0.25f
+//one in this many edges is collapsed per pass at most
+#define SIMPLIFY_PASS_SHARE 6
+//neighbours of a vertex looked at, a vertex with more never moves
+#define SIMPLIFY_MAX_NEIGHBOURS 64
+
+//how a vertex may move
+#define VERTEX_FREE 0
+//on a seam (group boundary, hard edge or border), only along it
+#define VERTEX_SEAM 1
+#define VERTEX_LOCKED 2
+
+//plane equation products: xx xy xz xw yy yz yw zz zw ww, and the sum of
+//the weights so the error comes out as a squared distance
+typedef struct Quadric {
+	double a[10];
+	double weight;
+} Quadric;
+
+typedef struct Simplifier {
+	ModelFile* model;
+	int numVertices;
+	//vertex of each point
+	int* weld;
+	//3 floats per vertex
+	float* positions;
+	Quadric* quadrics;
+	//3 vertices per triangle, the welded corners
+	int* vertices;
+	unsigned char* alive;
+	int liveTriangles;
+	//bounding box diagonal of the model
+	float size;
+	//squared distance no collapse may exceed, for the level being made
+	float maxCost;
+	//live triangles around each vertex, rebuilt every pass
+	int* firstTriangle;
+	int* vertexTriangles;
+	unsigned char* kinds;
+	unsigned char* touched;
+	float error;
+} Simplifier;
+
+typedef struct Collapse {
+	int u;
+	int v;
+	float cost;
+} Collapse;
+
+/**
+ * writeModelFile
+ * Writes the live triangles as a model file, with only the points they use.
+ * Every group line is written, even for groups that lost all their
+ * triangles, so group colors still follow the order in the file.
+ */
+static int writeModelFile(const char* fileName, const Simplifier* simplifier) {
+	const ModelFile* model = simplifier->model;
+	int* numbers = calloc(model->numPoints, sizeof(int));
+	int count = 0;
+	int i, t, group;
+	FILE* file;
+
+	if (numbers == NULL) {
+		return 0;
+	}
+	file = fopen(fileName, "wt");
+	if (file == NULL) {
+		free(numbers);
+		return 0;
+	}
+	for (t = 0; t < model->numTriangles; t++) {
+		for (i = 0; simplifier->alive[t] && i < 3; i++) {
+			int point = model->corners[t * 3 + i];
+			if (numbers[point] == 0) {
+				numbers[point] = ++count;
+				fprintf(file, "v %.8g %.8g %.8g\n", model->points[point * 3],
+						model->points[point * 3 + 1],
+						model->points[point * 3 + 2]);
+			}
+		}
+	}
+	//normals in the same order as the points
+	count = 0;
+	for (t = 0; t < model->numTriangles; t++) {
+		for (i = 0; simplifier->alive[t] && i < 3; i++) {
+			int point = model->corners[t * 3 + i];
+			if (numbers[point] == count + 1) {
+				count++;
+				fprintf(file, "n %.8g %.8g %.8g\n", model->normals[point * 3],
+						model->normals[point * 3 + 1],
+						model->normals[point * 3 + 2]);
+			}
+		}
+	}
+	for (group = -1; group < model->numGroups; group++) {
+		if (group >= 0) {
+			fprintf(file, "\n%s\n", model->groupLines[group]);
+		}
+		for (t = 0; t < model->numTriangles; t++) {
+			if (simplifier->alive[t] && model->groups[t] == group) {
+				fprintf(file, "f %d %d %d\n", numbers[model->corners[t * 3]],
+						numbers[model->corners[t * 3 + 1]],
+						numbers[model->corners[t * 3 + 2]]);
+			}
+		}
+	}
+	free(numbers);
+	return fclose(file) == 0;
+}
+//points being sorted by comparePoints
+static const float* sortPoints = NULL;
+
+/**
+ * comparePoints
+ * Orders point indices by position, with ties by index.
+ */
+static int comparePoints(const void* a, const void* b) {
+	const float* p = &sortPoints[*(const int*) a * 3];
+	const float* q = &sortPoints[*(const int*) b * 3];
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (p[i] != q[i]) {
+			return p[i] < q[i] ? -1 : 1;
+		}
+	}
+	return *(const int*) a - *(const int*) b;
+}
+/**
+ * weldPoints
+ * Gives every set of points with the same position one vertex.
+ */
+static int weldPoints(Simplifier* simplifier) {
+	const ModelFile* model = simplifier->model;
+	int* order = malloc(sizeof(int) * model->numPoints);
+	int i;
+	if (order == NULL) {
+		return 0;
+	}
+	for (i = 0; i < model->numPoints; i++) {
+		order[i] = i;
+	}
+	sortPoints = model->points;
+	qsort(order, model->numPoints, sizeof(int), comparePoints);
+	sortPoints = NULL;
+	simplifier->numVertices = 0;
+	for (i = 0; i < model->numPoints; i++) {
+		const float* p = &model->points[order[i] * 3];
+		if (i == 0 || memcmp(p, &model->points[order[i - 1] * 3],
+				sizeof(float) * 3) != 0) {
+			memcpy(&simplifier->positions[simplifier->numVertices * 3], p,
+					sizeof(float) * 3);
+			simplifier->numVertices++;
+		}
+		simplifier->weld[order[i]] = simplifier->numVertices - 1;
+	}
+	free(order);
+	return 1;
+}
+/**
+ * addPlane
+ * Adds the squared distance to the plane n.p + d = 0, times weight.
+ */
+static void addPlane(Quadric* quadric, const double n[3], double d,
+		double weight) {
+	quadric->a[0] += weight * n[0] * n[0];
+	quadric->a[1] += weight * n[0] * n[1];
+	quadric->a[2] += weight * n[0] * n[2];
+	quadric->a[3] += weight * n[0] * d;
+	quadric->a[4] += weight * n[1] * n[1];
+	quadric->a[5] += weight * n[1] * n[2];
+	quadric->a[6] += weight * n[1] * d;
+	quadric->a[7] += weight * n[2] * n[2];
+	quadric->a[8] += weight * n[2] * d;
+	quadric->a[9] += weight * d * d;
+	quadric->weight += weight;
+}
+/**
+ * quadricError
+ */
+static double quadricError(const Quadric* quadric, const float* p) {
+	const double* a = quadric->a;
+	double x = p[0], y = p[1], z = p[2];
+	return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+			+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y + a[7] * z * z
+			+ 2 * a[8] * z + a[9];
+}
+/**
+ * triangleNormal
+ * Returns the unnormalized normal of a triangle with corner u moved to p.
+ */
+static void triangleNormal(const Simplifier* simplifier, int t, int u,
+		const float* p, double n[3]) {
+	const float* corner[3];
+	double e1[3], e2[3];
+	int i;
+	for (i = 0; i < 3; i++) {
+		int vertex = simplifier->vertices[t * 3 + i];
+		corner[i] = vertex == u ? p : &simplifier->positions[vertex * 3];
+	}
+	for (i = 0; i < 3; i++) {
+		e1[i] = corner[1][i] - corner[0][i];
+		e2[i] = corner[2][i] - corner[0][i];
+	}
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+/**
+ * cornerOf
+ * Returns the slot of vertex v in triangle t, or -1.
+ */
+static int cornerOf(const Simplifier* simplifier, int t, int v) {
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (simplifier->vertices[t * 3 + i] == v) {
+			return i;
+		}
+	}
+	return -1;
+}
+/**
+ * buildAdjacency
+ * Lists the live triangles around each vertex.
+ */
+static void buildAdjacency(Simplifier* simplifier) {
+	int numTriangles = simplifier->model->numTriangles;
+	int* first = simplifier->firstTriangle;
+	int t, i, v;
+	memset(first, 0, sizeof(int) * (simplifier->numVertices + 1));
+	for (t = 0; t < numTriangles; t++) {
+		for (i = 0; simplifier->alive[t] && i < 3; i++) {
+			first[simplifier->vertices[t * 3 + i] + 1]++;
+		}
+	}
+	for (v = 0; v < simplifier->numVertices; v++) {
+		first[v + 1] += first[v];
+	}
+	for (t = 0; t < numTriangles; t++) {
+		for (i = 0; simplifier->alive[t] && i < 3; i++) {
+			simplifier->vertexTriangles[first[simplifier->vertices[t * 3 + i]]++] =
+					t;
+		}
+	}
+	//the fill moved every start to the next vertex
+	for (v = simplifier->numVertices; v > 0; v--) {
+		first[v] = first[v - 1];
+	}
+	first[0] = 0;
+}
+/**
+ * isSeamEdge
+ * An edge is a seam unless exactly two triangles share it and they use the
+ * same points at both ends.
+ */
+static int isSeamEdge(const Simplifier* simplifier, int a, int b) {
+	const int* corners = simplifier->model->corners;
+	int shared[2];
+	int count = 0;
+	int i;
+	for (i = simplifier->firstTriangle[a]; i < simplifier->firstTriangle[a + 1];
+			i++) {
+		int t = simplifier->vertexTriangles[i];
+		if (cornerOf(simplifier, t, b) >= 0) {
+			if (count == 2) {
+				return 1;
+			}
+			shared[count++] = t;
+		}
+	}
+	if (count != 2) {
+		return 1;
+	}
+	return corners[shared[0] * 3 + cornerOf(simplifier, shared[0], a)]
+			!= corners[shared[1] * 3 + cornerOf(simplifier, shared[1], a)]
+			|| corners[shared[0] * 3 + cornerOf(simplifier, shared[0], b)]
+					!= corners[shared[1] * 3 + cornerOf(simplifier, shared[1], b)];
+}
+/**
+ * neighbours
+ * Fills in the vertices that share a live triangle with v. Returns their
+ * number, or -1 if there are more than SIMPLIFY_MAX_NEIGHBOURS.
+ */
+static int neighbours(const Simplifier* simplifier, int v,
+		int list[SIMPLIFY_MAX_NEIGHBOURS]) {
+	int count = 0;
+	int i, k, j;
+	for (i = simplifier->firstTriangle[v]; i < simplifier->firstTriangle[v + 1];
+			i++) {
+		int t = simplifier->vertexTriangles[i];
+		for (k = 0; k < 3; k++) {
+			int w = simplifier->vertices[t * 3 + k];
+			int known = w == v;
+			for (j = 0; j < count && !known; j++) {
+				known = list[j] == w;
+			}
+			if (!known) {
+				if (count == SIMPLIFY_MAX_NEIGHBOURS) {
+					return -1;
+				}
+				list[count++] = w;
+			}
+		}
+	}
+	return count;
+}
+/**
+ * classifyVertices
+ * A vertex with no seam edges is free, one with two can slide along them,
+ * any other (the end of a seam, or where seams meet) is locked.
+ */
+static void classifyVertices(Simplifier* simplifier) {
+	int list[SIMPLIFY_MAX_NEIGHBOURS];
+	int v, i;
+	for (v = 0; v < simplifier->numVertices; v++) {
+		int count = neighbours(simplifier, v, list);
+		int seams = 0;
+		for (i = 0; i < count; i++) {
+			seams += isSeamEdge(simplifier, v, list[i]);
+		}
+		simplifier->kinds[v] = count < 0 ? VERTEX_LOCKED :
+				seams == 0 ? VERTEX_FREE :
+				seams == 2 ? VERTEX_SEAM : VERTEX_LOCKED;
+	}
+}
+/**
+ * initQuadrics
+ * Sums each vertex's triangle planes weighted by area, plus for seam edges
+ * a plane through the edge upright on the triangle, so seams keep their
+ * shape as well as the surface.
+ */
+static void initQuadrics(Simplifier* simplifier) {
+	int t, i, k;
+	memset(simplifier->quadrics, 0, sizeof(Quadric) * simplifier->numVertices);
+	for (t = 0; t < simplifier->model->numTriangles; t++) {
+		const float* p0 = &simplifier->positions[simplifier->vertices[t * 3] * 3];
+		double n[3];
+		double length;
+		triangleNormal(simplifier, t, -1, NULL, n);
+		length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0) {
+			continue;
+		}
+		for (k = 0; k < 3; k++) {
+			n[k] /= length;
+		}
+		for (i = 0; i < 3; i++) {
+			addPlane(&simplifier->quadrics[simplifier->vertices[t * 3 + i]], n,
+					-(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]), length * 0.5);
+		}
+		for (i = 0; i < 3; i++) {
+			int a = simplifier->vertices[t * 3 + i];
+			int b = simplifier->vertices[t * 3 + (i + 1) % 3];
+			const float* pa = &simplifier->positions[a * 3];
+			const float* pb = &simplifier->positions[b * 3];
+			double e[3], m[3];
+			double edgeLength;
+			if (!isSeamEdge(simplifier, a, b)) {
+				continue;
+			}
+			for (k = 0; k < 3; k++) {
+				e[k] = pb[k] - pa[k];
+			}
+			m[0] = e[1] * n[2] - e[2] * n[1];
+			m[1] = e[2] * n[0] - e[0] * n[2];
+			m[2] = e[0] * n[1] - e[1] * n[0];
+			edgeLength = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+			if (edgeLength == 0) {
+				continue;
+			}
+			for (k = 0; k < 3; k++) {
+				m[k] /= edgeLength;
+			}
+			addPlane(&simplifier->quadrics[a], m,
+					-(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]),
+					edgeLength * edgeLength * SIMPLIFY_SEAM_WEIGHT);
+			addPlane(&simplifier->quadrics[b], m,
+					-(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]),
+					edgeLength * edgeLength * SIMPLIFY_SEAM_WEIGHT);
+		}
+	}
+}
+/**
+ * mayMove
+ * Whether the kind of u lets it move onto v.
+ */
+static int mayMove(const Simplifier* simplifier, int u, int v) {
+	return simplifier->kinds[u] == VERTEX_FREE
+			|| (simplifier->kinds[u] == VERTEX_SEAM
+					&& isSeamEdge(simplifier, u, v));
+}
+/**
+ * collapseCost
+ * Returns the mean squared distance of v to the planes of u and v.
+ */
+static float collapseCost(const Simplifier* simplifier, int u, int v) {
+	const float* p = &simplifier->positions[v * 3];
+	const Quadric* qu = &simplifier->quadrics[u];
+	const Quadric* qv = &simplifier->quadrics[v];
+	double weight = qu->weight + qv->weight;
+	if (weight == 0) {
+		return 0;
+	}
+	return (quadricError(qu, p) + quadricError(qv, p)) / weight;
+}
+/**
+ * keepsShape
+ * Checks that moving u onto v keeps the surface a manifold (the two share
+ * no neighbours but the far corners of their triangles) and turns no
+ * triangle over.
+ */
+static int keepsShape(const Simplifier* simplifier, int u, int v) {
+	int listU[SIMPLIFY_MAX_NEIGHBOURS], listV[SIMPLIFY_MAX_NEIGHBOURS];
+	int countU = neighbours(simplifier, u, listU);
+	int countV = neighbours(simplifier, v, listV);
+	const float* p = &simplifier->positions[v * 3];
+	int common = 0;
+	int shared = 0;
+	int i, j;
+	if (countU < 0 || countV < 0) {
+		return 0;
+	}
+	for (i = 0; i < countU; i++) {
+		for (j = 0; j < countV; j++) {
+			common += listU[i] == listV[j];
+		}
+	}
+	for (i = simplifier->firstTriangle[u]; i < simplifier->firstTriangle[u + 1];
+			i++) {
+		int t = simplifier->vertexTriangles[i];
+		double before[3], after[3];
+		double dot, lengths;
+		if (cornerOf(simplifier, t, v) >= 0) {
+			shared++;
+			continue;
+		}
+		triangleNormal(simplifier, t, -1, NULL, before);
+		triangleNormal(simplifier, t, u, p, after);
+		dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+		lengths = sqrt(before[0] * before[0] + before[1] * before[1]
+				+ before[2] * before[2])
+				* sqrt(after[0] * after[0] + after[1] * after[1]
+						+ after[2] * after[2]);
+		//a sliver of the original has no direction to keep
+		if (lengths == 0) {
+			continue;
+		}
+		if (dot < SIMPLIFY_MIN_TURN_COS * lengths) {
+			return 0;
+		}
+	}
+	return common == shared;
+}
+/**
+ * pickPoint
+ * Returns the point at vertex v for a corner of triangle t that moves
+ * there: one used by v's triangles in the same group, with the normal
+ * closest to the corner's old one.
+ */
+static int pickPoint(const Simplifier* simplifier, int t, int v,
+		const float* normal) {
+	const ModelFile* model = simplifier->model;
+	int best = -1;
+	int bestSameGroup = 0;
+	float bestDot = 0;
+	int i;
+	for (i = simplifier->firstTriangle[v]; i < simplifier->firstTriangle[v + 1];
+			i++) {
+		int s = simplifier->vertexTriangles[i];
+		int point = model->corners[s * 3 + cornerOf(simplifier, s, v)];
+		const float* n = &model->normals[point * 3];
+		int sameGroup = model->groups[s] == model->groups[t];
+		float dot = n[0] * normal[0] + n[1] * normal[1] + n[2] * normal[2];
+		if (best < 0 || sameGroup > bestSameGroup
+				|| (sameGroup == bestSameGroup && dot > bestDot)) {
+			best = point;
+			bestSameGroup = sameGroup;
+			bestDot = dot;
+		}
+	}
+	return best;
+}
+/**
+ * collapse
+ * Moves u onto v and marks every vertex around both as touched.
+ */
+static void collapse(Simplifier* simplifier, int u, int v, float cost) {
+	ModelFile* model = simplifier->model;
+	int i, k, end;
+	for (k = 0; k < 2; k++) {
+		int w = k == 0 ? u : v;
+		for (i = simplifier->firstTriangle[w];
+				i < simplifier->firstTriangle[w + 1]; i++) {
+			int t = simplifier->vertexTriangles[i];
+			simplifier->touched[simplifier->vertices[t * 3]] = 1;
+			simplifier->touched[simplifier->vertices[t * 3 + 1]] = 1;
+			simplifier->touched[simplifier->vertices[t * 3 + 2]] = 1;
+		}
+	}
+	//pick every new point before a triangle changes
+	end = simplifier->firstTriangle[u + 1];
+	for (i = simplifier->firstTriangle[u]; i < end; i++) {
+		int t = simplifier->vertexTriangles[i];
+		int slot = cornerOf(simplifier, t, u);
+		if (cornerOf(simplifier, t, v) < 0) {
+			int point = model->corners[t * 3 + slot];
+			model->corners[t * 3 + slot] = pickPoint(simplifier, t, v,
+					&model->normals[point * 3]);
+		}
+	}
+	for (i = simplifier->firstTriangle[u]; i < end; i++) {
+		int t = simplifier->vertexTriangles[i];
+		if (cornerOf(simplifier, t, v) >= 0) {
+			simplifier->alive[t] = 0;
+			simplifier->liveTriangles--;
+		} else {
+			simplifier->vertices[t * 3 + cornerOf(simplifier, t, u)] = v;
+		}
+	}
+	for (k = 0; k < 10; k++) {
+		simplifier->quadrics[v].a[k] += simplifier->quadrics[u].a[k];
+	}
+	simplifier->quadrics[v].weight += simplifier->quadrics[u].weight;
+	if (cost > simplifier->error) {
+		simplifier->error = cost;
+	}
+}
+/**
+ * compareCollapses
+ */
+static int compareCollapses(const void* a, const void* b) {
+	float difference = ((const Collapse*) a)->cost - ((const Collapse*) b)->cost;
+	return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+/**
+ * simplifyPass
+ * Collapses the cheapest edges that do not touch each other until the
+ * target is met, a share of the edges is done or the next costs too much.
+ * Returns the number of collapses.
+ */
+static int simplifyPass(Simplifier* simplifier, Collapse* collapses,
+		int target) {
+	int numTriangles = simplifier->model->numTriangles;
+	int count = 0;
+	int done = 0;
+	int t, i;
+
+	buildAdjacency(simplifier);
+	classifyVertices(simplifier);
+	for (t = 0; t < numTriangles; t++) {
+		for (i = 0; simplifier->alive[t] && i < 3; i++) {
+			int a = simplifier->vertices[t * 3 + i];
+			int b = simplifier->vertices[t * 3 + (i + 1) % 3];
+			int forward, backward;
+			if (a > b) {
+				continue;
+			}
+			forward = mayMove(simplifier, a, b);
+			backward = mayMove(simplifier, b, a);
+			if (forward || backward) {
+				float costForward = forward ? collapseCost(simplifier, a, b) : 0;
+				float costBackward = backward ? collapseCost(simplifier, b, a) : 0;
+				if (!backward || (forward && costForward <= costBackward)) {
+					collapses[count].u = a;
+					collapses[count].v = b;
+					collapses[count].cost = costForward;
+				} else {
+					collapses[count].u = b;
+					collapses[count].v = a;
+					collapses[count].cost = costBackward;
+				}
+				count++;
+			}
+		}
+	}
+	qsort(collapses, count, sizeof(Collapse), compareCollapses);
+
+	memset(simplifier->touched, 0, simplifier->numVertices);
+	for (i = 0; i < count && done <= count / SIMPLIFY_PASS_SHARE
+			&& simplifier->liveTriangles > target
+			&& collapses[i].cost <= simplifier->maxCost; i++) {
+		int u = collapses[i].u;
+		int v = collapses[i].v;
+		if (simplifier->touched[u] || simplifier->touched[v]) {
+			continue;
+		}
+		if (keepsShape(simplifier, u, v)) {
+			collapse(simplifier, u, v, collapses[i].cost);
+			done++;
+		} else if (mayMove(simplifier, v, u) && keepsShape(simplifier, v, u)
+				&& collapseCost(simplifier, v, u) <= simplifier->maxCost) {
+			collapse(simplifier, v, u, collapseCost(simplifier, v, u));
+			done++;
+		}
+	}
+	return done;
+}
+/**
+ * measureModel
+ * Returns the bounding box diagonal of the vertices in use, 0 for a model
+ * without triangles.
+ */
+static float measureModel(const Simplifier* simplifier) {
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	int t, k;
+	if (simplifier->model->numTriangles <= 0) {
+		return 0.0f;
+	}
+	for (t = 0; t < simplifier->model->numTriangles * 3; t++) {
+		const float* p = &simplifier->positions[simplifier->vertices[t] * 3];
+		for (k = 0; k < 3; k++) {
+			low[k] = p[k] < low[k] ? p[k] : low[k];
+			high[k] = p[k] > high[k] ? p[k] : high[k];
+		}
+	}
+	return sqrtf((high[0] - low[0]) * (high[0] - low[0])
+			+ (high[1] - low[1]) * (high[1] - low[1])
+			+ (high[2] - low[2]) * (high[2] - low[2]));
+}
+/**
+ * simplifyModel
+ * Writes levels simplified versions of a model, each made from the one
+ * before. Level i + 1 keeps about ratios[i] of the model's triangles, or
+ * more where getting there would move the surface further than maxErrors[i]
+ * times the model's size. A level is only written while the count keeps
+ * going down, the files of the levels after the last one written are
+ * removed. results may be NULL. Returns the levels written, -1 if the model
+ * could not be read or a level not written.
+ */
+int simplifyModel(const char* fileName, int levels, const float* ratios,
+		const float* maxErrors, SimplifyLevel* results) {
+	ModelFile model;
+	Simplifier simplifier;
+	Collapse* collapses;
+	char lodName[256];
+	int ok = 1;
+	int written = 0;
+	int level, t;
+
+	if (!readModelFile(fileName, &model)) {
+		printf("Could not load resource.\n");
+		freeModelFile(&model);
+		return -1;
+	}
+	memset(&simplifier, 0, sizeof(Simplifier));
+	simplifier.model = &model;
+	simplifier.weld = malloc(sizeof(int) * model.numPoints);
+	simplifier.positions = malloc(sizeof(float) * 3 * model.numPoints);
+	simplifier.quadrics = malloc(sizeof(Quadric) * model.numPoints);
+	simplifier.vertices = malloc(sizeof(int) * 3 * model.numTriangles);
+	simplifier.alive = malloc(model.numTriangles);
+	simplifier.firstTriangle = malloc(sizeof(int) * (model.numPoints + 1));
+	simplifier.vertexTriangles = malloc(sizeof(int) * 3 * model.numTriangles);
+	simplifier.kinds = malloc(model.numPoints);
+	simplifier.touched = malloc(model.numPoints);
+	collapses = malloc(sizeof(Collapse) * 3 * model.numTriangles);
+	if (simplifier.weld == NULL || simplifier.positions == NULL
+			|| simplifier.quadrics == NULL || simplifier.vertices == NULL
+			|| simplifier.alive == NULL || simplifier.firstTriangle == NULL
+			|| simplifier.vertexTriangles == NULL || simplifier.kinds == NULL
+			|| simplifier.touched == NULL || collapses == NULL
+			|| !weldPoints(&simplifier)) {
+		ok = 0;
+	}
+
+	if (ok) {
+		for (t = 0; t < model.numTriangles * 3; t++) {
+			simplifier.vertices[t] = simplifier.weld[model.corners[t]];
+		}
+		memset(simplifier.alive, 1, model.numTriangles);
+		simplifier.liveTriangles = model.numTriangles;
+		buildAdjacency(&simplifier);
+		initQuadrics(&simplifier);
+		simplifier.size = measureModel(&simplifier);
+	}
+	for (level = 0; ok && level < levels; level++) {
+		int target = model.numTriangles * ratios[level];
+		float maxError = maxErrors[level] * simplifier.size;
+		simplifier.maxCost = maxError * maxError;
+		int before = simplifier.liveTriangles;
+		while (simplifier.liveTriangles > target
+				&& simplifyPass(&simplifier, collapses, target) > 0) {
+		}
+		//nothing more gives way within the error, it would only be a copy
+		if (simplifier.liveTriangles == before) {
+			break;
+		}
+		snprintf(lodName, sizeof(lodName), "%s.lod%d", fileName, level + 1);
+		ok = writeModelFile(lodName, &simplifier);
+		written++;
+		if (results != NULL) {
+			results[level].triangles = simplifier.liveTriangles;
+			results[level].error = simplifier.size > 0 ?
+					sqrtf(simplifier.error) / simplifier.size : 0;
+		}
+	}
+
+	for (level = written; ok && level < levels; level++) {
+		snprintf(lodName, sizeof(lodName), "%s.lod%d", fileName, level + 1);
+		remove(lodName);
+	}
+
+	free(simplifier.weld);
+	free(simplifier.positions);
+	free(simplifier.quadrics);
+	free(simplifier.vertices);
+	free(simplifier.alive);
+	free(simplifier.firstTriangle);
+	free(simplifier.vertexTriangles);
+	free(simplifier.kinds);
+	free(simplifier.touched);
+	free(collapses);
+	freeModelFile(&model);
+	return ok ? written : -1;
+}
@@ -0,0 +1,27 @@
+/*
+ * simplify.h
+ * CG flight simulator
+ * Offline mesh simplification for the aircraft level of detail chain.
+ * Collapses the edges of a model in order of their quadric error (Garland
+ * and Heckbert) and writes each level as a model file next to the original,
+ * "<model>.lod1", "<model>.lod2", ..., that loadMesh reads like any other
+ * model. Group boundaries and hard edges survive: a vertex on one may only
+ * slide along it, and a vertex where several of them meet never moves.
+ * The chain ends at the first level that would not have fewer triangles
+ * than the one before, loadMeshLods stops at the first missing level.
+ */
+
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+typedef struct SimplifyLevel {
+	int triangles;
+	//largest distance a collapse so far moved the surface, as a share of
+	//the model's size
+	float error;
+} SimplifyLevel;
+
+int simplifyModel(const char* fileName, int levels, const float* ratios,
+		const float* maxErrors, SimplifyLevel* results);
+
+#endif /* SIMPLIFY_H_ */
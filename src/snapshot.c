@@ -0,0 +1,308 @@
+/**
+ * snapshot.c
+ * CG flight simulator
+ * Multiplayer packet encoding, see snapshot.h.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "snapshot.h"
+
+#define FIELD_X 1
+#define FIELD_Y 2
+#define FIELD_Z 4
+#define FIELD_ROTATION 8
+#define FIELD_YAW 16
+#define FIELD_TILT 32
+#define FIELD_SPEED 64
+#define FIELD_FLAGS 128
+
+/**
+ * packetBegin
+ * Starts a packet of the given type.
+ */
+void packetBegin(PacketWriter* writer, PacketType type) {
+	writer->size = 0;
+	writer->overflow = 0;
+	packetWriteUnsigned(writer, NET_MAGIC, 2);
+	packetWriteUnsigned(writer, type, 1);
+}
+/**
+ * packetWriteUnsigned
+ * Writes a little endian unsigned integer of the given size in bytes.
+ */
+void packetWriteUnsigned(PacketWriter* writer, uint32_t value, int bytes) {
+	int i;
+	if (writer->size + bytes > NET_MAX_PACKET) {
+		writer->overflow = 1;
+		return;
+	}
+	for (i = 0; i < bytes; i++) {
+		writer->data[writer->size++] = (value >> (8 * i)) & 0xFF;
+	}
+}
+/**
+ * packetWriteVarint
+ */
+void packetWriteVarint(PacketWriter* writer, uint32_t value) {
+	while (value >= 0x80) {
+		packetWriteUnsigned(writer, (value & 0x7F) | 0x80, 1);
+		value >>= 7;
+	}
+	packetWriteUnsigned(writer, value, 1);
+}
+/**
+ * packetWriteSigned
+ * Writes a signed varint, zigzag encoded so small negative values stay short.
+ */
+void packetWriteSigned(PacketWriter* writer, int32_t value) {
+	packetWriteVarint(writer, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+/**
+ * packetOpen
+ * Starts reading a packet. Returns its type, or -1 if it is not ours.
+ */
+int packetOpen(PacketReader* reader, const void* data, int size) {
+	reader->data = data;
+	reader->size = size;
+	reader->position = 0;
+	reader->error = 0;
+	if (packetReadUnsigned(reader, 2) != NET_MAGIC) {
+		return -1;
+	}
+	int type = packetReadUnsigned(reader, 1);
+	return reader->error || type > PACKET_BYE ? -1 : type;
+}
+/**
+ * packetReadUnsigned
+ */
+uint32_t packetReadUnsigned(PacketReader* reader, int bytes) {
+	uint32_t value = 0;
+	int i;
+	if (reader->position + bytes > reader->size) {
+		reader->error = 1;
+		reader->position = reader->size;
+		return 0;
+	}
+	for (i = 0; i < bytes; i++) {
+		value |= (uint32_t) reader->data[reader->position++] << (8 * i);
+	}
+	return value;
+}
+/**
+ * packetReadVarint
+ */
+uint32_t packetReadVarint(PacketReader* reader) {
+	uint32_t value = 0;
+	int shift = 0;
+	for (;;) {
+		uint32_t byte = packetReadUnsigned(reader, 1);
+		value |= (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0 || reader->error) {
+			break;
+		}
+		shift += 7;
+		if (shift >= 35) {
+			reader->error = 1;
+			break;
+		}
+	}
+	return value;
+}
+/**
+ * packetReadSigned
+ */
+int32_t packetReadSigned(PacketReader* reader) {
+	uint32_t value = packetReadVarint(reader);
+	return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+/**
+ * quantise
+ * Rounds value * scale to the nearest integer within [min, max].
+ */
+static int32_t quantise(float value, float scale, int32_t min, int32_t max) {
+	float scaled = roundf(value * scale);
+	if (scaled < min) {
+		return min;
+	}
+	if (scaled > max) {
+		return max;
+	}
+	return (int32_t) scaled;
+}
+/**
+ * entityQuantise
+ */
+void entityQuantise(const PlayerState* player, uint16_t id, EntityState* entity) {
+	float turns = player->rotation / (2.0f * M_PI);
+	entity->id = id;
+	entity->x = quantise(player->x, 64, -2000000000, 2000000000);
+	entity->y = quantise(player->y, 64, -2000000000, 2000000000);
+	entity->z = quantise(player->z, 64, -2000000000, 2000000000);
+	entity->rotation = (uint16_t) quantise(turns - floorf(turns), 65536, 0,
+			65536);
+	entity->yawRotation = quantise(player->yawRotation, 32767, -32767, 32767);
+	entity->tilt = quantise(player->tilt, 100, -32767, 32767);
+	entity->speed = quantise(player->speed, 1000, 0, 65535);
+	entity->flags = (player->alive ? 1 : 0) | (player->firing ? 2 : 0);
+}
+/**
+ * entityDequantise
+ */
+void entityDequantise(const EntityState* entity, PlayerState* player) {
+	player->x = entity->x / 64.0f;
+	player->y = entity->y / 64.0f;
+	player->z = entity->z / 64.0f;
+	player->rotation = entity->rotation * (2.0f * M_PI / 65536.0f);
+	player->yawRotation = entity->yawRotation / 32767.0f;
+	player->tilt = entity->tilt / 100.0f;
+	player->speed = entity->speed / 1000.0f;
+	player->alive = (entity->flags & 1) != 0;
+	player->firing = (entity->flags & 2) != 0;
+}
+/**
+ * findEntity
+ * Finds an entity by id in a snapshot, starting from a hint index since
+ * both lists are sorted and walked together. Returns NULL if absent.
+ */
+static const EntityState* findEntity(const Snapshot* snapshot, uint16_t id,
+		int* hint) {
+	if (snapshot == NULL) {
+		return NULL;
+	}
+	while (*hint < snapshot->count && snapshot->entities[*hint].id < id) {
+		(*hint)++;
+	}
+	if (*hint < snapshot->count && snapshot->entities[*hint].id == id) {
+		return &snapshot->entities[*hint];
+	}
+	return NULL;
+}
+/**
+ * snapshotWrite
+ * Writes a snapshot packet as a delta against base, or in full if base is
+ * NULL. Entities missing from base are written against an all zero state.
+ */
+void snapshotWrite(PacketWriter* writer, const Snapshot* snapshot,
+		const Snapshot* base) {
+	static const EntityState zero;
+	int hint = 0;
+	int previousId = 0;
+	int i;
+	packetBegin(writer, PACKET_SNAPSHOT);
+	packetWriteUnsigned(writer, snapshot->tick, 4);
+	packetWriteUnsigned(writer, base != NULL ? base->tick : snapshot->tick, 4);
+	packetWriteUnsigned(writer, snapshot->inputAck, 4);
+	packetWriteVarint(writer, snapshot->count);
+	for (i = 0; i < snapshot->count; i++) {
+		const EntityState* entity = &snapshot->entities[i];
+		const EntityState* old = findEntity(base, entity->id, &hint);
+		int mask = 0;
+		if (old == NULL) {
+			old = &zero;
+		}
+		mask |= entity->x != old->x ? FIELD_X : 0;
+		mask |= entity->y != old->y ? FIELD_Y : 0;
+		mask |= entity->z != old->z ? FIELD_Z : 0;
+		mask |= entity->rotation != old->rotation ? FIELD_ROTATION : 0;
+		mask |= entity->yawRotation != old->yawRotation ? FIELD_YAW : 0;
+		mask |= entity->tilt != old->tilt ? FIELD_TILT : 0;
+		mask |= entity->speed != old->speed ? FIELD_SPEED : 0;
+		mask |= entity->flags != old->flags ? FIELD_FLAGS : 0;
+		packetWriteVarint(writer, entity->id - previousId);
+		previousId = entity->id;
+		packetWriteUnsigned(writer, mask, 1);
+		if (mask & FIELD_X) {
+			packetWriteSigned(writer, entity->x - old->x);
+		}
+		if (mask & FIELD_Y) {
+			packetWriteSigned(writer, entity->y - old->y);
+		}
+		if (mask & FIELD_Z) {
+			packetWriteSigned(writer, entity->z - old->z);
+		}
+		if (mask & FIELD_ROTATION) {
+			//wraps, so crossing north is a small step
+			packetWriteSigned(writer, (int16_t) (entity->rotation - old->rotation));
+		}
+		if (mask & FIELD_YAW) {
+			packetWriteSigned(writer, entity->yawRotation - old->yawRotation);
+		}
+		if (mask & FIELD_TILT) {
+			packetWriteSigned(writer, entity->tilt - old->tilt);
+		}
+		if (mask & FIELD_SPEED) {
+			packetWriteSigned(writer, entity->speed - old->speed);
+		}
+		if (mask & FIELD_FLAGS) {
+			packetWriteUnsigned(writer, entity->flags, 1);
+		}
+	}
+}
+/**
+ * snapshotBaseTick
+ * Returns the tick of the snapshot a just opened snapshot packet is a
+ * delta against, equal to its own tick if it is a full snapshot.
+ */
+uint32_t snapshotBaseTick(const PacketReader* reader) {
+	PacketReader peek = *reader;
+	packetReadUnsigned(&peek, 4);
+	return packetReadUnsigned(&peek, 4);
+}
+/**
+ * snapshotRead
+ * Reads a snapshot packet opened with packetOpen. base must be the
+ * snapshot with the base tick, or NULL for a full snapshot.
+ * Returns 0 if the packet is malformed.
+ */
+int snapshotRead(PacketReader* reader, Snapshot* snapshot, const Snapshot* base) {
+	static const EntityState zero;
+	uint32_t count;
+	int hint = 0;
+	int id = 0;
+	int i;
+	snapshot->tick = packetReadUnsigned(reader, 4);
+	packetReadUnsigned(reader, 4);
+	snapshot->inputAck = packetReadUnsigned(reader, 4);
+	//unsigned, so no count from the packet can pass as negative
+	count = packetReadVarint(reader);
+	if (reader->error || count > NET_MAX_ENTITIES) {
+		return 0;
+	}
+	snapshot->count = count;
+	for (i = 0; i < snapshot->count; i++) {
+		EntityState* entity = &snapshot->entities[i];
+		const EntityState* old;
+		int mask;
+		id += packetReadVarint(reader);
+		old = findEntity(base, id, &hint);
+		*entity = old != NULL ? *old : zero;
+		entity->id = id;
+		mask = packetReadUnsigned(reader, 1);
+		if (mask & FIELD_X) {
+			entity->x += packetReadSigned(reader);
+		}
+		if (mask & FIELD_Y) {
+			entity->y += packetReadSigned(reader);
+		}
+		if (mask & FIELD_Z) {
+			entity->z += packetReadSigned(reader);
+		}
+		if (mask & FIELD_ROTATION) {
+			entity->rotation += packetReadSigned(reader);
+		}
+		if (mask & FIELD_YAW) {
+			entity->yawRotation += packetReadSigned(reader);
+		}
+		if (mask & FIELD_TILT) {
+			entity->tilt += packetReadSigned(reader);
+		}
+		if (mask & FIELD_SPEED) {
+			entity->speed += packetReadSigned(reader);
+		}
+		if (mask & FIELD_FLAGS) {
+			entity->flags = packetReadUnsigned(reader, 1);
+		}
+	}
+	return reader->error == 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * snapshot.h
+ * CG flight simulator
+ * Multiplayer packet encoding.
+ * Pilot state is quantised to integers and snapshots are written as
+ * per-field deltas against a snapshot the client has acknowledged, so an
+ * unchanged field costs nothing and a small change costs a byte or two.
+ *
+ * Packet layout (little endian, varints are 7 bits per byte, signed values
+ * zigzag encoded):
+ *  all:      magic (2), type (1)
+ *  hello:    protocol version (1)
+ *  welcome:  client id (2), world seed (4), server tick (4)
+ *  input:    client id (2), acknowledged snapshot tick (4), sequence of the
+ *            first input (4), input count (1), inputs
+ *            (buttons (1), steer x (1), steer y (1), wheel (1))
+ *  snapshot: tick (4), base tick (4, equal to tick for a full snapshot),
+ *            last input applied (4), entity count (varint), entities
+ *            (id delta (varint), field mask (1), changed fields (varints))
+ *  bye:      client id (2)
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+#include <stdint.h>
+#include "net.h"
+#include "player.h"
+
+#define NET_MAGIC 0x5346
+#define NET_PROTOCOL_VERSION 1
+//other pilots sent to each client, the nearest ones
+#define NET_MAX_VISIBLE 24
+#define NET_MAX_ENTITIES (NET_MAX_VISIBLE + 1)
+//snapshots kept on both ends as delta bases
+#define NET_HISTORY 32
+//ticks between snapshots
+#define NET_SNAPSHOT_INTERVAL 2
+//each input packet repeats this many inputs to ride out packet loss
+#define NET_INPUT_REDUNDANCY 4
+
+typedef enum PacketType {
+	PACKET_HELLO,
+	PACKET_WELCOME,
+	PACKET_INPUT,
+	PACKET_SNAPSHOT,
+	PACKET_BYE
+} PacketType;
+
+typedef struct EntityState {
+	uint16_t id;
+	//1/64 world units
+	int32_t x;
+	int32_t y;
+	int32_t z;
+	//full turn is 65536
+	uint16_t rotation;
+	//1/32767 of the -1 to 1 range
+	int16_t yawRotation;
+	//1/100 degree
+	int16_t tilt;
+	//1/1000 speed units
+	uint16_t speed;
+	//bit 0 alive, bit 1 firing
+	uint8_t flags;
+} EntityState;
+
+typedef struct Snapshot {
+	uint32_t tick;
+	//last input of the receiving client the state includes
+	uint32_t inputAck;
+	int count;
+	//sorted by id
+	EntityState entities[NET_MAX_ENTITIES];
+} Snapshot;
+
+typedef struct PacketWriter {
+	uint8_t data[NET_MAX_PACKET];
+	int size;
+	//set when a write did not fit
+	int overflow;
+} PacketWriter;
+
+typedef struct PacketReader {
+	const uint8_t* data;
+	int size;
+	int position;
+	//set when a read ran past the end
+	int error;
+} PacketReader;
+
+void packetBegin(PacketWriter* writer, PacketType type);
+void packetWriteUnsigned(PacketWriter* writer, uint32_t value, int bytes);
+void packetWriteVarint(PacketWriter* writer, uint32_t value);
+void packetWriteSigned(PacketWriter* writer, int32_t value);
+int packetOpen(PacketReader* reader, const void* data, int size);
+uint32_t packetReadUnsigned(PacketReader* reader, int bytes);
+uint32_t packetReadVarint(PacketReader* reader);
+int32_t packetReadSigned(PacketReader* reader);
+
+void entityQuantise(const PlayerState* player, uint16_t id, EntityState* entity);
+void entityDequantise(const EntityState* entity, PlayerState* player);
+void snapshotWrite(PacketWriter* writer, const Snapshot* snapshot,
+		const Snapshot* base);
+uint32_t snapshotBaseTick(const PacketReader* reader);
+int snapshotRead(PacketReader* reader, Snapshot* snapshot, const Snapshot* base);
+
+#endif /* SNAPSHOT_H_ */
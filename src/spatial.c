@@ -0,0 +1,733 @@
+/**
+ * spatial.c
+ * CG flight simulator
+ * Spatial hash, see spatial.h.
+ * Cells are numbered along y, then z, then x from the corner of the
+ * entities' bounds, so the cells of a column and of neighbouring columns
+ * sit close together in the sorted entities. A bucket is its cell's number
+ * wrapped to the bucket count: when the bounds hold more cells than there
+ * are buckets several cells share one, so every sorted entity keeps the
+ * cell it is in and a query only takes the entities of the cell it is
+ * looking at, each entity is seen once however the cells collide. The
+ * build also lists the cells that hold entities, so a radius covering more
+ * cells than that walks the list instead of the empty cells. A nearest
+ * query grows shells of cells out from its own until nothing closer can be
+ * further out, its radius is passed or SPATIAL_NEAREST_CELLS cells have
+ * been looked at, so no query costs more than that however alone it is.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spatial.h"
+#include "jobs.h"
+
+#define SPATIAL_MIN_BUCKETS 256
+//entities per cell the cells are sized for, and the smallest cell
+#define SPATIAL_PER_CELL 4.0f
+#define SPATIAL_MIN_CELL 1.0f
+//how far the cell size is corrected from what the bounds give
+#define SPATIAL_MIN_SCALE 0.25f
+#define SPATIAL_MAX_SCALE 4.0f
+//cell coordinates are clamped to this, far beyond anything that flies
+#define SPATIAL_MAX_CELL (1 << 24)
+//entities per job when computing buckets, queries per job in a batch
+#define SPATIAL_GRAIN 4096
+#define SPATIAL_QUERY_GRAIN 64
+//cells a nearest query looks at before it settles for what it found
+#define SPATIAL_NEAREST_CELLS 1024
+//of a cell, how much closer than its faces an entity in it may round to
+#define SPATIAL_CELL_SLACK 0.001f
+//shells of more cells than this are sorted with qsort
+#define SPATIAL_SHELL_INSERTION 32
+
+typedef struct BatchJob {
+	const SpatialHash* hash;
+	const SpatialQuery* queries;
+	//the queries in the order of their buckets, NULL to run them as given
+	const int* order;
+	int maxHits;
+	SpatialHit* hits;
+	int* found;
+} BatchJob;
+
+//what a query has found so far
+typedef struct Collector {
+	const SpatialHash* hash;
+	const SpatialQuery* query;
+	float radiusSquared;
+	SpatialHit* hits;
+	int maxHits;
+	int found;
+} Collector;
+
+//a cell of a nearest query's shell and how far it is from the query
+typedef struct ShellCell {
+	float gapSquared;
+	int cellX;
+	int cellY;
+	int cellZ;
+} ShellCell;
+
+/**
+ * cellOf
+ */
+static int cellOf(const SpatialHash* hash, float coordinate) {
+	float cell = floorf(coordinate * hash->inverseCell);
+	if (!(cell > -SPATIAL_MAX_CELL)) {
+		return -SPATIAL_MAX_CELL;
+	}
+	return cell < SPATIAL_MAX_CELL ? (int) cell : SPATIAL_MAX_CELL;
+}
+/**
+ * bucketOf
+ */
+static int bucketOf(const SpatialHash* hash, int cellX, int cellY, int cellZ) {
+	unsigned int spanY = hash->maxCellY - hash->minCellY + 1;
+	unsigned int spanZ = hash->maxCellZ - hash->minCellZ + 1;
+	return (int) ((((unsigned int) (cellX - hash->minCellX) * spanZ
+			+ (unsigned int) (cellZ - hash->minCellZ)) * spanY
+			+ (unsigned int) (cellY - hash->minCellY)) & (hash->numBuckets - 1));
+}
+/**
+ * spatialInit
+ * Prepares an empty hash with cells at most maxCellSize across. Returns 0
+ * on failure.
+ */
+int spatialInit(SpatialHash* hash, float maxCellSize) {
+	memset(hash, 0, sizeof(SpatialHash));
+	hash->maxCellSize = maxCellSize >= SPATIAL_MIN_CELL ? maxCellSize
+			: SPATIAL_DEFAULT_CELL;
+	hash->cellSize = hash->maxCellSize;
+	hash->inverseCell = 1.0f / hash->cellSize;
+	hash->cellScale = 1.0f;
+	return 1;
+}
+/**
+ * freeArrays
+ */
+static void freeArrays(SpatialHash* hash) {
+	free(hash->x);
+	free(hash->y);
+	free(hash->z);
+	free(hash->kind);
+	free(hash->index);
+	free(hash->bucket);
+	free(hash->start);
+	free(hash->sorted);
+	free(hash->cells);
+}
+/**
+ * spatialFree
+ */
+void spatialFree(SpatialHash* hash) {
+	float maxCellSize = hash->maxCellSize;
+	freeArrays(hash);
+	spatialInit(hash, maxCellSize);
+}
+/**
+ * reserve
+ * Makes room for capacity entities, keeping those inserted. Only grows, so
+ * a hash that has seen its largest tick no longer allocates.
+ */
+static int reserve(SpatialHash* hash, int capacity) {
+	SpatialHash grown = *hash;
+	int numBuckets = SPATIAL_MIN_BUCKETS;
+	if (capacity <= hash->capacity) {
+		return 1;
+	}
+	if (capacity < hash->capacity * 2) {
+		capacity = hash->capacity * 2;
+	}
+	while (numBuckets < capacity) {
+		numBuckets *= 2;
+	}
+	grown.capacity = capacity;
+	grown.numBuckets = numBuckets;
+	grown.x = malloc(sizeof(float) * capacity);
+	grown.y = malloc(sizeof(float) * capacity);
+	grown.z = malloc(sizeof(float) * capacity);
+	grown.kind = malloc(capacity);
+	grown.index = malloc(sizeof(int) * capacity);
+	grown.bucket = malloc(sizeof(int) * capacity);
+	grown.start = malloc(sizeof(int) * (numBuckets + 1));
+	grown.sorted = malloc(sizeof(SpatialEntry) * capacity);
+	grown.cells = malloc(sizeof(SpatialCell) * capacity);
+	if (grown.x == NULL || grown.y == NULL || grown.z == NULL
+			|| grown.kind == NULL || grown.index == NULL || grown.bucket == NULL
+			|| grown.start == NULL || grown.sorted == NULL || grown.cells == NULL) {
+		freeArrays(&grown);
+		return 0;
+	}
+	if (hash->count > 0) {
+		memcpy(grown.x, hash->x, sizeof(float) * hash->count);
+		memcpy(grown.y, hash->y, sizeof(float) * hash->count);
+		memcpy(grown.z, hash->z, sizeof(float) * hash->count);
+		memcpy(grown.kind, hash->kind, hash->count);
+		memcpy(grown.index, hash->index, sizeof(int) * hash->count);
+	}
+	freeArrays(hash);
+	*hash = grown;
+	//nothing is sorted until the next build
+	memset(hash->start, 0, sizeof(int) * (numBuckets + 1));
+	hash->numCells = 0;
+	return 1;
+}
+/**
+ * spatialClear
+ * Removes every entity, keeping the memory for the next tick.
+ */
+void spatialClear(SpatialHash* hash) {
+	hash->count = 0;
+	hash->numCells = 0;
+}
+/**
+ * spatialInsert
+ * Adds an entity, found again by kind and index. Returns its id, -1 if out
+ * of memory. It is only found by queries after the next spatialBuild.
+ */
+int spatialInsert(SpatialHash* hash, SpatialKind kind, int index, float x,
+		float y, float z) {
+	int id = hash->count;
+	if (!reserve(hash, id + 1)) {
+		return -1;
+	}
+	hash->x[id] = x;
+	hash->y[id] = y;
+	hash->z[id] = z;
+	hash->kind[id] = kind;
+	hash->index[id] = index;
+	hash->count++;
+	return id;
+}
+/**
+ * spatialInsertMany
+ * Adds count entities of one kind with indices 0 to count - 1, from arrays
+ * of their coordinates. Returns the id of the first, -1 if out of memory.
+ */
+int spatialInsertMany(SpatialHash* hash, SpatialKind kind, int count,
+		const float* x, const float* y, const float* z) {
+	int first = hash->count;
+	int i;
+	if (count <= 0 || !reserve(hash, first + count)) {
+		return -1;
+	}
+	memcpy(hash->x + first, x, sizeof(float) * count);
+	memcpy(hash->y + first, y, sizeof(float) * count);
+	memcpy(hash->z + first, z, sizeof(float) * count);
+	memset(hash->kind + first, kind, count);
+	for (i = 0; i < count; i++) {
+		hash->index[first + i] = i;
+	}
+	hash->count += count;
+	return first;
+}
+/**
+ * computeBuckets
+ * Job finding the bucket of a range of entities.
+ */
+static void computeBuckets(void* data, int begin, int end, int worker) {
+	SpatialHash* hash = data;
+	int i;
+	for (i = begin; i < end; i++) {
+		hash->bucket[i] = bucketOf(hash, cellOf(hash, hash->x[i]),
+				cellOf(hash, hash->y[i]), cellOf(hash, hash->z[i]));
+	}
+}
+/**
+ * sizeCells
+ * Picks the cell size that spreads the entities over their bounds at
+ * SPATIAL_PER_CELL per cell, and finds the cells the bounds cover.
+ * Entities flatter than the cells that would give over their area only
+ * fill one layer of cells, so those are sized for the area alone. The
+ * size is then scaled by what the builds before learnt.
+ */
+static void sizeCells(SpatialHash* hash) {
+	float minX = hash->x[0], maxX = hash->x[0];
+	float minY = hash->y[0], maxY = hash->y[0];
+	float minZ = hash->z[0], maxZ = hash->z[0];
+	float height, cellSize;
+	int i;
+	for (i = 1; i < hash->count; i++) {
+		minX = hash->x[i] < minX ? hash->x[i] : minX;
+		maxX = hash->x[i] > maxX ? hash->x[i] : maxX;
+		minY = hash->y[i] < minY ? hash->y[i] : minY;
+		maxY = hash->y[i] > maxY ? hash->y[i] : maxY;
+		minZ = hash->z[i] < minZ ? hash->z[i] : minZ;
+		maxZ = hash->z[i] > maxZ ? hash->z[i] : maxZ;
+	}
+	cellSize = sqrtf(fmaxf(maxX - minX, SPATIAL_MIN_CELL)
+			* fmaxf(maxZ - minZ, SPATIAL_MIN_CELL) * SPATIAL_PER_CELL / hash->count);
+	height = maxY - minY;
+	if (height > cellSize) {
+		cellSize = cbrtf(cellSize * cellSize * height);
+	}
+	cellSize *= hash->cellScale;
+	//also catches bounds that are not finite
+	if (!(cellSize < hash->maxCellSize)) {
+		cellSize = hash->maxCellSize;
+	}
+	hash->cellSize = fmaxf(cellSize, SPATIAL_MIN_CELL);
+	hash->inverseCell = 1.0f / hash->cellSize;
+	hash->minCellX = cellOf(hash, minX);
+	hash->maxCellX = cellOf(hash, maxX);
+	hash->minCellY = cellOf(hash, minY);
+	hash->maxCellY = cellOf(hash, maxY);
+	hash->minCellZ = cellOf(hash, minZ);
+	hash->maxCellZ = cellOf(hash, maxZ);
+}
+/**
+ * listCells
+ * Lists the cells of the sorted entities, a bucket's in the order their
+ * first entities come in it.
+ */
+static void listCells(SpatialHash* hash) {
+	int b, e, c;
+	hash->numCells = 0;
+	for (b = 0; b < hash->numBuckets; b++) {
+		int first = hash->numCells;
+		for (e = hash->start[b]; e < hash->start[b + 1]; e++) {
+			const SpatialEntry* entry = &hash->sorted[e];
+			SpatialCell* cell;
+			//a bucket almost always holds one cell
+			for (c = first; c < hash->numCells; c++) {
+				cell = &hash->cells[c];
+				if (cell->cellX == entry->cellX && cell->cellY == entry->cellY
+						&& cell->cellZ == entry->cellZ) {
+					break;
+				}
+			}
+			if (c < hash->numCells) {
+				continue;
+			}
+			cell = &hash->cells[hash->numCells++];
+			cell->cellX = entry->cellX;
+			cell->cellY = entry->cellY;
+			cell->cellZ = entry->cellZ;
+			cell->bucket = b;
+		}
+	}
+}
+/**
+ * spatialBuild
+ * Sizes the cells and sorts the entities inserted since the last clear by
+ * bucket, stably, so queries see them in the same order on every run.
+ */
+void spatialBuild(SpatialHash* hash) {
+	int numBuckets = hash->numBuckets;
+	int sum = 0;
+	int i, b;
+	hash->minCellX = hash->minCellY = hash->minCellZ = SPATIAL_MAX_CELL;
+	hash->maxCellX = hash->maxCellY = hash->maxCellZ = -SPATIAL_MAX_CELL;
+	if (hash->count == 0) {
+		return;
+	}
+	sizeCells(hash);
+	jobsParallelFor(hash->count, SPATIAL_GRAIN, computeBuckets, hash);
+	memset(hash->start, 0, sizeof(int) * (numBuckets + 1));
+	for (i = 0; i < hash->count; i++) {
+		hash->start[hash->bucket[i]]++;
+	}
+	for (b = 0; b <= numBuckets; b++) {
+		int size = hash->start[b];
+		hash->start[b] = sum;
+		sum += size;
+	}
+	//each bucket's start moves to the next one's as it fills
+	for (i = 0; i < hash->count; i++) {
+		SpatialEntry* entry = &hash->sorted[hash->start[hash->bucket[i]]++];
+		entry->x = hash->x[i];
+		entry->y = hash->y[i];
+		entry->z = hash->z[i];
+		entry->id = i;
+		entry->cellX = cellOf(hash, hash->x[i]);
+		entry->cellY = cellOf(hash, hash->y[i]);
+		entry->cellZ = cellOf(hash, hash->z[i]);
+		entry->kind = hash->kind[i];
+	}
+	for (b = numBuckets; b > 0; b--) {
+		hash->start[b] = hash->start[b - 1];
+	}
+	hash->start[0] = 0;
+	listCells(hash);
+	//a cube root, the cells hold that many fewer when a third the volume
+	hash->cellScale *= cbrtf(SPATIAL_PER_CELL * hash->numCells / hash->count);
+	hash->cellScale = fminf(fmaxf(hash->cellScale, SPATIAL_MIN_SCALE),
+			SPATIAL_MAX_SCALE);
+}
+/**
+ * collect
+ * Tests one sorted entity against the query and keeps it if it matches.
+ * Nearest queries keep the closest maxHits in order, the others keep the
+ * first maxHits and count the rest.
+ */
+static void collect(Collector* collector, const SpatialEntry* entry) {
+	const SpatialQuery* query = collector->query;
+	float dx, dy, dz, distanceSquared;
+	SpatialHit hit;
+	int i;
+	if (entry->id == query->ignore
+			|| !(query->kinds & SPATIAL_KIND_BIT(entry->kind))) {
+		return;
+	}
+	dx = entry->x - query->x;
+	dy = entry->y - query->y;
+	dz = entry->z - query->z;
+	distanceSquared = dx * dx + dy * dy + dz * dz;
+	if (distanceSquared > collector->radiusSquared) {
+		return;
+	}
+	if (query->type == SPATIAL_CONE && distanceSquared > 0.0f
+			&& dx * query->dirX + dy * query->dirY + dz * query->dirZ
+					< query->cosHalfAngle * sqrtf(distanceSquared)) {
+		return;
+	}
+	hit.id = entry->id;
+	hit.kind = entry->kind;
+	hit.index = collector->hash->index[entry->id];
+	hit.distanceSquared = distanceSquared;
+	if (query->type != SPATIAL_NEAREST) {
+		if (collector->found < collector->maxHits) {
+			collector->hits[collector->found] = hit;
+		}
+		collector->found++;
+		return;
+	}
+	if (collector->found == collector->maxHits) {
+		if (distanceSquared >= collector->hits[collector->found - 1].distanceSquared) {
+			return;
+		}
+		collector->found--;
+	}
+	//insertion into the sorted hits, maxHits is small
+	i = collector->found;
+	while (i > 0 && collector->hits[i - 1].distanceSquared > distanceSquared) {
+		collector->hits[i] = collector->hits[i - 1];
+		i--;
+	}
+	collector->hits[i] = hit;
+	collector->found++;
+}
+/**
+ * collectBucket
+ * Tests the entities of one cell, sorted into bucket.
+ */
+static void collectBucket(Collector* collector, int bucket, int cellX, int cellY,
+		int cellZ) {
+	const SpatialHash* hash = collector->hash;
+	int e;
+	for (e = hash->start[bucket]; e < hash->start[bucket + 1]; e++) {
+		const SpatialEntry* entry = &hash->sorted[e];
+		if (entry->cellX == cellX && entry->cellY == cellY && entry->cellZ == cellZ) {
+			collect(collector, entry);
+		}
+	}
+}
+/**
+ * collectCell
+ * Tests the entities in one cell.
+ */
+static void collectCell(Collector* collector, int cellX, int cellY, int cellZ) {
+	const SpatialHash* hash = collector->hash;
+	if (cellX < hash->minCellX || cellX > hash->maxCellX
+			|| cellY < hash->minCellY || cellY > hash->maxCellY
+			|| cellZ < hash->minCellZ || cellZ > hash->maxCellZ) {
+		return;
+	}
+	collectBucket(collector, bucketOf(hash, cellX, cellY, cellZ), cellX, cellY,
+			cellZ);
+}
+/**
+ * queryRange
+ * Radius and cone queries: looks at every cell the radius overlaps, or at
+ * every cell holding entities if there are fewer of those.
+ */
+static void queryRange(Collector* collector) {
+	const SpatialHash* hash = collector->hash;
+	const SpatialQuery* query = collector->query;
+	int minX = cellOf(hash, query->x - query->radius);
+	int maxX = cellOf(hash, query->x + query->radius);
+	int minY = cellOf(hash, query->y - query->radius);
+	int maxY = cellOf(hash, query->y + query->radius);
+	int minZ = cellOf(hash, query->z - query->radius);
+	int maxZ = cellOf(hash, query->z + query->radius);
+	int cellX, cellY, cellZ, c;
+	minX = minX > hash->minCellX ? minX : hash->minCellX;
+	maxX = maxX < hash->maxCellX ? maxX : hash->maxCellX;
+	minY = minY > hash->minCellY ? minY : hash->minCellY;
+	maxY = maxY < hash->maxCellY ? maxY : hash->maxCellY;
+	minZ = minZ > hash->minCellZ ? minZ : hash->minCellZ;
+	maxZ = maxZ < hash->maxCellZ ? maxZ : hash->maxCellZ;
+	if (minX > maxX || minY > maxY || minZ > maxZ) {
+		return;
+	}
+	if ((double) (maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1)
+			> hash->numCells) {
+		for (c = 0; c < hash->numCells; c++) {
+			const SpatialCell* cell = &hash->cells[c];
+			if (cell->cellX >= minX && cell->cellX <= maxX && cell->cellY >= minY
+					&& cell->cellY <= maxY && cell->cellZ >= minZ && cell->cellZ <= maxZ) {
+				collectBucket(collector, cell->bucket, cell->cellX, cell->cellY,
+						cell->cellZ);
+			}
+		}
+		return;
+	}
+	for (cellX = minX; cellX <= maxX; cellX++) {
+		for (cellZ = minZ; cellZ <= maxZ; cellZ++) {
+			for (cellY = minY; cellY <= maxY; cellY++) {
+				collectCell(collector, cellX, cellY, cellZ);
+			}
+		}
+	}
+}
+/**
+ * shellDistance
+ * How far along one axis the coordinate is from leaving the cells within
+ * ring of its own cell, center.
+ */
+static float shellDistance(const SpatialHash* hash, float coordinate, int center,
+		int ring) {
+	float below = coordinate - (center - ring) * hash->cellSize;
+	float above = (center + ring + 1) * hash->cellSize - coordinate;
+	//not fminf and fmaxf, which are library calls on this hot path
+	float distance = below < above ? below : above;
+	return distance > 0.0f ? distance : 0.0f;
+}
+/**
+ * axisGap
+ * How far along one axis the coordinate is from a cell, 0 inside it, a
+ * little short so an entity that rounded into the cell is not missed.
+ */
+static float axisGap(const SpatialHash* hash, float coordinate, int cell) {
+	float below = cell * hash->cellSize - coordinate;
+	float above = coordinate - (cell + 1) * hash->cellSize;
+	float gap = (below > above ? below : above) - hash->cellSize * SPATIAL_CELL_SLACK;
+	return gap > 0.0f ? gap : 0.0f;
+}
+/**
+ * addToShell
+ * Adds a cell of a nearest query's shell to those to look at unless it is
+ * out of the radius or farther than all the closest hits found. Takes it
+ * from the budget either way.
+ */
+static void addToShell(Collector* collector, ShellCell* shell, int* numShell,
+		int cellX, int cellY, int cellZ, int* budget) {
+	const SpatialHash* hash = collector->hash;
+	const SpatialQuery* query = collector->query;
+	float dx = axisGap(hash, query->x, cellX);
+	float dy = axisGap(hash, query->y, cellY);
+	float dz = axisGap(hash, query->z, cellZ);
+	float gapSquared = dx * dx + dy * dy + dz * dz;
+	ShellCell* cell;
+	(*budget)--;
+	if (gapSquared > collector->radiusSquared
+			|| (collector->found == collector->maxHits
+					&& gapSquared >= collector->hits[collector->found - 1].distanceSquared)) {
+		return;
+	}
+	cell = &shell[(*numShell)++];
+	cell->gapSquared = gapSquared;
+	cell->cellX = cellX;
+	cell->cellY = cellY;
+	cell->cellZ = cellZ;
+}
+/**
+ * compareShellCells
+ */
+static int compareShellCells(const void* a, const void* b) {
+	float gapA = ((const ShellCell*) a)->gapSquared;
+	float gapB = ((const ShellCell*) b)->gapSquared;
+	return gapA < gapB ? -1 : gapA > gapB;
+}
+/**
+ * collectShell
+ * Looks at the cells of a shell nearest first, so the closest hits are
+ * found early and the far corners are usually left out.
+ */
+static void collectShell(Collector* collector, ShellCell* shell, int numShell) {
+	int i, j;
+	if (numShell > SPATIAL_SHELL_INSERTION) {
+		qsort(shell, numShell, sizeof(ShellCell), compareShellCells);
+	} else {
+		for (i = 1; i < numShell; i++) {
+			ShellCell cell = shell[i];
+			for (j = i; j > 0 && shell[j - 1].gapSquared > cell.gapSquared; j--) {
+				shell[j] = shell[j - 1];
+			}
+			shell[j] = cell;
+		}
+	}
+	for (i = 0; i < numShell; i++) {
+		const ShellCell* cell = &shell[i];
+		if (collector->found == collector->maxHits && cell->gapSquared
+				>= collector->hits[collector->found - 1].distanceSquared) {
+			return;
+		}
+		collectBucket(collector, bucketOf(collector->hash, cell->cellX, cell->cellY,
+				cell->cellZ), cell->cellX, cell->cellY, cell->cellZ);
+	}
+}
+/**
+ * queryNearest
+ * Nearest queries: looks at shells of cells around the query's cell until
+ * nothing closer than what was found can be in the next shell, which is at
+ * least as far as the nearest face of the shells already looked at. Only
+ * the cells of a shell inside the entities' bounds are looked at, starting
+ * with the first shell that reaches them, and no more than
+ * SPATIAL_NEAREST_CELLS of them.
+ */
+static void queryNearest(Collector* collector) {
+	const SpatialHash* hash = collector->hash;
+	const SpatialQuery* query = collector->query;
+	int centerX = cellOf(hash, query->x);
+	int centerY = cellOf(hash, query->y);
+	int centerZ = cellOf(hash, query->z);
+	int budget = SPATIAL_NEAREST_CELLS;
+	ShellCell shell[SPATIAL_NEAREST_CELLS];
+	int first = 0;
+	int ring, cellX, cellY, cellZ;
+	if (collector->maxHits <= 0) {
+		return;
+	}
+	//the shells inside the first one to reach the bounds are empty
+	first = hash->minCellX - centerX > first ? hash->minCellX - centerX : first;
+	first = centerX - hash->maxCellX > first ? centerX - hash->maxCellX : first;
+	first = hash->minCellY - centerY > first ? hash->minCellY - centerY : first;
+	first = centerY - hash->maxCellY > first ? centerY - hash->maxCellY : first;
+	first = hash->minCellZ - centerZ > first ? hash->minCellZ - centerZ : first;
+	first = centerZ - hash->maxCellZ > first ? centerZ - hash->maxCellZ : first;
+	for (ring = first; budget > 0; ring++) {
+		float reach = ring == 0 ? 0.0f : fminf(fminf(
+				shellDistance(hash, query->x, centerX, ring - 1),
+				shellDistance(hash, query->y, centerY, ring - 1)),
+				shellDistance(hash, query->z, centerZ, ring - 1));
+		int minX = centerX - ring > hash->minCellX ? centerX - ring : hash->minCellX;
+		int maxX = centerX + ring < hash->maxCellX ? centerX + ring : hash->maxCellX;
+		int minY = centerY - ring > hash->minCellY ? centerY - ring : hash->minCellY;
+		int maxY = centerY + ring < hash->maxCellY ? centerY + ring : hash->maxCellY;
+		int minZ = centerZ - ring > hash->minCellZ ? centerZ - ring : hash->minCellZ;
+		int maxZ = centerZ + ring < hash->maxCellZ ? centerZ + ring : hash->maxCellZ;
+		int numShell = 0;
+		if (ring > 0 && (reach > query->radius || (collector->found == collector->maxHits
+				&& collector->hits[collector->found - 1].distanceSquared
+						<= reach * reach))) {
+			return;
+		}
+		if (ring > 0 && centerX - ring < hash->minCellX && centerX + ring > hash->maxCellX
+				&& centerY - ring < hash->minCellY && centerY + ring > hash->maxCellY
+				&& centerZ - ring < hash->minCellZ && centerZ + ring > hash->maxCellZ) {
+			//the last shell held every cell there is
+			return;
+		}
+		for (cellX = minX; cellX <= maxX && budget > 0; cellX++) {
+			for (cellZ = minZ; cellZ <= maxZ && budget > 0; cellZ++) {
+				if (abs(cellX - centerX) == ring || abs(cellZ - centerZ) == ring) {
+					//a side of the shell, every cell of the column
+					for (cellY = minY; cellY <= maxY && budget > 0; cellY++) {
+						addToShell(collector, shell, &numShell, cellX, cellY, cellZ,
+								&budget);
+					}
+					continue;
+				}
+				//the shell's top and bottom
+				if (centerY - ring == minY) {
+					addToShell(collector, shell, &numShell, cellX, minY, cellZ, &budget);
+				}
+				if (centerY + ring == maxY && budget > 0) {
+					addToShell(collector, shell, &numShell, cellX, maxY, cellZ, &budget);
+				}
+			}
+		}
+		collectShell(collector, shell, numShell);
+	}
+}
+/**
+ * spatialQuery
+ * Runs one query. Nearest queries write the closest maxHits hits in order
+ * and return how many there are. Radius and cone queries write the first
+ * maxHits hits found and return how many matched in all.
+ */
+int spatialQuery(const SpatialHash* hash, const SpatialQuery* query,
+		SpatialHit* hits, int maxHits) {
+	Collector collector;
+	if (hash->count == 0) {
+		return 0;
+	}
+	collector.hash = hash;
+	collector.query = query;
+	collector.radiusSquared = query->radius * query->radius;
+	collector.hits = hits;
+	collector.maxHits = maxHits;
+	collector.found = 0;
+	if (query->type == SPATIAL_NEAREST) {
+		queryNearest(&collector);
+	} else {
+		queryRange(&collector);
+	}
+	return collector.found;
+}
+/**
+ * queryJob
+ * Job running a range of a batch's queries.
+ */
+static void queryJob(void* data, int begin, int end, int worker) {
+	BatchJob* job = data;
+	int i;
+	for (i = begin; i < end; i++) {
+		int q = job->order != NULL ? job->order[i] : i;
+		job->found[q] = spatialQuery(job->hash, &job->queries[q],
+				job->hits + (size_t) q * job->maxHits, job->maxHits);
+	}
+}
+/**
+ * orderQueries
+ * Sorts a batch's queries by the bucket they start in, so neighbouring
+ * queries read the same entities while those are still cached. Returns the
+ * order to free, NULL if there is no memory for it.
+ */
+static int* orderQueries(const SpatialHash* hash, const SpatialQuery* queries,
+		int count) {
+	int* order = malloc(sizeof(int) * count);
+	int* bucket = malloc(sizeof(int) * count);
+	int* start = calloc(hash->numBuckets + 1, sizeof(int));
+	int sum = 0;
+	int q, b;
+	if (order == NULL || bucket == NULL || start == NULL) {
+		free(order);
+		free(bucket);
+		free(start);
+		return NULL;
+	}
+	for (q = 0; q < count; q++) {
+		bucket[q] = bucketOf(hash, cellOf(hash, queries[q].x),
+				cellOf(hash, queries[q].y), cellOf(hash, queries[q].z));
+		start[bucket[q]]++;
+	}
+	for (b = 0; b <= hash->numBuckets; b++) {
+		int size = start[b];
+		start[b] = sum;
+		sum += size;
+	}
+	for (q = 0; q < count; q++) {
+		order[start[bucket[q]]++] = q;
+	}
+	free(bucket);
+	free(start);
+	return order;
+}
+/**
+ * spatialQueryBatch
+ * Runs count queries on the worker threads, in the order of where they are.
+ * Query q writes up to maxHits hits from hits[q * maxHits] and its result
+ * in found[q].
+ */
+void spatialQueryBatch(const SpatialHash* hash, const SpatialQuery* queries,
+		int count, int maxHits, SpatialHit* hits, int* found) {
+	BatchJob job = { hash, queries, NULL, maxHits, hits, found };
+	if (hash->count > 0 && count > SPATIAL_QUERY_GRAIN) {
+		job.order = orderQueries(hash, queries, count);
+	}
+	jobsParallelFor(count, SPATIAL_QUERY_GRAIN, queryJob, &job);
+	free((int*) job.order);
+}
@@ -0,0 +1,124 @@
+/*
+ * spatial.h
+ * CG flight simulator
+ * Spatial hash over everything that moves, for "what is near me" queries.
+ * It is rebuilt every tick with a counting sort by bucket, its cells sized
+ * to hold a few entities each. Queries only read the hash and can run on
+ * any number of threads.
+ */
+
+#ifndef SPATIAL_H_
+#define SPATIAL_H_
+
+//what an entity is, the index is into that kind's own storage
+typedef enum SpatialKind {
+	SPATIAL_PLAYER,
+	SPATIAL_AI,
+	SPATIAL_BULLET,
+	SPATIAL_KIND_COUNT
+} SpatialKind;
+
+#define SPATIAL_KIND_BIT(kind) (1u << (kind))
+#define SPATIAL_ALL_KINDS ((1u << SPATIAL_KIND_COUNT) - 1)
+//largest size of a grid cell in world units
+#define SPATIAL_DEFAULT_CELL 32.0f
+
+//an entity as the queries read it, sorted by bucket
+typedef struct SpatialEntry {
+	float x;
+	float y;
+	float z;
+	int id;
+	int cellX;
+	int cellY;
+	int cellZ;
+	int kind;
+} SpatialEntry;
+
+//a cell holding entities and the bucket they are sorted into
+typedef struct SpatialCell {
+	int cellX;
+	int cellY;
+	int cellZ;
+	int bucket;
+} SpatialCell;
+
+typedef struct SpatialHash {
+	float maxCellSize;
+	//cell size of the last build
+	float cellSize;
+	float inverseCell;
+	//of the cell size the bounds give, learnt from how crowded cells were
+	float cellScale;
+	int count;
+	int capacity;
+	//entities as inserted, an entity's id is its place here
+	float* x;
+	float* y;
+	float* z;
+	unsigned char* kind;
+	int* index;
+	int* bucket;
+	//entities sorted by bucket, bucket b is [start[b], start[b + 1])
+	int numBuckets;
+	int* start;
+	SpatialEntry* sorted;
+	//cells holding entities in bucket order, each once
+	int numCells;
+	SpatialCell* cells;
+	//cells every entity is in
+	int minCellX;
+	int maxCellX;
+	int minCellY;
+	int maxCellY;
+	int minCellZ;
+	int maxCellZ;
+} SpatialHash;
+
+typedef enum SpatialQueryType {
+	//everything within radius
+	SPATIAL_RADIUS,
+	//everything within radius and the cone around direction, like a radar
+	SPATIAL_CONE,
+	//the closest ones within radius, closest first
+	SPATIAL_NEAREST
+} SpatialQueryType;
+
+typedef struct SpatialQuery {
+	SpatialQueryType type;
+	float x;
+	float y;
+	float z;
+	float radius;
+	//cone axis, unit length, and the cosine of half its angle
+	float dirX;
+	float dirY;
+	float dirZ;
+	float cosHalfAngle;
+	//SPATIAL_KIND_BIT of the kinds wanted
+	unsigned int kinds;
+	//id of an entity to leave out (the one asking), -1 for none
+	int ignore;
+} SpatialQuery;
+
+typedef struct SpatialHit {
+	int id;
+	SpatialKind kind;
+	int index;
+	float distanceSquared;
+} SpatialHit;
+
+int spatialInit(SpatialHash* hash, float maxCellSize);
+void spatialFree(SpatialHash* hash);
+void spatialClear(SpatialHash* hash);
+int spatialInsert(SpatialHash* hash, SpatialKind kind, int index, float x,
+		float y, float z);
+int spatialInsertMany(SpatialHash* hash, SpatialKind kind, int count,
+		const float* x, const float* y, const float* z);
+void spatialBuild(SpatialHash* hash);
+int spatialQuery(const SpatialHash* hash, const SpatialQuery* query,
+		SpatialHit* hits, int maxHits);
+void spatialQueryBatch(const SpatialHash* hash, const SpatialQuery* queries,
+		int count, int maxHits, SpatialHit* hits, int* found);
+
+#endif /* SPATIAL_H_ */
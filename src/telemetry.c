@@ -0,0 +1,233 @@
+/**
+ * telemetry.c
+ * CG flight simulator
+ * Shared memory telemetry stream, see telemetry.h.
+ * Each slot is a seqlock: the publisher marks the slot odd, stores the
+ * record's words and marks it with the record's even number, then moves the
+ * head on. A reader loads the sequence, the words and the sequence again and
+ * keeps the copy only if both loads saw the number of the record it wanted.
+ * Every word goes through an atomic load or store so the racing copy is
+ * well defined.
+ */
+
+#include <string.h>
+#include "telemetry.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TELEMETRY_MAGIC 0x4d4c4554u
+#define TELEMETRY_WORDS (sizeof(TelemetryRecord) / sizeof(uint32_t))
+
+typedef struct TelemetrySlot {
+	uint64_t sequence;
+	uint32_t words[TELEMETRY_WORDS];
+} TelemetrySlot;
+
+struct TelemetryStream {
+	//set last by the publisher, readers wait for it
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t recordSize;
+	//records published so far
+	uint64_t head;
+	uint32_t closed;
+	uint32_t padding;
+	TelemetrySlot ring[TELEMETRY_SLOTS];
+};
+
+//the publisher's mapping and what it has published
+static TelemetryStream* publisher = NULL;
+static uint64_t published = 0;
+static char publisherName[256];
+
+#ifndef _WIN32
+/**
+ * mapStream
+ * Maps the shared memory object of an open descriptor, NULL if it is not the
+ * size of a stream.
+ */
+static TelemetryStream* mapStream(int file, int writable) {
+	struct stat status;
+	void* data;
+	if (fstat(file, &status) != 0
+			|| (size_t) status.st_size != sizeof(TelemetryStream)) {
+		return NULL;
+	}
+	data = mmap(NULL, sizeof(TelemetryStream),
+			writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	return data == MAP_FAILED ? NULL : data;
+}
+#endif
+/**
+ * telemetryOpenPublisher
+ * Creates the stream name, replacing one a crashed run left behind.
+ * Returns 0 if it could not, or where shared memory is not available.
+ */
+int telemetryOpenPublisher(const char* name) {
+#ifdef _WIN32
+	(void) name;
+	return 0;
+#else
+	int file;
+	if (publisher != NULL || strlen(name) >= sizeof(publisherName)) {
+		return 0;
+	}
+	//readers of the old stream keep their mapping, this run gets a new one
+	shm_unlink(name);
+	file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (file < 0) {
+		return 0;
+	}
+	if (ftruncate(file, sizeof(TelemetryStream)) != 0) {
+		close(file);
+		shm_unlink(name);
+		return 0;
+	}
+	publisher = mapStream(file, 1);
+	close(file);
+	if (publisher == NULL) {
+		shm_unlink(name);
+		return 0;
+	}
+	strcpy(publisherName, name);
+	published = 0;
+	//the new object is zeroed, only the description is left to fill in
+	publisher->version = TELEMETRY_VERSION;
+	publisher->slots = TELEMETRY_SLOTS;
+	publisher->recordSize = sizeof(TelemetryRecord);
+	__atomic_store_n(&publisher->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+	return 1;
+#endif
+}
+/**
+ * telemetryPublish
+ * Writes record into the next slot, does nothing if no stream is open.
+ */
+void telemetryPublish(const TelemetryRecord* record) {
+	uint32_t words[TELEMETRY_WORDS];
+	TelemetrySlot* slot;
+	size_t i;
+	if (publisher == NULL) {
+		return;
+	}
+	memcpy(words, record, sizeof(words));
+	slot = &publisher->ring[published & (TELEMETRY_SLOTS - 1)];
+	__atomic_store_n(&slot->sequence, published * 2 + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	for (i = 0; i < TELEMETRY_WORDS; i++) {
+		__atomic_store_n(&slot->words[i], words[i], __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&slot->sequence, published * 2 + 2, __ATOMIC_RELEASE);
+	published++;
+	__atomic_store_n(&publisher->head, published, __ATOMIC_RELEASE);
+}
+/**
+ * telemetryClosePublisher
+ * Tells readers the stream has ended and removes its name.
+ */
+void telemetryClosePublisher(void) {
+#ifndef _WIN32
+	if (publisher == NULL) {
+		return;
+	}
+	__atomic_store_n(&publisher->closed, 1, __ATOMIC_RELEASE);
+	munmap(publisher, sizeof(TelemetryStream));
+	shm_unlink(publisherName);
+	publisher = NULL;
+#endif
+}
+/**
+ * telemetryOpenReader
+ * Opens the stream name to read from the next record published. Returns 0 if
+ * there is no stream yet or it is not one this build can read.
+ */
+int telemetryOpenReader(TelemetryReader* reader, const char* name) {
+	memset(reader, 0, sizeof(TelemetryReader));
+#ifdef _WIN32
+	(void) name;
+	return 0;
+#else
+	int file = shm_open(name, O_RDONLY, 0);
+	if (file < 0) {
+		return 0;
+	}
+	reader->stream = mapStream(file, 0);
+	close(file);
+	if (reader->stream == NULL) {
+		return 0;
+	}
+	if (__atomic_load_n(&reader->stream->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC
+			|| reader->stream->version != TELEMETRY_VERSION
+			|| reader->stream->slots != TELEMETRY_SLOTS
+			|| reader->stream->recordSize != sizeof(TelemetryRecord)) {
+		telemetryCloseReader(reader);
+		return 0;
+	}
+	reader->next = __atomic_load_n(&reader->stream->head, __ATOMIC_ACQUIRE);
+	return 1;
+#endif
+}
+/**
+ * telemetryRead
+ * Copies the reader's next record into record. Records that were
+ * overwritten first are skipped and counted. Returns 0 if none is ready.
+ */
+int telemetryRead(TelemetryReader* reader, TelemetryRecord* record) {
+	uint32_t words[TELEMETRY_WORDS];
+	uint64_t head = __atomic_load_n(&reader->stream->head, __ATOMIC_ACQUIRE);
+	while (reader->next < head) {
+		const TelemetrySlot* slot;
+		uint64_t expected;
+		uint64_t before;
+		size_t i;
+		if (head - reader->next > TELEMETRY_SLOTS) {
+			reader->dropped += head - TELEMETRY_SLOTS - reader->next;
+			reader->next = head - TELEMETRY_SLOTS;
+		}
+		slot = &reader->stream->ring[reader->next & (TELEMETRY_SLOTS - 1)];
+		expected = reader->next * 2 + 2;
+		before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		if (before != expected) {
+			//lapped since head was read
+			reader->dropped++;
+			reader->next++;
+			continue;
+		}
+		for (i = 0; i < TELEMETRY_WORDS; i++) {
+			words[i] = __atomic_load_n(&slot->words[i], __ATOMIC_RELAXED);
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		reader->next++;
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != before) {
+			reader->torn++;
+			continue;
+		}
+		memcpy(record, words, sizeof(words));
+		return 1;
+	}
+	return 0;
+}
+/**
+ * telemetryPublisherClosed
+ * Whether the publisher has ended the stream. Records published before it
+ * did can still be read.
+ */
+int telemetryPublisherClosed(const TelemetryReader* reader) {
+	return __atomic_load_n(&reader->stream->closed, __ATOMIC_ACQUIRE) != 0;
+}
+/**
+ * telemetryCloseReader
+ */
+void telemetryCloseReader(TelemetryReader* reader) {
+#ifndef _WIN32
+	if (reader->stream != NULL) {
+		munmap(reader->stream, sizeof(TelemetryStream));
+	}
+#endif
+	memset(reader, 0, sizeof(TelemetryReader));
+}
@@ -0,0 +1,61 @@
+/*
+ * telemetry.h
+ * CG flight simulator
+ * Telemetry stream for external tools in POSIX shared memory.
+ * The sim publishes one fixed layout record per tick into a ring of slots,
+ * any number of readers tail it without locks. Each slot carries a sequence
+ * number that is odd while its record is being written and 2n + 2 once
+ * record n is complete, so a reader knows whether it got the record it
+ * wanted, a newer one that lapped it, or a torn one. Publishing only stores
+ * into the mapping: it never allocates, blocks or waits for readers.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+#include <stdint.h>
+
+#define TELEMETRY_NAME "/flightsim-telemetry"
+#define TELEMETRY_VERSION 1
+//a power of two, readers more than this many records behind lose some
+#define TELEMETRY_SLOTS 256
+
+//only 32 bit fields, records are copied a word at a time
+typedef struct TelemetryRecord {
+	uint32_t tick;
+	uint32_t seed;
+	float universeTime;
+	float position[3];
+	//x, y, z, w
+	float orientation[4];
+	float speed;
+	int32_t alive;
+	int32_t exploding;
+	int32_t flightModel;
+	//bullets in flight, the oldest are dropped past the world's maximum
+	uint32_t bulletsLive;
+	uint32_t bulletsFired;
+	//this tick's cost, the last frame's work and the frame interval
+	float tickMs;
+	float frameMs;
+	float frameIntervalMs;
+} TelemetryRecord;
+
+typedef struct TelemetryStream TelemetryStream;
+
+typedef struct TelemetryReader {
+	TelemetryStream* stream;
+	uint64_t next;
+	//records overwritten before they were read, or torn while being read
+	uint64_t dropped;
+	uint64_t torn;
+} TelemetryReader;
+
+int telemetryOpenPublisher(const char* name);
+void telemetryPublish(const TelemetryRecord* record);
+void telemetryClosePublisher(void);
+int telemetryOpenReader(TelemetryReader* reader, const char* name);
+int telemetryRead(TelemetryReader* reader, TelemetryRecord* record);
+int telemetryPublisherClosed(const TelemetryReader* reader);
+void telemetryCloseReader(TelemetryReader* reader);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,135 @@
+/**
+ * terrain.c
+ * CG flight simulator
+ * Island generation, see terrain.h.
+ * Islands start as cones which are then raised recursively at midpoints.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "terrain.h"
+
+/**
+ * raiseMountain
+ * Recurssive function to randomize the heights of a heightmap using midpoints.
+ */
+static void raiseMountain(Rng* rng, float* map, int mapSize, int left,
+		int right, int top, int bottom, int iteration) {
+	if (iteration >= 8) {
+		return;
+	}
+	int width = right - left;
+	int height = bottom - top;
+	map[(left + (width / 2)) * mapSize + top + (height / 2)] += rngRange(rng, 0, 4)
+			/ (2.0f * iteration);
+	map[left * mapSize + top + (height / 2)] += rngRange(rng, 0, 4) / (2.0f * iteration);
+	map[(left + (width / 2)) * mapSize + top] += rngRange(rng, 0, 4) / (2.0f * iteration);
+	map[(left + (width - 1)) * mapSize + top + (height / 2)] += rngRange(rng, 0, 4)
+			/ (2.0f * iteration);
+	map[(left + (width / 2)) * mapSize + top + (height - 1)] += rngRange(rng, 0, 4)
+			/ (2.0f * iteration);
+
+	iteration++;
+
+	raiseMountain(rng, map, mapSize, left, left + (width / 2), top,
+			bottom - (height / 2), iteration);
+	raiseMountain(rng, map, mapSize, left + (width / 2), right, top,
+			bottom - (height / 2), iteration);
+	raiseMountain(rng, map, mapSize, left, left + (width / 2),
+			top + (height / 2), bottom, iteration);
+	raiseMountain(rng, map, mapSize, left + (width / 2), right,
+			top + (height / 2), bottom, iteration);
+}
+/**
+ * generateIsland
+ * Fills one island's height map and jitter.
+ */
+static void generateIsland(Island* island, Rng* rng, int mapSize) {
+	float* map = island->heights;
+	int x, z, i;
+	//initialize the heights to be in a cone-like shape based on distance from center
+	for (x = 0; x < mapSize; x++) {
+		for (z = 0; z < mapSize; z++) {
+			float distance =
+					sqrt((pow((mapSize/2)-x,2))+(pow((mapSize/2)-z,2)))
+							* 0.9f;
+			map[x * mapSize + z] = ((mapSize / 2) - distance) / 2.0f;
+			if (map[x * mapSize + z] < 0) {
+				map[x * mapSize + z] = 0;
+			}
+		}
+	}
+	rngFillFloats(rng, island->jitterX, mapSize * mapSize, -0.5f, 0.5f);
+	rngFillFloats(rng, island->jitterZ, mapSize * mapSize, -0.5f, 0.5f);
+	//recussively raise the mountain to give it peaks and valleys, ignore the edges
+	raiseMountain(rng, map, mapSize, 1, mapSize - 1, 1, mapSize - 1, 1);
+
+	//change the outeredge to always be flat on the ground (so their normals will be 0, 1, 0
+	for (i = 0; i < mapSize; i++) {
+		map[i * mapSize] = 0.0;
+		map[i * mapSize + mapSize - 1] = 0.0;
+		map[i] = 0.0;
+		map[(mapSize - 1) * mapSize + i] = 0.0;
+	}
+}
+/**
+ * terrainAllocate
+ * Sizes the arrays of islandCount islands for mapSize, keeping them when
+ * neither has changed. Returns 0 if they could not be allocated.
+ */
+int terrainAllocate(Terrain* terrain, int mapSize, int islandCount) {
+	int i;
+	if (terrain->mapSize == mapSize && terrain->islandCount == islandCount) {
+		return 1;
+	}
+	terrainFree(terrain);
+	if (islandCount < 1 || islandCount > TERRAIN_MAX_ISLANDS) {
+		return 0;
+	}
+	for (i = 0; i < islandCount; i++) {
+		Island* island = &terrain->islands[i];
+		island->heights = malloc(sizeof(float) * mapSize * mapSize * 3);
+		if (island->heights == NULL) {
+			terrainFree(terrain);
+			return 0;
+		}
+		island->jitterX = island->heights + mapSize * mapSize;
+		island->jitterZ = island->jitterX + mapSize * mapSize;
+	}
+	terrain->mapSize = mapSize;
+	terrain->islandCount = islandCount;
+	return 1;
+}
+/**
+ * terrainGenerate
+ * Generates every island from the stream, reusing the arrays when the map
+ * size and island count have not changed. Returns 0 if they could not be
+ * allocated.
+ */
+int terrainGenerate(Terrain* terrain, Rng* rng, int mapSize, int islandCount) {
+	int i;
+	if (!terrainAllocate(terrain, mapSize, islandCount)) {
+		return 0;
+	}
+	for (i = 0; i < islandCount; i++) {
+		Island* island = &terrain->islands[i];
+		//z first, the order gcc evaluated the glScalef arguments these came
+		//from, so existing seeds keep their islands
+		island->scaleZ = rngRange(rng, 20, 150) / 100.0f;
+		island->scaleY = rngRange(rng, 20, 150) / 100.0f;
+		island->scaleX = rngRange(rng, 20, 150) / 100.0f;
+		generateIsland(island, rng, mapSize);
+	}
+	return 1;
+}
+/**
+ * terrainFree
+ */
+void terrainFree(Terrain* terrain) {
+	int i;
+	for (i = 0; i < TERRAIN_MAX_ISLANDS; i++) {
+		free(terrain->islands[i].heights);
+	}
+	memset(terrain, 0, sizeof(Terrain));
+}
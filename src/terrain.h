@@ -0,0 +1,42 @@
+/*
+ * terrain.h
+ * CG flight simulator
+ * Height maps of the islands, generated from the terrain random stream.
+ * Generation only fills arrays, turning them into geometry is left to the
+ * renderer so worlds that are never drawn can skip it.
+ */
+
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+#include "rng.h"
+
+//islands of a world unless configured otherwise, and the most it can have
+#define TERRAIN_ISLANDS 3
+#define TERRAIN_MAX_ISLANDS 16
+//islands sit on a circle of this radius before scaling
+#define TERRAIN_ISLAND_DISTANCE 80.0f
+
+typedef struct Island {
+	//per axis scale on top of the halving every island gets
+	float scaleX;
+	float scaleY;
+	float scaleZ;
+	//mapSize x mapSize, indexed [x * mapSize + z], jitterX and jitterZ
+	//follow in the same allocation
+	float* heights;
+	//offsets applied to x and z when drawing so peaks are not always straight up
+	float* jitterX;
+	float* jitterZ;
+} Island;
+
+typedef struct Terrain {
+	int mapSize;
+	int islandCount;
+	Island islands[TERRAIN_MAX_ISLANDS];
+} Terrain;
+
+int terrainAllocate(Terrain* terrain, int mapSize, int islandCount);
+int terrainGenerate(Terrain* terrain, Rng* rng, int mapSize, int islandCount);
+void terrainFree(Terrain* terrain);
+
+#endif /* TERRAIN_H_ */
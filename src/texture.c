@@ -0,0 +1,584 @@
+/**
+ * texture.c
+ * CG flight simulator
+ * Texture residency, see texture.h.
+ * Level 0 of a texture is its file scaled to powers of two, as
+ * gluBuild2DMipmaps did. A texture resident from level n has the levels
+ * n and coarser uploaded as GL levels 0, 1, ..., so its GL name never
+ * changes. Only the GL thread touches GL; the streaming thread only reads
+ * files and fills the chain buffer of the one request in flight.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "texture.h"
+#include "timer.h"
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+#define TEXTURE_PATH 256
+//what a texel is estimated to take in GL, and takes in the files
+#define TEXTURE_GL_BYTES 4
+#define TEXTURE_FILE_BYTES 3
+
+typedef struct Texture {
+	char fileName[TEXTURE_PATH];
+	GLuint name;
+	//in the file, and of level 0
+	int width;
+	int height;
+	int baseWidth;
+	int baseHeight;
+	int levels;
+	//coarsest level ever kept, the first no larger than TEXTURE_FLOOR_SIZE
+	int floorLevel;
+	//finest level in GL, wanted by the renderer and allowed by the budget
+	int residentLevel;
+	int wantedLevel;
+	int targetLevel;
+	unsigned int lastWanted;
+	//its file could not be read again, it stays at the levels it has
+	int unreadable;
+} Texture;
+
+//file, level 0 and the chain from the requested level, grown as needed
+typedef struct ChainBuffers {
+	unsigned char* file;
+	size_t fileBytes;
+	unsigned char* base;
+	size_t baseBytes;
+	unsigned char* chain;
+	size_t chainBytes;
+} ChainBuffers;
+
+typedef enum StreamState {
+	STREAM_IDLE,
+	STREAM_REQUESTED,
+	STREAM_READY
+} StreamState;
+
+static Texture textures[TEXTURE_MAX];
+static int numTextures = 0;
+static size_t budget = 0;
+static unsigned int frame = 0;
+static TextureStats counters;
+//levels read back from GL to drop to a coarser level
+static unsigned char* readback = NULL;
+static size_t readbackBytes = 0;
+
+//the one stream request, its texture and level are set by the GL thread
+//while idle and its chain by the streamer while requested
+static StreamState streamState = STREAM_IDLE;
+static int streamTexture;
+static int streamLevel;
+static int streamFailed;
+static ChainBuffers streamBuffers;
+static int stopping = 0;
+static int streamerRunning = 0;
+static pthread_t streamer;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ready = PTHREAD_COND_INITIALIZER;
+
+/**
+ * levelSize
+ */
+static void levelSize(const Texture* texture, int level, int* width, int* height) {
+	*width = texture->baseWidth >> level;
+	*height = texture->baseHeight >> level;
+	*width = *width < 1 ? 1 : *width;
+	*height = *height < 1 ? 1 : *height;
+}
+/**
+ * chainTexels
+ * Texels in the levels from level to the last.
+ */
+static size_t chainTexels(const Texture* texture, int level) {
+	size_t texels = 0;
+	int width, height;
+	for (; level < texture->levels; level++) {
+		levelSize(texture, level, &width, &height);
+		texels += (size_t) width * height;
+	}
+	return texels;
+}
+/**
+ * chainBytes
+ * Estimated GL memory of a texture resident from level.
+ */
+static size_t chainBytes(const Texture* texture, int level) {
+	return chainTexels(texture, level) * TEXTURE_GL_BYTES;
+}
+/**
+ * powerOfTwoBelow
+ */
+static int powerOfTwoBelow(int size) {
+	int power = 1;
+	while (power * 2 <= size) {
+		power *= 2;
+	}
+	return power;
+}
+/**
+ * grow
+ * Makes a buffer at least bytes long. Returns 0 if out of memory.
+ */
+static int grow(unsigned char** buffer, size_t* size, size_t bytes) {
+	unsigned char* grown;
+	if (*size >= bytes) {
+		return 1;
+	}
+	grown = realloc(*buffer, bytes);
+	if (grown == NULL) {
+		return 0;
+	}
+	*buffer = grown;
+	*size = bytes;
+	return 1;
+}
+/**
+ * scaleImage
+ * Scales an RGB image to another size, sampling it bilinearly at the
+ * center of every pixel.
+ */
+static void scaleImage(const unsigned char* in, int inWidth, int inHeight,
+		unsigned char* out, int outWidth, int outHeight) {
+	float stepX = (float) inWidth / outWidth;
+	float stepY = (float) inHeight / outHeight;
+	int x, y, c;
+	for (y = 0; y < outHeight; y++) {
+		float sy = (y + 0.5f) * stepY - 0.5f;
+		int y0 = sy < 0 ? 0 : (int) sy;
+		int y1 = y0 + 1 < inHeight ? y0 + 1 : inHeight - 1;
+		float fy = sy < 0 ? 0 : sy - y0;
+		for (x = 0; x < outWidth; x++) {
+			float sx = (x + 0.5f) * stepX - 0.5f;
+			int x0 = sx < 0 ? 0 : (int) sx;
+			int x1 = x0 + 1 < inWidth ? x0 + 1 : inWidth - 1;
+			float fx = sx < 0 ? 0 : sx - x0;
+			const unsigned char* a = in + ((size_t) y0 * inWidth + x0) * 3;
+			const unsigned char* b = in + ((size_t) y0 * inWidth + x1) * 3;
+			const unsigned char* d = in + ((size_t) y1 * inWidth + x0) * 3;
+			const unsigned char* e = in + ((size_t) y1 * inWidth + x1) * 3;
+			for (c = 0; c < 3; c++) {
+				float top = a[c] + (b[c] - a[c]) * fx;
+				float bottom = d[c] + (e[c] - d[c]) * fx;
+				*out++ = (unsigned char) (top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+}
+/**
+ * halveImage
+ * Averages every 2x2 block of an RGB image into one pixel, in place.
+ * Each output pixel is written before any input pixel after it is read.
+ */
+static void halveImage(unsigned char* image, int width, int height) {
+	int outWidth = width > 1 ? width / 2 : 1;
+	int outHeight = height > 1 ? height / 2 : 1;
+	//a side of 1 averages the pixel with itself
+	int stepX = width > 1 ? 1 : 0;
+	int stepY = height > 1 ? width : 0;
+	int x, y, c;
+	for (y = 0; y < outHeight; y++) {
+		for (x = 0; x < outWidth; x++) {
+			const unsigned char* in = image
+					+ ((size_t) y * (stepY * 2) + x * (stepX * 2)) * 3;
+			unsigned char* out = image + ((size_t) y * outWidth + x) * 3;
+			for (c = 0; c < 3; c++) {
+				out[c] = (in[c] + in[stepX * 3 + c] + in[stepY * 3 + c]
+						+ in[(stepX + stepY) * 3 + c] + 2) / 4;
+			}
+		}
+	}
+}
+/**
+ * buildChain
+ * Reads a texture's file and fills buffers->chain with its levels from
+ * level to the last, one after another. Returns 0 if the file could not be
+ * read or out of memory.
+ */
+static int buildChain(const Texture* texture, int level, ChainBuffers* buffers) {
+	size_t fileBytes = (size_t) texture->width * texture->height * TEXTURE_FILE_BYTES;
+	size_t baseBytes = (size_t) texture->baseWidth * texture->baseHeight
+			* TEXTURE_FILE_BYTES;
+	unsigned char* out;
+	int width = texture->baseWidth;
+	int height = texture->baseHeight;
+	int l;
+	FILE* file;
+	if (!grow(&buffers->file, &buffers->fileBytes, fileBytes)
+			|| !grow(&buffers->base, &buffers->baseBytes, baseBytes)
+			|| !grow(&buffers->chain, &buffers->chainBytes,
+					chainTexels(texture, level) * TEXTURE_FILE_BYTES)) {
+		return 0;
+	}
+	file = fopen(texture->fileName, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+	if (fread(buffers->file, fileBytes, 1, file) != 1) {
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	scaleImage(buffers->file, texture->width, texture->height, buffers->base,
+			width, height);
+	out = buffers->chain;
+	for (l = 0; l < texture->levels; l++) {
+		if (l >= level) {
+			size_t bytes = (size_t) width * height * TEXTURE_FILE_BYTES;
+			memcpy(out, buffers->base, bytes);
+			out += bytes;
+		}
+		halveImage(buffers->base, width, height);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return 1;
+}
+/**
+ * freeBuffers
+ */
+static void freeBuffers(ChainBuffers* buffers) {
+	free(buffers->file);
+	free(buffers->base);
+	free(buffers->chain);
+	memset(buffers, 0, sizeof(ChainBuffers));
+}
+/**
+ * upload
+ * Makes a texture resident from level with the chain of that level and
+ * coarser, dropping the GL levels it no longer has.
+ */
+static void upload(Texture* texture, int level, const unsigned char* chain) {
+	int count = texture->levels - level;
+	int oldCount = texture->levels - texture->residentLevel;
+	int width, height, l;
+	glBindTexture(GL_TEXTURE_2D, texture->name);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (l = 0; l < count; l++) {
+		levelSize(texture, level + l, &width, &height);
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGB8, width, height, 0, GL_RGB,
+				GL_UNSIGNED_BYTE, chain);
+		chain += (size_t) width * height * TEXTURE_FILE_BYTES;
+	}
+	for (l = count; l < oldCount; l++) {
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGB8, 0, 0, 0, GL_RGB,
+				GL_UNSIGNED_BYTE, NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	texture->residentLevel = level;
+}
+/**
+ * evict
+ * Drops a texture to a coarser level by reading that level and the ones
+ * after it back from GL. Returns 0 if out of memory.
+ */
+static int evict(Texture* texture, int level) {
+	unsigned char* out;
+	int width, height, l;
+	if (!grow(&readback, &readbackBytes,
+			chainTexels(texture, level) * TEXTURE_FILE_BYTES)) {
+		return 0;
+	}
+	out = readback;
+	glBindTexture(GL_TEXTURE_2D, texture->name);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (l = level; l < texture->levels; l++) {
+		levelSize(texture, l, &width, &height);
+		glGetTexImage(GL_TEXTURE_2D, l - texture->residentLevel, GL_RGB,
+				GL_UNSIGNED_BYTE, out);
+		out += (size_t) width * height * TEXTURE_FILE_BYTES;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	upload(texture, level, readback);
+	counters.evicted++;
+	return 1;
+}
+/**
+ * streamerMain
+ * Builds the chain of each request while the GL thread goes on drawing.
+ */
+static void* streamerMain(void* unused) {
+	pthread_mutex_lock(&mutex);
+	while (1) {
+		double start;
+		while (streamState != STREAM_REQUESTED && !stopping) {
+			pthread_cond_wait(&wake, &mutex);
+		}
+		if (stopping) {
+			break;
+		}
+		pthread_mutex_unlock(&mutex);
+		start = timerNow();
+		streamFailed = !buildChain(&textures[streamTexture], streamLevel,
+				&streamBuffers);
+		pthread_mutex_lock(&mutex);
+		counters.streamSeconds += timerNow() - start;
+		streamState = STREAM_READY;
+		pthread_cond_broadcast(&ready);
+	}
+	pthread_mutex_unlock(&mutex);
+	return unused;
+}
+/**
+ * textureSetBudget
+ * Sets the most GL memory the textures may take, 0 for no limit. Each
+ * texture still keeps its levels up to TEXTURE_FLOOR_SIZE.
+ */
+void textureSetBudget(size_t bytes) {
+	budget = bytes;
+}
+/**
+ * textureLoad
+ * Loads an RGB .raw texture of width x height at its floor level and
+ * returns its GL name, 0 if it could not be loaded. Finer levels are
+ * streamed in once the renderer wants them.
+ */
+GLuint textureLoad(const char* fileName, int width, int height, int wrap) {
+	Texture* texture = &textures[numTextures];
+	ChainBuffers buffers;
+	int level;
+	if (numTextures == TEXTURE_MAX || strlen(fileName) >= TEXTURE_PATH) {
+		printf("Could not load texture.\n");
+		return 0;
+	}
+	memset(texture, 0, sizeof(Texture));
+	memset(&buffers, 0, sizeof(buffers));
+	strcpy(texture->fileName, fileName);
+	texture->width = width;
+	texture->height = height;
+	texture->baseWidth = powerOfTwoBelow(width);
+	texture->baseHeight = powerOfTwoBelow(height);
+	texture->levels = 1;
+	while ((texture->baseWidth >> texture->levels) > 0
+			|| (texture->baseHeight >> texture->levels) > 0) {
+		texture->levels++;
+	}
+	level = 0;
+	while ((texture->baseWidth >> level) > TEXTURE_FLOOR_SIZE
+			|| (texture->baseHeight >> level) > TEXTURE_FLOOR_SIZE) {
+		level++;
+	}
+	texture->floorLevel = level;
+	if (!buildChain(texture, level, &buffers)) {
+		freeBuffers(&buffers);
+		printf("Could not load texture.\n");
+		return 0;
+	}
+
+	glGenTextures(1, &texture->name);
+	glBindTexture(GL_TEXTURE_2D, texture->name);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//wrap or cut off based on param
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap ? GL_REPEAT : GL_CLAMP);
+	texture->residentLevel = texture->levels;
+	upload(texture, level, buffers.chain);
+	freeBuffers(&buffers);
+	texture->wantedLevel = level;
+	texture->targetLevel = level;
+	numTextures++;
+
+	if (!streamerRunning) {
+		stopping = 0;
+		streamerRunning = pthread_create(&streamer, NULL, streamerMain, NULL) == 0;
+	}
+	return texture->name;
+}
+/**
+ * textureWant
+ * Asks for enough of a texture to draw texelsAcross of it across the
+ * screen this frame. The finest level asked for in a frame counts.
+ */
+void textureWant(GLuint name, float texelsAcross) {
+	int i, level;
+	for (i = 0; i < numTextures; i++) {
+		Texture* texture = &textures[i];
+		if (texture->name != name || name == 0) {
+			continue;
+		}
+		//the coarsest level still as wide as asked for
+		level = 0;
+		while (level < texture->floorLevel
+				&& (texture->baseWidth >> (level + 1)) >= texelsAcross) {
+			level++;
+		}
+		if (texture->lastWanted != frame || level < texture->wantedLevel) {
+			texture->wantedLevel = level;
+		}
+		texture->lastWanted = frame;
+	}
+}
+/**
+ * fitBudget
+ * Sets each texture's target level from the levels wanted, coarsening
+ * the least recently drawn and then the largest until they fit.
+ */
+static void fitBudget() {
+	size_t total = 0;
+	int i;
+	for (i = 0; i < numTextures; i++) {
+		Texture* texture = &textures[i];
+		if (frame - texture->lastWanted > TEXTURE_IDLE_FRAMES) {
+			texture->wantedLevel = texture->floorLevel;
+		}
+		texture->targetLevel = texture->wantedLevel;
+		total += chainBytes(texture, texture->targetLevel);
+	}
+	while (budget > 0 && total > budget) {
+		Texture* victim = NULL;
+		for (i = 0; i < numTextures; i++) {
+			Texture* texture = &textures[i];
+			if (texture->targetLevel >= texture->floorLevel) {
+				continue;
+			}
+			if (victim == NULL || texture->lastWanted < victim->lastWanted
+					|| (texture->lastWanted == victim->lastWanted
+							&& chainBytes(texture, texture->targetLevel)
+									> chainBytes(victim, victim->targetLevel))) {
+				victim = texture;
+			}
+		}
+		if (victim == NULL) {
+			break;
+		}
+		total -= chainBytes(victim, victim->targetLevel)
+				- chainBytes(victim, victim->targetLevel + 1);
+		victim->targetLevel++;
+	}
+}
+/**
+ * residentBytes
+ */
+static size_t residentBytes() {
+	size_t total = 0;
+	int i;
+	for (i = 0; i < numTextures; i++) {
+		total += chainBytes(&textures[i], textures[i].residentLevel);
+	}
+	return total;
+}
+/**
+ * nextRequest
+ * The texture missing the most levels of its target, -1 if none is.
+ */
+static int nextRequest() {
+	int request = -1;
+	int i;
+	for (i = 0; i < numTextures; i++) {
+		const Texture* texture = &textures[i];
+		int missing = texture->residentLevel - texture->targetLevel;
+		if (missing > 0 && !texture->unreadable && (request < 0 || missing
+				> textures[request].residentLevel - textures[request].targetLevel)) {
+			request = i;
+		}
+	}
+	return request;
+}
+/**
+ * textureUpdate
+ * Uploads a streamed level that came in, drops textures above their target
+ * level and asks for the next finer level that is missing. Call once a
+ * frame on the GL thread, before drawing.
+ */
+void textureUpdate(void) {
+	int request;
+	int i;
+	frame++;
+	fitBudget();
+	for (i = 0; i < numTextures; i++) {
+		Texture* texture = &textures[i];
+		if (texture->targetLevel > texture->residentLevel) {
+			evict(texture, texture->targetLevel);
+		}
+	}
+
+	pthread_mutex_lock(&mutex);
+	if (streamState == STREAM_READY) {
+		Texture* texture = &textures[streamTexture];
+		size_t after = residentBytes() - chainBytes(texture, texture->residentLevel)
+				+ chainBytes(texture, streamLevel);
+		texture->unreadable = streamFailed;
+		if (!streamFailed && streamLevel < texture->residentLevel
+				&& streamLevel >= texture->targetLevel
+				&& (budget == 0 || after <= budget)) {
+			upload(texture, streamLevel, streamBuffers.chain);
+			counters.streamed++;
+		} else {
+			counters.discarded++;
+		}
+		streamState = STREAM_IDLE;
+	}
+	request = nextRequest();
+	if (streamState == STREAM_IDLE && request >= 0 && streamerRunning) {
+		streamTexture = request;
+		streamLevel = textures[request].targetLevel;
+		streamState = STREAM_REQUESTED;
+		pthread_cond_signal(&wake);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+/**
+ * textureSettle
+ * Updates until every texture is at its target level, so benchmarks time
+ * frames that are not streaming.
+ */
+void textureSettle(void) {
+	int settled = 0;
+	while (!settled && streamerRunning) {
+		//the same frame, so what was wanted in it stays wanted
+		frame--;
+		textureUpdate();
+		pthread_mutex_lock(&mutex);
+		while (streamState == STREAM_REQUESTED) {
+			pthread_cond_wait(&ready, &mutex);
+		}
+		settled = streamState == STREAM_IDLE && nextRequest() < 0;
+		pthread_mutex_unlock(&mutex);
+	}
+}
+/**
+ * textureGetStats
+ */
+void textureGetStats(TextureStats* stats) {
+	pthread_mutex_lock(&mutex);
+	*stats = counters;
+	pthread_mutex_unlock(&mutex);
+	stats->textures = numTextures;
+	stats->residentBytes = residentBytes();
+	stats->budgetBytes = budget;
+}
+/**
+ * textureShutdown
+ * Stops the streaming thread and deletes every texture.
+ */
+void textureShutdown(void) {
+	int i;
+	if (streamerRunning) {
+		pthread_mutex_lock(&mutex);
+		stopping = 1;
+		pthread_cond_broadcast(&wake);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(streamer, NULL);
+		streamerRunning = 0;
+	}
+	streamState = STREAM_IDLE;
+	freeBuffers(&streamBuffers);
+	for (i = 0; i < numTextures; i++) {
+		glDeleteTextures(1, &textures[i].name);
+	}
+	numTextures = 0;
+	free(readback);
+	readback = NULL;
+	readbackBytes = 0;
+}
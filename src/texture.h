@@ -0,0 +1,51 @@
+/*
+ * texture.h
+ * CG flight simulator
+ * Texture residency: the scene's textures are kept in GL only down to the
+ * mip level their screen coverage needs, within a memory budget.
+ * While drawing, the renderer says how many texels across it would like of
+ * each texture, and the next textureUpdate turns that into a level per
+ * texture. When those levels would take more than the budget, the textures
+ * drawn least recently, then the largest, are held a level coarser until
+ * they fit. Dropping to a coarser level reads the texture's own smaller mip
+ * levels back from GL, so it never waits for the disk and the budget holds
+ * at once. Finer levels are read from disk and filtered on a streaming
+ * thread, and only uploaded if they still fit when they arrive.
+ * Memory is estimated at 4 bytes a texel, which is how drivers store RGB8,
+ * over the whole mip chain.
+ */
+
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+#include <stddef.h>
+#include "glPlatform.h"
+
+#define TEXTURE_MAX 16
+//every texture keeps its levels this size and smaller, even over budget
+#define TEXTURE_FLOOR_SIZE 32
+//frames a texture can go undrawn before it only needs its floor
+#define TEXTURE_IDLE_FRAMES 120
+
+typedef struct TextureStats {
+	int textures;
+	size_t residentBytes;
+	//0 without a budget
+	size_t budgetBytes;
+	//finer levels streamed in, and levels dropped for coarser ones
+	unsigned int streamed;
+	unsigned int evicted;
+	//streamed levels no longer wanted or no longer fitting when they came
+	unsigned int discarded;
+	//time the streaming thread spent reading and filtering
+	double streamSeconds;
+} TextureStats;
+
+void textureSetBudget(size_t bytes);
+GLuint textureLoad(const char* fileName, int width, int height, int wrap);
+void textureWant(GLuint name, float texelsAcross);
+void textureUpdate(void);
+void textureSettle(void);
+void textureGetStats(TextureStats* stats);
+void textureShutdown(void);
+
+#endif /* TEXTURE_H_ */
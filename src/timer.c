@@ -0,0 +1,49 @@
+/**
+ * timer.c
+ * CG flight simulator
+ * High resolution monotonic clock used for frame timings and fixed rate loops.
+ */
+
+#include "timer.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * timerNow
+ * Returns the current monotonic time in seconds.
+ */
+double timerNow(void) {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+#endif
+}
+/**
+ * timerSleep
+ * Sleeps for about the given number of seconds, returns at once if not positive.
+ */
+void timerSleep(double seconds) {
+	if (seconds <= 0) {
+		return;
+	}
+#ifdef _WIN32
+	Sleep((DWORD) (seconds * 1000.0));
+#else
+	struct timespec duration;
+	duration.tv_sec = (time_t) seconds;
+	duration.tv_nsec = (long) ((seconds - duration.tv_sec) * 1000000000.0);
+	nanosleep(&duration, NULL);
+#endif
+}
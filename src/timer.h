@@ -0,0 +1,13 @@
+/*
+ * timer.h
+ * CG flight simulator
+ * High resolution monotonic clock used for frame timings and fixed rate loops.
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+double timerNow(void);
+void timerSleep(double seconds);
+
+#endif /* TIMER_H_ */
@@ -0,0 +1,119 @@
+/**
+ * transform.c
+ * CG flight simulator
+ * Transform hierarchy, see transform.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "transform.h"
+
+/**
+ * transformInit
+ * Prepares an empty tree with room for capacity nodes, it grows as needed.
+ * Returns 0 if out of memory.
+ */
+int transformInit(TransformTree* tree, int capacity) {
+	memset(tree, 0, sizeof(TransformTree));
+	tree->nodes = malloc(sizeof(TransformNode) * (capacity > 0 ? capacity : 1));
+	if (tree->nodes == NULL) {
+		return 0;
+	}
+	tree->capacity = capacity > 0 ? capacity : 1;
+	return 1;
+}
+/**
+ * transformFree
+ */
+void transformFree(TransformTree* tree) {
+	free(tree->nodes);
+	memset(tree, 0, sizeof(TransformTree));
+}
+/**
+ * transformAdd
+ * Adds a node with an identity transform under parent, an earlier node or
+ * TRANSFORM_ROOT. Returns its index, -1 if out of memory.
+ */
+int transformAdd(TransformTree* tree, int parent) {
+	TransformNode* node;
+	if (tree->count == tree->capacity) {
+		TransformNode* grown = realloc(tree->nodes,
+				sizeof(TransformNode) * tree->capacity * 2);
+		if (grown == NULL) {
+			return -1;
+		}
+		tree->nodes = grown;
+		tree->capacity *= 2;
+	}
+	node = &tree->nodes[tree->count];
+	memset(node, 0, sizeof(TransformNode));
+	mat4Identity(&node->local);
+	mat4Identity(&node->world);
+	node->parent = parent < tree->count ? parent : TRANSFORM_ROOT;
+	node->dirty = 1;
+	return tree->count++;
+}
+/**
+ * transformSetTrs
+ * Sets a node's local transform from a translation, rotation and scale.
+ */
+void transformSetTrs(TransformTree* tree, int node, Vec3 translation,
+		Quat rotation, Vec3 scale) {
+	mat4FromTrs(&tree->nodes[node].local, translation, rotation, scale);
+	tree->nodes[node].dirty = 1;
+}
+/**
+ * transformSetLocal
+ * Sets a node's local matrix.
+ */
+void transformSetLocal(TransformTree* tree, int node, const Mat4* local) {
+	tree->nodes[node].local = *local;
+	tree->nodes[node].dirty = 1;
+}
+/**
+ * transformSetBounds
+ * Gives a node a bounding box in its local space.
+ */
+void transformSetBounds(TransformTree* tree, int node, Vec3 min, Vec3 max) {
+	tree->nodes[node].boundsMin = min;
+	tree->nodes[node].boundsMax = max;
+	tree->nodes[node].hasBounds = 1;
+	tree->nodes[node].dirty = 1;
+}
+/**
+ * transformUpdate
+ * Recomputes the world matrices and bounds of dirty nodes and their
+ * descendants. Returns the number of nodes recomputed.
+ */
+int transformUpdate(TransformTree* tree) {
+	int updated = 0;
+	int i;
+	for (i = 0; i < tree->count; i++) {
+		TransformNode* node = &tree->nodes[i];
+		const TransformNode* parent = node->parent == TRANSFORM_ROOT ?
+				NULL : &tree->nodes[node->parent];
+		node->changed = node->dirty || (parent != NULL && parent->changed);
+		if (!node->changed) {
+			continue;
+		}
+		if (parent != NULL) {
+			mat4Multiply(&node->world, &parent->world, &node->local);
+		} else {
+			node->world = node->local;
+		}
+		if (node->hasBounds) {
+			mat4TransformBounds(&node->world, node->boundsMin, node->boundsMax,
+					&node->worldMin, &node->worldMax);
+		}
+		node->dirty = 0;
+		updated++;
+	}
+	return updated;
+}
+/**
+ * transformWorld
+ * Returns a node's world matrix as of the last update.
+ */
+const Mat4* transformWorld(const TransformTree* tree, int node) {
+	return &tree->nodes[node].world;
+}
@@ -0,0 +1,49 @@
+/*
+ * transform.h
+ * CG flight simulator
+ * Transform hierarchy of the things drawn, with their world matrices and
+ * bounds on the CPU.
+ * Nodes live in one array and a parent always comes before its children, so
+ * one pass in order updates the whole tree. Setting a node's local transform
+ * marks it dirty, and transformUpdate recomputes the world matrix (and world
+ * bounds) of the dirty nodes and everything below them only.
+ */
+
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+#include "vecmath.h"
+
+#define TRANSFORM_ROOT -1
+
+typedef struct TransformNode {
+	Mat4 local;
+	Mat4 world;
+	//local bounding box and the world box around it, if the node has bounds
+	Vec3 boundsMin;
+	Vec3 boundsMax;
+	Vec3 worldMin;
+	Vec3 worldMax;
+	int hasBounds;
+	int parent;
+	int dirty;
+	//recomputed by the last update
+	int changed;
+} TransformNode;
+
+typedef struct TransformTree {
+	int count;
+	int capacity;
+	TransformNode* nodes;
+} TransformTree;
+
+int transformInit(TransformTree* tree, int capacity);
+void transformFree(TransformTree* tree);
+int transformAdd(TransformTree* tree, int parent);
+void transformSetTrs(TransformTree* tree, int node, Vec3 translation,
+		Quat rotation, Vec3 scale);
+void transformSetLocal(TransformTree* tree, int node, const Mat4* local);
+void transformSetBounds(TransformTree* tree, int node, Vec3 min, Vec3 max);
+int transformUpdate(TransformTree* tree);
+const Mat4* transformWorld(const TransformTree* tree, int node);
+
+#endif /* TRANSFORM_H_ */
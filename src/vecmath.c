@@ -0,0 +1,319 @@
+/**
+ * vecmath.c
+ * CG flight simulator
+ * Vector, quaternion and matrix functions, see vecmath.h.
+ * With SSE a matrix column is one register: a product is four broadcasts
+ * and multiply-adds per column, a point is transformed with three.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "vecmath.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/**
+ * vec3Make
+ */
+Vec3 vec3Make(float x, float y, float z) {
+	Vec3 v = { x, y, z };
+	return v;
+}
+/**
+ * vec3Add
+ */
+Vec3 vec3Add(Vec3 a, Vec3 b) {
+	return vec3Make(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+/**
+ * vec3Sub
+ */
+Vec3 vec3Sub(Vec3 a, Vec3 b) {
+	return vec3Make(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+/**
+ * vec3Scale
+ */
+Vec3 vec3Scale(Vec3 a, float scale) {
+	return vec3Make(a.x * scale, a.y * scale, a.z * scale);
+}
+/**
+ * vec3Mul
+ * Multiplies component by component.
+ */
+Vec3 vec3Mul(Vec3 a, Vec3 b) {
+	return vec3Make(a.x * b.x, a.y * b.y, a.z * b.z);
+}
+/**
+ * vec3Dot
+ */
+float vec3Dot(Vec3 a, Vec3 b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+/**
+ * vec3Cross
+ */
+Vec3 vec3Cross(Vec3 a, Vec3 b) {
+	return vec3Make(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+			a.x * b.y - a.y * b.x);
+}
+/**
+ * vec3Length
+ */
+float vec3Length(Vec3 a) {
+	return sqrtf(vec3Dot(a, a));
+}
+/**
+ * vec3Normalize
+ * Returns a unit vector along a, or a itself if it has no length.
+ */
+Vec3 vec3Normalize(Vec3 a) {
+	float length = vec3Length(a);
+	return length > 0.0f ? vec3Scale(a, 1.0f / length) : a;
+}
+/**
+ * quatIdentity
+ */
+Quat quatIdentity(void) {
+	Quat q = { 0.0f, 0.0f, 0.0f, 1.0f };
+	return q;
+}
+/**
+ * quatAxisAngle
+ * Rotation by angle around axis, like glRotatef but in radians.
+ */
+Quat quatAxisAngle(Vec3 axis, float angle) {
+	Vec3 unit = vec3Normalize(axis);
+	float s = sinf(angle * 0.5f);
+	Quat q = { unit.x * s, unit.y * s, unit.z * s, cosf(angle * 0.5f) };
+	return q;
+}
+/**
+ * quatMultiply
+ * Rotation by b then by a.
+ */
+Quat quatMultiply(Quat a, Quat b) {
+	Quat q;
+	q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+	q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+	q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+	q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+	return q;
+}
+/**
+ * quatNormalize
+ */
+Quat quatNormalize(Quat q) {
+	float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	if (length > 0.0f) {
+		q.x /= length;
+		q.y /= length;
+		q.z /= length;
+		q.w /= length;
+	}
+	return q;
+}
+/**
+ * quatRotate
+ * Rotates v by q.
+ */
+Vec3 quatRotate(Quat q, Vec3 v) {
+	Vec3 axis = vec3Make(q.x, q.y, q.z);
+	Vec3 t = vec3Scale(vec3Cross(axis, v), 2.0f);
+	return vec3Add(vec3Add(v, vec3Scale(t, q.w)), vec3Cross(axis, t));
+}
+/**
+ * mat4Identity
+ */
+void mat4Identity(Mat4* out) {
+	int i;
+	for (i = 0; i < 16; i++) {
+		out->m[i] = i % 5 == 0 ? 1.0f : 0.0f;
+	}
+}
+/**
+ * mat4FromTrs
+ * Scales, then rotates, then translates, as glTranslatef, glMultMatrixf of
+ * the rotation and glScalef in that order would.
+ */
+void mat4FromTrs(Mat4* out, Vec3 translation, Quat rotation, Vec3 scale) {
+	float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+	float* m = out->m;
+	m[0] = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+	m[1] = 2.0f * (x * y + w * z) * scale.x;
+	m[2] = 2.0f * (x * z - w * y) * scale.x;
+	m[3] = 0.0f;
+	m[4] = 2.0f * (x * y - w * z) * scale.y;
+	m[5] = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+	m[6] = 2.0f * (y * z + w * x) * scale.y;
+	m[7] = 0.0f;
+	m[8] = 2.0f * (x * z + w * y) * scale.z;
+	m[9] = 2.0f * (y * z - w * x) * scale.z;
+	m[10] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+	m[11] = 0.0f;
+	m[12] = translation.x;
+	m[13] = translation.y;
+	m[14] = translation.z;
+	m[15] = 1.0f;
+}
+/**
+ * mat4LookAt
+ * View matrix of a camera at eye looking at at, as gluLookAt.
+ */
+void mat4LookAt(Mat4* out, Vec3 eye, Vec3 at, Vec3 up) {
+	Vec3 forward = vec3Normalize(vec3Sub(at, eye));
+	Vec3 side = vec3Normalize(vec3Cross(forward, up));
+	Vec3 top = vec3Cross(side, forward);
+	float* m = out->m;
+	m[0] = side.x;
+	m[4] = side.y;
+	m[8] = side.z;
+	m[12] = -vec3Dot(side, eye);
+	m[1] = top.x;
+	m[5] = top.y;
+	m[9] = top.z;
+	m[13] = -vec3Dot(top, eye);
+	m[2] = -forward.x;
+	m[6] = -forward.y;
+	m[10] = -forward.z;
+	m[14] = vec3Dot(forward, eye);
+	m[3] = 0.0f;
+	m[7] = 0.0f;
+	m[11] = 0.0f;
+	m[15] = 1.0f;
+}
+/**
+ * mat4Multiply
+ * out = a * b, out may be either of them.
+ */
+void mat4Multiply(Mat4* out, const Mat4* a, const Mat4* b) {
+#ifdef __SSE__
+	__m128 a0 = _mm_loadu_ps(&a->m[0]);
+	__m128 a1 = _mm_loadu_ps(&a->m[4]);
+	__m128 a2 = _mm_loadu_ps(&a->m[8]);
+	__m128 a3 = _mm_loadu_ps(&a->m[12]);
+	__m128 columns[4];
+	int i;
+	for (i = 0; i < 4; i++) {
+		const float* column = &b->m[i * 4];
+		columns[i] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(column[0])),
+						_mm_mul_ps(a1, _mm_set1_ps(column[1]))),
+				_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(column[2])),
+						_mm_mul_ps(a3, _mm_set1_ps(column[3]))));
+	}
+	for (i = 0; i < 4; i++) {
+		_mm_storeu_ps(&out->m[i * 4], columns[i]);
+	}
+#else
+	Mat4 result;
+	int column, row;
+	for (column = 0; column < 4; column++) {
+		for (row = 0; row < 4; row++) {
+			result.m[column * 4 + row] = a->m[row] * b->m[column * 4]
+					+ a->m[4 + row] * b->m[column * 4 + 1]
+					+ a->m[8 + row] * b->m[column * 4 + 2]
+					+ a->m[12 + row] * b->m[column * 4 + 3];
+		}
+	}
+	*out = result;
+#endif
+}
+/**
+ * mat4TransformPoint
+ */
+Vec3 mat4TransformPoint(const Mat4* m, Vec3 point) {
+#ifdef __SSE__
+	float result[4];
+	_mm_storeu_ps(result, _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m->m[0]), _mm_set1_ps(point.x)),
+					_mm_mul_ps(_mm_loadu_ps(&m->m[4]), _mm_set1_ps(point.y))),
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m->m[8]), _mm_set1_ps(point.z)),
+					_mm_loadu_ps(&m->m[12]))));
+	return vec3Make(result[0], result[1], result[2]);
+#else
+	return vec3Make(
+			m->m[0] * point.x + m->m[4] * point.y + m->m[8] * point.z + m->m[12],
+			m->m[1] * point.x + m->m[5] * point.y + m->m[9] * point.z + m->m[13],
+			m->m[2] * point.x + m->m[6] * point.y + m->m[10] * point.z + m->m[14]);
+#endif
+}
+/**
+ * mat4TransformBounds
+ * Axis aligned box around the box [min, max] transformed by m: the center
+ * is transformed and the half extents grow by the absolute matrix.
+ */
+void mat4TransformBounds(const Mat4* m, Vec3 min, Vec3 max, Vec3* outMin,
+		Vec3* outMax) {
+	Vec3 center = mat4TransformPoint(m, vec3Scale(vec3Add(min, max), 0.5f));
+	Vec3 half = vec3Scale(vec3Sub(max, min), 0.5f);
+	Vec3 extent = vec3Make(
+			fabsf(m->m[0]) * half.x + fabsf(m->m[4]) * half.y + fabsf(m->m[8]) * half.z,
+			fabsf(m->m[1]) * half.x + fabsf(m->m[5]) * half.y + fabsf(m->m[9]) * half.z,
+			fabsf(m->m[2]) * half.x + fabsf(m->m[6]) * half.y + fabsf(m->m[10]) * half.z);
+	*outMin = vec3Sub(center, extent);
+	*outMax = vec3Add(center, extent);
+}
+/**
+ * mat4Perspective
+ * Projection of gluPerspective, fovY in radians.
+ */
+void mat4Perspective(Mat4* out, float fovY, float aspect, float nearZ,
+		float farZ) {
+	float f = 1.0f / tanf(fovY * 0.5f);
+	memset(out, 0, sizeof(*out));
+	out->m[0] = f / aspect;
+	out->m[5] = f;
+	out->m[10] = (farZ + nearZ) / (nearZ - farZ);
+	out->m[11] = -1.0f;
+	out->m[14] = 2.0f * farZ * nearZ / (nearZ - farZ);
+}
+/**
+ * mat4Ortho
+ * Projection of glOrtho.
+ */
+void mat4Ortho(Mat4* out, float left, float right, float bottom, float top,
+		float nearZ, float farZ) {
+	memset(out, 0, sizeof(*out));
+	out->m[0] = 2.0f / (right - left);
+	out->m[5] = 2.0f / (top - bottom);
+	out->m[10] = -2.0f / (farZ - nearZ);
+	out->m[12] = -(right + left) / (right - left);
+	out->m[13] = -(top + bottom) / (top - bottom);
+	out->m[14] = -(farZ + nearZ) / (farZ - nearZ);
+	out->m[15] = 1.0f;
+}
+/**
+ * frustumFromMatrix
+ * Finds the planes of the volume a projection times view matrix keeps, as
+ * the sums and differences of its last row with the others.
+ */
+void frustumFromMatrix(Frustum* out, const Mat4* m) {
+	int i, j;
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 4; j++) {
+			out->planes[i * 2][j] = m->m[j * 4 + 3] + m->m[j * 4 + i];
+			out->planes[i * 2 + 1][j] = m->m[j * 4 + 3] - m->m[j * 4 + i];
+		}
+	}
+}
+/**
+ * frustumOverlapsBounds
+ * Returns 0 if a box is wholly outside one of the planes. Boxes near a
+ * corner may be kept although they are outside, never the other way.
+ */
+int frustumOverlapsBounds(const Frustum* frustum, Vec3 min, Vec3 max) {
+	int i;
+	for (i = 0; i < 6; i++) {
+		const float* plane = frustum->planes[i];
+		//the corner furthest along the plane's normal
+		float x = plane[0] >= 0 ? max.x : min.x;
+		float y = plane[1] >= 0 ? max.y : min.y;
+		float z = plane[2] >= 0 ? max.z : min.z;
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,68 @@
+/*
+ * vecmath.h
+ * CG flight simulator
+ * Small vector, quaternion and matrix library for CPU side transforms.
+ * Matrices are column major like OpenGL's, so one can be handed straight to
+ * glLoadMatrixf, and the matrix products run on SSE when it is available.
+ * Angles are in radians.
+ */
+
+#ifndef VECMATH_H_
+#define VECMATH_H_
+
+typedef struct Vec3 {
+	float x;
+	float y;
+	float z;
+} Vec3;
+
+//unit quaternion for rotations, w is the real part
+typedef struct Quat {
+	float x;
+	float y;
+	float z;
+	float w;
+} Quat;
+
+//m[column * 4 + row]
+typedef struct Mat4 {
+	float m[16];
+} Mat4;
+
+//planes a, b, c, d of a view volume, inside where ax + by + cz + d >= 0
+typedef struct Frustum {
+	float planes[6][4];
+} Frustum;
+
+Vec3 vec3Make(float x, float y, float z);
+Vec3 vec3Add(Vec3 a, Vec3 b);
+Vec3 vec3Sub(Vec3 a, Vec3 b);
+Vec3 vec3Scale(Vec3 a, float scale);
+Vec3 vec3Mul(Vec3 a, Vec3 b);
+float vec3Dot(Vec3 a, Vec3 b);
+Vec3 vec3Cross(Vec3 a, Vec3 b);
+float vec3Length(Vec3 a);
+Vec3 vec3Normalize(Vec3 a);
+
+Quat quatIdentity(void);
+Quat quatAxisAngle(Vec3 axis, float angle);
+Quat quatMultiply(Quat a, Quat b);
+Quat quatNormalize(Quat q);
+Vec3 quatRotate(Quat q, Vec3 v);
+
+void mat4Identity(Mat4* out);
+void mat4FromTrs(Mat4* out, Vec3 translation, Quat rotation, Vec3 scale);
+void mat4LookAt(Mat4* out, Vec3 eye, Vec3 at, Vec3 up);
+void mat4Multiply(Mat4* out, const Mat4* a, const Mat4* b);
+Vec3 mat4TransformPoint(const Mat4* m, Vec3 point);
+void mat4TransformBounds(const Mat4* m, Vec3 min, Vec3 max, Vec3* outMin,
+		Vec3* outMax);
+void mat4Perspective(Mat4* out, float fovY, float aspect, float nearZ,
+		float farZ);
+void mat4Ortho(Mat4* out, float left, float right, float bottom, float top,
+		float nearZ, float farZ);
+
+void frustumFromMatrix(Frustum* out, const Mat4* m);
+int frustumOverlapsBounds(const Frustum* frustum, Vec3 min, Vec3 max);
+
+#endif /* VECMATH_H_ */
@@ -0,0 +1,234 @@
+/**
+ * vertexCache.c
+ * CG flight simulator
+ * Index reordering, see vertexCache.h.
+ * The cache optimisation follows Tom Forsyth's "Linear-Speed Vertex Cache
+ * Optimisation": every vertex scores by its place in a modelled LRU cache
+ * and by how few triangles still use it, and the next triangle is always
+ * the best scoring one that touches the cache.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vertexCache.h"
+
+//score constants from the article
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+/**
+ * vertexScore
+ * Scores a vertex at a cache position (-1 if not cached) with remaining
+ * triangles still to be drawn.
+ */
+static float vertexScore(int cachePosition, int remaining) {
+	float score = 0.0f;
+	if (remaining == 0) {
+		return -1.0f;
+	}
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			//used by the last triangle, deliberately less than the next
+			//places so strips do not just turn back on themselves
+			score = LAST_TRIANGLE_SCORE;
+		} else {
+			score = powf(1.0f - (float) (cachePosition - 3)
+					/ (VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+	}
+	//finish off vertices with few triangles left so they leave the cache
+	return score + VALENCE_BOOST_SCALE
+			* powf((float) remaining, -VALENCE_BOOST_POWER);
+}
+/**
+ * vertexCacheOptimize
+ * Reorders the triangles of an index list in place. Returns 0 if out of
+ * memory, leaving the indices as they were.
+ */
+int vertexCacheOptimize(unsigned int* indices, int numIndices,
+		int numVertices) {
+	int numTriangles = numIndices / 3;
+	int* first = calloc(numVertices + 1, sizeof(int));
+	//live triangles of each vertex, the front of its list in triangles
+	int* remaining = calloc(numVertices, sizeof(int));
+	int* triangles = malloc(sizeof(int) * (numTriangles * 3 + 1));
+	int* cachePositions = malloc(sizeof(int) * (numVertices + 1));
+	float* scores = malloc(sizeof(float) * (numVertices + 1));
+	float* triangleScores = malloc(sizeof(float) * (numTriangles + 1));
+	unsigned char* emitted = calloc(numTriangles + 1, 1);
+	unsigned int* output = malloc(sizeof(unsigned int) * (numIndices + 1));
+	int cache[VERTEX_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int best = -1;
+	int cursor = 0;
+	int i, j, k, t, v, n;
+
+	if (first == NULL || remaining == NULL || triangles == NULL
+			|| cachePositions == NULL || scores == NULL
+			|| triangleScores == NULL || emitted == NULL || output == NULL) {
+		free(first);
+		free(remaining);
+		free(triangles);
+		free(cachePositions);
+		free(scores);
+		free(triangleScores);
+		free(emitted);
+		free(output);
+		return 0;
+	}
+	for (i = 0; i < numTriangles * 3; i++) {
+		remaining[indices[i]]++;
+	}
+	for (v = 0; v < numVertices; v++) {
+		first[v + 1] = first[v] + remaining[v];
+		//fill position for now
+		cachePositions[v] = first[v];
+	}
+	for (i = 0; i < numTriangles * 3; i++) {
+		triangles[cachePositions[indices[i]]++] = i / 3;
+	}
+	for (v = 0; v < numVertices; v++) {
+		cachePositions[v] = -1;
+		scores[v] = vertexScore(-1, remaining[v]);
+	}
+	for (t = 0; t < numTriangles; t++) {
+		triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]]
+				+ scores[indices[t * 3 + 2]];
+	}
+
+	for (n = 0; n < numTriangles; n++) {
+		int newCache[VERTEX_CACHE_SIZE + 3];
+		int newCount = 0;
+		float bestScore = -1.0f;
+		if (best < 0) {
+			//nothing in the cache has triangles left, take the best of the rest
+			while (cursor < numTriangles && emitted[cursor]) {
+				cursor++;
+			}
+			for (t = cursor; t < numTriangles; t++) {
+				if (!emitted[t] && (best < 0 || triangleScores[t] > bestScore)) {
+					best = t;
+					bestScore = triangleScores[t];
+				}
+			}
+		}
+		memcpy(&output[n * 3], &indices[best * 3], sizeof(unsigned int) * 3);
+		emitted[best] = 1;
+		for (k = 0; k < 3; k++) {
+			int end;
+			v = indices[best * 3 + k];
+			end = first[v] + remaining[v];
+			for (i = first[v]; i < end; i++) {
+				if (triangles[i] == best) {
+					triangles[i] = triangles[end - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+			//a degenerate triangle lists a vertex twice
+			if (newCount == 0 || (newCache[0] != v
+					&& (newCount == 1 || newCache[1] != v))) {
+				newCache[newCount++] = v;
+			}
+		}
+		//the rest of the cache moves back behind the new triangle
+		for (i = 0; i < cacheCount; i++) {
+			v = cache[i];
+			if (v != (int) indices[best * 3] && v != (int) indices[best * 3 + 1]
+					&& v != (int) indices[best * 3 + 2]) {
+				newCache[newCount++] = v;
+			}
+		}
+		cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+		for (i = 0; i < newCount; i++) {
+			v = newCache[i];
+			cachePositions[v] = i < cacheCount ? i : -1;
+			scores[v] = vertexScore(cachePositions[v], remaining[v]);
+			if (i < cacheCount) {
+				cache[i] = v;
+			}
+		}
+		//rescore what the change touched, the next triangle is among them
+		best = -1;
+		bestScore = -1.0f;
+		for (i = 0; i < newCount; i++) {
+			v = newCache[i];
+			for (j = first[v]; j < first[v] + remaining[v]; j++) {
+				t = triangles[j];
+				triangleScores[t] = scores[indices[t * 3]]
+						+ scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+				if (i < cacheCount && triangleScores[t] > bestScore) {
+					best = t;
+					bestScore = triangleScores[t];
+				}
+			}
+		}
+	}
+	memcpy(indices, output, sizeof(unsigned int) * numTriangles * 3);
+
+	free(first);
+	free(remaining);
+	free(triangles);
+	free(cachePositions);
+	free(scores);
+	free(triangleScores);
+	free(emitted);
+	free(output);
+	return 1;
+}
+/**
+ * vertexFetchOptimize
+ * Renumbers the vertices in the order the indices first use them, filling
+ * remap with the new number of each old vertex (unused ones go last).
+ * Returns the number of vertices the indices use.
+ */
+int vertexFetchOptimize(unsigned int* indices, int numIndices,
+		int numVertices, int* remap) {
+	int used = 0;
+	int next;
+	int i;
+	for (i = 0; i < numVertices; i++) {
+		remap[i] = -1;
+	}
+	for (i = 0; i < numIndices; i++) {
+		if (remap[indices[i]] < 0) {
+			remap[indices[i]] = used++;
+		}
+		indices[i] = remap[indices[i]];
+	}
+	next = used;
+	for (i = 0; i < numVertices; i++) {
+		if (remap[i] < 0) {
+			remap[i] = next++;
+		}
+	}
+	return used;
+}
+/**
+ * vertexCacheMissRatio
+ * Returns the vertices transformed per triangle (ACMR) with a FIFO cache
+ * of cacheSize entries, between 0.5 at best and 3.
+ */
+float vertexCacheMissRatio(const unsigned int* indices, int numIndices,
+		int numVertices, int cacheSize) {
+	//miss count when each vertex last entered the cache, 0 for never
+	int* entered = calloc(numVertices, sizeof(int));
+	int misses = 0;
+	int i;
+	if (entered == NULL || numIndices < 3) {
+		free(entered);
+		return 0.0f;
+	}
+	for (i = 0; i < numIndices; i++) {
+		unsigned int v = indices[i];
+		if (entered[v] == 0 || misses - entered[v] >= cacheSize) {
+			misses++;
+			entered[v] = misses;
+		}
+	}
+	free(entered);
+	return (float) misses / (numIndices / 3);
+}
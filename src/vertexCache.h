@@ -0,0 +1,27 @@
+/*
+ * vertexCache.h
+ * CG flight simulator
+ * Index reordering for indexed meshes.
+ * Triangles are reordered so their vertices are found in the GPU's post
+ * transform cache (Forsyth's linear speed vertex cache optimisation), then
+ * vertices are renumbered in the order the triangles first use them so
+ * vertex fetches walk through memory.
+ */
+
+#ifndef VERTEXCACHE_H_
+#define VERTEXCACHE_H_
+
+//cache modelled by the optimisation, larger than most hardware caches as
+//the method recommends
+#define VERTEX_CACHE_SIZE 32
+//FIFO cache size used to report the miss ratio
+#define VERTEX_CACHE_REPORT_SIZE 16
+
+int vertexCacheOptimize(unsigned int* indices, int numIndices,
+		int numVertices);
+int vertexFetchOptimize(unsigned int* indices, int numIndices,
+		int numVertices, int* remap);
+float vertexCacheMissRatio(const unsigned int* indices, int numIndices,
+		int numVertices, int cacheSize);
+
+#endif /* VERTEXCACHE_H_ */
@@ -0,0 +1,80 @@
+/**
+ * view.c
+ * CG flight simulator
+ * View layouts and projections, see view.h.
+ * The first view of a layout is the chase camera, the HUD's markers are
+ * placed with its matrices. Insets keep clear of the HUD's corners: the
+ * mirror at the top middle and the map at the bottom middle.
+ */
+
+#include "view.h"
+
+static const char* layoutNames[VIEW_LAYOUT_COUNT] = { "chase", "split",
+		"mirror", "map", "all" };
+
+/**
+ * setView
+ */
+static void setView(View* view, ViewCamera camera, int x, int y, int width,
+		int height, int inset) {
+	view->camera = camera;
+	view->x = x;
+	view->y = y;
+	view->width = width > 1 ? width : 1;
+	view->height = height > 1 ? height : 1;
+	view->inset = inset;
+}
+/**
+ * viewLayout
+ * Fills views with those of a layout for a window of width by height
+ * pixels, in the order they are drawn: the full height views from the
+ * left, then the insets from the bottom. Returns the number of views.
+ */
+int viewLayout(ViewLayout layout, int width, int height, View views[VIEW_MAX]) {
+	int count = 0;
+	int mirrorWidth = width / 3;
+	int mirrorHeight = height / 6;
+	int mapSize = height / 3;
+	int margin = height / 40;
+	int split = layout == VIEW_LAYOUT_SPLIT || layout == VIEW_LAYOUT_ALL;
+	setView(&views[count++], VIEW_CHASE, 0, 0, split ? width / 2 : width,
+			height, 0);
+	if (split) {
+		setView(&views[count++], VIEW_COCKPIT, width / 2, 0, width - width / 2,
+				height, 0);
+	}
+	if (layout == VIEW_LAYOUT_MAP || layout == VIEW_LAYOUT_ALL) {
+		setView(&views[count++], VIEW_MAP, (width - mapSize) / 2, margin,
+				mapSize, mapSize, 1);
+	}
+	if (layout == VIEW_LAYOUT_MIRROR || layout == VIEW_LAYOUT_ALL) {
+		setView(&views[count++], VIEW_MIRROR, (width - mirrorWidth) / 2,
+				height - mirrorHeight - margin, mirrorWidth, mirrorHeight, 1);
+	}
+	return count;
+}
+/**
+ * viewLayoutName
+ */
+const char* viewLayoutName(ViewLayout layout) {
+	return layout >= 0 && layout < VIEW_LAYOUT_COUNT ? layoutNames[layout] : "?";
+}
+/**
+ * viewProjection
+ * The projection of a view: perspective with the view's aspect, mirrored
+ * left to right for the mirror, and VIEW_MAP_RANGE either way of the
+ * middle without perspective for the map. fovY is in radians.
+ */
+void viewProjection(const View* view, float fovY, float nearZ, float farZ,
+		Mat4* out) {
+	float aspect = (float) view->width / view->height;
+	if (view->camera == VIEW_MAP) {
+		mat4Ortho(out, -VIEW_MAP_RANGE * aspect, VIEW_MAP_RANGE * aspect,
+				-VIEW_MAP_RANGE, VIEW_MAP_RANGE, nearZ, farZ);
+		return;
+	}
+	mat4Perspective(out, fovY, aspect, nearZ, farZ);
+	if (view->camera == VIEW_MIRROR) {
+		out->m[0] = -out->m[0];
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * view.h
+ * CG flight simulator
+ * Views drawn into one window, each with its own viewport and camera.
+ * A layout splits the window into views: the chase camera alone, beside
+ * the cockpit, under a rear view mirror or a map, or all of them.
+ * draw() does what every view shares once a frame (transforms, animation,
+ * the world bounds views are culled with), so a view only costs its
+ * camera, its culling and its draws.
+ */
+
+#ifndef VIEW_H_
+#define VIEW_H_
+#include "vecmath.h"
+
+#define VIEW_MAX 4
+//half the height of ground the map shows, world units
+#define VIEW_MAP_RANGE 60.0f
+//how far above the plane the map looks down from
+#define VIEW_MAP_HEIGHT 200.0f
+
+typedef enum ViewCamera {
+	VIEW_CHASE,
+	VIEW_COCKPIT,
+	//looks back from the cockpit, mirrored
+	VIEW_MIRROR,
+	//straight down with the heading up, without perspective
+	VIEW_MAP
+} ViewCamera;
+
+typedef enum ViewLayout {
+	VIEW_LAYOUT_CHASE,
+	VIEW_LAYOUT_SPLIT,
+	VIEW_LAYOUT_MIRROR,
+	VIEW_LAYOUT_MAP,
+	VIEW_LAYOUT_ALL,
+	VIEW_LAYOUT_COUNT
+} ViewLayout;
+
+typedef struct View {
+	ViewCamera camera;
+	//pixels from the bottom left of the window
+	int x;
+	int y;
+	int width;
+	int height;
+	//drawn over another view, which it clears its rectangle of first
+	int inset;
+} View;
+
+int viewLayout(ViewLayout layout, int width, int height, View views[VIEW_MAX]);
+const char* viewLayoutName(ViewLayout layout);
+void viewProjection(const View* view, float fovY, float nearZ, float farZ,
+		Mat4* out);
+
+#endif /* VIEW_H_ */
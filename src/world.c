@@ -0,0 +1,410 @@
+/**
+ * world.c
+ * CG flight simulator
+ * World state and simulation tick, see world.h.
+ * The arcade flight and bullets are the game's original update() logic,
+ * now applied to an explicit world instead of globals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+//float arguments use the float functions, as in the game's original tick
+#include <tgmath.h>
+#include "world.h"
+#include "timer.h"
+
+/**
+ * worldInit
+ * Prepares an empty world, call worldNew before stepping it.
+ * Returns 0 on failure.
+ */
+int worldInit(World* world) {
+	memset(world, 0, sizeof(World));
+	spatialInit(&world->spatial, SPATIAL_DEFAULT_CELL);
+	return flightCreate(&world->playerFlight, 1);
+}
+/**
+ * worldFree
+ */
+void worldFree(World* world) {
+	aiFree(&world->aiSwarm);
+	flightFree(&world->playerFlight);
+	terrainFree(&world->terrain);
+	spatialFree(&world->spatial);
+	arenaFree(&world->arena);
+}
+/**
+ * worldNew
+ * Starts a new world from a seed: reseeds the streams, clears the bullets,
+ * spawns the AI aircraft and puts the plane at the start. The flight model
+ * stays on if it was on. Terrain is left to worldGenerateTerrain.
+ */
+void worldNew(World* world, unsigned int seed, const SimContext* context) {
+	int i;
+	world->seed = seed;
+	world->tick = 0;
+	for (i = 0; i < RNG_STREAM_COUNT; i++) {
+		rngSeedStream(&world->rngStreams[i], seed, i, 0);
+	}
+	//the last generation's bullets and AI aircraft go all at once
+	aiFree(&world->aiSwarm);
+	arenaReset(&world->arena);
+	world->firstBullet = NULL;
+	world->currBullet = NULL;
+	world->freeBullets = NULL;
+	world->numBullets = 0;
+	world->maxNumBullets = context->maxBullets > 0 ? context->maxBullets
+			: WORLD_MAX_BULLETS;
+	//one more than the limit, a new bullet is added before the oldest goes
+	world->bulletPool = arenaAlloc(&world->arena,
+			sizeof(Bullet) * (world->maxNumBullets + 1));
+	world->bulletPoolUsed = 0;
+	if (world->bulletPool == NULL) {
+		printf("Could not allocate %u bullets.\n", world->maxNumBullets);
+	}
+	world->bulletSpeed = context->bulletSpeed > 0.0f ? context->bulletSpeed
+			: WORLD_BULLET_SPEED;
+	world->tickMs = context->tickMs > 0 ? context->tickMs : WORLD_TICK_MS;
+	world->targetScale = 1;
+
+	if (context->aiCount > 0
+			&& !aiCreateIn(&world->aiSwarm, context->aiCount, seed, &world->arena)) {
+		printf("Could not create %d AI aircraft.\n", context->aiCount);
+	}
+
+	world->eyeX = 0;
+	world->eyeY = 5;
+	world->eyeZ = -15;
+	world->atX = 0;
+	world->atY = 5;
+	world->atZ = -5;
+	world->upX = 0.0f;
+	world->upY = 1.0f;
+	world->upZ = 0.0f;
+	world->planeSpeed = 1.0f;
+	world->planeRotation = 0.0f;
+	world->planeTilt = 0.0f;
+	world->planeYawRotation = 0.0f;
+	world->propellerSpeed = WORLD_PROPELLER_IDLE_SPEED;
+	world->alive = 1;
+	world->exploding = 0;
+	world->explosionScale = 1.0f;
+	if (world->toggleFlightModel == 1) {
+		worldEnterFlightModel(world);
+	}
+	worldUpdateSpatial(world);
+}
+/**
+ * worldGenerateTerrain
+ * Generates the islands from the terrain stream.
+ */
+void worldGenerateTerrain(World* world, int mapSize, int islandCount) {
+	if (!terrainGenerate(&world->terrain, &world->rngStreams[RNG_TERRAIN],
+			mapSize, islandCount)) {
+		printf("Could not allocate the terrain.\n");
+	}
+}
+/**
+ * worldUpdateBullets
+ * Fires a bullet while shooting and moves every bullet.
+ */
+void worldUpdateBullets(World* world, const SimContext* context) {
+	//if shooting
+	if (context->boolShoot == 1 && world->bulletPool != NULL) {
+		//create a new bullet
+		Rng* weapons = &world->rngStreams[RNG_WEAPONS];
+		Bullet* bullet = world->freeBullets;
+		if (bullet != NULL) {
+			world->freeBullets = bullet->nextBullet;
+		} else {
+			bullet = &world->bulletPool[world->bulletPoolUsed++];
+		}
+		bullet->x = world->eyeX + (sin(world->planeRotation));
+		bullet->y = world->eyeY + (sin(world->planeYawRotation)) - 1;
+		bullet->z = world->eyeZ + (cos(world->planeRotation));
+		bullet->rotation = world->planeRotation
+				+ ((rngRange(weapons, 0, world->targetScale * 2) - (world->targetScale)) / 80.0f);
+		bullet->yaw = world->planeYawRotation
+				+ ((rngRange(weapons, 0, world->targetScale * 2) - (world->targetScale)) / 80.0f);
+		bullet->nextBullet = NULL;
+		//if its the first bullet
+		if (world->numBullets == 0) {
+			world->firstBullet = bullet;
+			world->currBullet = bullet;
+		} else {
+			//otherwise add to end of linked list
+			world->currBullet->nextBullet = bullet;
+			world->currBullet = bullet;
+		}
+		//count number of bullets
+		world->numBullets++;
+		//if more than allowed number of bullets
+		if (world->numBullets > world->maxNumBullets) {
+			//remove the first bullet and set the next in line as the new first
+			Bullet* oldest = world->firstBullet;
+			world->firstBullet = oldest->nextBullet;
+			oldest->nextBullet = world->freeBullets;
+			world->freeBullets = oldest;
+		}
+	}
+	//if there are bullets
+	if (world->numBullets > 0) {
+		//move them a bit based on bullet direction and speed
+		Bullet* bullet = world->firstBullet;
+		while (bullet != NULL) {
+			bullet->x += (sin(bullet->rotation) * (world->bulletSpeed));
+			bullet->z += (cos(bullet->rotation) * (world->bulletSpeed));
+			bullet->y += (sin(bullet->yaw) * (world->bulletSpeed));
+			bullet = bullet->nextBullet;
+		}
+	}
+}
+/**
+ * worldEnterFlightModel
+ * Hands the plane to the 6-DOF flight model in level flight at its current
+ * position and heading, no slower than cruise.
+ */
+void worldEnterFlightModel(World* world) {
+	//world units per second at the arcade model's speed
+	float speed = (world->planeSpeed + 1) / 10.0f * (1000.0f / world->tickMs);
+	if (speed < FLIGHT_CRUISE_SPEED) {
+		speed = FLIGHT_CRUISE_SPEED;
+	}
+	world->toggleFlightModel = 1;
+	flightPlace(&world->playerFlight, 0, world->eyeX, world->eyeY, world->eyeZ,
+			world->planeRotation, speed);
+	world->propellerSpeed = FLIGHT_CRUISE_THROTTLE * WORLD_PROPELLER_MAX_SPEED;
+	world->upX = 0.0f;
+	world->upY = 1.0f;
+	world->upZ = 0.0f;
+}
+/**
+ * worldLeaveFlightModel
+ * Returns the plane to the arcade model, level on its current heading.
+ */
+void worldLeaveFlightModel(World* world) {
+	world->toggleFlightModel = 0;
+	world->propellerSpeed = WORLD_PROPELLER_IDLE_SPEED;
+	world->upX = 0.0f;
+	world->upY = 1.0f;
+	world->upZ = 0.0f;
+	world->planeTilt = 0.0f;
+	world->planeYawRotation = 0.0f;
+	if (world->planeSpeed > PLAYER_MAX_SPEED) {
+		world->planeSpeed = PLAYER_MAX_SPEED;
+	} else if (world->planeSpeed < PLAYER_MIN_SPEED) {
+		world->planeSpeed = PLAYER_MIN_SPEED;
+	}
+	world->atX = world->eyeX + (sin(world->planeRotation) * 10.0f);
+	world->atY = world->eyeY;
+	world->atZ = world->eyeZ + (cos(world->planeRotation) * 10.0f);
+}
+/**
+ * updateFlightModel
+ * Turns the input into control surfaces and throttle, integrates the
+ * flight model and moves the camera with the result.
+ * The mouse picks a bank angle that the ailerons hold, so steering feels
+ * like the arcade model, while the elevator and throttle are direct.
+ */
+static void updateFlightModel(World* world, const SimContext* context) {
+	FlightBatch* flight = &world->playerFlight;
+	float centerX = context->inputWidth / 2.0f;
+	float distanceX = (centerX - context->lastMouseX) / context->inputWidth;
+	float forward[3], up[3];
+	float leftY, bank, aileron, elevator;
+
+	flightAxes(flight, 0, forward, up);
+	//height of the left wing tip, the y of up x forward
+	leftY = up[2] * forward[0] - up[0] * forward[2];
+	bank = atan2(leftY, up[1]);
+	aileron = (-distanceX * 1.5f - bank) * 2.0f - flight->wz[0] * 0.5f;
+	if (aileron > 1.0f) {
+		aileron = 1.0f;
+	} else if (aileron < -1.0f) {
+		aileron = -1.0f;
+	}
+	flight->aileron[0] = aileron;
+	flight->rudder[0] = aileron * 0.3f;
+
+	if (context->toggleAltControls == 0) {
+		elevator = context->boolMoveUp - context->boolMoveDown;
+		if (context->boolAccelerate == 1
+				&& world->propellerSpeed < WORLD_PROPELLER_MAX_SPEED) {
+			world->propellerSpeed += 0.2f;
+		} else if (context->boolDeaccelerate == 1 && world->propellerSpeed > 0.0f) {
+			world->propellerSpeed -= 0.2f;
+		}
+	} else {
+		float centerY = context->inputHeight / 2.0f;
+		float distanceY = (centerY - context->lastMouseY) / context->inputHeight;
+		elevator = distanceY * 4.0f;
+	}
+	//hold the nose up a little in turns
+	elevator += (1.0f - up[1]) * 0.5f;
+	if (elevator > 1.0f) {
+		elevator = 1.0f;
+	} else if (elevator < -1.0f) {
+		elevator = -1.0f;
+	}
+	flight->elevator[0] = elevator;
+	flight->throttle[0] = fmax(world->propellerSpeed, 0.0f) / WORLD_PROPELLER_MAX_SPEED;
+
+	flightStep(flight, world->tickMs / 1000.0f / WORLD_FLIGHT_SUBSTEPS,
+			WORLD_FLIGHT_SUBSTEPS);
+
+	flightAxes(flight, 0, forward, up);
+	world->eyeX = flight->x[0];
+	world->eyeY = flight->y[0];
+	world->eyeZ = flight->z[0];
+	world->atX = world->eyeX + forward[0] * 10.0f;
+	world->atY = world->eyeY + forward[1] * 10.0f;
+	world->atZ = world->eyeZ + forward[2] * 10.0f;
+	world->upX = up[0];
+	world->upY = up[1];
+	world->upZ = up[2];
+	//keep the arcade state current for bullets, the HUD and the checksum
+	world->planeRotation = atan2(forward[0], forward[2]);
+	world->planeYawRotation = asin(forward[1]);
+	world->planeSpeed = flightAirspeed(flight, 0) * (world->tickMs / 1000.0f) * 10.0f - 1;
+}
+/**
+ * worldStep
+ * Advances the world by one tick.
+ * Controls actual movement of camera and bullets
+ */
+void worldStep(World* world, const SimContext* context) {
+	world->universeTime += 1.0f;
+	world->tick++;
+
+	worldUpdateBullets(world, context);
+	//if alive update the state of camera/plane
+	if (world->alive == 1) {
+		//the crosshair grows while shooting, widening the bullet spread
+		if (context->boolShoot == 1) {
+			world->targetScale *= 1.3f;
+			if (world->targetScale > 1.5) {
+				world->targetScale = 1.5;
+			}
+		} else if (world->targetScale > 1.0f) {
+			world->targetScale *= 0.5f;
+		}
+
+		if (world->toggleFlightModel == 1) {
+			updateFlightModel(world, context);
+		} else {
+			float centerX = context->inputWidth / 2.0f;
+			float distanceX = (centerX - context->lastMouseX) / context->inputWidth;
+			world->planeRotation += distanceX / (10.5 * (world->planeSpeed + 1));
+
+			world->planeTilt = distanceX * 40.0f;
+
+			if (context->boolAccelerate == 1
+					&& world->planeSpeed <= PLAYER_MAX_SPEED - PLAYER_ACCELERATION) {
+				world->planeSpeed += PLAYER_ACCELERATION;
+			} else if (context->boolDeaccelerate == 1
+					&& world->planeSpeed >= PLAYER_MIN_SPEED + PLAYER_DECELERATION) {
+				world->planeSpeed -= PLAYER_DECELERATION;
+			}
+			//if alternate controls are enabled
+			if (context->toggleAltControls == 0) {
+				if (context->boolMoveUp == 1) {
+					world->eyeY += PLAYER_RISE_SPEED;
+					world->atY += PLAYER_RISE_SPEED;
+				} else if (context->boolMoveDown == 1) {
+					world->eyeY -= PLAYER_FALL_SPEED;
+					world->atY -= PLAYER_FALL_SPEED;
+				}
+			} else {
+				float centerY = context->inputHeight / 2.0f;
+				float distanceY = (centerY - context->lastMouseY) / context->inputHeight;
+				world->planeYawRotation += distanceY / (20 * (world->planeSpeed + 1));
+				if (world->planeYawRotation > 1) {
+					world->planeYawRotation = 1;
+				} else if (world->planeYawRotation < -1) {
+					world->planeYawRotation = -1;
+				}
+
+				world->eyeY += (sin(world->planeYawRotation) * (world->planeSpeed + 1)) / 10.0f;
+				world->atY = world->eyeY + (sin(world->planeYawRotation) * 10.0f);
+
+			}
+			//move the camera based on circles using plane speed as the radius
+			world->eyeX += (sin(world->planeRotation) * (world->planeSpeed + 1)) / 10.0f;
+			world->eyeZ += (cos(world->planeRotation) * (world->planeSpeed + 1)) / 10.0f;
+			//always look 10 units ahead
+			world->atX = world->eyeX + (sin(world->planeRotation) * 10.0f);
+			world->atZ = world->eyeZ + (cos(world->planeRotation) * 10.0f);
+		}
+		if (world->eyeY < PLAYER_MIN_ALTITUDE) {
+			world->alive = 0;
+			world->explosionScale = 0.0f;
+			world->exploding = 1;
+			world->eyeY = PLAYER_MIN_ALTITUDE;
+		}
+	}
+	if (world->aiSwarm.count > 0) {
+		//the player is what evading aircraft run from
+		double aiStart = timerNow();
+		aiUpdate(&world->aiSwarm, world->eyeX, world->eyeY, world->eyeZ);
+		world->aiUpdateTime += ((timerNow() - aiStart) - world->aiUpdateTime) * 0.1f;
+	}
+	worldUpdateSpatial(world);
+}
+/**
+ * worldUpdateSpatial
+ * Rebuilds the spatial hash from where everything is now. Bullets are
+ * indexed by their place in the list, oldest first.
+ */
+void worldUpdateSpatial(World* world) {
+	Bullet* bullet = world->firstBullet;
+	int i = 0;
+	spatialClear(&world->spatial);
+	if (world->alive == 1) {
+		spatialInsert(&world->spatial, SPATIAL_PLAYER, 0, world->eyeX,
+				world->eyeY, world->eyeZ);
+	}
+	spatialInsertMany(&world->spatial, SPATIAL_AI, world->aiSwarm.count,
+			world->aiSwarm.x, world->aiSwarm.y, world->aiSwarm.z);
+	while (bullet != NULL) {
+		spatialInsert(&world->spatial, SPATIAL_BULLET, i++, bullet->x, bullet->y,
+				bullet->z);
+		bullet = bullet->nextBullet;
+	}
+	spatialBuild(&world->spatial);
+}
+/**
+ * worldChecksum
+ * Hashes the simulation state so replays can be compared between builds.
+ */
+unsigned int worldChecksum(const World* world) {
+	unsigned int hash = 2166136261u;
+	float values[8] = { world->eyeX, world->eyeY, world->eyeZ,
+			world->planeRotation, world->planeYawRotation, world->planeSpeed,
+			world->alive, world->numBullets };
+	unsigned char* bytes = (unsigned char*) values;
+	unsigned int i;
+	for (i = 0; i < sizeof(values); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	Bullet* bullet = world->firstBullet;
+	while (bullet != NULL) {
+		float position[3] = { bullet->x, bullet->y, bullet->z };
+		bytes = (unsigned char*) position;
+		for (i = 0; i < sizeof(position); i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		bullet = bullet->nextBullet;
+	}
+	//AI positions, so thread count must not change the replay
+	bytes = (unsigned char*) world->aiSwarm.x;
+	for (i = 0; i < world->aiSwarm.count * sizeof(float); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	bytes = (unsigned char*) world->aiSwarm.z;
+	for (i = 0; i < world->aiSwarm.count * sizeof(float); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
@@ -0,0 +1,128 @@
+/*
+ * world.h
+ * CG flight simulator
+ * Simulation state of one world and the tick that advances it.
+ * A World owns everything the simulation changes (plane, camera, bullets,
+ * AI aircraft, random streams, terrain), a SimContext holds what it reads
+ * each tick (held keys, mouse, window size, control scheme). Neither uses
+ * globals, so any number of worlds can run side by side, one per thread.
+ * What a world generation allocates (bullets, AI aircraft) comes from the
+ * world's arena, so worldNew drops the last generation in one reset and a
+ * running world does not allocate once its arena has grown to fit.
+ */
+
+#ifndef WORLD_H_
+#define WORLD_H_
+#include "rng.h"
+#include "ai.h"
+#include "flight.h"
+#include "player.h"
+#include "terrain.h"
+#include "spatial.h"
+
+#define WORLD_TICK_MS 15
+#define WORLD_MAX_BULLETS 100
+#define WORLD_BULLET_SPEED 4.0f
+//fixed flight model steps per tick
+#define WORLD_FLIGHT_SUBSTEPS 2
+//propellerSpeed at full throttle in the flight model
+#define WORLD_PROPELLER_MAX_SPEED 20.0f
+//propellerSpeed of the arcade model
+#define WORLD_PROPELLER_IDLE_SPEED -8.0f
+
+typedef struct Bullet Bullet;
+struct Bullet {
+	float x;
+	float y;
+	float z;
+	float rotation;
+	float yaw;
+	Bullet* nextBullet;
+};
+
+typedef struct SimContext {
+	int boolAccelerate;
+	int boolDeaccelerate;
+	int boolMoveUp;
+	int boolMoveDown;
+	int boolShoot;
+	int toggleAltControls;
+	//mouse position in a window of inputWidth x inputHeight
+	int lastMouseX;
+	int lastMouseY;
+	int inputWidth;
+	int inputHeight;
+	//AI aircraft spawned with each new world
+	int aiCount;
+	//bullet limit and speed and the tick length of new worlds, 0 for the
+	//WORLD_ defaults
+	int maxBullets;
+	float bulletSpeed;
+	int tickMs;
+} SimContext;
+
+typedef struct World {
+	unsigned int seed;
+	//ticks since the world was made
+	unsigned int tick;
+	//one random stream per subsystem, seeded from the world seed
+	Rng rngStreams[RNG_STREAM_COUNT];
+	float universeTime;
+	double eyeX;
+	double eyeY;
+	double eyeZ;
+	double atX;
+	double atY;
+	double atZ;
+	//camera up, follows the aircraft's roll in the flight model
+	float upX;
+	float upY;
+	float upZ;
+	int alive;
+	int exploding;
+	float explosionScale;
+	float planeSpeed;
+	float planeRotation;
+	float planeYawRotation;
+	float planeTilt;
+	float propellerSpeed;
+	//6-DOF flight model instead of the arcade model
+	int toggleFlightModel;
+	FlightBatch playerFlight;
+	//bullets in flight oldest first, taken from the pool and returned to
+	//freeBullets when dropped
+	Bullet* firstBullet;
+	Bullet* currBullet;
+	Bullet* freeBullets;
+	Bullet* bulletPool;
+	unsigned int bulletPoolUsed;
+	//bullets fired, those in flight are the last maxNumBullets of them
+	unsigned int numBullets;
+	unsigned int maxNumBullets;
+	float bulletSpeed;
+	//length of a tick, the flight model's time step
+	int tickMs;
+	float targetScale;
+	AiSwarm aiSwarm;
+	//seconds, smoothed
+	float aiUpdateTime;
+	//islands, only generated for worlds that are drawn
+	Terrain terrain;
+	//the player, AI aircraft and bullets as of the end of the last tick
+	SpatialHash spatial;
+	//what this generation of the world allocated, reset by worldNew
+	Arena arena;
+} World;
+
+int worldInit(World* world);
+void worldFree(World* world);
+void worldNew(World* world, unsigned int seed, const SimContext* context);
+void worldStep(World* world, const SimContext* context);
+void worldUpdateBullets(World* world, const SimContext* context);
+void worldUpdateSpatial(World* world);
+void worldEnterFlightModel(World* world);
+void worldLeaveFlightModel(World* world);
+void worldGenerateTerrain(World* world, int mapSize, int islandCount);
+unsigned int worldChecksum(const World* world);
+
+#endif /* WORLD_H_ */
@@ -0,0 +1,216 @@
+/**
+ * worldCache.c
+ * CG flight simulator
+ * World cache files, see worldCache.h.
+ * A file is a header with the key, the islands' scales, every island's
+ * heights, jitterX and jitterZ as they are laid out in memory, then the
+ * island meshes. It is mapped read only, so loading copies the small height
+ * maps into the terrain and hands the mesh straight to the GL upload.
+ * Files are written to a temporary name and renamed, a reader never sees
+ * half of one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "worldCache.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define WORLD_CACHE_MAGIC "FSWORLD"
+
+typedef struct WorldCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t seed;
+	int32_t mapSize;
+	float erosion;
+	int32_t vertexFloats;
+	int32_t islands;
+	uint64_t numVertexFloats;
+	//scaleX, scaleY, scaleZ of each island
+	float scales[TERRAIN_MAX_ISLANDS * 3];
+} WorldCacheHeader;
+
+/**
+ * cachePath
+ */
+static void cachePath(char* path, size_t size, const char* dir,
+		unsigned int seed) {
+	snprintf(path, size, "%s/world_%u.cache", dir, seed);
+}
+/**
+ * mapBytes
+ * Bytes of one island's heights and jitter.
+ */
+static size_t mapBytes(int mapSize) {
+	return sizeof(float) * mapSize * mapSize * 3;
+}
+/**
+ * mapFile
+ * Maps a whole file read only, or reads it where mapping is not available.
+ * Returns NULL if it could not.
+ */
+static void* mapFile(const char* path, size_t* size) {
+#ifdef _WIN32
+	FILE* file = fopen(path, "rb");
+	void* data = NULL;
+	long length;
+	if (file == NULL) {
+		return NULL;
+	}
+	if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) > 0
+			&& fseek(file, 0, SEEK_SET) == 0) {
+		data = malloc(length);
+		if (data != NULL && fread(data, 1, length, file) != (size_t) length) {
+			free(data);
+			data = NULL;
+		}
+		*size = length;
+	}
+	fclose(file);
+	return data;
+#else
+	struct stat status;
+	void* data;
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		return NULL;
+	}
+	if (fstat(file, &status) != 0 || status.st_size <= 0) {
+		close(file);
+		return NULL;
+	}
+	data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	//the mapping keeps the file alive
+	close(file);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	*size = status.st_size;
+	return data;
+#endif
+}
+/**
+ * worldCacheClose
+ * Releases a loaded cache file.
+ */
+void worldCacheClose(WorldCache* cache) {
+	if (cache->mapping != NULL) {
+#ifdef _WIN32
+		free(cache->mapping);
+#else
+		munmap(cache->mapping, cache->size);
+#endif
+	}
+	memset(cache, 0, sizeof(WorldCache));
+}
+/**
+ * worldCacheLoad
+ * Maps the cached world for key and fills terrain from it, leaving the
+ * meshes mapped in cache until worldCacheClose. Returns 0 if there is no
+ * cached world for the key, the terrain is then left alone.
+ */
+int worldCacheLoad(WorldCache* cache, const char* dir,
+		const WorldCacheKey* key, Terrain* terrain) {
+	char path[1024];
+	const WorldCacheHeader* header;
+	const char* maps;
+	int i;
+	memset(cache, 0, sizeof(WorldCache));
+	cachePath(path, sizeof(path), dir, key->seed);
+	cache->mapping = mapFile(path, &cache->size);
+	if (cache->mapping == NULL) {
+		return 0;
+	}
+	header = cache->mapping;
+	if (cache->size < sizeof(WorldCacheHeader)
+			|| memcmp(header->magic, WORLD_CACHE_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != WORLD_CACHE_VERSION
+			|| header->seed != key->seed || header->mapSize != key->mapSize
+			|| header->erosion != key->erosion
+			|| header->vertexFloats != key->vertexFloats
+			|| header->islands != key->islands
+			|| cache->size != sizeof(WorldCacheHeader)
+					+ mapBytes(key->mapSize) * key->islands
+					+ sizeof(float) * header->numVertexFloats
+			|| !terrainAllocate(terrain, key->mapSize, key->islands)) {
+		worldCacheClose(cache);
+		return 0;
+	}
+	maps = (const char*) cache->mapping + sizeof(WorldCacheHeader);
+	for (i = 0; i < key->islands; i++) {
+		Island* island = &terrain->islands[i];
+		size_t bytes = mapBytes(key->mapSize);
+		island->scaleX = header->scales[i * 3];
+		island->scaleY = header->scales[i * 3 + 1];
+		island->scaleZ = header->scales[i * 3 + 2];
+		memcpy(island->heights, maps + bytes * i, bytes);
+	}
+	cache->vertices = (const float*) (maps + mapBytes(key->mapSize) * key->islands);
+	cache->numVertexFloats = header->numVertexFloats;
+	return 1;
+}
+/**
+ * worldCacheSave
+ * Writes terrain and its meshes as the cached world for key, replacing any
+ * older file. Returns 0 if it could not be written.
+ */
+int worldCacheSave(const char* dir, const WorldCacheKey* key,
+		const Terrain* terrain, const float* vertices, size_t numVertexFloats) {
+	char path[1024];
+	char temporary[1040];
+	WorldCacheHeader header;
+	FILE* file;
+	int ok;
+	int i;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, WORLD_CACHE_MAGIC, sizeof(header.magic));
+	header.version = WORLD_CACHE_VERSION;
+	header.seed = key->seed;
+	header.mapSize = key->mapSize;
+	header.erosion = key->erosion;
+	header.vertexFloats = key->vertexFloats;
+	header.islands = key->islands;
+	header.numVertexFloats = numVertexFloats;
+	for (i = 0; i < key->islands; i++) {
+		header.scales[i * 3] = terrain->islands[i].scaleX;
+		header.scales[i * 3 + 1] = terrain->islands[i].scaleY;
+		header.scales[i * 3 + 2] = terrain->islands[i].scaleZ;
+	}
+#ifdef _WIN32
+	_mkdir(dir);
+#else
+	mkdir(dir, 0755);
+#endif
+	cachePath(path, sizeof(path), dir, key->seed);
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+	file = fopen(temporary, "wb");
+	if (file == NULL) {
+		return 0;
+	}
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (i = 0; i < key->islands && ok; i++) {
+		ok = fwrite(terrain->islands[i].heights, mapBytes(key->mapSize), 1,
+				file) == 1;
+	}
+	ok = ok && fwrite(vertices, sizeof(float), numVertexFloats, file)
+			== numVertexFloats;
+	ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+	//rename does not replace on Windows
+	remove(path);
+#endif
+	if (!ok || rename(temporary, path) != 0) {
+		remove(temporary);
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,46 @@
+/*
+ * worldCache.h
+ * CG flight simulator
+ * On-disk cache of generated worlds.
+ * A world's islands (heights, jitter and scales) and the island meshes
+ * built from them are written to "<dir>/world_<seed>.cache" and mapped back
+ * the next time that seed is asked for with the same generation parameters,
+ * instead of generating, eroding and building them again. A file written
+ * with other parameters or by another cache version is regenerated and
+ * overwritten. Files are in the byte order of the machine that wrote them.
+ */
+
+#ifndef WORLDCACHE_H_
+#define WORLDCACHE_H_
+#include <stddef.h>
+#include "terrain.h"
+
+//bump whenever generation, erosion or the island vertex layout changes, so
+//old files are regenerated instead of showing different islands
+#define WORLD_CACHE_VERSION 2
+
+typedef struct WorldCacheKey {
+	unsigned int seed;
+	int mapSize;
+	int islands;
+	//erosion droplets per cell, 0 for none
+	float erosion;
+	//floats per island mesh vertex
+	int vertexFloats;
+} WorldCacheKey;
+
+typedef struct WorldCache {
+	void* mapping;
+	size_t size;
+	//island meshes, one after another, valid until worldCacheClose
+	const float* vertices;
+	size_t numVertexFloats;
+} WorldCache;
+
+int worldCacheLoad(WorldCache* cache, const char* dir,
+		const WorldCacheKey* key, Terrain* terrain);
+void worldCacheClose(WorldCache* cache);
+int worldCacheSave(const char* dir, const WorldCacheKey* key,
+		const Terrain* terrain, const float* vertices, size_t numVertexFloats);
+
+#endif /* WORLDCACHE_H_ */
@@ -4,13 +4,130 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
-../src/OGLFlightSim.c 
+../src/OGLFlightSim.c \
+../src/ai.c \
+../src/aircraftRenderer.c \
+../src/archipelago.c \
+../src/arena.c \
+../src/batch.c \
+../src/bench.c \
+../src/benchModes.c \
+../src/bots.c \
+../src/capture.c \
+../src/client.c \
+../src/config.c \
+../src/erosion.c \
+../src/flight.c \
+../src/glFunctions.c \
+../src/governor.c \
+../src/hud.c \
+../src/jobs.c \
+../src/latency.c \
+../src/minimap.c \
+../src/model.c \
+../src/net.c \
+../src/player.c \
+../src/record.c \
+../src/rng.c \
+../src/server.c \
+../src/shader.c \
+../src/simplify.c \
+../src/snapshot.c \
+../src/spatial.c \
+../src/telemetry.c \
+../src/terrain.c \
+../src/texture.c \
+../src/timer.c \
+../src/transform.c \
+../src/vecmath.c \
+../src/vertexCache.c \
+../src/view.c \
+../src/world.c \
+../src/worldCache.c 
 
 OBJS += \
-./src/OGLFlightSim.o 
+./src/OGLFlightSim.o \
+./src/ai.o \
+./src/aircraftRenderer.o \
+./src/archipelago.o \
+./src/arena.o \
+./src/batch.o \
+./src/bench.o \
+./src/benchModes.o \
+./src/bots.o \
+./src/capture.o \
+./src/client.o \
+./src/config.o \
+./src/erosion.o \
+./src/flight.o \
+./src/glFunctions.o \
+./src/governor.o \
+./src/hud.o \
+./src/jobs.o \
+./src/latency.o \
+./src/minimap.o \
+./src/model.o \
+./src/net.o \
+./src/player.o \
+./src/record.o \
+./src/rng.o \
+./src/server.o \
+./src/shader.o \
+./src/simplify.o \
+./src/snapshot.o \
+./src/spatial.o \
+./src/telemetry.o \
+./src/terrain.o \
+./src/texture.o \
+./src/timer.o \
+./src/transform.o \
+./src/vecmath.o \
+./src/vertexCache.o \
+./src/view.o \
+./src/world.o \
+./src/worldCache.o 
 
 C_DEPS += \
-./src/OGLFlightSim.d 
+./src/OGLFlightSim.d \
+./src/ai.d \
+./src/aircraftRenderer.d \
+./src/archipelago.d \
+./src/arena.d \
+./src/batch.d \
+./src/bench.d \
+./src/benchModes.d \
+./src/bots.d \
+./src/capture.d \
+./src/client.d \
+./src/config.d \
+./src/erosion.d \
+./src/flight.d \
+./src/glFunctions.d \
+./src/governor.d \
+./src/hud.d \
+./src/jobs.d \
+./src/latency.d \
+./src/minimap.d \
+./src/model.d \
+./src/net.d \
+./src/player.d \
+./src/record.d \
+./src/rng.d \
+./src/server.d \
+./src/shader.d \
+./src/simplify.d \
+./src/snapshot.d \
+./src/spatial.d \
+./src/telemetry.d \
+./src/terrain.d \
+./src/texture.d \
+./src/timer.d \
+./src/transform.d \
+./src/vecmath.d \
+./src/vertexCache.d \
+./src/view.d \
+./src/world.d \
+./src/worldCache.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes